@@ -17,10 +17,10 @@ d1 = d1a + d1b*j;
 DataToGRC('dualFRS1', d1,'complex');
 
 d2a = FRSdual{:,3}';
-d2a = d1a/mean(abs(d2a));
+d2a = d2a/mean(abs(d2a));
 
 d2b = FRSdual{:,4}';
-d2b = d1b/mean(abs(d2b));
+d2b = d2b/mean(abs(d2b));
 
 d2 = d2a + d2b*j;
 DataToGRC('dualFRS2', d2,'complex');
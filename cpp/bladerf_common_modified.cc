@@ -110,6 +110,65 @@ static bool _is_tx(bladerf_channel ch)
   return (1 == (ch & BLADERF_DIRECTION_MASK));
 }
 
+/* Settings that are only written when they change */
+enum _setting_kind {
+  SETTING_SAMPLE_RATE,
+  SETTING_FREQUENCY,
+  SETTING_BANDWIDTH,
+  SETTING_GAIN
+};
+
+/* What was last requested of each setting on a device, and what the
+ * hardware read back once it was in place. The hardware rounds, so the
+ * read-back seldom equals the request; a request is skipped only when it
+ * repeats the last one and the read-back has not changed since. Entries
+ * are keyed by serial number, so they outlive a close and reopen of the
+ * device within this process; a stale one can only fail to match. */
+struct _setting {
+  double requested;
+  double actual;
+};
+
+typedef std::pair<std::string, std::pair<int, bladerf_channel> >
+  _setting_key;
+
+static boost::mutex _settings_mutex;
+static std::map<_setting_key, struct _setting> _settings;
+
+static _setting_key _key(struct bladerf *dev, _setting_kind kind,
+                         bladerf_channel ch)
+{
+  char serial[BLADERF_SERIAL_LENGTH];
+
+  if (bladerf_get_serial(dev, serial) != 0) {
+    serial[0] = '\0';
+  }
+  return std::make_pair(std::string(serial), std::make_pair((int)kind, ch));
+}
+
+static bool _is_set(struct bladerf *dev, _setting_kind kind,
+                    bladerf_channel ch, double requested, double actual)
+{
+  _setting_key key = _key(dev, kind, ch);
+  boost::unique_lock<boost::mutex> lock(_settings_mutex);
+  std::map<_setting_key, struct _setting>::const_iterator it =
+    _settings.find(key);
+
+  return !key.first.empty() && it != _settings.end() &&
+         it->second.requested == requested && it->second.actual == actual;
+}
+
+static void _remember_set(struct bladerf *dev, _setting_kind kind,
+                          bladerf_channel ch, double requested, double actual)
+{
+  _setting_key key = _key(dev, kind, ch);
+  boost::unique_lock<boost::mutex> lock(_settings_mutex);
+  struct _setting &s = _settings[key];
+
+  s.requested = requested;
+  s.actual = actual;
+}
+
 size_t num_streams(bladerf_channel_layout layout)
 {
 #ifdef BLADERF_COMPATIBILITY
@@ -320,6 +379,12 @@ void bladerf_common::init(dict_t const &dict, bladerf_direction direction)
     _format = BLADERF_FORMAT_SC16_Q11_META;
   }
 
+  /* 8-bit samples halve the USB bandwidth; needs FPGA support */
+  if (dict.count("sc8") > 0) {
+    _format = (_format == BLADERF_FORMAT_SC16_Q11_META) ?
+              BLADERF_FORMAT_SC8_Q7_META : BLADERF_FORMAT_SC8_Q7;
+  }
+
   /* Require value to be >= 2 so we can ensure we have twice as many
    * buffers as transfers */
   if (_num_buffers <= 1) {
@@ -554,6 +619,12 @@ double bladerf_common::set_sample_rate(double rate, bladerf_channel ch)
   int status;
   struct bladerf_rational_rate rational_rate, actual;
 
+  /* Changing the rate resets the RFIC filters; skip it when nothing changes */
+  double current = get_sample_rate(ch);
+  if (_is_set(_dev.get(), SETTING_SAMPLE_RATE, ch, rate, current)) {
+    return current;
+  }
+
   rational_rate.integer = static_cast<uint32_t>(rate);
   rational_rate.den = 1;
   rational_rate.num = (rate - rational_rate.integer) * rational_rate.den;
@@ -566,6 +637,9 @@ double bladerf_common::set_sample_rate(double rate, bladerf_channel ch)
     BLADERF_THROW_STATUS(status, "Failed to set sample rate");
   }
 
+  /* get_sample_rate() reads back the integer part */
+  _remember_set(_dev.get(), SETTING_SAMPLE_RATE, ch, rate, actual.integer);
+
   return actual.integer + (actual.num / static_cast<double>(actual.den));
 }
 
@@ -610,7 +684,14 @@ double bladerf_common::set_center_freq(double freq, bladerf_channel ch)
   int status;
   uint64_t freqint = static_cast<uint64_t>(freq + 0.5);
 
+  /* already tuned; a retune would only cost a PLL lock */
+  double current = get_center_freq(ch);
+  if (_is_set(_dev.get(), SETTING_FREQUENCY, ch, freqint, current)) {
+    return current;
+  }
+
   /* Check frequency range */
+  bool tuned = false;
   if (freqint < freq_range(ch).start() || freqint > freq_range(ch).stop()) {
     BLADERF_WARNING(boost::str(boost::format("Frequency %d Hz is outside "
                     "range, ignoring") % freqint));
@@ -620,11 +701,17 @@ double bladerf_common::set_center_freq(double freq, bladerf_channel ch)
       BLADERF_THROW_STATUS(status, boost::str(boost::format("Failed to set center "
                     "frequency to %d Hz") % freqint));
     }
+    tuned = true;
   }
 
   bladerf_common::get_sample_rate(ch);
 
-  return get_center_freq(ch);
+  current = get_center_freq(ch);
+  if (tuned) {
+    _remember_set(_dev.get(), SETTING_FREQUENCY, ch, freqint, current);
+  }
+
+  return current;
 }
 
 double bladerf_common::get_center_freq(bladerf_channel ch)
@@ -681,12 +768,20 @@ double bladerf_common::set_bandwidth(double bandwidth, bladerf_channel ch)
 
   bwint = static_cast<uint32_t>(bandwidth + 0.5);
 
-  status = bladerf_set_bandwidth(_dev.get(), ch, bwint, NULL);
+  double current = get_bandwidth(ch);
+  if (_is_set(_dev.get(), SETTING_BANDWIDTH, ch, bwint, current)) {
+    return current;
+  }
+
+  uint32_t actual;
+  status = bladerf_set_bandwidth(_dev.get(), ch, bwint, &actual);
   if (status != 0) {
     BLADERF_THROW_STATUS(status, "could not set bandwidth");
   }
 
-  return get_bandwidth(ch);
+  _remember_set(_dev.get(), SETTING_BANDWIDTH, ch, bwint, actual);
+
+  return actual;
 }
 
 double bladerf_common::get_bandwidth(bladerf_channel ch)
@@ -814,6 +909,19 @@ double bladerf_common::set_gain(double gain,
 {
   int status;
 
+#ifndef BLADERF_COMPATIBILITY
+  /* Only the overall gain is cached; setting a stage changes what it
+   * reads back, which is enough to invalidate the entry */
+  bool system = (name == SYSTEM_GAIN_NAME);
+  double current = 0;
+  if (system) {
+    current = get_gain(name, ch);
+    if (_is_set(_dev.get(), SETTING_GAIN, ch, gain, current)) {
+      return current;
+    }
+  }
+#endif
+
 #ifdef BLADERF_COMPATIBILITY
   if( name == "LNA" ) {
     bladerf_lna_gain g;
@@ -853,6 +961,16 @@ double bladerf_common::set_gain(double gain,
                          "gain for stage '%s'") % name));
   }
 
+#ifndef BLADERF_COMPATIBILITY
+  if (system) {
+    current = get_gain(name, ch);
+    if (status == 0) {
+      _remember_set(_dev.get(), SETTING_GAIN, ch, gain, current);
+    }
+    return current;
+  }
+#endif
+
   return get_gain(name, ch);
 }
 
@@ -28,13 +28,21 @@
 #include "config.h"
 #endif
 
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <vector>
 
 #include <boost/assign.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/format.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <gnuradio/io_signature.h>
+#include <pmt/pmt.h>
 
 #include <volk/volk.h>
 
@@ -44,6 +52,126 @@
 
 using namespace boost::assign;
 
+/* Full scale of SC8_Q7 samples */
+static const float SC8_SCALING_FACTOR = 128.0f;
+
+/* How long work() waits on a stream restart before handing out the time
+ * it has taken so far as zeros */
+static const unsigned int RESTART_POLL_MS = 10;
+
+/* Wait ahead of a retry after a failed restart, doubling up to the max */
+static const unsigned int MIN_BACKOFF_MS = 50;
+static const unsigned int MAX_BACKOFF_MS = 2000;
+
+/* What a stream restart needs, copied so it can run off work()'s thread */
+struct rx_restart {
+  boost::shared_ptr<struct bladerf> dev;
+  std::vector<bladerf_channel> channels;
+  bladerf_channel_layout layout;
+  bladerf_format format;
+  unsigned int num_buffers;
+  unsigned int samples_per_buffer;
+  unsigned int num_transfers;
+  unsigned int stream_timeout;
+};
+
+/* An RX outage of one running source: the restart thread, and the zero
+ * frames that stand in for the time the stream was down. The wall clock
+ * time that passes is turned into frames at the sample rate, so the
+ * output keeps its timeline. Kept here rather than in the class, whose
+ * header is not part of this patch. */
+struct rx_outage {
+  boost::shared_ptr<boost::thread> restart;
+  int restart_status;          /* of the last restart, once joined */
+  unsigned int backoff_ms;     /* wait ahead of the next restart */
+  bool down;                   /* receives are failing */
+  double samp_rate;
+  boost::posix_time::ptime last_good;  /* end of the last good receive */
+  boost::posix_time::ptime accounted;  /* end of the time owed covers */
+  uint64_t owed;               /* zero frames not handed out yet */
+  std::vector<char> pending;   /* samples received behind those zeros */
+  size_t pending_frames;
+  size_t pending_offset;
+};
+
+static boost::mutex _outages_mutex;
+static std::map<const void *, boost::shared_ptr<struct rx_outage> > _outages;
+
+static boost::posix_time::ptime _now()
+{
+  return boost::posix_time::microsec_clock::universal_time();
+}
+
+static boost::shared_ptr<struct rx_outage> _outage(const void *src)
+{
+  boost::unique_lock<boost::mutex> lock(_outages_mutex);
+  boost::shared_ptr<struct rx_outage> &o = _outages[src];
+
+  if (!o) {
+    o.reset(new rx_outage);
+    o->restart_status = 0;
+    o->backoff_ms = 0;
+    o->down = false;
+    o->samp_rate = 0;
+    o->last_good = _now();
+    o->accounted = o->last_good;
+    o->owed = 0;
+    o->pending_frames = 0;
+    o->pending_offset = 0;
+  }
+  return o;
+}
+
+static boost::shared_ptr<struct rx_outage> _take_outage(const void *src)
+{
+  boost::unique_lock<boost::mutex> lock(_outages_mutex);
+  boost::shared_ptr<struct rx_outage> o;
+  std::map<const void *, boost::shared_ptr<struct rx_outage> >::iterator it =
+    _outages.find(src);
+
+  if (it != _outages.end()) {
+    o = it->second;
+    _outages.erase(it);
+  }
+  return o;
+}
+
+/* Owe zero frames for the time from o.accounted up to t */
+static void _account(struct rx_outage &o, boost::posix_time::ptime t)
+{
+  double seconds = (t - o.accounted).total_microseconds() * 1e-6;
+
+  if (seconds > 0) {
+    o.owed += static_cast<uint64_t>(seconds * o.samp_rate);
+    o.accounted = t;
+  }
+}
+
+/* Runs on its own thread so the flowgraph keeps moving meanwhile */
+static void _restart_stream(boost::shared_ptr<struct rx_outage> o,
+                            struct rx_restart r, unsigned int backoff_ms)
+{
+  int status;
+
+  if (backoff_ms > 0) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(backoff_ms));
+  }
+
+  for (size_t i = 0; i < r.channels.size(); ++i) {
+    bladerf_enable_module(r.dev.get(), r.channels[i], false);
+  }
+
+  status = bladerf_sync_config(r.dev.get(), r.layout, r.format,
+                               r.num_buffers, r.samples_per_buffer,
+                               r.num_transfers, r.stream_timeout);
+
+  for (size_t i = 0; status == 0 && i < r.channels.size(); ++i) {
+    status = bladerf_enable_module(r.dev.get(), r.channels[i], true);
+  }
+
+  o->restart_status = status;
+}
+
 /******************************************************************************
  * Functions
  ******************************************************************************/
@@ -244,6 +372,10 @@ bool bladerf_source_c::start()
   _16icbuf = reinterpret_cast<int16_t *>(volk_malloc(4*_samples_per_buffer*sizeof(int16_t), alignment));
   _32fcbuf = reinterpret_cast<gr_complex *>(volk_malloc(2*_samples_per_buffer*sizeof(gr_complex), alignment));
 
+  _take_outage(this);
+  _outage(this)->samp_rate = get_sample_rate();
+  _failures = 0;
+
   _running = true;
 
   return true;
@@ -264,6 +396,12 @@ bool bladerf_source_c::stop()
 
   _running = false;
 
+  /* A restart still in flight must be done with the device first */
+  boost::shared_ptr<struct rx_outage> outage = _take_outage(this);
+  if (outage && outage->restart) {
+    outage->restart->join();
+  }
+
   for (size_t ch = 0; ch < get_max_channels(); ++ch) {
     bladerf_channel brfch = BLADERF_CHANNEL_RX(ch);
     if (get_channel_enable(brfch)) {
@@ -300,53 +438,170 @@ int bladerf_source_c::work(int noutput_items,
   }
 
   // set up metadata
-  if (BLADERF_FORMAT_SC16_Q11_META == _format) {
+  if (BLADERF_FORMAT_SC16_Q11_META == _format ||
+      BLADERF_FORMAT_SC8_Q7_META == _format) {
     memset(&meta, 0, sizeof(meta));
     meta.flags = BLADERF_META_FLAG_RX_NOW;
     meta_ptr = &meta;
   }
 
-  // grab samples into temp buffer
-  if(nstreams > 1)
-    status = bladerf_sync_rx(_dev.get(), static_cast<void *>(_16icbuf), 2 * noutput_items, meta_ptr, _stream_timeout);
-  else
-    status = bladerf_sync_rx(_dev.get(), static_cast<void *>(_16icbuf), noutput_items, meta_ptr, _stream_timeout);
+  boost::shared_ptr<struct rx_outage> o = _outage(this);
+  size_t frame_bytes = 2 * nstreams *
+                       ((BLADERF_FORMAT_SC8_Q7 == _format ||
+                         BLADERF_FORMAT_SC8_Q7_META == _format) ?
+                        sizeof(int8_t) : sizeof(int16_t));
+  size_t nframes = 0;
+
+  // see whether a stream restart has finished
+  if (o->restart &&
+      o->restart->timed_join(boost::posix_time::milliseconds(RESTART_POLL_MS))) {
+    o->restart.reset();
+    if (o->restart_status == 0) {
+      BLADERF_INFO("RX stream restarted");
+      o->backoff_ms = 0;
+    } else {
+      BLADERF_WARNING(boost::str(boost::format("stream restart failed: %s")
+                      % bladerf_strerror(o->restart_status)));
+      o->backoff_ms = std::min(std::max(2 * o->backoff_ms, MIN_BACKOFF_MS),
+                               MAX_BACKOFF_MS);
+    }
+  }
 
-  if (status != 0) {
-    BLADERF_WARNING(boost::str(boost::format("bladerf_sync_rx error: %s")
-                    % bladerf_strerror(status)));
-    ++_failures;
+  if (o->owed > 0 || o->pending_frames > 0) {
+    // an earlier outage is still being handed out
+  } else if (o->restart) {
+    // the device is being restarted; the time that takes is lost
+    _account(*o, _now());
+  } else {
+    // grab samples into temp buffer
+    if(nstreams > 1)
+      status = bladerf_sync_rx(_dev.get(), static_cast<void *>(_16icbuf), 2 * noutput_items, meta_ptr, _stream_timeout);
+    else
+      status = bladerf_sync_rx(_dev.get(), static_cast<void *>(_16icbuf), noutput_items, meta_ptr, _stream_timeout);
+
+    boost::posix_time::ptime now = _now();
+
+    if (status != 0) {
+      BLADERF_WARNING(boost::str(boost::format("bladerf_sync_rx error: %s")
+                      % bladerf_strerror(status)));
+      ++_failures;
+
+      // the samples since the last good receive are lost
+      if (!o->down) {
+        o->down = true;
+        o->accounted = o->last_good;
+      }
+      _account(*o, now);
+
+      if (_failures >= MAX_CONSECUTIVE_FAILURES) {
+        // restart the stream off this thread instead of ending the
+        // flowgraph; outputs carry zeros tagged rx_gap meanwhile
+        BLADERF_WARNING("Consecutive error limit hit. Restarting stream.");
+
+        struct rx_restart r;
+        r.dev = _dev;
+        for (size_t ch = 0; ch < get_max_channels(); ++ch) {
+          bladerf_channel brfch = BLADERF_CHANNEL_RX(ch);
+          if (get_channel_enable(brfch)) {
+            r.channels.push_back(brfch);
+          }
+        }
+        r.layout = _layout;
+        r.format = _format;
+        r.num_buffers = _num_buffers;
+        r.samples_per_buffer = _samples_per_buffer;
+        r.num_transfers = _num_transfers;
+        r.stream_timeout = _stream_timeout;
+
+        o->restart.reset(new boost::thread(
+          boost::bind(&_restart_stream, o, r, o->backoff_ms)));
+        _failures = 0;
+      }
+    } else {
+      _failures = 0;
+      nframes = noutput_items;
+
+      if (o->down) {
+        // this receive covers the tail of the outage; the rest is lost
+        _account(*o, now - boost::posix_time::microseconds(
+          static_cast<int64_t>(noutput_items / o->samp_rate * 1e6)));
+        o->down = false;
+        if (o->owed > 0) {
+          // keep the samples until the zeros ahead of them are out
+          o->pending.assign(reinterpret_cast<char *>(_16icbuf),
+                            reinterpret_cast<char *>(_16icbuf) +
+                            nframes * frame_bytes);
+          o->pending_frames = nframes;
+          o->pending_offset = 0;
+          nframes = 0;
+        }
+      }
+      o->last_good = now;
+    }
+  }
 
-    if (_failures >= MAX_CONSECUTIVE_FAILURES) {
-      BLADERF_WARNING("Consecutive error limit hit. Shutting down.");
-      return WORK_DONE;
+  gr_complex **out = reinterpret_cast<gr_complex **>(&output_items[0]);
+
+  if (o->owed > 0) {
+    // zeros for the samples lost, tagged with how many there are
+    size_t n = static_cast<size_t>(
+      std::min<uint64_t>(o->owed, noutput_items));
+
+    for (size_t i = 0; i < nstreams; ++i) {
+      memset(out[i], 0, n * sizeof(gr_complex));
+      add_item_tag(i, nitems_written(i), pmt::intern("rx_gap"),
+                   pmt::from_uint64(n));
     }
-  } else {
-    _failures = 0;
+    o->owed -= n;
+    return n;
+  }
+
+  if (o->pending_frames > 0) {
+    nframes = std::min(o->pending_frames - o->pending_offset,
+                       static_cast<size_t>(noutput_items));
+    memcpy(_16icbuf, &o->pending[o->pending_offset * frame_bytes],
+           nframes * frame_bytes);
+    o->pending_offset += nframes;
+    if (o->pending_offset == o->pending_frames) {
+      o->pending.clear();
+      o->pending_frames = 0;
+      o->pending_offset = 0;
+    }
+  }
+
+  if (nframes == 0) {
+    return 0;
   }
 
   // convert from int16_t to float
-  // output_items is gr_complex (2x float), so num_points is 2*noutput_items
-  volk_16i_s32f_convert_32f(reinterpret_cast<float *>(_32fcbuf), _16icbuf, SCALING_FACTOR, 4*noutput_items);
+  // output_items is gr_complex (2x float), so num_points is 2*nframes
+  // per stream
+  if (BLADERF_FORMAT_SC8_Q7 == _format ||
+      BLADERF_FORMAT_SC8_Q7_META == _format) {
+    // SC8 samples sit packed at the start of the same buffer
+    volk_8i_s32f_convert_32f(reinterpret_cast<float *>(_32fcbuf),
+                             reinterpret_cast<const int8_t *>(_16icbuf),
+                             SC8_SCALING_FACTOR, 2*nstreams*nframes);
+  } else {
+    volk_16i_s32f_convert_32f(reinterpret_cast<float *>(_32fcbuf), _16icbuf, SCALING_FACTOR, 2*nstreams*nframes);
+  }
 
   // copy the samples into output_items
-  gr_complex **out = reinterpret_cast<gr_complex **>(&output_items[0]);
-
   if (nstreams > 1) {
     // we need to deinterleave the multiplex as we copy
     gr_complex const *deint_in = _32fcbuf;
 
-    for (size_t i = 0; i < noutput_items; ++i) {
+    for (size_t i = 0; i < nframes; ++i) {
       for (size_t n = 0; n < nstreams; ++n) {
         memcpy(out[n]++, deint_in++, sizeof(gr_complex));
       }
     }
   } else {
     // no deinterleaving to do: simply copy everything
-    memcpy(out[0], _32fcbuf, sizeof(gr_complex) * noutput_items);
+    memcpy(out[0], _32fcbuf, sizeof(gr_complex) * nframes);
   }
 
-  return noutput_items;
+  return nframes;
 }
 
 osmosdr::meta_range_t bladerf_source_c::get_sample_rates()
@@ -356,7 +611,16 @@ osmosdr::meta_range_t bladerf_source_c::get_sample_rates()
 
 double bladerf_source_c::set_sample_rate(double rate)
 {
-  return bladerf_common::set_sample_rate(rate, chan2channel(BLADERF_RX, 0));
+  double actual = bladerf_common::set_sample_rate(rate,
+                                                  chan2channel(BLADERF_RX, 0));
+
+  /* Outages are sized at the rate the stream runs at */
+  gr::thread::scoped_lock guard(d_mutex);
+  if (_running) {
+    _outage(this)->samp_rate = actual;
+  }
+
+  return actual;
 }
 
 double bladerf_source_c::get_sample_rate()
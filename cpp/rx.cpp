@@ -14,7 +14,7 @@ using namespace std;
 //g++ rx.cpp -lbladeRF -L/usr/local/lib
 
 
-static int init_sync(struct bladerf *dev)
+static int init_sync(struct bladerf *dev, bladerf_format format)
 {
     int status;
     /* These items configure the underlying asynch stream used by the sync
@@ -33,8 +33,8 @@ static int init_sync(struct bladerf *dev)
     const unsigned int timeout_ms    = 3500;
     /* Configure both the device's x1 RX and TX channels for use with the
      * synchronous
-     * interface. SC16 Q11 samples *without* metadata are used. */
-    status = bladerf_sync_config(dev, BLADERF_RX_X1, BLADERF_FORMAT_SC16_Q11,
+     * interface. SC16 Q11 or SC8 Q7 samples *without* metadata are used. */
+    status = bladerf_sync_config(dev, BLADERF_RX_X1, format,
                                  num_buffers, buffer_size, num_transfers,
                                  timeout_ms);
     if (status != 0) {
@@ -42,9 +42,16 @@ static int init_sync(struct bladerf *dev)
                 bladerf_strerror(status));
         return status;
     }
+    return status;
+}
 
+/* Bytes in one I or Q value of a sample format */
+static size_t value_size(bladerf_format format)
+{
+    return format == BLADERF_FORMAT_SC8_Q7 ? sizeof(int8_t) : sizeof(int16_t);
 }
-int sync_rx_example(struct bladerf *dev)
+
+int sync_rx_example(struct bladerf *dev, bladerf_format format, FILE *record)
 {
     int status, ret;
     bool done         = false;
@@ -58,14 +65,14 @@ int sync_rx_example(struct bladerf *dev)
     int16_t *tx_samples            = NULL;
     const unsigned int samples_len = 4096; /* May be any (reasonable) size */
     /* Allocate a buffer to store received samples in */
-    rx_samples = (int16_t*)malloc(samples_len * 2 * 1 * sizeof(int16_t));
+    rx_samples = (int16_t*)malloc(samples_len * 2 * 1 * value_size(format));
     if (rx_samples == NULL) {
         perror("malloc");
         return BLADERF_ERR_MEM;
     }
 
     /* Initialize synch interface on RX and TX */
-    status = init_sync(dev);
+    status = init_sync(dev, format);
     if (status != 0) {
         goto out;
     }
@@ -81,6 +88,14 @@ int sync_rx_example(struct bladerf *dev)
         status = bladerf_sync_rx(dev, rx_samples, samples_len, NULL, timeout_ms);
 	t2 = clock();
 	time = (float)(t2 - t1)/CLOCKS_PER_SEC*1000;
+        /* Samples are recorded exactly as they came over USB; an SC8 file
+         * is half the size of the SC16 one */
+        if (status == 0 && record != NULL &&
+            fwrite(rx_samples, 2 * value_size(format), samples_len, record)
+                != samples_len) {
+            perror("fwrite");
+            record = NULL;
+        }
 	  if( iter%1024 == 0){
 	    if(status==0){
 	      printf("bladerf_sync_rx pass\n");
@@ -152,12 +167,15 @@ int configure_channel(struct bladerf *dev, struct channel_config *c)
     return status;
 }
 /* Usage:
- *   libbladeRF_example_boilerplate [serial #]
+ *   libbladeRF_example_boilerplate [serial #] [output file] [sc16|sc8]
  *
  * If a serial number is supplied, the program will attempt to open the
  * device with the provided serial number.
  *
- * Otherwise, the first available device will be used.
+ * Otherwise, the first available device will be used. An empty serial
+ * ("") also selects the first device. With an output file the raw samples
+ * are recorded to it; sc8 streams and records 8-bit samples, which needs
+ * an FPGA with SC8_Q7 support.
  */
 int main(int argc, char *argv[])
 {
@@ -165,14 +183,26 @@ int main(int argc, char *argv[])
     struct channel_config config;
     struct bladerf *dev = NULL;
     struct bladerf_devinfo dev_info;
+    bladerf_format format = BLADERF_FORMAT_SC16_Q11;
+    FILE *record = NULL;
     /* Initialize the information used to identify the desired device
      * to all wildcard (i.e., "any device") values */
     bladerf_init_devinfo(&dev_info);
     /* Request a device with the provided serial number.
      * Invalid strings should simply fail to match a device. */
-    if (argc >= 2) {
+    if (argc >= 2 && argv[1][0] != '\0') {
         strncpy(dev_info.serial, argv[1], sizeof(dev_info.serial) - 1);
     }
+    if (argc >= 4 && strcmp(argv[3], "sc8") == 0) {
+        format = BLADERF_FORMAT_SC8_Q7;
+    }
+    if (argc >= 3) {
+        record = fopen(argv[2], "wb");
+        if (record == NULL) {
+            perror(argv[2]);
+            return 1;
+        }
+    }
     status = bladerf_open_with_devinfo(&dev, &dev_info);
     if (status != 0) {
         fprintf(stderr, "Unable to open device: %s\n",
@@ -191,13 +221,16 @@ int main(int argc, char *argv[])
         goto out;
     }
 
-    sync_rx_example(dev);
+    sync_rx_example(dev, format, record);
     /* Application code goes here.
      *
      * Don't forget to call bladerf_enable_module() before attempting to
      * transmit or receive samples!
      */
 out:
+    if (record != NULL) {
+        fclose(record);
+    }
     bladerf_close(dev);
     return status;
 }
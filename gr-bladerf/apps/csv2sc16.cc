@@ -0,0 +1,278 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * csv2sc16: convert bladeRF-cli CSV captures to binary.
+ *
+ *   csv2sc16 [-F [-M]] [-t threads] in.csv out [out2]
+ *
+ * Reads what "rx config file=... format=csv" writes, one channel (two
+ * columns) or two (four columns), and writes raw sc16 as frs_rxd -f
+ * and the GRC file sources read it or, with -F, interleaved float32
+ * complex samples at the SC16 Q11 scale for DataFromGRC.m and GRC.
+ * A two channel capture goes into one file of interleaved frames, or
+ * with a second output path one file per channel, the way
+ * convertCSVtoDAT.m writes dualFRS1 and dualFRS2. -M normalizes each
+ * component by its mean magnitude as convertCSVtoDAT.m does.
+ *
+ * The CSV is mapped and parsed in chunks on every core, each chunk
+ * written straight to its place in the output.
+ */
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "csv_samples.h"
+#include "sample_convert.h"
+#include "worker_pool.h"
+
+using namespace gr::bladerf;
+
+struct conversion {
+  const csv_samples *csv;
+  std::vector<int> fds;          /* one, or one per channel */
+  bool floats;
+  std::vector<float> scale;      /* per column, for floats */
+  std::vector<std::vector<double> > sums;  /* per chunk, per column */
+  std::vector<std::string> errors;         /* per chunk */
+};
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s [options] in.csv out [out2]\n"
+          "  -F          write float32 I/Q instead of sc16\n"
+          "  -M          with -F, scale each of I and Q by its mean\n"
+          "              magnitude, as convertCSVtoDAT.m does\n"
+          "  -t threads  worker threads besides the main one\n"
+          "              (default: one per core)\n",
+          prog);
+}
+
+static double
+now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static bool
+write_at(int fd, const void *data, size_t bytes, off_t offset)
+{
+  const char *p = (const char *)data;
+  while (bytes > 0) {
+    ssize_t n = pwrite(fd, p, bytes, offset);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    offset += n;
+    bytes -= n;
+  }
+  return true;
+}
+
+/* Sum of magnitudes per column of chunk i, for -M */
+static void
+measure_chunk(conversion *c, size_t i)
+{
+  const size_t columns = c->csv->columns();
+  std::vector<int16_t> values(c->csv->chunk_frames(i) * columns);
+  try {
+    c->csv->read_chunk(i, &values[0]);
+  } catch (const std::exception &e) {
+    c->errors[i] = e.what();
+    return;
+  }
+  std::vector<double> &sums = c->sums[i];
+  sums.assign(columns, 0);
+  for (size_t k = 0; k < values.size(); k++) {
+    sums[k % columns] += abs(values[k]);
+  }
+}
+
+static void
+convert_chunk(conversion *c, size_t i)
+{
+  const size_t columns = c->csv->columns();
+  const size_t n = c->csv->chunk_frames(i);
+  std::vector<int16_t> values(n * columns);
+  try {
+    c->csv->read_chunk(i, &values[0]);
+  } catch (const std::exception &e) {
+    c->errors[i] = e.what();
+    return;
+  }
+
+  /* Columns go to the outputs in turn, as many to each as it holds */
+  const size_t per_file = columns / c->fds.size();
+  const size_t value_bytes = c->floats ? sizeof(float) : sizeof(int16_t);
+  std::vector<int16_t> sc16;
+  std::vector<float> fc32;
+  for (size_t f = 0; f < c->fds.size(); f++) {
+    const void *data;
+    if (c->floats) {
+      fc32.resize(n * per_file);
+      for (size_t k = 0; k < n; k++) {
+        for (size_t j = 0; j < per_file; j++) {
+          size_t col = f * per_file + j;
+          fc32[k * per_file + j] = values[k * columns + col] * c->scale[col];
+        }
+      }
+      data = &fc32[0];
+    } else if (per_file == columns) {
+      data = &values[0];
+    } else {
+      sc16.resize(n * per_file);
+      for (size_t k = 0; k < n; k++) {
+        for (size_t j = 0; j < per_file; j++) {
+          sc16[k * per_file + j] = values[k * columns + f * per_file + j];
+        }
+      }
+      data = &sc16[0];
+    }
+    const size_t frame_bytes = per_file * value_bytes;
+    if (!write_at(c->fds[f], data, n * frame_bytes,
+                  (off_t)(c->csv->chunk_start(i) * frame_bytes))) {
+      c->errors[i] = "unable to write the output";
+      return;
+    }
+  }
+}
+
+static bool
+check(const conversion &c)
+{
+  for (size_t i = 0; i < c.errors.size(); i++) {
+    if (!c.errors[i].empty()) {
+      fprintf(stderr, "csv2sc16: %s\n", c.errors[i].c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+  bool floats = false, normalize = false;
+  size_t threads = boost::thread::hardware_concurrency();
+  threads = threads > 1 ? threads - 1 : 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "FMt:h")) != -1) {
+    switch (opt) {
+    case 'F': floats = true; break;
+    case 'M': normalize = true; break;
+    case 't': threads = atoi(optarg); break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  const int outputs = argc - optind - 1;
+  if (outputs < 1 || outputs > 2 || (normalize && !floats)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  worker_pool pool(threads, std::vector<int>(), 0);
+  boost::scoped_ptr<csv_samples> csv;
+  double start = now();
+  try {
+    csv.reset(new csv_samples(argv[optind], &pool));
+  } catch (const std::exception &e) {
+    fprintf(stderr, "csv2sc16: %s\n", e.what());
+    return 1;
+  }
+  if (outputs == 2 && csv->nchan() != 2) {
+    fprintf(stderr, "csv2sc16: %s has one channel, give one output\n",
+            argv[optind]);
+    return 1;
+  }
+
+  conversion c;
+  c.csv = csv.get();
+  c.floats = floats;
+  c.scale.assign(csv->columns(), 1.0f / SC16_Q11_SCALE);
+  c.sums.resize(csv->chunks());
+  c.errors.resize(csv->chunks());
+
+  if (normalize) {
+    pool.run(csv->chunks(), boost::bind(&measure_chunk, &c, _1));
+    if (!check(c)) {
+      return 1;
+    }
+    for (size_t col = 0; col < csv->columns(); col++) {
+      double sum = 0;
+      for (size_t i = 0; i < csv->chunks(); i++) {
+        sum += c.sums[i][col];
+      }
+      c.scale[col] = sum > 0 ? (float)(csv->frames() / sum) : 1.0f;
+    }
+  }
+
+  const size_t value_bytes = floats ? sizeof(float) : sizeof(int16_t);
+  const off_t file_bytes = (off_t)(csv->frames() * csv->columns() /
+                                   outputs * value_bytes);
+  bool ok = true;
+  for (int f = 0; f < outputs; f++) {
+    const char *path = argv[optind + 1 + f];
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, file_bytes) != 0) {
+      perror(path);
+      ok = false;
+    }
+    c.fds.push_back(fd);
+  }
+  if (ok) {
+    pool.run(csv->chunks(), boost::bind(&convert_chunk, &c, _1));
+    ok = check(c);
+  }
+  for (size_t f = 0; f < c.fds.size(); f++) {
+    if (c.fds[f] >= 0 && close(c.fds[f]) != 0) {
+      ok = false;
+    }
+  }
+  if (!ok) {
+    return 1;
+  }
+
+  double elapsed = now() - start;
+  fprintf(stderr, "%llu frames of %zu channel(s), %.0f MB of CSV in "
+          "%.2f s, %.0f MB/s\n",
+          (unsigned long long)csv->frames(), csv->nchan(),
+          csv->file_size() / 1e6, elapsed,
+          elapsed > 0 ? csv->file_size() / 1e6 / elapsed : 0.0);
+  return 0;
+}
@@ -0,0 +1,440 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * frs_analyze: spectra and pattern checks of captures of any size, in
+ * place of Analysis.m and ExamineAlternating.m.
+ *
+ *   frs_analyze [options] capture...
+ *
+ * Takes raw sc16 captures (rx.cpp, frs_rxd -f; -n for interleaved
+ * channels), compressed ones (frs_rxd -w, sc16z -e, found by their
+ * magic) or, with -F, the float32 complex .dat files GRC and
+ * DataToGRC.m write. Each capture is streamed through in blocks, so
+ * its size is not bounded by memory, and every channel gets a Welch
+ * spectrum and, while the transmitter loops the alternating.m
+ * sequence, a check of where the sequence breaks: the sample, how long
+ * it stayed broken and how many samples were lost modulo the period,
+ * or -1 when the sequence went away for longer than two periods.
+ *
+ * A JSON summary goes to stdout or -j file:
+ *
+ *   {"captures": [{"file": ..., "sample_rate": ..., "channels": [
+ *     {"channel": 1, "samples": ..., "seconds": ..., "power_db": ...,
+ *      "peak_hz": ..., "peak_db": ..., "segments": ...,
+ *      "pattern": {"locked": ..., "good_fraction": ..., "breaks": [
+ *        {"sample": ..., "seconds": ..., "length": ..., "slip": ...}]}}
+ *   ]}], "breaks": <total>}
+ *
+ * with -s the spectra as CSV rows of file,channel,frequency_hz,
+ * density_db and with -b the breaks as file,channel,sample,seconds,
+ * length,slip. The exit status is 2 when any break was found, so a CI
+ * job can fail on it. -g writes alternating.dat for the GRC file
+ * source instead.
+ */
+
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <complex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "alternating_checker.h"
+#include "sample_convert.h"
+#include "sc16_file.h"
+#include "welch_psd.h"
+#include "worker_pool.h"
+
+using namespace gr::bladerf;
+
+struct channel_analysis {
+  boost::shared_ptr<welch_psd> psd;
+  boost::shared_ptr<alternating_checker> check;
+  std::vector<std::complex<float> > samples;
+  double energy;
+};
+
+struct capture {
+  std::string path;
+  FILE *file;
+  boost::shared_ptr<sc16_file_reader> compressed;
+  bool floats;
+  size_t nchan;
+  double samp_rate;
+  uint64_t pos;
+  std::vector<channel_analysis> channels;
+};
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s [options] capture...\n"
+          "  -F          captures are float32 complex, as GRC writes\n"
+          "  -n nchan    interleaved channels in raw captures (default 1)\n"
+          "  -r rate     sample rate of raw captures (default 8e6)\n"
+          "  -N size     Welch segment, a power of two (default 4096)\n"
+          "  -P period   period of the looped sequence (default 4096)\n"
+          "  -T level    correlation a block needs to match (default 0.7)\n"
+          "  -A          no alternating sequence check\n"
+          "  -j file     write the JSON summary to file\n"
+          "  -s file     write the spectra as CSV\n"
+          "  -b file     write the breaks as CSV\n"
+          "  -g file     write the alternating.m sequence as float32\n"
+          "              complex for GRC, and exit\n"
+          "  -B frames   frames per block read (default 1048576)\n"
+          "  -t threads  worker threads besides the main one\n"
+          "              (default: one per core)\n",
+          prog);
+}
+
+static double
+now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static std::string
+json_string(const std::string &s)
+{
+  std::string out = "\"";
+  for (size_t i = 0; i < s.size(); i++) {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c < 0x20) {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      out += esc;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+static bool
+write_alternating(const char *path)
+{
+  std::vector<float> seq = alternating_sequence();
+  std::vector<float> iq(2 * seq.size());
+  for (size_t i = 0; i < seq.size(); i++) {
+    /* As alternating.m does, the same on I and Q */
+    iq[2 * i] = iq[2 * i + 1] = seq[i];
+  }
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  bool ok = fwrite(&iq[0], sizeof(float), iq.size(), f) == iq.size();
+  ok = fclose(f) == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "frs_analyze: unable to write %s\n", path);
+  }
+  return ok;
+}
+
+/* Next up to n frames of c into its channels' sample buffers; the
+ * number read, 0 at the end */
+static size_t
+read_block(capture *c, size_t n, std::vector<int16_t> *raw,
+           std::vector<float> *floats)
+{
+  size_t got = 0;
+  if (c->compressed) {
+    got = (size_t)std::min((uint64_t)n, c->compressed->frames() - c->pos);
+    raw->resize(got * 2 * c->nchan);
+    if (got > 0 && !c->compressed->read(c->pos, got, &(*raw)[0])) {
+      throw std::runtime_error(c->path + " has a corrupt block");
+    }
+  } else if (c->floats) {
+    floats->resize(n * 2 * c->nchan);
+    got = fread(&(*floats)[0], 2 * c->nchan * sizeof(float), n, c->file);
+  } else {
+    raw->resize(n * 2 * c->nchan);
+    got = fread(&(*raw)[0], 2 * c->nchan * sizeof(int16_t), n, c->file);
+  }
+  if (got == 0) {
+    return 0;
+  }
+
+  std::vector<std::complex<float> *> out(c->nchan);
+  for (size_t ch = 0; ch < c->nchan; ch++) {
+    c->channels[ch].samples.resize(got);
+    out[ch] = &c->channels[ch].samples[0];
+  }
+  if (c->floats) {
+    const std::complex<float> *in =
+      (const std::complex<float> *)&(*floats)[0];
+    for (size_t k = 0; k < got; k++) {
+      for (size_t ch = 0; ch < c->nchan; ch++) {
+        out[ch][k] = in[k * c->nchan + ch];
+      }
+    }
+  } else {
+    sc16_to_fc32(&(*raw)[0], &out[0], got, c->nchan, SC16_Q11_SCALE);
+  }
+  c->pos += got;
+  return got;
+}
+
+/* The pattern check and power of one channel's block, as a task */
+static void
+check_channel(capture *c, size_t ch)
+{
+  channel_analysis &a = c->channels[ch];
+  const std::vector<std::complex<float> > &x = a.samples;
+  double energy = 0;
+  for (size_t i = 0; i < x.size(); i++) {
+    energy += std::norm(x[i]);
+  }
+  a.energy += energy;
+  if (a.check) {
+    a.check->process(&x[0], x.size());
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  bool floats = false, pattern = true;
+  size_t nchan = 1, fft_size = 4096, period = 4096;
+  size_t block_frames = 1 << 20;
+  float threshold = 0.7f;
+  double samp_rate = 8e6;
+  const char *json_path = NULL, *spectrum_path = NULL;
+  const char *breaks_path = NULL, *sequence_path = NULL;
+  size_t threads = boost::thread::hardware_concurrency();
+  threads = threads > 1 ? threads - 1 : 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "Fn:r:N:P:T:Aj:s:b:g:B:t:h")) != -1) {
+    switch (opt) {
+    case 'F': floats = true; break;
+    case 'n': nchan = atoi(optarg); break;
+    case 'r': samp_rate = atof(optarg); break;
+    case 'N': fft_size = atoi(optarg); break;
+    case 'P': period = atoi(optarg); break;
+    case 'T': threshold = atof(optarg); break;
+    case 'A': pattern = false; break;
+    case 'j': json_path = optarg; break;
+    case 's': spectrum_path = optarg; break;
+    case 'b': breaks_path = optarg; break;
+    case 'g': sequence_path = optarg; break;
+    case 'B': block_frames = atoi(optarg); break;
+    case 't': threads = atoi(optarg); break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (sequence_path != NULL) {
+    return write_alternating(sequence_path) ? 0 : 1;
+  }
+  if (optind == argc || nchan < 1 || block_frames < 1 || samp_rate <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *json = stdout, *spectrum = NULL, *breaks_csv = NULL;
+  if (json_path != NULL && (json = fopen(json_path, "w")) == NULL) {
+    perror(json_path);
+    return 1;
+  }
+  if (spectrum_path != NULL) {
+    if ((spectrum = fopen(spectrum_path, "w")) == NULL) {
+      perror(spectrum_path);
+      return 1;
+    }
+    fprintf(spectrum, "file,channel,frequency_hz,density_db\n");
+  }
+  if (breaks_path != NULL) {
+    if ((breaks_csv = fopen(breaks_path, "w")) == NULL) {
+      perror(breaks_path);
+      return 1;
+    }
+    fprintf(breaks_csv, "file,channel,sample,seconds,length,slip\n");
+  }
+
+  worker_pool pool(threads, std::vector<int>(), 0);
+  std::vector<int16_t> raw;
+  std::vector<float> float_buf;
+  uint64_t total_breaks = 0, total_frames = 0;
+  double start = now();
+
+  fprintf(json, "{\"captures\": [");
+  for (int i = optind; i < argc; i++) {
+    capture c;
+    c.path = argv[i];
+    c.file = NULL;
+    c.floats = floats;
+    c.nchan = nchan;
+    c.samp_rate = samp_rate;
+    c.pos = 0;
+    try {
+      char magic[sizeof(SC16_FILE_MAGIC)] = { 0 };
+      c.file = fopen(c.path.c_str(), "rb");
+      if (c.file == NULL) {
+        throw std::runtime_error("unable to open " + c.path);
+      }
+      if (!floats &&
+          fread(magic, 1, sizeof(magic), c.file) == sizeof(magic) &&
+          memcmp(magic, SC16_FILE_MAGIC, sizeof(magic)) == 0) {
+        fclose(c.file);
+        c.file = NULL;
+        c.compressed.reset(new sc16_file_reader(c.path));
+        c.nchan = c.compressed->header().nchan;
+        c.samp_rate = c.compressed->header().samp_rate;
+      } else {
+        rewind(c.file);
+      }
+
+      c.channels.resize(c.nchan);
+      for (size_t ch = 0; ch < c.nchan; ch++) {
+        c.channels[ch].psd.reset(new welch_psd(fft_size, c.samp_rate,
+                                               &pool));
+        if (pattern) {
+          c.channels[ch].check.reset(new alternating_checker(period,
+                                                             threshold));
+        }
+        c.channels[ch].energy = 0;
+      }
+
+      while (read_block(&c, block_frames, &raw, &float_buf) > 0) {
+        /* The checks are serial per channel, so the channels go in
+         * parallel; the spectra split their own blocks */
+        pool.run(c.nchan, boost::bind(&check_channel, &c, _1));
+        for (size_t ch = 0; ch < c.nchan; ch++) {
+          const std::vector<std::complex<float> > &x =
+            c.channels[ch].samples;
+          c.channels[ch].psd->process(&x[0], x.size());
+        }
+      }
+      if (c.file != NULL && ferror(c.file)) {
+        throw std::runtime_error("unable to read " + c.path);
+      }
+    } catch (const std::exception &e) {
+      fprintf(stderr, "frs_analyze: %s\n", e.what());
+      return 1;
+    }
+    if (c.file != NULL) {
+      fclose(c.file);
+    }
+    total_frames += c.pos;
+
+    fprintf(json, "%s\n  {\"file\": %s, \"sample_rate\": %.0f, "
+            "\"channels\": [", i > optind ? "," : "",
+            json_string(c.path).c_str(), c.samp_rate);
+    for (size_t ch = 0; ch < c.nchan; ch++) {
+      channel_analysis &a = c.channels[ch];
+      std::vector<double> db = a.psd->density_db();
+      size_t peak = 0;
+      for (size_t k = 1; k < db.size(); k++) {
+        if (db[k] > db[peak]) {
+          peak = k;
+        }
+      }
+      double power = c.pos > 0 ? a.energy / c.pos : 0;
+      fprintf(json, "%s\n    {\"channel\": %zu, \"samples\": %llu, "
+              "\"seconds\": %.6f, \"power_db\": %.2f, ",
+              ch > 0 ? "," : "", ch + 1, (unsigned long long)c.pos,
+              c.pos / c.samp_rate, power > 0 ? 10 * log10(power) : -999.0);
+      if (a.psd->segments() > 0) {
+        fprintf(json, "\"peak_hz\": %.1f, \"peak_db\": %.2f, ",
+                a.psd->frequency(peak), db[peak]);
+      } else {
+        fprintf(json, "\"peak_hz\": null, \"peak_db\": null, ");
+      }
+      fprintf(json, "\"segments\": %llu",
+              (unsigned long long)a.psd->segments());
+
+      if (spectrum != NULL && a.psd->segments() > 0) {
+        for (size_t k = 0; k < db.size(); k++) {
+          fprintf(spectrum, "%s,%zu,%.1f,%.3f\n", c.path.c_str(), ch + 1,
+                  a.psd->frequency(k), db[k]);
+        }
+      }
+
+      if (a.check) {
+        a.check->finish();
+        const std::vector<pattern_break> &b = a.check->breaks();
+        fprintf(json, ",\n     \"pattern\": {\"locked\": %s, "
+                "\"good_fraction\": %.6f, \"breaks\": [",
+                a.check->locked() ? "true" : "false",
+                c.pos > 0 ? (double)a.check->good_samples() / c.pos : 0.0);
+        for (size_t k = 0; k < b.size(); k++) {
+          fprintf(json, "%s\n       {\"sample\": %llu, \"seconds\": %.6f, "
+                  "\"length\": %llu, \"slip\": %lld}",
+                  k > 0 ? "," : "", (unsigned long long)b[k].position,
+                  b[k].position / c.samp_rate,
+                  (unsigned long long)b[k].length, (long long)b[k].slip);
+          if (breaks_csv != NULL) {
+            fprintf(breaks_csv, "%s,%zu,%llu,%.6f,%llu,%lld\n",
+                    c.path.c_str(), ch + 1,
+                    (unsigned long long)b[k].position,
+                    b[k].position / c.samp_rate,
+                    (unsigned long long)b[k].length, (long long)b[k].slip);
+          }
+        }
+        fprintf(json, "]}");
+        total_breaks += b.size();
+      }
+      fprintf(json, "}");
+    }
+    fprintf(json, "]}");
+  }
+  fprintf(json, "\n], \"breaks\": %llu}\n",
+          (unsigned long long)total_breaks);
+
+  bool ok = true;
+  if (json != stdout && fclose(json) != 0) {
+    ok = false;
+  }
+  if (spectrum != NULL && fclose(spectrum) != 0) {
+    ok = false;
+  }
+  if (breaks_csv != NULL && fclose(breaks_csv) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    fprintf(stderr, "frs_analyze: unable to write the output\n");
+    return 1;
+  }
+
+  double elapsed = now() - start;
+  fprintf(stderr, "%llu frames in %.2f s, %.1f Mframes/s, %llu break(s)\n",
+          (unsigned long long)total_frames, elapsed,
+          elapsed > 0 ? total_frames / 1e6 / elapsed : 0.0,
+          (unsigned long long)total_breaks);
+  return total_breaks > 0 ? 2 : 0;
+}
@@ -0,0 +1,220 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * frs_batch: run the FRS receiver over recordings as fast as the
+ * machine allows.
+ *
+ * Takes any number of raw sc16 recordings (rx.cpp, frs_rxd -T, -r and
+ * -c give their rate and LO) or compressed ones (frs_rxd -w, sc16z -e,
+ * which carry their own), cuts them into slices and receives the slices
+ * on every core, each warmed up on the second before it. The squelch
+ * events and, with -X, CTCSS tones come out once everything is done,
+ * the same on any number of threads, as
+ *
+ *   <recording> <seconds> <channel> <frequency Hz> open|close <power dB>
+ *   <recording> <seconds> <channel> <frequency Hz> tone <Hz>
+ *
+ * with seconds counted from the start of the recording, and a summary
+ * of the speed goes to stderr.
+ */
+
+#include <boost/thread/thread.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "batch_receiver.h"
+
+using namespace gr::bladerf;
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s [options] recording...\n"
+          "  -r rate     sample rate of raw recordings (default 6e6)\n"
+          "  -c freq     LO of raw recordings (default: middle of the band)\n"
+          "  -G          all 22 FRS/GMRS channels instead of 1-14\n"
+          "  -q dB       squelch threshold (default -45)\n"
+          "  -a mode     discriminator: exact, poly (default), fast, cross\n"
+          "  -m method   channelizer: auto (default), nco, fft\n"
+          "  -F          keep SC16 samples in fixed point until decimated\n"
+          "  -X          detect CTCSS tones\n"
+          "  -s seconds  slice length (default 60)\n"
+          "  -O seconds  run in before each slice (default 1)\n"
+          "  -t threads  worker threads besides the main one\n"
+          "              (default: one per core)\n"
+          "  -C list     comma separated CPUs for the workers\n",
+          prog);
+}
+
+static std::vector<int>
+parse_cpus(const char *s)
+{
+  std::vector<int> cpus;
+  while (*s) {
+    char *end;
+    long cpu = strtol(s, &end, 10);
+    if (end == s) {
+      break;
+    }
+    cpus.push_back((int)cpu);
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return cpus;
+}
+
+static bool
+parse_accuracy(const char *s, fm_accuracy *accuracy)
+{
+  static const char *names[4] = { "exact", "poly", "fast", "cross" };
+  static const fm_accuracy values[4] = { FM_EXACT, FM_POLY, FM_FAST,
+                                         FM_CROSS };
+  for (int i = 0; i < 4; i++) {
+    if (strcmp(s, names[i]) == 0) {
+      *accuracy = values[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool
+parse_method(const char *s, channelizer_method *method)
+{
+  static const char *names[3] = { "auto", "nco", "fft" };
+  static const channelizer_method values[3] = { CHANNELIZER_AUTO,
+                                                CHANNELIZER_NCO,
+                                                CHANNELIZER_FFT };
+  for (int i = 0; i < 3; i++) {
+    if (strcmp(s, names[i]) == 0) {
+      *method = values[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+static double
+now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct batch_config config;
+  bool gmrs = false;
+  int opt;
+
+  config.rx.samp_rate = 6e6;
+  config.rx.center_freq = 0;
+  config.rx.demod = nbfm_channel::default_config();
+  config.rx.method = CHANNELIZER_AUTO;
+  config.rx.ctcss = false;
+  config.rx.threads = boost::thread::hardware_concurrency();
+  config.rx.threads = config.rx.threads > 1 ? config.rx.threads - 1 : 0;
+  config.rx.rt_priority = 0;
+  config.fixed = false;
+  config.slice_seconds = 60;
+  config.overlap_seconds = 1;
+
+  while ((opt = getopt(argc, argv, "r:c:Gq:a:m:FXs:O:t:C:h")) != -1) {
+    switch (opt) {
+    case 'r': config.rx.samp_rate = atof(optarg); break;
+    case 'c': config.rx.center_freq = atof(optarg); break;
+    case 'G': gmrs = true; break;
+    case 'q': config.rx.demod.squelch_db = atof(optarg); break;
+    case 'a':
+      if (!parse_accuracy(optarg, &config.rx.demod.accuracy)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'm':
+      if (!parse_method(optarg, &config.rx.method)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'F': config.fixed = true; break;
+    case 'X': config.rx.ctcss = true; break;
+    case 's': config.slice_seconds = atof(optarg); break;
+    case 'O': config.overlap_seconds = atof(optarg); break;
+    case 't': config.rx.threads = atoi(optarg); break;
+    case 'C': config.rx.cpus = parse_cpus(optarg); break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind == argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  config.rx.channels = gmrs ? frs_gmrs_channel_table()
+                            : frs_channel_table();
+  if (config.rx.center_freq == 0) {
+    config.rx.center_freq = frs_center_frequency(config.rx.channels);
+  }
+
+  std::vector<struct batch_event> events;
+  double elapsed, seconds = 0;
+  try {
+    batch_receiver batch(config);
+    for (int i = optind; i < argc; i++) {
+      batch.add(argv[i]);
+      seconds += batch.recording(i - optind).frames /
+                 batch.recording(i - optind).samp_rate;
+    }
+
+    double start = now();
+    batch.run(events);
+    elapsed = now() - start;
+
+    for (size_t i = 0; i < events.size(); i++) {
+      const struct batch_event &e = events[i];
+      const char *type = e.type == BATCH_OPEN ? "open"
+                       : e.type == BATCH_CLOSE ? "close" : "tone";
+      printf("%s %.6f %d %.0f %s %.1f\n",
+             batch.recording(e.recording).path.c_str(), e.time, e.channel,
+             e.frequency, type, e.value);
+    }
+    fprintf(stderr, "%zu recordings, %zu slices, %.1f s in %.1f s, "
+            "%.1fx real time on %zu threads\n",
+            batch.recordings(), batch.slices(), seconds, elapsed,
+            elapsed > 0 ? seconds / elapsed : 0.0, config.rx.threads + 1);
+  } catch (const std::exception &e) {
+    fprintf(stderr, "frs_batch: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
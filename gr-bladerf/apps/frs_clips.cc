@@ -0,0 +1,178 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * frs_clips: search the transmission index frs_rxd -I writes.
+ *
+ * Prints one line per transmission overlapping the time range on the
+ * chosen channels,
+ *
+ *   <UTC start> <unix start> <channel> <seconds> <CTCSS Hz> <RSSI dB>
+ *
+ * in the order the transmissions ended, and with -x writes each one's
+ * audio to <dir>/<channel>_<unix start>.s16 as raw signed 16-bit mono
+ * at the index's audio rate. Only the records in the range are read.
+ */
+
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "clip_store.h"
+
+using namespace gr::bladerf;
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s -d dir [options]\n"
+          "  -d dir      clip store written by frs_rxd -I\n"
+          "  -s time     start of the range (default: the beginning)\n"
+          "  -e time     end of the range (default: now)\n"
+          "  -c list     comma separated channels (default: all)\n"
+          "  -x dir      extract the audio of each match to dir\n"
+          "Times are Unix seconds or UTC as YYYY-mm-ddTHH:MM:SS.\n",
+          prog);
+}
+
+static bool
+parse_time(const char *s, double *t)
+{
+  struct tm tm;
+  const char *end;
+
+  memset(&tm, 0, sizeof(tm));
+  end = strptime(s, "%Y-%m-%dT%H:%M:%S", &tm);
+  if (end != NULL && *end == '\0') {
+    *t = (double)timegm(&tm);
+    return true;
+  }
+
+  char *e;
+  *t = strtod(s, &e);
+  return e != s && *e == '\0';
+}
+
+static std::vector<int>
+parse_channels(const char *s)
+{
+  std::vector<int> channels;
+  while (*s) {
+    char *end;
+    long ch = strtol(s, &end, 10);
+    if (end == s) {
+      break;
+    }
+    channels.push_back((int)ch);
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return channels;
+}
+
+static void
+print_clip(const struct clip_record &r)
+{
+  time_t secs = (time_t)floor(r.start);
+  struct tm tm;
+  char stamp[32];
+
+  gmtime_r(&secs, &tm);
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+  printf("%sZ %.3f %u %.3f %.1f %.1f\n", stamp, r.start,
+         (unsigned)r.channel, r.duration, r.ctcss / 10.0, r.rssi_db);
+}
+
+static bool
+extract(const clip_index &index, size_t i, const std::string &dir)
+{
+  const struct clip_record &r = index[i];
+  std::vector<int16_t> pcm;
+  char path[512];
+
+  if (!index.audio(i, pcm)) {
+    fprintf(stderr, "clip %zu: unable to read its audio\n", i);
+    return false;
+  }
+  snprintf(path, sizeof(path), "%s/%u_%.3f.s16", dir.c_str(),
+           (unsigned)r.channel, r.start);
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  fwrite(&pcm[0], sizeof(int16_t), pcm.size(), f);
+  fclose(f);
+  return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+  std::string dir, outdir;
+  std::vector<int> channels;
+  double begin = 0, end = (double)time(NULL) + 1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:s:e:c:x:h")) != -1) {
+    switch (opt) {
+    case 'd': dir = optarg; break;
+    case 's':
+    case 'e':
+      if (!parse_time(optarg, opt == 's' ? &begin : &end)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'c': channels = parse_channels(optarg); break;
+    case 'x': outdir = optarg; break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (dir.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    clip_index index(dir);
+    std::vector<size_t> found = index.find(begin, end, channels);
+    int status = 0;
+
+    for (size_t i = 0; i < found.size(); i++) {
+      print_clip(index[found[i]]);
+      if (!outdir.empty() && !extract(index, found[i], outdir)) {
+        status = 1;
+      }
+    }
+    return status;
+  } catch (const std::exception &e) {
+    fprintf(stderr, "frs_clips: %s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,702 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * frs_latency: TX to RX latency through the radio.
+ *
+ * Sends a Zadoff-Chu marker burst every -i milliseconds, finds it
+ * again in the RX stream by correlation and times the round trip, for
+ * every combination of the sample rates (-r), buffer sizes (-s) and
+ * transfer counts (-x) given as comma separated lists. TX reaches RX
+ * through a bladerf_set_loopback() mode (-l) or a cable (-l none, with
+ * an attenuator), or through a simulated device (-S) that needs no
+ * hardware.
+ *
+ * Markers go out as soon as they reach the device (TX_NOW), or with
+ * -m scheduled at a timestamp -L milliseconds ahead. Two latencies are
+ * measured for each:
+ *
+ *   turnaround  wall time from handing the burst to libbladeRF to
+ *               receiving the buffer the marker ends in
+ *   air         hardware time from the handover, or from the
+ *               scheduled timestamp, to the marker's first sample on RX
+ *
+ * In TX_NOW mode the handover time is read off the RX clock, so air
+ * there also counts the USB latency of the RX samples it came from.
+ *
+ * With -v each marker is printed as
+ *
+ *   marker <n> tx <ts> rx <ts> turnaround_us <us> air_us <us> score <s>
+ *
+ * and each combination ends with
+ *
+ *   summary rate <Hz> size <n> transfers <n> buffers <n> mode <mode>
+ *     sent <n> found <n> late <n> overruns <n>
+ *     turnaround_us min <us> p50 <us> p90 <us> p99 <us> max <us>
+ *     air_us min <us> p50 <us> p90 <us> p99 <us> max <us>
+ *
+ * on one line. The exit status is 2 when a marker was not found.
+ */
+
+#include <libbladeRF.h>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+#include <inttypes.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "device_utils.h"
+#include "loopback_sim.h"
+#include "marker_correlator.h"
+#include "sample_convert.h"
+
+using namespace gr::bladerf;
+
+static const unsigned int STREAM_TIMEOUT_MS = 1000;
+
+/* Recent RX buffers remembered for when a hit in them is reported */
+static const size_t BLOCK_HISTORY = 256;
+
+static volatile sig_atomic_t running = 1;
+
+typedef boost::function<int (void *buf, unsigned int nsamples,
+                             struct bladerf_metadata *meta)> stream_fn;
+
+typedef boost::posix_time::ptime wall_time;
+
+struct options {
+  std::string serial;
+  bool simulate;
+  bladerf_loopback loopback;
+  bool scheduled;
+  bool verbose;
+  std::vector<double> rates;
+  std::vector<unsigned int> sizes;
+  std::vector<unsigned int> transfers;
+  unsigned int buffers;
+  unsigned int markers;
+  double interval_ms;
+  double lead_ms;
+  size_t marker_length;
+  float threshold;
+  double freq;
+  int rx_gain;
+  int tx_gain;
+  uint64_t sim_delay;
+  double sim_usb_us;
+};
+
+/* One marker found on RX */
+struct detection {
+  uint64_t timestamp;       /* of its first sample */
+  wall_time arrival;        /* of the buffer it ends in */
+  float score;
+};
+
+/* What the RX thread shares with the one sending markers */
+struct rx_state {
+  stream_fn receive;
+  size_t block;
+  marker_correlator *correlator;
+
+  boost::mutex mutex;
+  bool have_clock;
+  uint64_t clock_ts;        /* end of the last buffer */
+  wall_time clock_wall;
+  std::deque<struct detection> found;
+  uint64_t overruns;
+  int status;
+  bool stop;
+};
+
+static const char *loopback_names[] = {
+  "none", "firmware", "bb_txlpf_rxvga2", "bb_txvga1_rxvga2",
+  "bb_txlpf_rxlpf", "bb_txvga1_rxlpf", "rf_lna1", "rf_lna2", "rf_lna3",
+  "rfic_bist"
+};
+
+static bool
+parse_loopback(const char *name, bladerf_loopback *lb)
+{
+  const size_t n = sizeof(loopback_names) / sizeof(loopback_names[0]);
+  for (size_t i = 0; i < n; i++) {
+    if (strcmp(name, loopback_names[i]) == 0) {
+      *lb = (bladerf_loopback)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void
+on_signal(int sig)
+{
+  running = 0;
+}
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -S          simulate the device\n"
+          "  -d serial   device serial number\n"
+          "  -l mode     loopback: none (a cable), firmware,\n"
+          "              bb_txlpf_rxvga2, bb_txvga1_rxvga2, bb_txlpf_rxlpf,\n"
+          "              bb_txvga1_rxlpf, rf_lna1, rf_lna2, rf_lna3 or\n"
+          "              rfic_bist (default none)\n"
+          "  -m mode     now or scheduled (default now)\n"
+          "  -L ms       lead of scheduled markers (default 20)\n"
+          "  -r rates    sample rates (default 8e6)\n"
+          "  -s sizes    buffer sizes, multiples of 1024 (default 4096)\n"
+          "  -x counts   transfers in flight (default 8)\n"
+          "  -b count    buffers, at least twice the transfers (default 16)\n"
+          "  -k count    markers per combination (default 50)\n"
+          "  -i ms       between markers (default 20)\n"
+          "  -M length   marker length (default 255)\n"
+          "  -t score    detection threshold, 0..1 (default 0.5)\n"
+          "  -c freq     frequency (default 465e6)\n"
+          "  -g gain     RX gain in dB (default 0)\n"
+          "  -G gain     TX gain in dB (default 0)\n"
+          "  -P frames   with -S, DAC to ADC delay (default 50)\n"
+          "  -U us       with -S, bus latency (default 125)\n"
+          "  -v          print every marker\n",
+          prog);
+}
+
+static bool
+parse_doubles(const char *s, std::vector<double> &out)
+{
+  out.clear();
+  const char *p = s;
+  while (*p != '\0') {
+    char *end;
+    double v = strtod(p, &end);
+    if (end == p || v <= 0) {
+      return false;
+    }
+    out.push_back(v);
+    p = *end == ',' ? end + 1 : end;
+    if (*end != ',' && *end != '\0') {
+      return false;
+    }
+  }
+  return !out.empty();
+}
+
+static bool
+parse_counts(const char *s, std::vector<unsigned int> &out)
+{
+  std::vector<double> v;
+  if (!parse_doubles(s, v)) {
+    return false;
+  }
+  out.clear();
+  for (size_t i = 0; i < v.size(); i++) {
+    if (v[i] != floor(v[i])) {
+      return false;
+    }
+    out.push_back((unsigned int)v[i]);
+  }
+  return true;
+}
+
+static wall_time
+wall_now()
+{
+  return boost::posix_time::microsec_clock::universal_time();
+}
+
+static int
+device_receive(struct bladerf *dev, void *buf, unsigned int nsamples,
+               struct bladerf_metadata *meta)
+{
+  meta->flags = BLADERF_META_FLAG_RX_NOW;
+  return bladerf_sync_rx(dev, buf, nsamples, meta, STREAM_TIMEOUT_MS);
+}
+
+static int
+device_transmit(struct bladerf *dev, const void *buf, unsigned int nsamples,
+                struct bladerf_metadata *meta)
+{
+  return bladerf_sync_tx(dev, buf, nsamples, meta, STREAM_TIMEOUT_MS);
+}
+
+static void
+rx_loop(struct rx_state *rx)
+{
+  marker_correlator &c = *rx->correlator;
+  std::vector<int16_t> buf(2 * rx->block);
+  std::vector<std::complex<float> > x(rx->block);
+  std::complex<float> *out = &x[0];
+  std::deque<std::pair<uint64_t, wall_time> > blocks;
+  uint64_t base = 0, expected = 0;
+  bool started = false;
+
+  for (;;) {
+    {
+      boost::mutex::scoped_lock lock(rx->mutex);
+      if (rx->stop || !running) {
+        break;
+      }
+    }
+    struct bladerf_metadata meta;
+    memset(&meta, 0, sizeof(meta));
+    int status = rx->receive(&buf[0], rx->block, &meta);
+    const wall_time arrival = wall_now();
+    if (status == BLADERF_ERR_TIMEOUT) {
+      continue;
+    }
+    if (status != 0) {
+      boost::mutex::scoped_lock lock(rx->mutex);
+      rx->status = status;
+      break;
+    }
+
+    /* After lost samples the correlator starts over from here */
+    if (!started || meta.timestamp != expected ||
+        (meta.status & BLADERF_META_STATUS_OVERRUN)) {
+      if (started) {
+        boost::mutex::scoped_lock lock(rx->mutex);
+        rx->overruns++;
+      }
+      c.reset();
+      c.clear_hits();
+      blocks.clear();
+      base = meta.timestamp;
+      started = true;
+    }
+    expected = meta.timestamp + rx->block;
+    blocks.push_back(std::make_pair(expected, arrival));
+    if (blocks.size() > BLOCK_HISTORY) {
+      blocks.pop_front();
+    }
+
+    sc16_to_fc32(&buf[0], &out, rx->block, 1, SC16_Q11_SCALE);
+    c.process(&x[0], x.size());
+
+    boost::mutex::scoped_lock lock(rx->mutex);
+    rx->clock_ts = expected;
+    rx->clock_wall = arrival;
+    rx->have_clock = true;
+    for (size_t i = 0; i < c.hits().size(); i++) {
+      struct detection d;
+      d.timestamp = base + c.hits()[i].position;
+      d.score = c.hits()[i].score;
+      d.arrival = arrival;
+      const uint64_t end = d.timestamp + c.marker_length();
+      for (size_t b = 0; b < blocks.size(); b++) {
+        if (blocks[b].first >= end) {
+          d.arrival = blocks[b].second;
+          break;
+        }
+      }
+      rx->found.push_back(d);
+    }
+    c.clear_hits();
+  }
+}
+
+/* Hardware time by the RX clock, moved on by the wall clock */
+static bool
+hardware_now(struct rx_state &rx, double rate, uint64_t *t)
+{
+  boost::mutex::scoped_lock lock(rx.mutex);
+  if (!rx.have_clock) {
+    return false;
+  }
+  *t = rx.clock_ts + (uint64_t)((wall_now() - rx.clock_wall)
+                                .total_microseconds() * 1e-6 * rate);
+  return true;
+}
+
+static void
+print_distribution(const char *name, std::vector<double> v)
+{
+  if (v.empty()) {
+    printf(" %s -", name);
+    return;
+  }
+  std::sort(v.begin(), v.end());
+  const double q[3] = { 0.5, 0.9, 0.99 };
+  printf(" %s min %.1f", name, v.front());
+  for (int i = 0; i < 3; i++) {
+    size_t k = (size_t)ceil(q[i] * v.size()) - 1;
+    printf(" p%d %.1f", (int)(q[i] * 100), v[std::min(k, v.size() - 1)]);
+  }
+  printf(" max %.1f", v.back());
+}
+
+struct run_result {
+  unsigned int sent;
+  unsigned int found;
+  uint64_t late;
+};
+
+/* Send the markers of one combination and time their return */
+static int
+measure(const struct options &o, double rate, const struct stream_config &s,
+        stream_fn receive, stream_fn transmit, int64_t tx_offset,
+        struct run_result *result)
+{
+  const std::vector<std::complex<float> > marker =
+    zadoff_chu(o.marker_length, 7);
+  std::vector<int16_t> burst(2 * (marker.size() + 1), 0);
+  for (size_t n = 0; n < marker.size(); n++) {
+    burst[2 * n] = (int16_t)lrintf(1024 * marker[n].real());
+    burst[2 * n + 1] = (int16_t)lrintf(1024 * marker[n].imag());
+  }
+
+  marker_correlator correlator(marker, o.threshold);
+  struct rx_state rx;
+  rx.receive = receive;
+  rx.block = s.buffer_size;
+  rx.correlator = &correlator;
+  rx.have_clock = false;
+  rx.clock_ts = 0;
+  rx.overruns = 0;
+  rx.status = 0;
+  rx.stop = false;
+  boost::thread rx_thread(boost::bind(&rx_loop, &rx));
+
+  std::vector<double> turnaround, air;
+  result->sent = 0;
+  result->found = 0;
+  result->late = 0;
+  int status = 0;
+  uint64_t hw = 0;
+  while (running && !hardware_now(rx, rate, &hw)) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+
+  const uint64_t lead = (uint64_t)(o.lead_ms * 1e-3 * rate);
+  const unsigned int wait_ms =
+    (unsigned int)(1000 + 2 * o.interval_ms + o.lead_ms);
+  for (unsigned int k = 0; running && k < o.markers; k++) {
+    boost::this_thread::sleep(boost::posix_time::microseconds(
+      (int64_t)(o.interval_ms * 1e3)));
+    if (!hardware_now(rx, rate, &hw)) {
+      break;
+    }
+
+    struct bladerf_metadata meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.flags = BLADERF_META_FLAG_TX_BURST_START |
+                 BLADERF_META_FLAG_TX_BURST_END;
+    uint64_t from = hw;
+    if (o.scheduled) {
+      from = hw + lead;
+      meta.timestamp = from + tx_offset;
+    } else {
+      meta.flags |= BLADERF_META_FLAG_TX_NOW;
+    }
+    const wall_time submitted = wall_now();
+    status = transmit(&burst[0], marker.size() + 1, &meta);
+    if (status != 0) {
+      fprintf(stderr, "TX failed: %s\n", bladerf_strerror(status));
+      break;
+    }
+    result->sent++;
+
+    /* The first marker to start after the handover is this one */
+    bool got = false;
+    struct detection d;
+    const wall_time deadline =
+      submitted + boost::posix_time::milliseconds(wait_ms);
+    while (running && !got && wall_now() < deadline) {
+      {
+        boost::mutex::scoped_lock lock(rx.mutex);
+        while (!rx.found.empty() && !got) {
+          d = rx.found.front();
+          rx.found.pop_front();
+          got = d.timestamp >= hw;
+        }
+        if (rx.status != 0) {
+          break;
+        }
+      }
+      if (!got) {
+        boost::this_thread::sleep(boost::posix_time::microseconds(200));
+      }
+    }
+    if (!got) {
+      if (o.verbose) {
+        printf("marker %u lost\n", k);
+      }
+      continue;
+    }
+
+    result->found++;
+    if (o.scheduled && d.timestamp < from) {
+      result->late++;
+    }
+    const double t_us = (d.arrival - submitted).total_microseconds();
+    const double a_us = ((double)d.timestamp - (double)from) * 1e6 / rate;
+    turnaround.push_back(t_us);
+    air.push_back(a_us);
+    if (o.verbose) {
+      printf("marker %u tx %" PRIu64 " rx %" PRIu64 " turnaround_us %.1f "
+             "air_us %.1f score %.3f\n", k, from, d.timestamp, t_us, a_us,
+             d.score);
+    }
+  }
+
+  {
+    boost::mutex::scoped_lock lock(rx.mutex);
+    rx.stop = true;
+  }
+  rx_thread.join();
+  if (rx.status != 0) {
+    fprintf(stderr, "RX failed: %s\n", bladerf_strerror(rx.status));
+    status = rx.status;
+  }
+
+  printf("summary rate %.0f size %u transfers %u buffers %u mode %s "
+         "sent %u found %u late %" PRIu64 " overruns %" PRIu64, rate,
+         s.buffer_size, s.num_transfers, s.num_buffers,
+         o.scheduled ? "scheduled" : "now", result->sent, result->found,
+         result->late, rx.overruns);
+  print_distribution("turnaround_us", turnaround);
+  print_distribution("air_us", air);
+  printf("\n");
+  fflush(stdout);
+  return status;
+}
+
+static int
+run_simulated(const struct options &o, double rate,
+              const struct stream_config &s, struct run_result *result)
+{
+  struct loopback_sim_config config;
+  config.samp_rate = rate;
+  config.stream = s;
+  config.path_delay = o.sim_delay;
+  config.usb_latency = o.sim_usb_us * 1e-6;
+  config.gain = 0.25f;
+  config.noise = 4;
+  loopback_sim sim(config);
+  return measure(o, rate, s,
+                 boost::bind(&loopback_sim::receive, &sim, _1, _2, _3),
+                 boost::bind(&loopback_sim::transmit, &sim, _1, _2, _3),
+                 0, result);
+}
+
+static int
+run_device(struct bladerf *dev, const struct options &o, double rate,
+           const struct stream_config &s, struct run_result *result)
+{
+  struct channel_config config;
+  config.frequency  = (unsigned int)o.freq;
+  config.bandwidth  = (unsigned int)(rate * 0.8);
+  config.samplerate = (unsigned int)rate;
+  config.channel    = BLADERF_CHANNEL_RX(0);
+  config.gain       = o.rx_gain;
+  int status = configure_channel(dev, &config);
+  if (status == 0) {
+    config.channel = BLADERF_CHANNEL_TX(0);
+    config.gain    = o.tx_gain;
+    status = configure_channel(dev, &config);
+  }
+  if (status == 0) {
+    status = init_sync(dev, BLADERF_RX_X1, BLADERF_FORMAT_SC16_Q11_META, &s);
+  }
+  if (status == 0) {
+    status = init_sync(dev, BLADERF_TX_X1, BLADERF_FORMAT_SC16_Q11_META, &s);
+  }
+  if (status == 0) {
+    status = enable_rx_channels(dev, 1, true);
+  }
+  if (status == 0) {
+    status = enable_tx_channels(dev, 1, true);
+  }
+
+  /* The TX and RX counters start apart; read back to back, their
+   * difference is good to a control transfer */
+  uint64_t rx_now = 0, tx_now = 0;
+  if (status == 0) {
+    status = bladerf_get_timestamp(dev, BLADERF_RX, &rx_now);
+    if (status == 0) {
+      status = bladerf_get_timestamp(dev, BLADERF_TX, &tx_now);
+    }
+    if (status != 0) {
+      fprintf(stderr, "Failed to read the timestamps: %s\n",
+              bladerf_strerror(status));
+    }
+  }
+  if (status == 0) {
+    status = measure(o, rate, s, boost::bind(&device_receive, dev, _1, _2, _3),
+                     boost::bind(&device_transmit, dev, _1, _2, _3),
+                     (int64_t)(tx_now - rx_now), result);
+  }
+  enable_tx_channels(dev, 1, false);
+  enable_rx_channels(dev, 1, false);
+  return status;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct options o;
+  int opt;
+
+  o.simulate = false;
+  o.loopback = BLADERF_LB_NONE;
+  o.scheduled = false;
+  o.verbose = false;
+  o.rates.push_back(8e6);
+  o.sizes.push_back(default_stream_config.buffer_size);
+  o.transfers.push_back(default_stream_config.num_transfers);
+  o.buffers = default_stream_config.num_buffers;
+  o.markers = 50;
+  o.interval_ms = 20;
+  o.lead_ms = 20;
+  o.marker_length = 255;
+  o.threshold = 0.5f;
+  o.freq = 465e6;
+  o.rx_gain = 0;
+  o.tx_gain = 0;
+  o.sim_delay = 50;
+  o.sim_usb_us = 125;
+
+  while ((opt = getopt(argc, argv, "Sd:l:m:L:r:s:x:b:k:i:M:t:c:g:G:P:U:vh"))
+         != -1) {
+    switch (opt) {
+    case 'S': o.simulate = true; break;
+    case 'd': o.serial = optarg; break;
+    case 'l':
+      if (!parse_loopback(optarg, &o.loopback)) {
+        fprintf(stderr, "frs_latency: unknown loopback %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'm':
+      if (strcmp(optarg, "now") != 0 && strcmp(optarg, "scheduled") != 0) {
+        fprintf(stderr, "frs_latency: unknown mode %s\n", optarg);
+        return 1;
+      }
+      o.scheduled = strcmp(optarg, "scheduled") == 0;
+      break;
+    case 'L': o.lead_ms = atof(optarg); break;
+    case 'r':
+      if (!parse_doubles(optarg, o.rates)) {
+        fprintf(stderr, "frs_latency: bad rates %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 's':
+      if (!parse_counts(optarg, o.sizes)) {
+        fprintf(stderr, "frs_latency: bad sizes %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'x':
+      if (!parse_counts(optarg, o.transfers)) {
+        fprintf(stderr, "frs_latency: bad transfer counts %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'b': o.buffers = atoi(optarg); break;
+    case 'k': o.markers = atoi(optarg); break;
+    case 'i': o.interval_ms = atof(optarg); break;
+    case 'M': o.marker_length = atoi(optarg); break;
+    case 't': o.threshold = atof(optarg); break;
+    case 'c': o.freq = atof(optarg); break;
+    case 'g': o.rx_gain = atoi(optarg); break;
+    case 'G': o.tx_gain = atoi(optarg); break;
+    case 'P': o.sim_delay = atoi(optarg); break;
+    case 'U': o.sim_usb_us = atof(optarg); break;
+    case 'v': o.verbose = true; break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  bool ok = optind == argc && o.markers > 0 && o.interval_ms > 0 &&
+            o.lead_ms > 0 && o.marker_length >= 16 && o.threshold > 0 &&
+            o.threshold < 1 && o.sim_usb_us >= 0;
+  for (size_t i = 0; i < o.sizes.size(); i++) {
+    ok = ok && o.sizes[i] > 0 && o.sizes[i] % 1024 == 0;
+  }
+  for (size_t i = 0; i < o.transfers.size(); i++) {
+    ok = ok && o.transfers[i] > 0;
+  }
+  if (!ok) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  struct bladerf *dev = NULL;
+  if (!o.simulate) {
+    if (open_device(&dev, o.serial) != 0) {
+      return 1;
+    }
+    int status = bladerf_set_loopback(dev, o.loopback);
+    if (status != 0) {
+      fprintf(stderr, "Failed to set loopback %s: %s\n",
+              loopback_names[o.loopback], bladerf_strerror(status));
+      bladerf_close(dev);
+      return 1;
+    }
+  }
+
+  int status = 0;
+  bool lost = false;
+  for (size_t r = 0; running && status == 0 && r < o.rates.size(); r++) {
+    for (size_t i = 0; running && status == 0 && i < o.sizes.size(); i++) {
+      for (size_t j = 0; running && status == 0 && j < o.transfers.size();
+           j++) {
+        struct stream_config s = default_stream_config;
+        s.buffer_size = o.sizes[i];
+        s.num_transfers = o.transfers[j];
+        s.num_buffers = std::max(o.buffers, 2 * o.transfers[j]);
+        s.timeout_ms = STREAM_TIMEOUT_MS;
+
+        struct run_result result;
+        status = o.simulate ? run_simulated(o, o.rates[r], s, &result)
+                            : run_device(dev, o, o.rates[r], s, &result);
+        lost = lost || result.found < result.sent;
+      }
+    }
+  }
+
+  if (dev != NULL) {
+    bladerf_set_loopback(dev, BLADERF_LB_NONE);
+    bladerf_close(dev);
+  }
+  if (status != 0) {
+    return 1;
+  }
+  return lost ? 2 : 0;
+}
@@ -0,0 +1,619 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * frs_ptt: push-to-talk narrowband FM transmitter.
+ *
+ * Reads 16-bit mono PCM at the audio rate (-A) from standard input or
+ * a file (-f), for instance from
+ *
+ *   arecord -t raw -f S16_LE -c 1 -r 25000 --buffer-size=250
+ *
+ * or makes a test tone (-t), and sends it on an FRS/GMRS channel (-n)
+ * with an optional CTCSS privacy code (-q). The audio is taken -a
+ * milliseconds at a time and an nbfm_modulator pre-emphasizes it, adds
+ * the tone and modulates it straight at the radio's sample rate. Each
+ * transmission is one burst of a duplex_engine, its samples pushed
+ * while it is on the air.
+ *
+ * A burst is timed so that every audio sample goes on the air -T
+ * milliseconds after it was read, whatever the buffering in between.
+ * That target has to cover the audio block, the filter delay, a
+ * libbladeRF buffer and the TX lead (-L) and is checked against them
+ * at the start; the margin left over absorbs scheduling jitter. Time
+ * spent upstream, in the sound card and the pipe, comes on top, hence
+ * the small capture buffer above. Every transmission starts its own
+ * timeline, so sound card clock drift only builds up within one.
+ *
+ * PTT is keyed by SIGUSR1 and released by SIGUSR2, keyed while the
+ * audio is above -V dBFS and for -H milliseconds after (VOX), or held
+ * down throughout with -K. Each transmission is reported as
+ *
+ *   burst <n> keyup_ms <ms> frames <n> padded <n> underruns <n>
+ *     min_lead <ms> [late]
+ *
+ * keyup_ms being the time from reading the first audio sample after
+ * key-up to that sample going on the air. -S runs against a simulated
+ * device instead of a bladeRF.
+ */
+
+#include <libbladeRF.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <inttypes.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ctcss_detector.h"
+#include "device_utils.h"
+#include "duplex_engine.h"
+#include "frs_channels.h"
+#include "loopback_sim.h"
+#include "nbfm_modulator.h"
+#include "sample_convert.h"
+
+using namespace gr::bladerf;
+
+static const unsigned int STREAM_TIMEOUT_MS = 1000;
+
+static volatile sig_atomic_t running = 1;
+static volatile sig_atomic_t ptt = 0;
+
+struct options {
+  std::string serial;
+  bool simulate;
+  double samp_rate;
+  double audio_rate;
+  int channel;
+  int code;
+  double lo_freq;
+  int tx_gain;
+  double audio_gain_db;
+  double block_ms;
+  double target_ms;
+  double lead_ms;
+  bool vox;
+  double vox_db;
+  double hang_ms;
+  bool keyed;
+  double tone;
+  double seconds;
+  const char *in_path;
+  struct stream_config stream;
+};
+
+static void
+on_signal(int sig)
+{
+  running = 0;
+}
+
+static void
+on_ptt(int sig)
+{
+  ptt = sig == SIGUSR1;
+}
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -S          simulate the device\n"
+          "  -d serial   device serial number\n"
+          "  -n channel  FRS/GMRS channel, 1-22 (default 1)\n"
+          "  -q code     CTCSS privacy code, 1-38 (default: none)\n"
+          "  -c freq     LO frequency (default: a quarter of the sample\n"
+          "              rate below the channel)\n"
+          "  -r rate     sample rate (default 2e6)\n"
+          "  -A rate     audio sample rate, dividing it (default 25000)\n"
+          "  -G gain     TX gain in dB (default 0)\n"
+          "  -g dB       audio gain (default 0)\n"
+          "  -f file     raw S16_LE mono audio (default: stdin)\n"
+          "  -t freq     send a test tone instead\n"
+          "  -a ms       audio block (default 5)\n"
+          "  -T ms       latency target, audio in to RF out (default 30)\n"
+          "  -L ms       TX lead over the hardware clock (default 5)\n"
+          "  -K          PTT held down throughout\n"
+          "  -V dBFS     VOX: PTT keyed while the audio is above this\n"
+          "  -H ms       VOX hang time (default 500)\n"
+          "  -D seconds  stop after this long (default: end of input)\n"
+          "  -b count    libbladeRF buffers (default 16)\n"
+          "  -s frames   libbladeRF buffer size, a multiple of 1024\n"
+          "              (default 4096)\n"
+          "  -x count    libbladeRF transfers in flight (default 8)\n",
+          prog);
+}
+
+static int
+receive(struct bladerf *dev, void *buf, unsigned int nsamples,
+        uint64_t *timestamp)
+{
+  struct bladerf_metadata meta;
+  memset(&meta, 0, sizeof(meta));
+  meta.flags = BLADERF_META_FLAG_RX_NOW;
+  int status = bladerf_sync_rx(dev, buf, nsamples, &meta, STREAM_TIMEOUT_MS);
+  if (status == 0) {
+    *timestamp = meta.timestamp;
+  } else if (status != BLADERF_ERR_TIMEOUT) {
+    fprintf(stderr, "RX failed: %s\n", bladerf_strerror(status));
+  }
+  return status;
+}
+
+static int
+transmit(struct bladerf *dev, const void *buf, unsigned int nsamples,
+         uint64_t timestamp, uint32_t flags)
+{
+  struct bladerf_metadata meta;
+  memset(&meta, 0, sizeof(meta));
+  meta.timestamp = timestamp;
+  meta.flags = flags;
+  int status = bladerf_sync_tx(dev, buf, nsamples, &meta, STREAM_TIMEOUT_MS);
+  if (status != 0) {
+    fprintf(stderr, "TX failed: %s\n", bladerf_strerror(status));
+  }
+  return status;
+}
+
+static int
+sim_receive(loopback_sim *sim, void *buf, unsigned int nsamples,
+            uint64_t *timestamp)
+{
+  struct bladerf_metadata meta;
+  memset(&meta, 0, sizeof(meta));
+  int status = sim->receive(buf, nsamples, &meta);
+  *timestamp = meta.timestamp;
+  return status;
+}
+
+static int
+sim_transmit(loopback_sim *sim, const void *buf, unsigned int nsamples,
+             uint64_t timestamp, uint32_t flags)
+{
+  struct bladerf_metadata meta;
+  memset(&meta, 0, sizeof(meta));
+  meta.timestamp = timestamp;
+  meta.flags = flags;
+  return sim->transmit(buf, nsamples, &meta);
+}
+
+/* Audio from a PCM stream or a tone. A tone or a regular file is read
+ * in real time, as a sound card would deliver it. */
+class audio_source
+{
+ public:
+  audio_source(FILE *in, double rate, double tone, float gain)
+    : d_in(in),
+      d_rate(rate),
+      d_tone(tone),
+      d_gain(gain),
+      d_phase(0),
+      d_read(0),
+      d_start(boost::posix_time::microsec_clock::universal_time())
+  {
+    struct stat st;
+    d_paced = in == NULL ||
+              (fstat(fileno(in), &st) == 0 && S_ISREG(st.st_mode));
+  }
+
+  /* Fill n samples; false at the end of the input */
+  bool read(float *out, size_t n)
+  {
+    if (d_paced) {
+      const boost::posix_time::ptime due = d_start +
+        boost::posix_time::microseconds((int64_t)((d_read + n) * 1e6 /
+                                                  d_rate));
+      boost::this_thread::sleep(due);
+    }
+    if (d_in == NULL) {
+      for (size_t i = 0; i < n; i++) {
+        out[i] = d_gain * 0.5f * (float)sin(d_phase);
+        d_phase = fmod(d_phase + 2 * M_PI * d_tone / d_rate, 2 * M_PI);
+      }
+    } else {
+      d_pcm.resize(n);
+      if (fread(&d_pcm[0], sizeof(int16_t), n, d_in) != n) {
+        return false;
+      }
+      for (size_t i = 0; i < n; i++) {
+        out[i] = d_gain * d_pcm[i] * (1.0f / 32768.0f);
+      }
+    }
+    d_read += n;
+    return true;
+  }
+
+ private:
+  FILE *d_in;
+  double d_rate;
+  double d_tone;
+  float d_gain;
+  double d_phase;
+  uint64_t d_read;
+  boost::posix_time::ptime d_start;
+  bool d_paced;
+  std::vector<int16_t> d_pcm;
+};
+
+static double
+to_ms(const struct options &o, int64_t frames)
+{
+  return frames * 1e3 / o.samp_rate;
+}
+
+static void
+print_reports(const struct options &o, duplex_engine &engine,
+              std::map<uint64_t, uint64_t> &keyups, size_t delay)
+{
+  std::vector<struct duplex_burst_report> reports = engine.take_reports();
+  for (size_t i = 0; i < reports.size(); i++) {
+    const struct duplex_burst_report &r = reports[i];
+    const uint64_t keyup = keyups[r.id];
+    keyups.erase(r.id);
+    printf("burst %" PRIu64 " keyup_ms %.3f frames %" PRIu64 " padded %"
+           PRIu64 " underruns %" PRIu64 " min_lead %.3f%s", r.id,
+           to_ms(o, (int64_t)(r.start + delay - keyup)), r.frames,
+           r.padded, r.underruns, to_ms(o, r.min_lead),
+           r.start != r.requested ? " late" : "");
+    if (r.status != 0) {
+      printf(" failed: %s", bladerf_strerror(r.status));
+    }
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
+/* Key up and down with the PTT and send the audio in between */
+static int
+talk(const struct options &o, const struct nbfm_tx_config &tx,
+     audio_source &source, duplex_engine &engine)
+{
+  const size_t block = (size_t)lrint(o.block_ms * 1e-3 * o.audio_rate);
+  nbfm_modulator mod(tx, block);
+  const size_t delay = mod.delay();
+  const uint64_t block_frames = mod.max_output(block);
+  const uint64_t target = (uint64_t)(o.target_ms * 1e-3 * o.samp_rate);
+  const unsigned int hang_blocks = (unsigned int)(o.hang_ms / o.block_ms);
+  const float vox_power = (float)pow(10.0, o.vox_db / 10);
+
+  std::vector<float> audio(block);
+  std::vector<std::complex<float> > rf(block_frames);
+  std::vector<int16_t> frames(2 * block_frames);
+  std::map<uint64_t, uint64_t> keyups;
+  boost::posix_time::ptime start =
+    boost::posix_time::microsec_clock::universal_time();
+
+  engine.start(std::vector<int>(), std::vector<int>(), 0);
+
+  bool keyed = false;
+  unsigned int quiet = hang_blocks + 1;
+  uint64_t scheduled = 0, dropped = 0;
+  while (running && source.read(&audio[0], block)) {
+    if (o.seconds > 0 &&
+        (boost::posix_time::microsec_clock::universal_time() - start)
+        .total_microseconds() >= o.seconds * 1e6) {
+      break;
+    }
+
+    if (o.vox) {
+      float power = 0;
+      for (size_t i = 0; i < block; i++) {
+        power += audio[i] * audio[i];
+      }
+      quiet = power / block > vox_power ? 0 : quiet + 1;
+    }
+    const bool down = o.keyed || ptt || (o.vox && quiet <= hang_blocks);
+
+    uint64_t now;
+    if (down && !keyed && engine.now(&now)) {
+      /* The block just read started block_frames ago; each of its
+       * samples is due on the air target after that */
+      const uint64_t keyup = now - block_frames;
+      mod.reset();
+      keyups[engine.schedule(keyup + target - delay)] = keyup;
+      scheduled++;
+      keyed = true;
+    } else if (!down && keyed) {
+      engine.end_burst();
+      keyed = false;
+    }
+
+    if (keyed) {
+      const size_t n = mod.process(&audio[0], block, &rf[0]);
+      fc32_to_sc16(&rf[0], &frames[0], n, SC16_Q11_SCALE);
+      const size_t taken = engine.push(&frames[0], n,
+                                       (unsigned int)o.block_ms);
+      dropped += n - taken;
+    }
+    print_reports(o, engine, keyups, delay);
+  }
+  if (keyed) {
+    engine.end_burst();
+  }
+
+  /* Let the last burst go out */
+  for (int i = 0; i < 100 && engine.stats().tx_bursts < scheduled; i++) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    print_reports(o, engine, keyups, delay);
+  }
+  engine.stop();
+  print_reports(o, engine, keyups, delay);
+  const struct duplex_stats s = engine.stats();
+
+  printf("# tx bursts %" PRIu64 " frames %" PRIu64 " underruns %" PRIu64
+         " padded %" PRIu64 " dropped %" PRIu64 " late %" PRIu64
+         " min_lead %.3f rx gaps %" PRIu64 "\n", s.tx_bursts, s.tx_frames,
+         s.tx_underruns, s.tx_padded, dropped, s.tx_late,
+         to_ms(o, s.tx_min_lead), s.rx_gaps);
+  return s.rx_errors > 0 || s.tx_errors > 0 ? 1 : 0;
+}
+
+static void
+fill_duplex_config(const struct options &o, struct duplex_config *dc)
+{
+  dc->rx_nchan = 1;
+  dc->tx_nchan = 1;
+  dc->rx_frames = o.stream.buffer_size;
+  dc->tx_frames = o.stream.buffer_size;
+  dc->samp_rate = o.samp_rate;
+  dc->tx_lead = (uint64_t)(o.lead_ms * 1e-3 * o.samp_rate);
+  dc->tx_queue_frames = (size_t)(2 * o.target_ms * 1e-3 * o.samp_rate);
+  dc->tx_offset = 0;
+}
+
+static int
+run_simulated(const struct options &o, const struct nbfm_tx_config &tx,
+              audio_source &source)
+{
+  struct loopback_sim_config sc;
+  sc.samp_rate = o.samp_rate;
+  sc.stream = o.stream;
+  sc.path_delay = 0;
+  sc.usb_latency = 100e-6;
+  sc.gain = 0;
+  sc.noise = 0;
+  loopback_sim sim(sc);
+
+  struct duplex_config dc;
+  fill_duplex_config(o, &dc);
+  duplex_engine engine(dc, boost::bind(&sim_receive, &sim, _1, _2, _3),
+                       boost::bind(&sim_transmit, &sim, _1, _2, _3, _4));
+  return talk(o, tx, source, engine);
+}
+
+static int
+run_device(const struct options &o, const struct nbfm_tx_config &tx,
+           audio_source &source)
+{
+  struct bladerf *dev = NULL;
+  int status = open_device(&dev, o.serial);
+  if (status != 0) {
+    return 1;
+  }
+
+  /* RX runs only for the hardware clock the bursts are timed to */
+  struct channel_config config;
+  config.bandwidth  = (unsigned int)(o.samp_rate * 0.8);
+  config.samplerate = (unsigned int)o.samp_rate;
+  config.frequency  = (unsigned int)o.lo_freq;
+  config.channel    = BLADERF_CHANNEL_RX(0);
+  config.gain       = 0;
+  status = configure_channel(dev, &config);
+  if (status == 0) {
+    config.channel = BLADERF_CHANNEL_TX(0);
+    config.gain    = o.tx_gain;
+    status = configure_channel(dev, &config);
+  }
+  if (status == 0) {
+    status = init_sync(dev, BLADERF_RX_X1, BLADERF_FORMAT_SC16_Q11_META,
+                       &o.stream);
+  }
+  if (status == 0) {
+    status = init_sync(dev, BLADERF_TX_X1, BLADERF_FORMAT_SC16_Q11_META,
+                       &o.stream);
+  }
+  if (status == 0) {
+    status = enable_rx_channels(dev, 1, true);
+  }
+  if (status == 0) {
+    status = enable_tx_channels(dev, 1, true);
+  }
+
+  uint64_t rx_now = 0, tx_now = 0;
+  if (status == 0) {
+    status = bladerf_get_timestamp(dev, BLADERF_RX, &rx_now);
+    if (status == 0) {
+      status = bladerf_get_timestamp(dev, BLADERF_TX, &tx_now);
+    }
+    if (status != 0) {
+      fprintf(stderr, "Failed to read the timestamps: %s\n",
+              bladerf_strerror(status));
+    }
+  }
+  if (status != 0) {
+    enable_rx_channels(dev, 1, false);
+    enable_tx_channels(dev, 1, false);
+    bladerf_close(dev);
+    return 1;
+  }
+
+  struct duplex_config dc;
+  fill_duplex_config(o, &dc);
+  dc.tx_offset = (int64_t)(tx_now - rx_now);
+  int result;
+  {
+    duplex_engine engine(dc, boost::bind(&receive, dev, _1, _2, _3),
+                         boost::bind(&transmit, dev, _1, _2, _3, _4));
+    result = talk(o, tx, source, engine);
+  }
+
+  enable_tx_channels(dev, 1, false);
+  enable_rx_channels(dev, 1, false);
+  bladerf_close(dev);
+  return result;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct options o;
+  int opt;
+
+  o.simulate = false;
+  o.samp_rate = 2e6;
+  o.audio_rate = 25e3;
+  o.channel = 1;
+  o.code = 0;
+  o.lo_freq = 0;
+  o.tx_gain = 0;
+  o.audio_gain_db = 0;
+  o.block_ms = 5;
+  o.target_ms = 30;
+  o.lead_ms = 5;
+  o.vox = false;
+  o.vox_db = 0;
+  o.hang_ms = 500;
+  o.keyed = false;
+  o.tone = 0;
+  o.seconds = 0;
+  o.in_path = NULL;
+  o.stream = default_stream_config;
+
+  while ((opt = getopt(argc, argv,
+                       "Sd:n:q:c:r:A:G:g:f:t:a:T:L:KV:H:D:b:s:x:h")) != -1) {
+    switch (opt) {
+    case 'S': o.simulate = true; break;
+    case 'd': o.serial = optarg; break;
+    case 'n': o.channel = atoi(optarg); break;
+    case 'q': o.code = atoi(optarg); break;
+    case 'c': o.lo_freq = atof(optarg); break;
+    case 'r': o.samp_rate = atof(optarg); break;
+    case 'A': o.audio_rate = atof(optarg); break;
+    case 'G': o.tx_gain = atoi(optarg); break;
+    case 'g': o.audio_gain_db = atof(optarg); break;
+    case 'f': o.in_path = optarg; break;
+    case 't': o.tone = atof(optarg); break;
+    case 'a': o.block_ms = atof(optarg); break;
+    case 'T': o.target_ms = atof(optarg); break;
+    case 'L': o.lead_ms = atof(optarg); break;
+    case 'K': o.keyed = true; break;
+    case 'V': o.vox = true; o.vox_db = atof(optarg); break;
+    case 'H': o.hang_ms = atof(optarg); break;
+    case 'D': o.seconds = atof(optarg); break;
+    case 'b': o.stream.num_buffers = atoi(optarg); break;
+    case 's': o.stream.buffer_size = atoi(optarg); break;
+    case 'x': o.stream.num_transfers = atoi(optarg); break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || o.samp_rate <= 0 || o.audio_rate <= 0 ||
+      o.code < 0 || o.code > (int)ctcss_tones().size() ||
+      o.block_ms <= 0 || o.target_ms <= 0 || o.lead_ms <= 0 ||
+      o.hang_ms < 0 || o.tone < 0 || o.stream.buffer_size == 0 ||
+      o.stream.buffer_size % 1024 != 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const std::vector<struct frs_channel> &table = frs_gmrs_channel_table();
+  double channel_freq = 0;
+  for (size_t i = 0; i < table.size(); i++) {
+    if (table[i].number == o.channel) {
+      channel_freq = table[i].frequency;
+    }
+  }
+  if (channel_freq == 0) {
+    fprintf(stderr, "frs_ptt: no channel %d\n", o.channel);
+    return 1;
+  }
+  if (o.lo_freq == 0) {
+    o.lo_freq = channel_freq - o.samp_rate / 4;
+  }
+
+  struct nbfm_tx_config tx = nbfm_modulator::default_config();
+  tx.audio_rate = o.audio_rate;
+  tx.samp_rate = o.samp_rate;
+  tx.offset = channel_freq - o.lo_freq;
+  tx.ctcss = o.code > 0 ? ctcss_tones()[o.code - 1] : 0;
+  if (fabs(tx.offset) + tx.max_dev + tx.audio_cutoff > o.samp_rate * 0.4) {
+    fprintf(stderr, "frs_ptt: channel %d is outside the band around "
+            "the LO\n", o.channel);
+    return 1;
+  }
+
+  /* The latency budget, from an audio block being read to its first
+   * sample going on the air */
+  size_t delay;
+  try {
+    delay = nbfm_modulator(tx, 1).delay();
+  } catch (const std::exception &e) {
+    fprintf(stderr, "frs_ptt: %s\n", e.what());
+    return 1;
+  }
+  const double filters_ms = delay * 1e3 / o.samp_rate;
+  const double buffer_ms = o.stream.buffer_size * 1e3 / o.samp_rate;
+  const double needed = o.block_ms + filters_ms + buffer_ms + o.lead_ms;
+  printf("# channel %d %.4f MHz lo %.4f MHz ctcss %.1f budget audio %.3f "
+         "filters %.3f buffer %.3f lead %.3f margin %.3f ms\n", o.channel,
+         channel_freq * 1e-6, o.lo_freq * 1e-6, tx.ctcss, o.block_ms,
+         filters_ms, buffer_ms, o.lead_ms, o.target_ms - needed);
+  if (o.target_ms < needed) {
+    fprintf(stderr, "frs_ptt: a latency target of at least %.1f ms is "
+            "needed\n", needed);
+    return 1;
+  }
+
+  FILE *in = NULL;
+  if (o.tone <= 0) {
+    in = o.in_path != NULL ? fopen(o.in_path, "rb") : stdin;
+    if (in == NULL) {
+      fprintf(stderr, "frs_ptt: unable to read %s\n", o.in_path);
+      return 1;
+    }
+  }
+  audio_source source(in, o.audio_rate, o.tone,
+                      (float)pow(10.0, o.audio_gain_db / 20));
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGUSR1, on_ptt);
+  signal(SIGUSR2, on_ptt);
+
+  int status = o.simulate ? run_simulated(o, tx, source)
+                          : run_device(o, tx, source);
+  if (in != NULL && in != stdin) {
+    fclose(in);
+  }
+  return status;
+}
@@ -0,0 +1,897 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * frs_rxd: headless FRS receiver.
+ *
+ * Demodulates FRS channels 1-14 from one wideband capture with a fixed
+ * pool of worker threads and no GNU Radio scheduler in the way. Squelch
+ * open/close events go to stdout as
+ *
+ *   <seconds> <channel> <frequency Hz> open|close <power dB>
+ *
+ * and, with -o, each channel's audio is appended to <dir>/frs<N>.s16 as
+ * raw signed 16-bit mono at the audio rate. With -X the CTCSS tone of
+ * each transmission is reported as it is found, as
+ *
+ *   <seconds> <channel> <frequency Hz> tone <Hz>
+ *
+ * and with -I every transmission is also kept as a clip in <dir>, with
+ * an index that frs_clips searches by time and channel.
+ *
+ * Samples come from a bladeRF (default), a raw sc16/sc8 recording as
+ * written by rx.cpp (-f), a built-in simulator (-S), or a shared
+ * memory IQ bus published by another process (-b), or an iq_served
+ * stream from another machine (-N over TCP, -u over UDP). With -B,
+ * whatever the samples come from is published to such a bus in turn,
+ * so other programs can share the radio.
+ *
+ * With -T, the last few seconds of wideband IQ are kept in memory and a
+ * window around each squelch opening, each SIGUSR1 and, with -L, each
+ * rise of the wideband power above a level is written to <dir> as a raw
+ * sc16 recording that -f can replay.
+ *
+ * With -w, the whole wideband stream is also recorded to a compressed
+ * .sc16z file as it is captured; sc16z turns it back into a raw
+ * recording.
+ */
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <libbladeRF.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "channel_plan.h"
+#include "clip_store.h"
+#include "device_state.h"
+#include "device_utils.h"
+#include "frs_receiver.h"
+#include "frs_simulator.h"
+#include "iq_bus.h"
+#include "iq_stream.h"
+#include "sc16_file.h"
+#include "iq_ring.h"
+#include "rx_pipeline.h"
+#include "sample_convert.h"
+#include "trigger_recorder.h"
+
+using namespace gr::bladerf;
+
+/* Wideband frames handed to the receiver at a time */
+static const size_t BLOCK_FRAMES = 60000;
+static const size_t PIPELINE_FRAMES = 8192;
+static const size_t PIPELINE_DEPTH = 16;
+static const unsigned int RX_TIMEOUT_MS = 1000;
+static const float AUDIO_SCALE = 29000.0f;
+/* How much an IQ bus published with -B holds for its readers */
+static const double BUS_SECONDS = 2;
+
+static volatile sig_atomic_t running = 1;
+static volatile sig_atomic_t external_trigger = 0;
+
+static void
+on_signal(int sig)
+{
+  running = 0;
+}
+
+static void
+on_trigger_signal(int sig)
+{
+  external_trigger = 1;
+}
+
+struct options {
+  std::string serial;
+  std::string file;
+  std::string outdir;
+  std::string profile;
+  std::string trigger_dir;
+  std::string index_dir;
+  std::string bus_in;
+  std::string bus_out;
+  std::string compressed;
+  std::string stream;
+  bool stream_udp;
+  bool simulate;
+  bool sc8;
+  bool fixed;
+  bool plan;
+  bool gmrs;
+  double samp_rate;
+  double bandwidth;
+  double center;
+  double seconds;
+  double pre_seconds;
+  double post_seconds;
+  double trigger_db;
+  double max_clip;
+  int gain;
+  struct frs_receiver_config rx;
+};
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -d serial   bladeRF serial number (default: first device)\n"
+          "  -f file     read a raw recording instead of a device\n"
+          "  -S          use the built-in simulator\n"
+          "  -b name     read from an IQ bus (sets -r and -c)\n"
+          "  -B name     publish the wideband samples as an IQ bus\n"
+          "  -w file     record the wideband samples compressed (.sc16z)\n"
+          "  -N host:port  read from iq_served over TCP (sets -r and -c)\n"
+          "  -u [host:]port  the same over UDP\n"
+          "  -8          samples are SC8_Q7 (device or file)\n"
+          "  -F          keep SC16 samples in fixed point until decimated\n"
+          "  -r rate     sample rate in Hz (default 6e6)\n"
+          "  -c freq     LO frequency in Hz (default: middle of the band)\n"
+          "  -A          plan rate and LO for the least DSP (overrides -r, -c)\n"
+          "  -G          all 22 FRS/GMRS channels instead of 1-14\n"
+          "  -g gain     RX gain in dB (default 30)\n"
+          "  -q dB       squelch threshold (default -45)\n"
+          "  -a mode     discriminator: exact, poly (default), fast, cross\n"
+          "  -m method   channelizer: auto (default), nco, fft\n"
+          "  -t threads  worker threads besides the main one (default 3)\n"
+          "  -C list     comma separated CPUs for the workers\n"
+          "  -p prio     SCHED_FIFO priority, 0 for none\n"
+          "  -P file     device profile to load and save\n"
+          "  -o dir      write per-channel audio to dir\n"
+          "  -T dir      write IQ around squelch openings and SIGUSR1 to dir\n"
+          "  -W pre,post seconds kept before and after a trigger (default 2,3)\n"
+          "  -L dBFS     also trigger when the wideband power rises above this\n"
+          "  -X          detect CTCSS tones\n"
+          "  -I dir      keep every transmission as an indexed clip in dir\n"
+          "  -M seconds  split longer transmissions (default 120)\n"
+          "  -n seconds  stop after this much input (default: run forever)\n",
+          prog);
+}
+
+static std::vector<int>
+parse_cpus(const char *s)
+{
+  std::vector<int> cpus;
+  while (*s) {
+    char *end;
+    long cpu = strtol(s, &end, 10);
+    if (end == s) {
+      break;
+    }
+    cpus.push_back((int)cpu);
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return cpus;
+}
+
+static bool
+parse_accuracy(const char *s, fm_accuracy *accuracy)
+{
+  static const char *names[4] = { "exact", "poly", "fast", "cross" };
+  static const fm_accuracy values[4] = { FM_EXACT, FM_POLY, FM_FAST,
+                                         FM_CROSS };
+  for (int i = 0; i < 4; i++) {
+    if (strcmp(s, names[i]) == 0) {
+      *accuracy = values[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool
+parse_method(const char *s, channelizer_method *method)
+{
+  static const char *names[3] = { "auto", "nco", "fft" };
+  static const channelizer_method values[3] = { CHANNELIZER_AUTO,
+                                                CHANNELIZER_NCO,
+                                                CHANNELIZER_FFT };
+  for (int i = 0; i < 3; i++) {
+    if (strcmp(s, names[i]) == 0) {
+      *method = values[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Per-channel audio files, indexed by FRS channel number. Each channel's
+ * audio only ever arrives from one worker at a time, so no locking. */
+static std::vector<FILE *> audio_files(23, (FILE *)NULL);
+
+/* Transmission clips (-I); audio arrives on the workers, everything
+ * else on the main thread, as clip_store expects */
+static boost::scoped_ptr<clip_store> clips;
+
+static double stream_rate = 0;
+
+static void
+write_audio(const struct frs_channel &ch, const float *audio, size_t n)
+{
+  FILE *f = audio_files[ch.number];
+  int16_t pcm[1024];
+
+  if (clips) {
+    clips->audio(ch.number, audio, n);
+  }
+  if (f == NULL) {
+    return;
+  }
+  while (n > 0) {
+    size_t m = std::min(n, sizeof(pcm) / sizeof(pcm[0]));
+    for (size_t i = 0; i < m; i++) {
+      float x = std::max(-1.0f, std::min(1.0f, audio[i]));
+      pcm[i] = (int16_t)(x * AUDIO_SCALE);
+    }
+    fwrite(pcm, sizeof(int16_t), m, f);
+    audio += m;
+    n -= m;
+  }
+}
+
+/* Pre-trigger capture. Blocks enter the ring just before the receiver
+ * sees them, so ring positions and receiver sample counts agree. Only
+ * the main thread feeds the ring and receives squelch events. */
+static boost::scoped_ptr<iq_ring> capture_ring;
+static boost::scoped_ptr<trigger_recorder> recorder;
+static std::vector<int16_t> capture_buf;
+static double trigger_power = 0;   /* mean I^2 + Q^2, 0 for none */
+static bool above_power = false;
+
+/* IQ bus we publish to (-B) */
+static boost::scoped_ptr<iq_bus_writer> bus_out;
+
+/* Compressed recording of everything captured (-w) */
+static boost::scoped_ptr<sc16_file_writer> compressed_out;
+
+static void
+capture(const int16_t *frames, size_t n)
+{
+  if (bus_out) {
+    bus_out->write(frames, n);
+  }
+  if (compressed_out) {
+    compressed_out->write(frames, n);
+  }
+  if (!capture_ring) {
+    return;
+  }
+
+  uint64_t pos = capture_ring->written();
+  capture_ring->write(frames, n);
+
+  if (external_trigger) {
+    external_trigger = 0;
+    recorder->trigger(pos, "signal");
+  }
+  if (trigger_power > 0) {
+    double sum = 0;
+    for (size_t i = 0; i < 2 * n; i++) {
+      sum += (double)frames[i] * frames[i];
+    }
+    bool above = sum > trigger_power * n;
+    if (above && !above_power) {
+      recorder->trigger(pos, "power");
+    }
+    above_power = above;
+  }
+}
+
+static void
+capture(const std::complex<float> *in, size_t n)
+{
+  if (capture_ring || bus_out || compressed_out) {
+    fc32_to_sc16(in, &capture_buf[0], n, SC16_Q11_SCALE);
+    capture(&capture_buf[0], n);
+  }
+}
+
+static void
+print_event(const struct frs_channel &ch, double time,
+            const struct squelch_event &e)
+{
+  printf("%.6f %d %.0f %s %.1f\n", time, ch.number, ch.frequency,
+         e.open ? "open" : "close", e.power_db);
+  fflush(stdout);
+
+  if (recorder && e.open) {
+    char reason[32];
+    snprintf(reason, sizeof(reason), "ch%d", ch.number);
+    recorder->trigger((uint64_t)(time * stream_rate), reason);
+  }
+  if (clips) {
+    clips->squelch(ch.number, time, e.open, e.power_db);
+  }
+}
+
+static void
+print_tone(const struct frs_channel &ch, double time, float tone)
+{
+  printf("%.6f %d %.0f tone %.1f\n", time, ch.number, ch.frequency, tone);
+  fflush(stdout);
+
+  if (clips) {
+    clips->tone(ch.number, time, tone);
+  }
+}
+
+/* Hand a wideband block to the receiver, then sample the power of the
+ * open channels for the clip index */
+template <typename T>
+static void
+demodulate(frs_receiver &rx, const T *in, size_t n)
+{
+  rx.process(in, n);
+
+  if (clips) {
+    const std::vector<struct frs_channel> &channels = rx.channels();
+    const double time = rx.samples() / stream_rate;
+    for (size_t i = 0; i < channels.size(); i++) {
+      if (rx.squelch_open(i)) {
+        clips->level(channels[i].number, time, rx.power_db(i));
+      }
+    }
+  }
+}
+
+/* Keep every channel's squelch exercised: a tone on 1, 8 and 14, each
+ * under its own CTCSS tone */
+static int
+run_simulator(struct options &o, frs_receiver &rx)
+{
+  frs_simulator sim(o.samp_rate, 0.01f);
+  const int busy[3] = { 1, 8, 14 };
+  std::vector<std::complex<float> > buf(BLOCK_FRAMES);
+
+  for (int i = 0; i < 3; i++) {
+    struct sim_signal s;
+    s.offset = frs_channel_table()[busy[i] - 1].frequency - o.center;
+    s.tone = 500 + 250 * i;
+    s.deviation = 2000;
+    s.ctcss = ctcss_tones()[11 * i];
+    s.amplitude = 0.2f;
+    sim.add_signal(s);
+  }
+
+  while (running && (o.seconds <= 0 ||
+                     rx.samples() < o.seconds * o.samp_rate)) {
+    sim.generate(&buf[0], buf.size());
+    capture(&buf[0], buf.size());
+    demodulate(rx, &buf[0], buf.size());
+  }
+  return 0;
+}
+
+/* The receiver works on the bus's memory in place when it carries one
+ * channel; the first of several is copied out */
+static int
+run_bus(struct options &o, frs_receiver &rx, iq_bus_reader &bus)
+{
+  const size_t nchan = bus.nchan();
+  std::vector<int16_t> first(nchan > 1 ? 2 * BLOCK_FRAMES : 0);
+  uint64_t torn = 0;
+
+  while (running && (o.seconds <= 0 ||
+                     rx.samples() < o.seconds * o.samp_rate)) {
+    size_t n;
+    const int16_t *frames = bus.acquire(BLOCK_FRAMES, &n, RX_TIMEOUT_MS);
+    if (frames == NULL) {
+      if (!bus.writer_alive()) {
+        fprintf(stderr, "IQ bus publisher has gone away\n");
+        break;
+      }
+      continue;
+    }
+    if (nchan > 1) {
+      for (size_t i = 0; i < n; i++) {
+        first[2 * i] = frames[2 * nchan * i];
+        first[2 * i + 1] = frames[2 * nchan * i + 1];
+      }
+      frames = &first[0];
+    }
+    capture(frames, n);
+    demodulate(rx, frames, n);
+    if (!bus.release(n) && nchan == 1) {
+      torn += n;
+    }
+  }
+
+  fprintf(stderr, "IQ bus: %llu frames dropped, %llu overwritten while "
+          "in use\n", (unsigned long long)bus.dropped(),
+          (unsigned long long)torn);
+  return 0;
+}
+
+/* Frames that never arrived are skipped over, not filled in */
+static int
+run_stream(struct options &o, frs_receiver &rx, iq_stream_client &stream)
+{
+  const size_t nchan = stream.nchan();
+  std::vector<int16_t> frames(2 * nchan * BLOCK_FRAMES);
+  uint64_t gap;
+
+  while (running && (o.seconds <= 0 ||
+                     rx.samples() < o.seconds * o.samp_rate)) {
+    size_t n = stream.read(&frames[0], BLOCK_FRAMES, RX_TIMEOUT_MS, &gap);
+    if (n == 0) {
+      if (!stream.connected()) {
+        fprintf(stderr, "IQ stream server has gone away\n");
+        break;
+      }
+      continue;
+    }
+    for (size_t i = 1; nchan > 1 && i < n; i++) {
+      frames[2 * i] = frames[2 * nchan * i];
+      frames[2 * i + 1] = frames[2 * nchan * i + 1];
+    }
+    capture(&frames[0], n);
+    demodulate(rx, &frames[0], n);
+  }
+
+  fprintf(stderr, "IQ stream: %llu frames lost, %llu dropped by the "
+          "server\n", (unsigned long long)stream.lost(),
+          (unsigned long long)stream.server_dropped());
+  return 0;
+}
+
+static int
+run_file(struct options &o, frs_receiver &rx)
+{
+  FILE *in = fopen(o.file.c_str(), "rb");
+  size_t sample_bytes = o.sc8 ? 2 : 4;
+  std::vector<char> raw(BLOCK_FRAMES * sample_bytes);
+  std::vector<std::complex<float> > buf(BLOCK_FRAMES);
+  std::complex<float> *out = &buf[0];
+
+  if (in == NULL) {
+    perror(o.file.c_str());
+    return -1;
+  }
+
+  while (running && (o.seconds <= 0 ||
+                     rx.samples() < o.seconds * o.samp_rate)) {
+    size_t n = fread(&raw[0], sample_bytes, BLOCK_FRAMES, in);
+    if (n == 0) {
+      break;
+    }
+    if (o.sc8) {
+      sc8_to_fc32((const int8_t *)&raw[0], &out, n, 1, SC8_Q7_SCALE);
+      capture(out, n);
+      demodulate(rx, out, n);
+      continue;
+    }
+    capture((const int16_t *)&raw[0], n);
+    if (o.fixed) {
+      demodulate(rx, (const int16_t *)&raw[0], n);
+    } else {
+      sc16_to_fc32((const int16_t *)&raw[0], &out, n, 1, 2048.0f);
+      demodulate(rx, out, n);
+    }
+  }
+
+  fclose(in);
+  return 0;
+}
+
+static int
+receive(struct bladerf *dev, void *buf, unsigned int nsamples)
+{
+  return bladerf_sync_rx(dev, buf, nsamples, NULL, RX_TIMEOUT_MS);
+}
+
+static int
+reset_stream(struct bladerf *dev, bladerf_format format)
+{
+  int status;
+
+  enable_rx_channels(dev, 1, false);
+  status = init_sync(dev, BLADERF_RX_X1, format, &default_stream_config);
+  if (status != 0) {
+    return status;
+  }
+  return enable_rx_channels(dev, 1, true);
+}
+
+static int
+run_device(struct options &o, frs_receiver &rx)
+{
+  struct bladerf *dev = NULL;
+  struct channel_config config;
+  struct device_profile saved;
+  bladerf_format format = o.sc8 ? BLADERF_FORMAT_SC8_Q7
+                                : BLADERF_FORMAT_SC16_Q11;
+  int status;
+
+  status = open_device(&dev, o.serial);
+  if (status != 0) {
+    return status;
+  }
+
+  {
+    device_state state(dev);
+    if (!o.profile.empty() && load_profile(o.profile, saved) == 0) {
+      state.restore(saved);
+    }
+
+    config.channel    = BLADERF_CHANNEL_RX(0);
+    config.frequency  = (unsigned int)o.center;
+    config.bandwidth  = (unsigned int)o.bandwidth;
+    config.samplerate = (unsigned int)o.samp_rate;
+    config.gain       = o.gain;
+    status = state.apply(&config);
+    if (status != 0) {
+      fprintf(stderr, "Failed to configure RX0\n");
+      bladerf_close(dev);
+      return status;
+    }
+    if (!o.profile.empty() && state.snapshot(saved) == 0) {
+      save_profile(o.profile, saved);
+    }
+  }
+
+  status = init_sync(dev, BLADERF_RX_X1, format, &default_stream_config);
+  if (status == 0) {
+    status = enable_rx_channels(dev, 1, true);
+  }
+  if (status != 0) {
+    fprintf(stderr, "Failed to start RX: %s\n", bladerf_strerror(status));
+    bladerf_close(dev);
+    return status;
+  }
+
+  /* With nothing to convert, raw SC16 blocks go straight to the
+   * receiver, but still through the pipeline so a wedged stream is
+   * reset and its outage filled rather than ending the daemon */
+  const bool raw = o.fixed && !o.sc8;
+  rx_pipeline pipeline(PIPELINE_DEPTH, PIPELINE_FRAMES, 1,
+                       raw ? std::vector<int>() : std::vector<int>(1, 0),
+                       boost::bind(&receive, dev, _1, _2), o.samp_rate,
+                       boost::bind(&reset_stream, dev, format), format);
+
+  pipeline.start(std::vector<int>(), std::vector<int>(),
+                 o.rx.rt_priority);
+
+  if (raw) {
+    std::vector<int16_t> buf(2 * BLOCK_FRAMES);
+    size_t have = 0;
+    while (running && (o.seconds <= 0 ||
+                       rx.samples() < o.seconds * o.samp_rate)) {
+      have += pipeline.deliver_raw(&buf[2 * have], BLOCK_FRAMES - have,
+                                   RX_TIMEOUT_MS);
+      if (have == BLOCK_FRAMES) {
+        capture(&buf[0], have);
+        demodulate(rx, &buf[0], have);
+        have = 0;
+      }
+    }
+  } else {
+    std::vector<std::complex<float> > buf(BLOCK_FRAMES);
+
+    /* Fill a whole block before demodulating so the workers always get
+     * the same amount of work */
+    size_t have = 0;
+    while (running && (o.seconds <= 0 ||
+                       rx.samples() < o.seconds * o.samp_rate)) {
+      std::complex<float> *out = &buf[have];
+      have += pipeline.deliver(&out, buf.size() - have, RX_TIMEOUT_MS);
+      if (have == buf.size()) {
+        capture(&buf[0], have);
+        demodulate(rx, &buf[0], have);
+        have = 0;
+      }
+    }
+  }
+  pipeline.stop();
+
+  fprintf(stderr, "rx errors: %llu resets: %llu\n",
+          (unsigned long long)pipeline.receive_errors(),
+          (unsigned long long)pipeline.resets());
+
+  enable_rx_channels(dev, 1, false);
+  bladerf_close(dev);
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct options o;
+  int opt, status;
+
+  o.stream_udp = false;
+  o.simulate = false;
+  o.sc8 = false;
+  o.fixed = false;
+  o.plan = false;
+  o.gmrs = false;
+  o.samp_rate = 6e6;
+  o.center = 0;
+  o.seconds = 0;
+  o.pre_seconds = 2;
+  o.post_seconds = 3;
+  o.trigger_db = 0;
+  o.max_clip = 120;
+  o.gain = 30;
+  o.rx.demod = nbfm_channel::default_config();
+  o.rx.method = CHANNELIZER_AUTO;
+  o.rx.ctcss = false;
+  o.rx.threads = 3;
+  o.rx.rt_priority = 0;
+
+  while ((opt = getopt(argc, argv, "d:f:Sb:B:w:N:u:8Fr:c:AGg:q:a:m:t:C:p:P:o:T:W:L:XI:M:n:h")) != -1) {
+    switch (opt) {
+    case 'd': o.serial = optarg; break;
+    case 'f': o.file = optarg; break;
+    case 'S': o.simulate = true; break;
+    case 'b': o.bus_in = optarg; break;
+    case 'B': o.bus_out = optarg; break;
+    case 'w': o.compressed = optarg; break;
+    case 'N': o.stream = optarg; o.stream_udp = false; break;
+    case 'u': o.stream = optarg; o.stream_udp = true; break;
+    case '8': o.sc8 = true; break;
+    case 'F': o.fixed = true; break;
+    case 'r': o.samp_rate = atof(optarg); break;
+    case 'c': o.center = atof(optarg); break;
+    case 'A': o.plan = true; break;
+    case 'G': o.gmrs = true; break;
+    case 'g': o.gain = atoi(optarg); break;
+    case 'q': o.rx.demod.squelch_db = atof(optarg); break;
+    case 'a':
+      if (!parse_accuracy(optarg, &o.rx.demod.accuracy)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'm':
+      if (!parse_method(optarg, &o.rx.method)) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 't': o.rx.threads = atoi(optarg); break;
+    case 'C': o.rx.cpus = parse_cpus(optarg); break;
+    case 'p': o.rx.rt_priority = atoi(optarg); break;
+    case 'P': o.profile = optarg; break;
+    case 'o': o.outdir = optarg; break;
+    case 'T': o.trigger_dir = optarg; break;
+    case 'W':
+      if (sscanf(optarg, "%lf,%lf", &o.pre_seconds, &o.post_seconds) != 2 ||
+          o.pre_seconds < 0 || o.post_seconds < 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'L': o.trigger_db = atof(optarg); break;
+    case 'X': o.rx.ctcss = true; break;
+    case 'I': o.index_dir = optarg; o.rx.ctcss = true; break;
+    case 'M': o.max_clip = atof(optarg); break;
+    case 'n': o.seconds = atof(optarg); break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  o.rx.channels = o.gmrs ? frs_gmrs_channel_table() : frs_channel_table();
+  if (o.center == 0) {
+    o.center = frs_center_frequency(o.rx.channels);
+  }
+  o.bandwidth = o.samp_rate;
+  if (o.plan) {
+    try {
+      struct channel_plan plan = make_channel_plan(
+        o.rx.channels, o.rx.demod.bandwidth, o.rx.demod.audio_rate,
+        default_plan_limits());
+      o.samp_rate = plan.samp_rate;
+      o.center = plan.center_freq;
+      o.bandwidth = plan.bandwidth;
+      if (o.rx.method == CHANNELIZER_AUTO) {
+        o.rx.method = plan.channelizer.method;
+      }
+      fputs(format_channel_plan(plan, o.rx.channels).c_str(), stderr);
+    } catch (const std::exception &e) {
+      fprintf(stderr, "frs_rxd: %s\n", e.what());
+      return 1;
+    }
+  }
+  boost::scoped_ptr<iq_bus_reader> bus_in;
+  if (!o.bus_in.empty()) {
+    try {
+      bus_in.reset(new iq_bus_reader(o.bus_in));
+    } catch (const std::exception &e) {
+      fprintf(stderr, "frs_rxd: %s\n", e.what());
+      return 1;
+    }
+    o.samp_rate = bus_in->samp_rate();
+    o.center = bus_in->center_freq();
+  }
+  boost::scoped_ptr<iq_stream_client> stream;
+  if (!o.stream.empty()) {
+    try {
+      stream.reset(new iq_stream_client(o.stream, o.stream_udp));
+    } catch (const std::exception &e) {
+      fprintf(stderr, "frs_rxd: %s\n", e.what());
+      return 1;
+    }
+    o.samp_rate = stream->samp_rate();
+    o.center = stream->center_freq();
+  }
+  o.rx.samp_rate = o.samp_rate;
+  o.rx.center_freq = o.center;
+  o.rx.max_block = BLOCK_FRAMES;
+
+  /* Only listen to channels the capture actually covers */
+  std::vector<struct frs_channel> covered;
+  for (size_t i = 0; i < o.rx.channels.size(); i++) {
+    if (fabs(o.rx.channels[i].frequency - o.center) <
+        o.samp_rate / 2 - 12.5e3) {
+      covered.push_back(o.rx.channels[i]);
+    } else {
+      fprintf(stderr, "channel %d is outside the capture, skipped\n",
+              o.rx.channels[i].number);
+    }
+  }
+  o.rx.channels = covered;
+
+  if (!o.outdir.empty()) {
+    for (size_t i = 0; i < covered.size(); i++) {
+      char path[256];
+      snprintf(path, sizeof(path), "%s/frs%d.s16", o.outdir.c_str(),
+               covered[i].number);
+      audio_files[covered[i].number] = fopen(path, "wb");
+      if (audio_files[covered[i].number] == NULL) {
+        perror(path);
+      }
+    }
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGUSR1, on_trigger_signal);
+
+  /* Receiver time 0 in Unix time, for file names and the clip index */
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  const double start_time = now.tv_sec + now.tv_usec / 1e6;
+  stream_rate = o.samp_rate;
+
+  if (!o.trigger_dir.empty()) {
+    /* A second of slack lets the recorder fall behind that much before
+     * frames after the trigger are lost */
+    struct trigger_config tc;
+    tc.samp_rate = o.samp_rate;
+    tc.pre_seconds = o.pre_seconds;
+    tc.post_seconds = o.post_seconds;
+    tc.start_time = start_time;
+    tc.directory = o.trigger_dir;
+    tc.prefix = "frs";
+    capture_ring.reset(new iq_ring(
+      (size_t)((o.pre_seconds + 1) * o.samp_rate) + BLOCK_FRAMES, 1));
+    recorder.reset(new trigger_recorder(*capture_ring, tc));
+    capture_buf.resize(2 * BLOCK_FRAMES);
+    if (o.trigger_db != 0) {
+      trigger_power = SC16_Q11_SCALE * SC16_Q11_SCALE *
+                      pow(10.0, o.trigger_db / 10);
+    }
+  }
+
+  try {
+    if (!o.index_dir.empty()) {
+      struct clip_store_config cc;
+      cc.directory = o.index_dir;
+      for (size_t i = 0; i < covered.size(); i++) {
+        cc.channels.push_back(covered[i].number);
+      }
+      cc.audio_rate = o.rx.demod.audio_rate;
+      cc.start_time = start_time;
+      cc.max_duration = o.max_clip;
+      clips.reset(new clip_store(cc));
+    }
+    if (!o.bus_out.empty()) {
+      struct iq_bus_config bc;
+      bc.name = o.bus_out;
+      bc.capacity = (size_t)(BUS_SECONDS * o.samp_rate);
+      bc.nchan = 1;
+      bc.samp_rate = o.samp_rate;
+      bc.center_freq = o.center;
+      bc.start_time = start_time;
+      bus_out.reset(new iq_bus_writer(bc));
+      capture_buf.resize(2 * BLOCK_FRAMES);
+    }
+    if (!o.compressed.empty()) {
+      struct sc16_writer_config wc;
+      wc.path = o.compressed;
+      wc.codec = SC16_CODEC_RICE;
+      wc.block_frames = BLOCK_FRAMES;
+      wc.nchan = 1;
+      wc.samp_rate = o.samp_rate;
+      wc.center_freq = o.center;
+      wc.start_time = start_time;
+      compressed_out.reset(new sc16_file_writer(wc));
+      capture_buf.resize(2 * BLOCK_FRAMES);
+    }
+
+    frs_receiver rx(o.rx, &write_audio, &print_event, &print_tone);
+
+    fprintf(stderr, "%zu channels at %.0f S/s around %.4f MHz, %zu threads\n",
+            covered.size(), o.samp_rate, o.center / 1e6, o.rx.threads + 1);
+    fprintf(stderr, "%s channelizer, %.1f multiplies per sample\n",
+            rx.method() == CHANNELIZER_FFT ? "FFT" : "NCO",
+            rx.multiplies());
+
+    if (bus_in) {
+      status = run_bus(o, rx, *bus_in);
+    } else if (stream) {
+      status = run_stream(o, rx, *stream);
+    } else if (o.simulate) {
+      status = run_simulator(o, rx);
+    } else if (!o.file.empty()) {
+      status = run_file(o, rx);
+    } else {
+      status = run_device(o, rx);
+    }
+    if (compressed_out) {
+      compressed_out->close();
+      if (!compressed_out->ok()) {
+        fprintf(stderr, "frs_rxd: writing %s failed\n",
+                o.compressed.c_str());
+        status = -1;
+      } else if (compressed_out->frames() > 0) {
+        fprintf(stderr, "%llu frames recorded, %.2f:1\n",
+                (unsigned long long)compressed_out->frames(),
+                4.0 * compressed_out->frames() / compressed_out->bytes());
+      }
+    }
+    if (clips) {
+      clips->close(rx.samples() / stream_rate);
+      fprintf(stderr, "%llu clips indexed\n",
+              (unsigned long long)clips->clips());
+    }
+  } catch (const std::exception &e) {
+    fprintf(stderr, "frs_rxd: %s\n", e.what());
+    status = -1;
+  }
+
+  if (recorder) {
+    recorder->stop();
+    fprintf(stderr, "%llu trigger files, %llu frames lost\n",
+            (unsigned long long)recorder->files(),
+            (unsigned long long)recorder->lost_frames());
+  }
+
+  for (size_t i = 0; i < audio_files.size(); i++) {
+    if (audio_files[i] != NULL) {
+      fclose(audio_files[i]);
+    }
+  }
+  return status == 0 ? 0 : 1;
+}
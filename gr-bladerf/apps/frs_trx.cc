@@ -0,0 +1,451 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * frs_trx: full-duplex bladeRF transceiver.
+ *
+ * Streams RX and TX at the same time, each on a thread of its own, and
+ * sends TX bursts at hardware timestamps. RX can be recorded with -o
+ * as a raw sc16 file. Each burst is the raw sc16 recording given with
+ * -f, or a tone, and goes out -a seconds after the stream starts and
+ * then every -p seconds. Its samples are pushed while it is on the
+ * air, the way PTT audio would be, and a buffer whose samples are not
+ * there in time is padded with zeros.
+ *
+ * Every burst is reported on stdout as
+ *
+ *   burst <n> requested <ts> start <ts> frames <n> padded <n>
+ *     underruns <n> lead <ms> min_lead <ms> [late] [failed: <error>]
+ *
+ * with timestamps on the TX clock, lead how long before its start the
+ * first buffer was handed to libbladeRF and min_lead the least margin
+ * of any of its buffers. At the end a line
+ *
+ *   # rx frames <n> gaps <n> lost <n> tx bursts <n> frames <n>
+ *     underruns <n> padded <n> late <n> min_lead <ms> offset <frames>
+ *
+ * sums up both streams, offset being the TX clock minus the RX clock.
+ */
+
+#include <libbladeRF.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <string>
+#include <vector>
+#include <inttypes.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "device_utils.h"
+#include "duplex_engine.h"
+
+using namespace gr::bladerf;
+
+static const unsigned int STREAM_TIMEOUT_MS = 1000;
+
+/* How much of a burst is pushed at a time */
+static const size_t PUSH_FRAMES = 4096;
+
+static volatile sig_atomic_t running = 1;
+
+struct options {
+  std::string serial;
+  double samp_rate;
+  double rx_freq;
+  double tx_freq;
+  int rx_gain;
+  int tx_gain;
+  size_t rx_nchan;
+  double first;
+  double period;
+  unsigned int count;
+  double tone_seconds;
+  double lead_ms;
+  double seconds;
+  const char *tx_path;
+  const char *rx_path;
+  struct stream_config stream;
+};
+
+static void
+on_signal(int sig)
+{
+  running = 0;
+}
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -d serial   device serial number\n"
+          "  -r rate     sample rate (default 8e6)\n"
+          "  -c freq     RX frequency (default 465e6)\n"
+          "  -t freq     TX frequency (default: the RX frequency)\n"
+          "  -g gain     RX gain in dB (default 30)\n"
+          "  -G gain     TX gain in dB (default 0)\n"
+          "  -n nchan    RX channels, 1 or 2 (default 1)\n"
+          "  -f file     raw sc16 burst to send (default: a tone)\n"
+          "  -l seconds  length of the tone burst (default 0.5)\n"
+          "  -a seconds  first burst this long in (default 1)\n"
+          "  -p seconds  then one every this long (default: just one)\n"
+          "  -k count    bursts to send with -p (default: until stopped)\n"
+          "  -L ms       TX lead over the hardware clock (default 20)\n"
+          "  -o file     record RX as raw sc16\n"
+          "  -T seconds  stop after this long (default: once sent)\n"
+          "  -b count    libbladeRF buffers (default 16)\n"
+          "  -s frames   libbladeRF buffer size, a multiple of 1024\n"
+          "              (default 4096)\n"
+          "  -x count    libbladeRF transfers in flight (default 8)\n",
+          prog);
+}
+
+static int
+receive(struct bladerf *dev, void *buf, unsigned int nsamples,
+        uint64_t *timestamp)
+{
+  struct bladerf_metadata meta;
+  memset(&meta, 0, sizeof(meta));
+  meta.flags = BLADERF_META_FLAG_RX_NOW;
+  int status = bladerf_sync_rx(dev, buf, nsamples, &meta, STREAM_TIMEOUT_MS);
+  if (status == 0) {
+    *timestamp = meta.timestamp;
+  } else if (status != BLADERF_ERR_TIMEOUT) {
+    fprintf(stderr, "RX failed: %s\n", bladerf_strerror(status));
+  }
+  return status;
+}
+
+static int
+transmit(struct bladerf *dev, const void *buf, unsigned int nsamples,
+         uint64_t timestamp, uint32_t flags)
+{
+  struct bladerf_metadata meta;
+  memset(&meta, 0, sizeof(meta));
+  meta.timestamp = timestamp;
+  meta.flags = flags;
+  int status = bladerf_sync_tx(dev, buf, nsamples, &meta, STREAM_TIMEOUT_MS);
+  if (status != 0) {
+    fprintf(stderr, "TX failed: %s\n", bladerf_strerror(status));
+  }
+  return status;
+}
+
+static void
+record(FILE *out, size_t nchan, const int16_t *frames, size_t nframes,
+       uint64_t timestamp)
+{
+  fwrite(frames, 2 * nchan * sizeof(int16_t), nframes, out);
+}
+
+/* The burst: the file's samples, or a tone a tenth of the sample rate
+ * off the carrier at half scale */
+static bool
+load_burst(const struct options &o, std::vector<int16_t> &samples)
+{
+  if (o.tx_path != NULL) {
+    FILE *in = fopen(o.tx_path, "rb");
+    if (in == NULL) {
+      fprintf(stderr, "frs_trx: unable to read %s\n", o.tx_path);
+      return false;
+    }
+    int16_t buf[2 * 1024];
+    size_t n;
+    while ((n = fread(buf, 2 * sizeof(int16_t), 1024, in)) > 0) {
+      samples.insert(samples.end(), buf, buf + 2 * n);
+    }
+    fclose(in);
+    if (samples.empty()) {
+      fprintf(stderr, "frs_trx: %s is empty\n", o.tx_path);
+      return false;
+    }
+    return true;
+  }
+
+  const size_t n = (size_t)(o.tone_seconds * o.samp_rate);
+  samples.resize(2 * n);
+  for (size_t k = 0; k < n; k++) {
+    const double phase = 2 * M_PI * 0.1 * k;
+    samples[2 * k] = (int16_t)lrint(1024 * cos(phase));
+    samples[2 * k + 1] = (int16_t)lrint(1024 * sin(phase));
+  }
+  return !samples.empty();
+}
+
+static double
+to_ms(const struct options &o, int64_t frames)
+{
+  return frames * 1e3 / o.samp_rate;
+}
+
+static void
+print_reports(const struct options &o, duplex_engine &engine)
+{
+  std::vector<struct duplex_burst_report> reports = engine.take_reports();
+  for (size_t i = 0; i < reports.size(); i++) {
+    const struct duplex_burst_report &r = reports[i];
+    printf("burst %" PRIu64 " requested %" PRIu64 " start %" PRIu64
+           " frames %" PRIu64 " padded %" PRIu64 " underruns %" PRIu64
+           " lead %.3f min_lead %.3f%s", r.id, r.requested, r.start,
+           r.frames, r.padded, r.underruns, to_ms(o, r.lead),
+           to_ms(o, r.min_lead), r.start != r.requested ? " late" : "");
+    if (r.status != 0) {
+      printf(" failed: %s", bladerf_strerror(r.status));
+    }
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
+/* Whether the TX clock has reached t */
+static bool
+reached(duplex_engine &engine, uint64_t t)
+{
+  uint64_t now;
+  return engine.now(&now) && (int64_t)(now - t) >= 0;
+}
+
+static int
+run(const struct options &o, const std::vector<int16_t> &burst,
+    FILE *rx_out)
+{
+  struct bladerf *dev = NULL;
+  int status = open_device(&dev, o.serial);
+  if (status != 0) {
+    return 1;
+  }
+
+  const unsigned int nchan = (unsigned int)o.rx_nchan;
+  struct channel_config config;
+  config.bandwidth  = (unsigned int)(o.samp_rate * 0.8);
+  config.samplerate = (unsigned int)o.samp_rate;
+  for (unsigned int ch = 0; status == 0 && ch < nchan; ch++) {
+    config.channel   = BLADERF_CHANNEL_RX(ch);
+    config.frequency = (unsigned int)o.rx_freq;
+    config.gain      = o.rx_gain;
+    status = configure_channel(dev, &config);
+  }
+  if (status == 0) {
+    config.channel   = BLADERF_CHANNEL_TX(0);
+    config.frequency = (unsigned int)o.tx_freq;
+    config.gain      = o.tx_gain;
+    status = configure_channel(dev, &config);
+  }
+  if (status == 0) {
+    status = init_sync(dev, nchan > 1 ? BLADERF_RX_X2 : BLADERF_RX_X1,
+                       BLADERF_FORMAT_SC16_Q11_META, &o.stream);
+  }
+  if (status == 0) {
+    status = init_sync(dev, BLADERF_TX_X1, BLADERF_FORMAT_SC16_Q11_META,
+                       &o.stream);
+  }
+  if (status == 0) {
+    status = enable_rx_channels(dev, nchan, true);
+  }
+  if (status == 0) {
+    status = enable_tx_channels(dev, 1, true);
+  }
+
+  /* The two timestamp counters run from the same clock but from
+   * different starts; read back to back, their difference is good to
+   * the time of a control transfer */
+  uint64_t rx_now = 0, tx_now = 0;
+  if (status == 0) {
+    status = bladerf_get_timestamp(dev, BLADERF_RX, &rx_now);
+    if (status == 0) {
+      status = bladerf_get_timestamp(dev, BLADERF_TX, &tx_now);
+    }
+    if (status != 0) {
+      fprintf(stderr, "Failed to read the timestamps: %s\n",
+              bladerf_strerror(status));
+    }
+  }
+  if (status != 0) {
+    enable_rx_channels(dev, nchan, false);
+    enable_tx_channels(dev, 1, false);
+    bladerf_close(dev);
+    return 1;
+  }
+
+  struct duplex_config dc;
+  dc.rx_nchan = nchan;
+  dc.tx_nchan = 1;
+  dc.rx_frames = o.stream.buffer_size;
+  dc.tx_frames = o.stream.buffer_size;
+  dc.samp_rate = o.samp_rate;
+  dc.tx_lead = (uint64_t)(o.lead_ms * 1e-3 * o.samp_rate);
+  dc.tx_queue_frames = (size_t)o.samp_rate;
+  dc.tx_offset = (int64_t)(tx_now - rx_now);
+
+  duplex_engine engine(dc, boost::bind(&receive, dev, _1, _2, _3),
+                       boost::bind(&transmit, dev, _1, _2, _3, _4));
+  if (rx_out != NULL) {
+    engine.set_rx_handler(boost::bind(&record, rx_out, o.rx_nchan,
+                                      _1, _2, _3));
+  }
+  engine.start(std::vector<int>(), std::vector<int>(), 0);
+
+  uint64_t origin = 0;
+  while (running && !engine.now(&origin)) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  const uint64_t end = origin + (uint64_t)(o.seconds * o.samp_rate);
+  const size_t total = burst.size() / 2;
+
+  unsigned int scheduled = 0;
+  for (unsigned int k = 0; running && (o.count == 0 || k < o.count); k++) {
+    const uint64_t start =
+      origin + (uint64_t)((o.first + k * o.period) * o.samp_rate);
+    if (o.seconds > 0 && (int64_t)(start - end) >= 0) {
+      break;
+    }
+    /* Schedule it once the previous one is on its way and push its
+     * samples as the queue drains */
+    engine.schedule(start);
+    scheduled++;
+    size_t done = 0;
+    while (running && done < total) {
+      done += engine.push(&burst[2 * done],
+                          std::min(PUSH_FRAMES, total - done), 100);
+      print_reports(o, engine);
+    }
+    engine.end_burst();
+    if (o.period <= 0) {
+      break;
+    }
+    const uint64_t next = start + (uint64_t)(o.period * o.samp_rate);
+    while (running && !reached(engine, next - 2 * dc.tx_lead)) {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+      print_reports(o, engine);
+    }
+  }
+
+  /* Run on to -T, or until the bursts have gone out; repeating ones
+   * without -k or -T go on until stopped */
+  const bool forever = o.seconds <= 0 && o.period > 0 && o.count == 0;
+  while (running) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    print_reports(o, engine);
+    if (o.seconds > 0 ? reached(engine, end)
+                      : !forever && engine.stats().tx_bursts >= scheduled) {
+      break;
+    }
+  }
+  engine.stop();
+  print_reports(o, engine);
+  const struct duplex_stats s = engine.stats();
+
+  printf("# rx frames %" PRIu64 " gaps %" PRIu64 " lost %" PRIu64
+         " tx bursts %" PRIu64 " frames %" PRIu64 " underruns %" PRIu64
+         " padded %" PRIu64 " late %" PRIu64 " min_lead %.3f offset %"
+         PRId64 "\n", s.rx_frames, s.rx_gaps, s.rx_gap_frames, s.tx_bursts,
+         s.tx_frames, s.tx_underruns, s.tx_padded, s.tx_late,
+         to_ms(o, s.tx_min_lead), dc.tx_offset);
+
+  enable_tx_channels(dev, 1, false);
+  enable_rx_channels(dev, nchan, false);
+  bladerf_close(dev);
+  return s.rx_errors > 0 || s.tx_errors > 0 ? 1 : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct options o;
+  bool tx_freq_given = false;
+  int opt;
+
+  o.samp_rate = 8e6;
+  o.rx_freq = 465e6;
+  o.tx_freq = 0;
+  o.rx_gain = 30;
+  o.tx_gain = 0;
+  o.rx_nchan = 1;
+  o.first = 1;
+  o.period = 0;
+  o.count = 0;
+  o.tone_seconds = 0.5;
+  o.lead_ms = 20;
+  o.seconds = 0;
+  o.tx_path = NULL;
+  o.rx_path = NULL;
+  o.stream = default_stream_config;
+
+  while ((opt = getopt(argc, argv, "d:r:c:t:g:G:n:f:l:a:p:k:L:o:T:b:s:x:h"))
+         != -1) {
+    switch (opt) {
+    case 'd': o.serial = optarg; break;
+    case 'r': o.samp_rate = atof(optarg); break;
+    case 'c': o.rx_freq = atof(optarg); break;
+    case 't': o.tx_freq = atof(optarg); tx_freq_given = true; break;
+    case 'g': o.rx_gain = atoi(optarg); break;
+    case 'G': o.tx_gain = atoi(optarg); break;
+    case 'n': o.rx_nchan = atoi(optarg); break;
+    case 'f': o.tx_path = optarg; break;
+    case 'l': o.tone_seconds = atof(optarg); break;
+    case 'a': o.first = atof(optarg); break;
+    case 'p': o.period = atof(optarg); break;
+    case 'k': o.count = atoi(optarg); break;
+    case 'L': o.lead_ms = atof(optarg); break;
+    case 'o': o.rx_path = optarg; break;
+    case 'T': o.seconds = atof(optarg); break;
+    case 'b': o.stream.num_buffers = atoi(optarg); break;
+    case 's': o.stream.buffer_size = atoi(optarg); break;
+    case 'x': o.stream.num_transfers = atoi(optarg); break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || o.samp_rate <= 0 || o.rx_nchan < 1 ||
+      o.rx_nchan > 2 || o.first < 0 || o.period < 0 || o.lead_ms <= 0 ||
+      o.tone_seconds <= 0 || o.stream.buffer_size == 0 ||
+      o.stream.buffer_size % 1024 != 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (!tx_freq_given) {
+    o.tx_freq = o.rx_freq;
+  }
+
+  std::vector<int16_t> burst;
+  if (!load_burst(o, burst)) {
+    return 1;
+  }
+  FILE *rx_out = NULL;
+  if (o.rx_path != NULL && (rx_out = fopen(o.rx_path, "wb")) == NULL) {
+    fprintf(stderr, "frs_trx: unable to write %s\n", o.rx_path);
+    return 1;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  int status = run(o, burst, rx_out);
+  if (rx_out != NULL) {
+    fclose(rx_out);
+  }
+  return status;
+}
@@ -0,0 +1,243 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * iq_served: serve the radio to DSP running on other machines.
+ *
+ * Attaches to an IQ bus published by frs_rxd -B or a single_rx with an
+ * IQ bus name, or reads a raw sc16 recording with -f, and serves the
+ * SC16 frames to TCP clients (the stream_source block, frs_rxd -N) or,
+ * with -u, sends them as UDP datagrams. A client that cannot keep up
+ * with a live bus has blocks dropped for it alone; a recording is
+ * served at the pace of the slowest client unless -R asks for its
+ * real rate. Once a second it prints
+ *
+ *   <clients> <MB/s sent> <compression ratio> <frames dropped>
+ */
+
+#include <boost/scoped_ptr.hpp>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "iq_bus.h"
+#include "iq_stream.h"
+
+using namespace gr::bladerf;
+
+static const size_t BLOCK_FRAMES = 16384;
+static const unsigned short DEFAULT_PORT = 5257;
+
+static volatile sig_atomic_t running = 1;
+
+static void
+on_signal(int sig)
+{
+  running = 0;
+}
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s (-b bus | -f file) [options]\n"
+          "  -b name     serve an IQ bus\n"
+          "  -f file     serve a raw sc16 recording\n"
+          "  -r rate     sample rate of the recording (default 6e6)\n"
+          "  -c freq     center frequency of the recording\n"
+          "  -R          serve the recording at its real rate\n"
+          "  -p port     TCP port to listen on (default %u)\n"
+          "  -u host:port  send UDP datagrams there instead\n"
+          "  -z          compress losslessly (-m rice)\n"
+          "  -m codec    none, delta, rice or pack12\n"
+          "  -k blocks   blocks queued per client (default 64)\n",
+          prog, DEFAULT_PORT);
+}
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Once a second, the figures of the header comment */
+static void
+report(iq_stream_server &server, double *last, uint64_t *last_bytes)
+{
+  double t = now();
+  if (t - *last < 1) {
+    return;
+  }
+  uint64_t bytes = server.encoded_bytes();
+  fprintf(stderr, "%zu %.2f %.2f %llu\n", server.clients(),
+          (bytes - *last_bytes) / (t - *last) / 1e6,
+          bytes ? (double)server.raw_bytes() / bytes : 1.0,
+          (unsigned long long)server.dropped());
+  *last = t;
+  *last_bytes = bytes;
+}
+
+static void
+serve_bus(iq_bus_reader &bus, iq_stream_server &server)
+{
+  std::vector<int16_t> frames(BLOCK_FRAMES * 2 * bus.nchan());
+  double last = now();
+  uint64_t last_bytes = 0;
+
+  while (running) {
+    uint64_t dropped = bus.dropped();
+    size_t n = bus.read(&frames[0], BLOCK_FRAMES, 100);
+    if (bus.dropped() != dropped) {
+      server.gap(bus.dropped() - dropped);
+    }
+    if (n == 0 && !bus.writer_alive()) {
+      fprintf(stderr, "IQ bus publisher has gone away\n");
+      break;
+    }
+    server.write(&frames[0], n);
+    report(server, &last, &last_bytes);
+  }
+}
+
+static int
+serve_file(const char *path, bool real_time, double samp_rate,
+           iq_stream_server &server)
+{
+  FILE *in = fopen(path, "rb");
+  std::vector<int16_t> frames(BLOCK_FRAMES * 2);
+  double start = now(), last = start;
+  uint64_t last_bytes = 0, sent = 0;
+
+  if (in == NULL) {
+    perror(path);
+    return 1;
+  }
+
+  /* A recording is only worth reading once somebody is listening */
+  while (running && server.port() != 0 && server.clients() == 0) {
+    usleep(10000);
+  }
+  start = last = now();
+
+  while (running) {
+    size_t n = fread(&frames[0], 4, BLOCK_FRAMES, in);
+    if (n == 0) {
+      break;
+    }
+    if (real_time) {
+      double ahead = sent / samp_rate - (now() - start);
+      if (ahead > 0) {
+        usleep((useconds_t)(ahead * 1e6));
+      }
+    }
+    server.write(&frames[0], n);
+    sent += n;
+    report(server, &last, &last_bytes);
+  }
+
+  fclose(in);
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  std::string bus_name, file;
+  double samp_rate = 6e6, center = 0;
+  bool real_time = false;
+  struct iq_stream_config config =
+    default_iq_stream_config(DEFAULT_PORT, samp_rate);
+  config.block_frames = BLOCK_FRAMES;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:f:r:c:Rp:u:zm:k:h")) != -1) {
+    switch (opt) {
+    case 'b': bus_name = optarg; break;
+    case 'f': file = optarg; break;
+    case 'r': samp_rate = atof(optarg); break;
+    case 'c': center = atof(optarg); break;
+    case 'R': real_time = true; break;
+    case 'p': config.port = atoi(optarg); break;
+    case 'u': config.udp = optarg; break;
+    case 'z': config.codec = SC16_CODEC_RICE; break;
+    case 'm':
+      if (!parse_sc16_codec(optarg, &config.codec)) {
+        fprintf(stderr, "unknown codec %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'k': config.queue_blocks = atoi(optarg); break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (bus_name.empty() == file.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  try {
+    boost::scoped_ptr<iq_bus_reader> bus;
+    if (!bus_name.empty()) {
+      bus.reset(new iq_bus_reader(bus_name));
+      config.nchan = bus->nchan();
+      config.samp_rate = bus->samp_rate();
+      config.center_freq = bus->center_freq();
+      config.start_time = bus->start_time();
+    } else {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      config.samp_rate = samp_rate;
+      config.center_freq = center;
+      config.start_time = ts.tv_sec + ts.tv_nsec / 1e9;
+      config.block_when_full = !real_time;
+    }
+
+    iq_stream_server server(config);
+    if (config.udp.empty()) {
+      fprintf(stderr, "serving %zu channel(s) at %.0f S/s on port %u\n",
+              config.nchan, config.samp_rate, server.port());
+    } else {
+      fprintf(stderr, "sending %zu channel(s) at %.0f S/s to %s\n",
+              config.nchan, config.samp_rate, config.udp.c_str());
+    }
+
+    if (bus) {
+      serve_bus(*bus, server);
+      return 0;
+    }
+    return serve_file(file.c_str(), real_time, samp_rate, server);
+  } catch (const std::exception &e) {
+    fprintf(stderr, "iq_served: %s\n", e.what());
+    return 1;
+  }
+}
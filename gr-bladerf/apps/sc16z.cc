@@ -0,0 +1,292 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * sc16z: compress raw sc16 recordings losslessly and back.
+ *
+ *   sc16z -e [-m codec] [-r rate] [-c freq] in.sc16 out.sc16z
+ *   sc16z -d [-t threads] [-F] in.sc16z out
+ *   sc16z -B in.sc16
+ *
+ * -e codes a recording as written by rx.cpp or frs_rxd -T into the
+ * block format frs_rxd -w writes, -d turns either back into a raw sc16
+ * recording, or with -F into interleaved floats scaled to +-1 as
+ * DataFromGRC.m reads them, decoding blocks on several threads. -B
+ * codes the recording with every codec and prints
+ *
+ *   <codec> <ratio> <encode MB/s> <decode MB/s>
+ */
+
+#include <boost/scoped_ptr.hpp>
+#include <algorithm>
+#include <complex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "sample_convert.h"
+#include "sc16_codec.h"
+#include "sc16_file.h"
+#include "worker_pool.h"
+
+using namespace gr::bladerf;
+
+static const size_t BLOCK_FRAMES = 16384;
+
+/* Blocks decoded per pass, per thread */
+static const size_t DECODE_BLOCKS = 16;
+
+/* Most of a recording -B reads */
+static const size_t BENCH_FRAMES = 64 << 20;
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s -e [options] in.sc16 out.sc16z\n"
+          "       %s -d [options] in.sc16z out\n"
+          "       %s -B in.sc16\n"
+          "  -m codec    none, delta, rice (default) or pack12\n"
+          "  -r rate     sample rate to note in the header\n"
+          "  -c freq     center frequency to note in the header\n"
+          "  -t threads  decoding threads besides the main one (default 3)\n"
+          "  -F          decode to interleaved float32 instead of sc16\n",
+          prog, prog, prog);
+}
+
+static double
+now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int
+encode(const char *in_path, const char *out_path,
+       const struct sc16_writer_config &config)
+{
+  FILE *in = fopen(in_path, "rb");
+  if (in == NULL) {
+    perror(in_path);
+    return 1;
+  }
+
+  sc16_file_writer out(config);
+  std::vector<int16_t> buf(2 * config.block_frames);
+  size_t n;
+  while ((n = fread(&buf[0], 4, config.block_frames, in)) > 0) {
+    out.write(&buf[0], n);
+  }
+  fclose(in);
+  out.close();
+  if (!out.ok()) {
+    fprintf(stderr, "sc16z: writing %s failed\n", out_path);
+    return 1;
+  }
+  fprintf(stderr, "%llu frames, %.3f:1\n",
+          (unsigned long long)out.frames(),
+          out.bytes() > 0 ? 4.0 * out.frames() / out.bytes() : 0.0);
+  return 0;
+}
+
+static int
+decode(const char *in_path, const char *out_path, size_t threads,
+       bool floats)
+{
+  sc16_file_reader in(in_path);
+  const size_t nchan = in.header().nchan;
+  if (nchan != 1 && floats) {
+    fprintf(stderr, "sc16z: -F takes one channel, %s has %zu\n",
+            in_path, nchan);
+    return 1;
+  }
+
+  boost::scoped_ptr<worker_pool> pool;
+  if (threads > 0) {
+    pool.reset(new worker_pool(threads, std::vector<int>(), 0));
+  }
+  const size_t per_pass = DECODE_BLOCKS * (threads + 1);
+
+  FILE *out = fopen(out_path, "wb");
+  if (out == NULL) {
+    perror(out_path);
+    return 1;
+  }
+
+  std::vector<int16_t> frames;
+  std::vector<std::complex<float> > samples;
+  bool ok = true;
+  for (size_t first = 0; ok && first < in.blocks(); first += per_pass) {
+    size_t count = std::min(per_pass, in.blocks() - first);
+    size_t n = 0;
+    for (size_t i = first; i < first + count; i++) {
+      n += in.block_frames(i);
+    }
+    frames.resize(2 * nchan * n);
+    if (!in.decode(first, count, &frames[0], pool.get())) {
+      fprintf(stderr, "sc16z: %s: block %zu or after is corrupt\n",
+              in_path, first);
+      ok = false;
+      break;
+    }
+    if (floats) {
+      samples.resize(n);
+      std::complex<float> *p = &samples[0];
+      sc16_to_fc32(&frames[0], &p, n, 1, SC16_Q11_SCALE);
+      ok = fwrite(p, sizeof(*p), n, out) == n;
+    } else {
+      ok = fwrite(&frames[0], 4 * nchan, n, out) == n;
+    }
+  }
+  if (fclose(out) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    fprintf(stderr, "sc16z: writing %s failed\n", out_path);
+    return 1;
+  }
+  fprintf(stderr, "%llu frames, %zu blocks\n",
+          (unsigned long long)in.frames(), in.blocks());
+  return 0;
+}
+
+static int
+bench(const char *in_path)
+{
+  FILE *in = fopen(in_path, "rb");
+  if (in == NULL) {
+    perror(in_path);
+    return 1;
+  }
+  std::vector<int16_t> frames(2 * BENCH_FRAMES);
+  size_t total = fread(&frames[0], 4, BENCH_FRAMES, in);
+  fclose(in);
+  frames.resize(2 * total);
+  if (total == 0) {
+    fprintf(stderr, "sc16z: %s is empty\n", in_path);
+    return 1;
+  }
+
+  const enum sc16_codec_type types[4] = {
+    SC16_CODEC_NONE, SC16_CODEC_DELTA, SC16_CODEC_RICE, SC16_CODEC_PACK12
+  };
+  const double mb = 4e-6 * total;
+  std::vector<int16_t> out(frames.size());
+  for (int t = 0; t < 4; t++) {
+    std::vector<std::vector<uint8_t> > coded;
+    std::vector<enum sc16_codec_type> used;
+    size_t bytes = 0;
+
+    double start = now();
+    for (size_t pos = 0; pos < total; pos += BLOCK_FRAMES) {
+      size_t n = std::min(BLOCK_FRAMES, total - pos);
+      coded.push_back(std::vector<uint8_t>());
+      used.push_back(sc16_encode(types[t], &frames[2 * pos], n, 1,
+                                 coded.back()));
+      bytes += coded.back().size();
+    }
+    double encode_time = now() - start;
+
+    start = now();
+    for (size_t b = 0, pos = 0; pos < total; b++, pos += BLOCK_FRAMES) {
+      size_t n = std::min(BLOCK_FRAMES, total - pos);
+      if (!sc16_decode(used[b], &coded[b][0], coded[b].size(), n, 1,
+                       &out[2 * pos])) {
+        fprintf(stderr, "sc16z: %s failed to decode\n",
+                sc16_codec_name(types[t]));
+        return 1;
+      }
+    }
+    double decode_time = now() - start;
+    if (out != frames) {
+      fprintf(stderr, "sc16z: %s is not lossless\n",
+              sc16_codec_name(types[t]));
+      return 1;
+    }
+
+    printf("%-7s %6.3f %8.0f %8.0f\n", sc16_codec_name(types[t]),
+           4.0 * total / bytes, mb / encode_time, mb / decode_time);
+  }
+  return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct sc16_writer_config config;
+  config.codec = SC16_CODEC_RICE;
+  config.block_frames = BLOCK_FRAMES;
+  config.nchan = 1;
+  config.samp_rate = 0;
+  config.center_freq = 0;
+  config.start_time = 0;
+  size_t threads = 3;
+  bool floats = false;
+  char mode = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "edBm:r:c:t:Fh")) != -1) {
+    switch (opt) {
+    case 'e':
+    case 'd':
+    case 'B':
+      mode = opt;
+      break;
+    case 'm':
+      if (!parse_sc16_codec(optarg, &config.codec)) {
+        fprintf(stderr, "unknown codec %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'r': config.samp_rate = atof(optarg); break;
+    case 'c': config.center_freq = atof(optarg); break;
+    case 't': threads = atoi(optarg); break;
+    case 'F': floats = true; break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  const int args = argc - optind;
+  if (mode == 0 || args != (mode == 'B' ? 1 : 2)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  try {
+    if (mode == 'e') {
+      config.path = argv[optind + 1];
+      return encode(argv[optind], argv[optind + 1], config);
+    } else if (mode == 'd') {
+      return decode(argv[optind], argv[optind + 1], threads, floats);
+    }
+    return bench(argv[optind]);
+  } catch (const std::exception &e) {
+    fprintf(stderr, "sc16z: %s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,548 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+/*
+ * seq_audit: count the samples a receive path loses, repeats or mixes
+ * up, from a known counter pattern instead of eyeballed pulses.
+ *
+ *   seq_audit -D [-L] [options]      live, from a bladeRF
+ *   seq_audit -S [options]           a simulated link with faults
+ *   seq_audit [options] capture      a raw sc16 capture
+ *   seq_audit -g file [-N frames]    write the pattern for a TX source
+ *
+ * The tagged pattern carries a 22 bit frame counter and the channel
+ * number in every sample; the FPGA's own 32 bit counter (-p counter,
+ * the default live) carries just the count. Live, the FPGA counter is
+ * selected with the RX mux, or with -L the tagged pattern is sent on
+ * TX and looped back to RX inside the FPGA, so both directions are
+ * audited. -S runs the same audit on buffers of the pattern that are
+ * dropped, repeated or swapped between channels at random.
+ *
+ * Every event goes to stdout as
+ *
+ *   <seconds> <channel> slip|repeat|corrupt|swap <frames> <frame> [<from>]
+ *
+ * with seconds of stream time and the frame of the stream where it
+ * shows, and every -i seconds and at the end a line per channel
+ *
+ *   # <seconds> ch<n> frames <n> lost <n> <ppm> ppm slips <n>
+ *     repeated <n> corrupt <n> swapped <n>
+ *
+ * ending with the buffer geometry, so runs of different geometries can
+ * be compared. The exit status is 2 when anything was found or a
+ * channel never carried the pattern.
+ */
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <libbladeRF.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "device_utils.h"
+#include "sample_convert.h"
+#include "sequence_auditor.h"
+
+using namespace gr::bladerf;
+
+static const unsigned int RX_TIMEOUT_MS = 3500;
+
+static volatile sig_atomic_t running = 1;
+
+/* Frames at the last report, so the final one is not a repeat */
+static uint64_t reported = ~0ull;
+
+struct options {
+  size_t nchan;
+  enum sequence_pattern pattern;
+  bool pattern_given;
+  bool loopback;
+  bool quiet;
+  double samp_rate;
+  double center;
+  double seconds;
+  double interval;
+  size_t block_frames;
+  struct stream_config stream;
+  double p_drop, p_repeat, p_swap;
+  std::string serial;
+};
+
+static void
+on_signal(int sig)
+{
+  running = 0;
+}
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "Usage: %s -D [-L] [options]\n"
+          "       %s -S [options]\n"
+          "       %s [options] capture.sc16\n"
+          "       %s -g file [-N frames] [-n nchan] [-F]\n"
+          "  -D          audit a bladeRF live\n"
+          "  -L          with -D, send the tagged pattern on TX through\n"
+          "              the FPGA loopback instead of the FPGA counter\n"
+          "  -S          audit a simulated link\n"
+          "  -d serial   device serial number\n"
+          "  -n nchan    channels, 1 or 2 (default 1)\n"
+          "  -p pattern  tagged or counter (default: counter live,\n"
+          "              tagged otherwise)\n"
+          "  -r rate     sample rate (default 8e6)\n"
+          "  -c freq     LO frequency (default 465e6)\n"
+          "  -b count    libbladeRF buffers (default 16)\n"
+          "  -s frames   libbladeRF buffer size, a multiple of 1024\n"
+          "              (default 4096)\n"
+          "  -x count    libbladeRF transfers in flight (default 8)\n"
+          "  -B frames   frames per read (default: the buffer size)\n"
+          "  -T seconds  stop after this much stream time\n"
+          "  -i seconds  report interval (default 1)\n"
+          "  -P d,r,s    with -S, chance per buffer of a drop, a repeat\n"
+          "              and a channel swap (default 1e-3,1e-4,1e-4)\n"
+          "  -q          no event lines, only the reports\n"
+          "  -g file     write the tagged pattern as sc16 and exit\n"
+          "  -N frames   frames for -g (default 4194304, a full cycle)\n"
+          "  -F          with -g, write float32 complex for GRC\n",
+          prog, prog, prog, prog);
+}
+
+static bool
+parse_probabilities(const char *s, struct options &o)
+{
+  return sscanf(s, "%lf,%lf,%lf", &o.p_drop, &o.p_repeat, &o.p_swap) == 3 &&
+         o.p_drop >= 0 && o.p_repeat >= 0 && o.p_swap >= 0 &&
+         o.p_drop + o.p_repeat + o.p_swap <= 1;
+}
+
+static bool
+write_pattern(const char *path, size_t nchan, size_t frames, bool floats)
+{
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  const size_t block = 65536;
+  std::vector<int16_t> sc16(2 * nchan * block);
+  std::vector<float> fc32(floats ? sc16.size() : 0);
+  bool ok = true;
+  for (size_t k = 0; ok && k < frames; k += block) {
+    size_t n = std::min(block, frames - k);
+    sequence_frames(k, nchan, n, &sc16[0]);
+    if (floats) {
+      /* At the scale the GRC bladeRF sink takes back to SC16 Q11 */
+      for (size_t i = 0; i < 2 * nchan * n; i++) {
+        fc32[i] = sc16[i] / SC16_Q11_SCALE;
+      }
+      ok = fwrite(&fc32[0], sizeof(float), 2 * nchan * n, f) ==
+           2 * nchan * n;
+    } else {
+      ok = fwrite(&sc16[0], sizeof(int16_t), 2 * nchan * n, f) ==
+           2 * nchan * n;
+    }
+  }
+  ok = fclose(f) == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "seq_audit: unable to write %s\n", path);
+  }
+  return ok;
+}
+
+static uint64_t
+found(const sequence_auditor &audit)
+{
+  uint64_t n = 0;
+  for (size_t ch = 0; ch < audit.nchan(); ch++) {
+    n += audit.slips(ch) + audit.repeated(ch) + audit.corrupt(ch) +
+         audit.swapped(ch) + !audit.synced(ch);
+  }
+  return n;
+}
+
+static void
+print_events(const struct options &o, sequence_auditor &audit)
+{
+  const std::vector<sequence_event> &e = audit.events();
+  for (size_t k = 0; !o.quiet && k < e.size(); k++) {
+    printf("%.6f %zu %s %llu %llu", e[k].position / o.samp_rate,
+           e[k].channel + 1, sequence_event_name(e[k].type),
+           (unsigned long long)e[k].frames,
+           (unsigned long long)e[k].position);
+    if (e[k].type == SEQ_SWAP) {
+      printf(" %zu", e[k].source + 1);
+    }
+    printf("\n");
+  }
+  audit.clear_events();
+}
+
+static void
+report(const struct options &o, const sequence_auditor &audit)
+{
+  const double seconds = audit.frames() / o.samp_rate;
+  for (size_t ch = 0; ch < audit.nchan(); ch++) {
+    const uint64_t lost = audit.lost(ch);
+    const uint64_t sent = audit.frames() + lost - audit.repeated(ch);
+    reported = audit.frames();
+    printf("# %.3f ch%zu frames %llu lost %llu %.3f ppm slips %llu "
+           "repeated %llu corrupt %llu swapped %llu%s\n",
+           seconds, ch + 1, (unsigned long long)audit.frames(),
+           (unsigned long long)lost, sent > 0 ? 1e6 * lost / sent : 0.0,
+           (unsigned long long)audit.slips(ch),
+           (unsigned long long)audit.repeated(ch),
+           (unsigned long long)audit.corrupt(ch),
+           (unsigned long long)audit.swapped(ch),
+           audit.synced(ch) ? "" : " never synced");
+  }
+  fflush(stdout);
+}
+
+/* Audit one read's worth, reporting every interval; false once the
+ * requested time is up */
+static bool
+audit_block(const struct options &o, sequence_auditor &audit,
+            const int16_t *frames, size_t n, uint64_t *next_report)
+{
+  audit.process(frames, n);
+  print_events(o, audit);
+  if (audit.frames() >= *next_report) {
+    report(o, audit);
+    *next_report += (uint64_t)(o.interval * o.samp_rate);
+  }
+  return o.seconds <= 0 || audit.frames() < o.seconds * o.samp_rate;
+}
+
+/* Small, fast and the same everywhere, for the simulated faults */
+static double
+uniform(uint64_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return (*state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void
+fill(const struct options &o, uint64_t first, size_t n, int16_t *out)
+{
+  if (o.pattern == SEQ_TAGGED) {
+    sequence_frames(first, o.nchan, n, out);
+    return;
+  }
+  for (size_t k = 0; k < n; k++) {
+    uint32_t c = (uint32_t)(first + k);
+    for (size_t ch = 0; ch < o.nchan; ch++) {
+      *out++ = (int16_t)(c & 0xffff);
+      *out++ = (int16_t)(c >> 16);
+    }
+  }
+}
+
+/* Buffers of the pattern as a link with faults would deliver them */
+static int
+run_simulated(const struct options &o, sequence_auditor &audit)
+{
+  const size_t size = o.stream.buffer_size;
+  std::vector<int16_t> buf(2 * o.nchan * size);
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+  uint64_t source = 0, next_report = (uint64_t)(o.interval * o.samp_rate);
+  bool have = false;
+
+  while (running) {
+    double u = uniform(&state);
+    if (u < o.p_drop) {
+      source += size;
+      continue;
+    }
+    if (!(have && u < o.p_drop + o.p_repeat)) {
+      fill(o, source, size, &buf[0]);
+      source += size;
+      have = true;
+    }
+    if (o.nchan > 1 && u >= o.p_drop + o.p_repeat &&
+        u < o.p_drop + o.p_repeat + o.p_swap) {
+      std::vector<int16_t> swapped(buf);
+      for (size_t k = 0; k < size; k++) {
+        std::swap(swapped[4 * k], swapped[4 * k + 2]);
+        std::swap(swapped[4 * k + 1], swapped[4 * k + 3]);
+      }
+      if (!audit_block(o, audit, &swapped[0], size, &next_report)) {
+        break;
+      }
+    } else if (!audit_block(o, audit, &buf[0], size, &next_report)) {
+      break;
+    }
+  }
+  return 0;
+}
+
+static int
+run_file(const struct options &o, sequence_auditor &audit, const char *path)
+{
+  FILE *in = fopen(path, "rb");
+  if (in == NULL) {
+    perror(path);
+    return 1;
+  }
+  std::vector<int16_t> buf(2 * o.nchan * o.block_frames);
+  uint64_t next_report = (uint64_t)(o.interval * o.samp_rate);
+  size_t n;
+  while (running &&
+         (n = fread(&buf[0], 2 * o.nchan * sizeof(int16_t),
+                    o.block_frames, in)) > 0) {
+    if (!audit_block(o, audit, &buf[0], n, &next_report)) {
+      break;
+    }
+  }
+  bool failed = ferror(in);
+  fclose(in);
+  if (failed) {
+    fprintf(stderr, "seq_audit: unable to read %s\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+/* Keeps TX fed with the tagged pattern until told to stop */
+static void
+transmit(struct bladerf *dev, const struct options *o, int *status)
+{
+  std::vector<int16_t> buf(2 * o->nchan * o->block_frames);
+  uint64_t next = 0;
+  while (running) {
+    sequence_frames(next, o->nchan, o->block_frames, &buf[0]);
+    *status = bladerf_sync_tx(dev, &buf[0], o->block_frames * o->nchan,
+                              NULL, RX_TIMEOUT_MS);
+    if (*status != 0) {
+      fprintf(stderr, "TX failed: %s\n", bladerf_strerror(*status));
+      running = 0;
+      break;
+    }
+    next += o->block_frames;
+  }
+}
+
+static int
+run_device(const struct options &o, sequence_auditor &audit)
+{
+  struct bladerf *dev = NULL;
+  int status = open_device(&dev, o.serial);
+  if (status != 0) {
+    return 1;
+  }
+
+  const unsigned int nchan = (unsigned int)o.nchan;
+  for (unsigned int ch = 0; status == 0 && ch < nchan; ch++) {
+    struct channel_config config;
+    config.channel    = BLADERF_CHANNEL_RX(ch);
+    config.frequency  = (unsigned int)o.center;
+    config.bandwidth  = (unsigned int)(o.samp_rate * 0.8);
+    config.samplerate = (unsigned int)o.samp_rate;
+    config.gain       = 0;
+    status = configure_channel(dev, &config);
+    if (status == 0 && o.loopback) {
+      config.channel = BLADERF_CHANNEL_TX(ch);
+      status = configure_channel(dev, &config);
+    }
+  }
+  if (status == 0) {
+    status = bladerf_set_rx_mux(dev, o.loopback
+                                       ? BLADERF_RX_MUX_DIGITAL_LOOPBACK
+                                       : BLADERF_RX_MUX_32BIT_COUNTER);
+    if (status != 0) {
+      fprintf(stderr, "Failed to set the RX mux: %s\n",
+              bladerf_strerror(status));
+    }
+  }
+  if (status == 0) {
+    status = init_sync(dev, nchan > 1 ? BLADERF_RX_X2 : BLADERF_RX_X1,
+                       BLADERF_FORMAT_SC16_Q11, &o.stream);
+  }
+  if (status == 0 && o.loopback) {
+    status = init_sync(dev, nchan > 1 ? BLADERF_TX_X2 : BLADERF_TX_X1,
+                       BLADERF_FORMAT_SC16_Q11, &o.stream);
+    if (status == 0) {
+      status = enable_tx_channels(dev, nchan, true);
+    }
+  }
+  if (status == 0) {
+    status = enable_rx_channels(dev, nchan, true);
+  }
+  if (status != 0) {
+    bladerf_set_rx_mux(dev, BLADERF_RX_MUX_BASEBAND);
+    bladerf_close(dev);
+    return 1;
+  }
+
+  int tx_status = 0;
+  boost::thread *tx = NULL;
+  if (o.loopback) {
+    tx = new boost::thread(boost::bind(&transmit, dev, &o, &tx_status));
+  }
+
+  std::vector<int16_t> buf(2 * o.nchan * o.block_frames);
+  uint64_t next_report = (uint64_t)(o.interval * o.samp_rate);
+  while (running) {
+    status = bladerf_sync_rx(dev, &buf[0], o.block_frames * nchan, NULL,
+                             RX_TIMEOUT_MS);
+    if (status != 0) {
+      fprintf(stderr, "RX failed: %s\n", bladerf_strerror(status));
+      break;
+    }
+    if (!audit_block(o, audit, &buf[0], o.block_frames, &next_report)) {
+      break;
+    }
+  }
+  running = 0;
+  if (tx != NULL) {
+    tx->join();
+    delete tx;
+    enable_tx_channels(dev, nchan, false);
+  }
+  enable_rx_channels(dev, nchan, false);
+  bladerf_set_rx_mux(dev, BLADERF_RX_MUX_BASEBAND);
+  bladerf_close(dev);
+  return status != 0 || tx_status != 0 ? 1 : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct options o;
+  bool device = false, simulate = false, floats = false;
+  const char *pattern_path = NULL;
+  size_t pattern_frames = 1 << 22;
+  int opt;
+
+  o.nchan = 1;
+  o.pattern = SEQ_TAGGED;
+  o.pattern_given = false;
+  o.loopback = false;
+  o.quiet = false;
+  o.samp_rate = 8e6;
+  o.center = 465e6;
+  o.seconds = 0;
+  o.interval = 1;
+  o.block_frames = 0;
+  o.stream = default_stream_config;
+  o.p_drop = 1e-3;
+  o.p_repeat = 1e-4;
+  o.p_swap = 1e-4;
+
+  while ((opt = getopt(argc, argv, "DLSd:n:p:r:c:b:s:x:B:T:i:P:qg:N:Fh"))
+         != -1) {
+    switch (opt) {
+    case 'D': device = true; break;
+    case 'L': o.loopback = true; break;
+    case 'S': simulate = true; break;
+    case 'd': o.serial = optarg; break;
+    case 'n': o.nchan = atoi(optarg); break;
+    case 'p':
+      if (!parse_sequence_pattern(optarg, &o.pattern)) {
+        fprintf(stderr, "seq_audit: unknown pattern %s\n", optarg);
+        return 1;
+      }
+      o.pattern_given = true;
+      break;
+    case 'r': o.samp_rate = atof(optarg); break;
+    case 'c': o.center = atof(optarg); break;
+    case 'b': o.stream.num_buffers = atoi(optarg); break;
+    case 's': o.stream.buffer_size = atoi(optarg); break;
+    case 'x': o.stream.num_transfers = atoi(optarg); break;
+    case 'B': o.block_frames = atoi(optarg); break;
+    case 'T': o.seconds = atof(optarg); break;
+    case 'i': o.interval = atof(optarg); break;
+    case 'P':
+      if (!parse_probabilities(optarg, o)) {
+        fprintf(stderr, "seq_audit: bad fault chances %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'q': o.quiet = true; break;
+    case 'g': pattern_path = optarg; break;
+    case 'N': pattern_frames = atoi(optarg); break;
+    case 'F': floats = true; break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (o.nchan < 1 || o.nchan > 2 || o.samp_rate <= 0 ||
+      o.interval <= 0 || o.stream.buffer_size == 0 ||
+      o.stream.buffer_size % 1024 != 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (pattern_path != NULL) {
+    return write_pattern(pattern_path, o.nchan, pattern_frames, floats)
+           ? 0 : 1;
+  }
+  if ((int)device + (int)simulate + (optind < argc) != 1 ||
+      (o.loopback && !device)) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (device) {
+    if (o.loopback && o.pattern_given && o.pattern != SEQ_TAGGED) {
+      fprintf(stderr, "seq_audit: the loopback carries the tagged "
+              "pattern\n");
+      return 1;
+    }
+    o.pattern = o.loopback || o.pattern_given ? o.pattern : SEQ_COUNTER32;
+  }
+  if (o.block_frames == 0) {
+    o.block_frames = o.stream.buffer_size;
+  }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  sequence_auditor audit(o.nchan, o.pattern);
+  int status;
+  if (device) {
+    status = run_device(o, audit);
+  } else if (simulate) {
+    status = run_simulated(o, audit);
+  } else {
+    status = run_file(o, audit, argv[optind]);
+  }
+  audit.finish();
+  print_events(o, audit);
+  if (reported != audit.frames()) {
+    report(o, audit);
+  }
+  printf("# geometry nchan %zu buffers %u size %u transfers %u read %zu "
+         "pattern %s\n", o.nchan, o.stream.num_buffers,
+         o.stream.buffer_size, o.stream.num_transfers, o.block_frames,
+         o.pattern == SEQ_TAGGED ? "tagged" : "counter");
+  if (status != 0) {
+    return status;
+  }
+  return found(audit) > 0 ? 2 : 0;
+}
@@ -0,0 +1,64 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_BUS_SOURCE_H
+#define INCLUDED_BLADERF_BUS_SOURCE_H
+
+#include <bladerf/api.h>
+#include <gnuradio/sync_block.h>
+#include <string>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Samples from a shared memory IQ bus
+     * \ingroup bladerf
+     *
+     * Attaches to a bus published by single_rx or frs_rxd in another
+     * process and delivers its channels as complex floats, so several
+     * flowgraphs can share one radio without another USB stream. The
+     * SC16 samples are converted straight out of shared memory. Samples
+     * the writer overran before this block got to them come out as
+     * zeros or are skipped, and either way are tagged rx_gap with the
+     * number lost; rx_time tags give the time of the first sample and
+     * of the first after each skip.
+     */
+    class BLADERF_API bus_source : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<bus_source> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of
+       * bladerf::bus_source.
+       *
+       * \param bus      bus name, as given to the publisher
+       * \param channels channels the bus carries, one output each
+       */
+      static sptr make(const std::string &bus, int channels = 1);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_BUS_SOURCE_H */
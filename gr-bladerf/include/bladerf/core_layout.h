@@ -0,0 +1,83 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_CORE_LAYOUT_H
+#define INCLUDED_BLADERF_CORE_LAYOUT_H
+
+#include <bladerf/api.h>
+#include <vector>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief One logical CPU as seen in /sys/devices/system
+     * \ingroup bladerf
+     */
+    struct BLADERF_API cpu_info {
+      int cpu;     /*!< logical CPU number */
+      int core;    /*!< physical core id within the package */
+      int package; /*!< physical package (socket) id */
+      int node;    /*!< NUMA node */
+    };
+
+    /*!
+     * \brief Assigns the threads of a multi-channel receiver to CPUs
+     * \ingroup bladerf
+     *
+     * Places the capture thread, the output thread and one DSP chain per
+     * channel on separate physical cores of a single NUMA node. CPU 0 is
+     * left to the kernel and interrupts when there are enough cores, and
+     * hyper-thread siblings are only handed out once every physical DSP
+     * core has a channel. The result is meant to fill the affinity of the
+     * RX block and of each channel's blocks, e.g.
+     * bladerf.core_layout(14).channel(3) in a GRC affinity field.
+     */
+    class BLADERF_API core_layout
+    {
+     public:
+      /*! Lay out \p nchannels DSP chains on the CPUs of this machine */
+      core_layout(int nchannels);
+      /*! Lay out \p nchannels DSP chains on the given topology */
+      core_layout(const std::vector<cpu_info> &cpus, int nchannels);
+
+      std::vector<int> capture() const { return d_capture; }
+      std::vector<int> output() const { return d_output; }
+      std::vector<int> channel(int ch) const;
+      int nchannels() const { return d_nchannels; }
+
+      /*! Read the topology of the CPUs this process may run on */
+      static std::vector<cpu_info> probe();
+
+     private:
+      int d_nchannels;
+      std::vector<int> d_capture;
+      std::vector<int> d_output;
+      std::vector<int> d_dsp;
+
+      void plan(const std::vector<cpu_info> &cpus);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_CORE_LAYOUT_H */
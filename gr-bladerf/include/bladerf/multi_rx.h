@@ -0,0 +1,87 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_BLADERF_MULTI_RX_H
+#define INCLUDED_BLADERF_MULTI_RX_H
+
+#include <bladerf/api.h>
+#include <gnuradio/sync_block.h>
+#include <string>
+#include <vector>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Synchronized receive from several bladeRF devices
+     * \ingroup bladerf
+     *
+     * Opens one device per serial number and streams \p nchan RX channels
+     * from each of them. The first device is the master: with ref "master"
+     * it drives its reference clock to the others, and its trigger output
+     * starts the streams of every device on the same sample. Each device is
+     * read by its own capture thread, optionally pinned to a core from
+     * \p cores, and the buffers are aligned by hardware timestamp before they
+     * are written out. Output k carries channel k % nchan of device
+     * k / nchan.
+     *
+     * With trigger "none" the streams start whenever each device gets to
+     * it and each device's first timestamp is taken as its time zero, so
+     * the outputs of different devices are not sample-aligned; only the
+     * channels of one device are.
+     */
+    class BLADERF_API multi_rx : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<multi_rx> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of bladerf::multi_rx.
+       *
+       * \param serials   serial numbers of the devices, master first
+       * \param nchan     RX channels used on each device (1 or 2)
+       * \param freq      center frequency in Hz
+       * \param samp_rate sample rate in samples/s
+       * \param bandwidth analog filter bandwidth in Hz
+       * \param gain      RX gain in dB
+       * \param ref       "master", "external" or "internal" clock reference
+       * \param trigger   "miniexp-1", "j51-1", "j71-4" or "none"
+       *                  (devices are then not sample-aligned)
+       * \param cores     cores to pin the capture threads to, one per device
+       * \param rt_priority SCHED_FIFO priority of the capture threads
+       *                  (0 keeps the normal scheduler)
+       */
+      static sptr make(const std::vector<std::string> &serials,
+                       int nchan, double freq, double samp_rate,
+                       double bandwidth, int gain,
+                       const std::string &ref = "master",
+                       const std::string &trigger = "miniexp-1",
+                       const std::vector<int> &cores = std::vector<int>(),
+                       int rt_priority = 0);
+
+      /*! Number of buffers dropped because the flowgraph fell behind */
+      virtual uint64_t overflows(int device) = 0;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_MULTI_RX_H */
@@ -24,6 +24,8 @@
 
 #include <bladerf/api.h>
 #include <gnuradio/sync_block.h>
+#include <string>
+#include <vector>
 
 namespace gr {
   namespace bladerf {
@@ -32,6 +34,20 @@ namespace gr {
      * \brief <+description of block+>
      * \ingroup bladerf
      *
+     * Bit n of the channel mask selects RX channel n, and every selected
+     * channel gets its own output, lowest channel first. A mask of 0x1
+     * or 0x2 streams that channel alone with the X1 layout, so only it
+     * is configured, enabled and carried over USB; 0x3 streams both
+     * with X2.
+     *
+     * With format "sc8" samples cross USB as 8-bit SC8_Q7, which halves
+     * the bandwidth per sample; the outputs are scaled to the same +/-1.0
+     * range either way. FPGAs without SC8 support fall back to SC16.
+     *
+     * Naming a bus publishes the raw stream, every streamed channel, to
+     * a shared memory IQ bus from the capture thread while the block
+     * runs, so other processes can use the same samples through
+     * bladerf.bus_source or iq_bus_reader.
      */
     class BLADERF_API single_rx : virtual public gr::sync_block
     {
@@ -45,8 +61,23 @@ namespace gr {
        * constructor is in a private implementation
        * class. bladerf::single_rx::make is the public interface for
        * creating new instances.
+       *
+       * \param cores       CPUs for the capture, convert and work threads,
+       *                    one each, wrapping around (empty: any)
+       * \param rt_priority SCHED_FIFO priority of those threads (0: normal)
+       * \param profile     file to restore the device configuration,
+       *                    calibration and quick-tune table from, and to
+       *                    save them to once configured (empty: none)
+       * \param channel_mask RX channels to deliver (0x1, 0x2 or 0x3)
+       * \param format      "sc16" or "sc8" sample format over USB
+       * \param bus         IQ bus to publish to (empty: none)
        */
-      static sptr make();
+      static sptr make(const std::vector<int> &cores = std::vector<int>(),
+                       int rt_priority = 0,
+                       const std::string &profile = "",
+                       int channel_mask = 0x1,
+                       const std::string &format = "sc16",
+                       const std::string &bus = "");
     };
 
   } // namespace bladerf
@@ -0,0 +1,66 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_STREAM_SOURCE_H
+#define INCLUDED_BLADERF_STREAM_SOURCE_H
+
+#include <bladerf/api.h>
+#include <gnuradio/sync_block.h>
+#include <string>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Samples served over the network by iq_served
+     * \ingroup bladerf
+     *
+     * Connects to an IQ stream server, or over UDP listens for one, so
+     * the DSP can run on a bigger machine than the one the radio is
+     * plugged into. Blocks are decoded as they arrive. Samples that
+     * never arrived, because the server dropped them for a slow
+     * connection, the radio lost them or a datagram went missing, are
+     * skipped and tagged rx_gap with the number lost; rx_time tags give
+     * the time of the first sample and of the first after each skip.
+     */
+    class BLADERF_API stream_source : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<stream_source> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of
+       * bladerf::stream_source.
+       *
+       * \param address  server "host:port", or with udp the local
+       *                 "host:port" the server sends to
+       * \param udp      receive datagrams rather than connect over TCP
+       * \param channels channels the stream carries, one output each
+       */
+      static sptr make(const std::string &address, bool udp = false,
+                       int channels = 1);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_STREAM_SOURCE_H */
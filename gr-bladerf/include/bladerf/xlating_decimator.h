@@ -0,0 +1,64 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_XLATING_DECIMATOR_H
+#define INCLUDED_BLADERF_XLATING_DECIMATOR_H
+
+#include <bladerf/api.h>
+#include <gnuradio/sync_decimator.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Frequency translating multi-stage decimator
+     * \ingroup bladerf
+     *
+     * Drop-in for a freq_xlating_fir_filter followed by a decimating
+     * fir_filter: an NCO moves \p offset to DC, a multiplier-free CIC
+     * stage and halfband stages take out most of the rate, and a final
+     * real-tap FIR shapes the channel and corrects the CIC droop. Only
+     * retained outputs are computed at every stage.
+     */
+    class BLADERF_API xlating_decimator : virtual public gr::sync_decimator
+    {
+     public:
+      typedef boost::shared_ptr<xlating_decimator> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of
+       * bladerf::xlating_decimator.
+       *
+       * \param samp_rate input sample rate
+       * \param offset    channel centre relative to the input's, Hz
+       * \param decim     total decimation
+       * \param passband  edge of the flat part of the channel, Hz
+       * \param stopband  start of the fully attenuated band, Hz
+       */
+      static sptr make(double samp_rate, double offset, int decim,
+                       double passband, double stopband);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_XLATING_DECIMATOR_H */
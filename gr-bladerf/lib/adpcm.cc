@@ -0,0 +1,104 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include "adpcm.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const int STEPS[89] = {
+      7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34,
+      37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+      157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494,
+      544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552,
+      1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428,
+      4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+      12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086,
+      29794, 32767
+    };
+
+    static const int INDEX_STEP[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+    int16_t
+    adpcm_state::decode_one(uint8_t code)
+    {
+      const int step = STEPS[d_index];
+      int diff = step >> 3;
+      if (code & 4) diff += step;
+      if (code & 2) diff += step >> 1;
+      if (code & 1) diff += step >> 2;
+      d_predicted += (code & 8) ? -diff : diff;
+      d_predicted = std::max(-32768, std::min(32767, d_predicted));
+      d_index = std::max(0, std::min(88, d_index + INDEX_STEP[code & 7]));
+      return (int16_t)d_predicted;
+    }
+
+    uint8_t
+    adpcm_state::encode_one(int x)
+    {
+      const int step = STEPS[d_index];
+      int diff = x - d_predicted;
+      uint8_t code = 0;
+      if (diff < 0) {
+        code = 8;
+        diff = -diff;
+      }
+      if (diff >= step) { code |= 4; diff -= step; }
+      if (diff >= step >> 1) { code |= 2; diff -= step >> 1; }
+      if (diff >= step >> 2) { code |= 1; }
+
+      /* Track the decoder exactly */
+      decode_one(code);
+      return code;
+    }
+
+    void
+    adpcm_state::encode(const int16_t *in, size_t n, uint8_t *out)
+    {
+      for (size_t i = 0; i + 1 < n; i += 2) {
+        uint8_t lo = encode_one(in[i]);
+        *out++ = lo | (uint8_t)(encode_one(in[i + 1]) << 4);
+      }
+      if (n & 1) {
+        *out = encode_one(in[n - 1]);
+      }
+    }
+
+    void
+    adpcm_state::decode(const uint8_t *in, size_t n, int16_t *out)
+    {
+      for (size_t i = 0; i + 1 < n; i += 2) {
+        out[i] = decode_one(in[i / 2] & 15);
+        out[i + 1] = decode_one(in[i / 2] >> 4);
+      }
+      if (n & 1) {
+        out[n - 1] = decode_one(in[n / 2] & 15);
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,63 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_ADPCM_H
+#define INCLUDED_BLADERF_ADPCM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief IMA ADPCM, four bits per 16-bit sample.
+     *
+     * Samples are packed two per byte, the first in the low nibble. The
+     * coder state starts at zero and a trailing odd sample leaves the
+     * high nibble zero, so a clip encoded in one piece decodes on its
+     * own from (n + 1) / 2 bytes.
+     */
+    class adpcm_state
+    {
+     public:
+      adpcm_state() : d_predicted(0), d_index(0) {}
+
+      /* n samples to (n + 1) / 2 bytes, and back; encode() must be
+       * given an even n except on a clip's last call */
+      void encode(const int16_t *in, size_t n, uint8_t *out);
+      void decode(const uint8_t *in, size_t n, int16_t *out);
+
+      static size_t bytes(size_t samples) { return (samples + 1) / 2; }
+
+     private:
+      int d_predicted;
+      int d_index;
+
+      uint8_t encode_one(int x);
+      int16_t decode_one(uint8_t code);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_ADPCM_H */
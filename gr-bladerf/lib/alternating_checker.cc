@@ -0,0 +1,330 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "alternating_checker.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Samples per correlated block, and blocks to acquire over */
+    static const size_t BLOCK = 64;
+    static const size_t WINDOW_BLOCKS = 16;
+
+    /* Periods of history kept, enough to look back from the end of a
+     * break of two periods for the lag search */
+    static const size_t HISTORY_PERIODS = 8;
+
+    /* Breaks longer than this many periods are outages, not slips */
+    static const size_t SLIP_PERIODS = 2;
+
+    std::vector<float>
+    srrc_taps(double beta, size_t span, size_t sps)
+    {
+      if (beta <= 0 || beta > 1 || span == 0 || sps == 0 ||
+          (span * sps) % 2 != 0) {
+        throw std::invalid_argument("srrc_taps: bad design");
+      }
+      const size_t n = span * sps + 1;
+      std::vector<double> b(n);
+      double energy = 0;
+      for (size_t i = 0; i < n; i++) {
+        /* Time in symbols from the centre tap */
+        double t = ((double)i - (double)(n - 1) / 2) / sps;
+        if (t == 0) {
+          b[i] = -1 / (M_PI * sps) * (M_PI * (beta - 1) - 4 * beta);
+        } else if (fabs(fabs(4 * beta * t) - 1) < 1.5e-8) {
+          b[i] = 1 / (2 * M_PI * sps) *
+                 (M_PI * (beta + 1) * sin(M_PI * (beta + 1) / (4 * beta)) -
+                  4 * beta * sin(M_PI * (beta - 1) / (4 * beta)) +
+                  M_PI * (beta - 1) * cos(M_PI * (beta - 1) / (4 * beta)));
+        } else {
+          b[i] = -4 * beta / sps *
+                 (cos((1 + beta) * M_PI * t) +
+                  sin((1 - beta) * M_PI * t) / (4 * beta * t)) /
+                 (M_PI * ((4 * beta * t) * (4 * beta * t) - 1));
+        }
+        energy += b[i] * b[i];
+      }
+
+      std::vector<float> taps(n);
+      for (size_t i = 0; i < n; i++) {
+        taps[i] = (float)(b[i] / sqrt(energy));
+      }
+      return taps;
+    }
+
+    std::vector<float>
+    alternating_sequence()
+    {
+      static const int pattern[8] = { 1, 1, -1, 1, -1, -1, 1, -1 };
+      const size_t sps = 64, symbols = 64;
+      const std::vector<float> taps = srrc_taps(0.5, 6, sps);
+
+      /* filter(B, 1, upsample(pattern, sps)), which starts from rest
+       * and stops at the length of the pattern */
+      std::vector<float> out(symbols * sps, 0.0f);
+      for (size_t s = 0; s < symbols; s++) {
+        for (size_t k = 0; k < taps.size() && s * sps + k < out.size();
+             k++) {
+          out[s * sps + k] += pattern[s % 8] * taps[k];
+        }
+      }
+      return out;
+    }
+
+    alternating_checker::alternating_checker(size_t period, float threshold)
+      : d_period(period),
+        d_threshold(threshold),
+        d_samples(0),
+        d_good_samples(0),
+        d_product(0),
+        d_energy(0),
+        d_prev_energy(0),
+        d_win_product(WINDOW_BLOCKS),
+        d_win_energy(WINDOW_BLOCKS),
+        d_win_prev_energy(WINDOW_BLOCKS),
+        d_win_pos(0),
+        d_win_fill(0),
+        d_state(SEARCHING),
+        d_reference(1),
+        d_level(0),
+        d_break_open(false),
+        d_break_start(0),
+        d_break_end(0)
+    {
+      if (period < WINDOW_BLOCKS * BLOCK || period % BLOCK != 0) {
+        throw std::invalid_argument("alternating_checker: the period must "
+                                    "be a multiple of 64 of at least "
+                                    "1024");
+      }
+      if (threshold <= 0 || threshold >= 1) {
+        throw std::invalid_argument("alternating_checker: bad threshold");
+      }
+      size_t size = 1;
+      while (size < HISTORY_PERIODS * period) {
+        size <<= 1;
+      }
+      d_history.resize(size);
+      d_mask = size - 1;
+    }
+
+    void
+    alternating_checker::process(const std::complex<float> *in, size_t n)
+    {
+      for (size_t i = 0; i < n; i++) {
+        const std::complex<float> x = in[i];
+        d_history[d_samples & d_mask] = x;
+        if (d_samples >= d_period) {
+          const std::complex<float> prev =
+            d_history[(d_samples - d_period) & d_mask];
+          d_product += std::complex<double>(x * std::conj(prev));
+          d_energy += std::norm(x);
+          d_prev_energy += std::norm(prev);
+        }
+        d_samples++;
+        if (d_samples % BLOCK == 0 && d_samples > d_period) {
+          end_block();
+        }
+      }
+    }
+
+    /* A block matches the period before it when what is left after
+     * taking one from the other, turned by the phase of the channel,
+     * is small next to the energy of a typical block; judging against
+     * the typical block rather than this one keeps the quiet stretches
+     * of the pattern, where the noise is all there is, from failing */
+    static bool
+    matches(const std::complex<double> &product, double energy,
+            double prev_energy, const std::complex<double> &phase,
+            double level, float threshold)
+    {
+      double residual = energy + prev_energy -
+                        2 * (product * std::conj(phase)).real();
+      return residual <= 2 * (1 - threshold) * level;
+    }
+
+    bool
+    alternating_checker::window_coherent() const
+    {
+      if (d_win_fill < WINDOW_BLOCKS) {
+        return false;
+      }
+      std::complex<double> sum = 0;
+      double energy = 0;
+      for (size_t i = 0; i < WINDOW_BLOCKS; i++) {
+        sum += d_win_product[i];
+        energy += d_win_energy[i];
+      }
+      if (std::abs(sum) == 0) {
+        return false;
+      }
+      /* Every block on its own has to agree with the phase of the
+       * window, so no block of a break is left in it */
+      const std::complex<double> phase = sum / std::abs(sum);
+      const double level = energy / WINDOW_BLOCKS;
+      for (size_t i = 0; i < WINDOW_BLOCKS; i++) {
+        if (!matches(d_win_product[i], d_win_energy[i],
+                     d_win_prev_energy[i], phase, level, d_threshold)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    void
+    alternating_checker::end_block()
+    {
+      const uint64_t start = d_samples - BLOCK;
+
+      d_win_product[d_win_pos] = d_product;
+      d_win_energy[d_win_pos] = d_energy;
+      d_win_prev_energy[d_win_pos] = d_prev_energy;
+      d_win_pos = (d_win_pos + 1) % WINDOW_BLOCKS;
+      if (d_win_fill < WINDOW_BLOCKS) {
+        d_win_fill++;
+      }
+
+      if (d_state == LOCKED) {
+        double window = 0;
+        for (size_t i = 0; i < WINDOW_BLOCKS; i++) {
+          window += d_win_energy[i];
+        }
+        /* A matching block, and no fade of the whole window, which
+         * two stretches of noise a period apart would otherwise pass */
+        if (matches(d_product, d_energy, d_prev_energy, d_reference,
+                    d_level, d_threshold) &&
+            window >= 0.25 * WINDOW_BLOCKS * d_level) {
+          /* Follow slow drift of the phase and level over a period */
+          d_reference += 0.1 * d_product / d_level;
+          d_reference /= std::abs(d_reference);
+          d_level += (d_energy - d_level) / 256;
+          d_good_samples += BLOCK;
+        } else {
+          /* Within a period of a break the samples before it are still
+           * being compared with, so this is the same break */
+          if (!d_break_open) {
+            d_break_start = start;
+            d_break_open = true;
+          }
+          d_state = BROKEN;
+        }
+      } else if (window_coherent()) {
+        std::complex<double> sum = 0;
+        double energy = 0;
+        for (size_t i = 0; i < WINDOW_BLOCKS; i++) {
+          sum += d_win_product[i];
+          energy += d_win_energy[i];
+        }
+        d_reference = sum / std::abs(sum);
+        d_level = energy / WINDOW_BLOCKS;
+        if (d_state == BROKEN) {
+          d_break_end = d_samples - WINDOW_BLOCKS * BLOCK;
+        }
+        d_state = LOCKED;
+        d_good_samples += WINDOW_BLOCKS * BLOCK;
+      }
+
+      /* Once locked a period on from where it began, a break is over.
+       * A slip of a multiple of 512 samples, which the pattern repeats
+       * in but for the start of the filter, only shows where that start
+       * meets the period before it, in as many as two stretches */
+      if (d_break_open && d_state == LOCKED &&
+          d_samples >= d_break_start + d_period + BLOCK) {
+        close_break(d_break_end);
+      }
+
+      d_product = 0;
+      d_energy = 0;
+      d_prev_energy = 0;
+    }
+
+    int64_t
+    alternating_checker::estimate_slip(uint64_t start) const
+    {
+      /* The slip is somewhere in the first bad block, so the samples
+       * from the next one on are all after it and, for lags of one to
+       * two periods, are matched against samples all before it */
+      start += BLOCK;
+      if (d_samples <= start) {
+        return -1;
+      }
+      const uint64_t count = std::min((uint64_t)(d_period - BLOCK),
+                                      d_samples - start);
+      double best = -1;
+      int64_t slip = -1;
+      for (uint64_t lag = d_period; lag < 2 * d_period; lag++) {
+        if (lag + BLOCK > start) {
+          break;
+        }
+        std::complex<double> sum = 0;
+        double energy = 0;
+        for (uint64_t n = start; n < start + count; n++) {
+          const std::complex<float> prev = d_history[(n - lag) & d_mask];
+          sum += std::complex<double>(d_history[n & d_mask] *
+                                      std::conj(prev));
+          energy += std::norm(prev);
+        }
+        double match = energy > 0 ? std::abs(sum) / sqrt(energy) : 0;
+        if (match > best) {
+          best = match;
+          slip = (int64_t)((2 * d_period - lag) % d_period);
+        }
+      }
+      return slip;
+    }
+
+    void
+    alternating_checker::close_break(uint64_t end)
+    {
+      struct pattern_break b;
+      b.position = d_break_start;
+      b.length = end - d_break_start;
+      b.slip = -1;
+      if (b.length <= SLIP_PERIODS * d_period &&
+          d_samples - d_break_start + 2 * d_period <= d_history.size()) {
+        b.slip = estimate_slip(d_break_start);
+      }
+      d_breaks.push_back(b);
+      d_break_open = false;
+    }
+
+    void
+    alternating_checker::finish()
+    {
+      if (d_break_open) {
+        close_break(d_state == BROKEN ? d_samples : d_break_end);
+      }
+      if (d_state == BROKEN) {
+        d_state = SEARCHING;
+        d_win_fill = 0;
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,126 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_ALTERNATING_CHECKER_H
+#define INCLUDED_BLADERF_ALTERNATING_CHECKER_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /* Square root raised cosine taps as rcosdesign(beta, span, sps)
+     * makes them: span * sps + 1 of them, of unit energy */
+    std::vector<float> srrc_taps(double beta, size_t span, size_t sps);
+
+    /* The 4096 samples alternating.m writes for GRC to loop: its 64
+     * symbol pattern upsampled by 64 and filtered by rcosdesign(0.5, 6,
+     * 64), the real part only; the file repeats it on I and Q */
+    std::vector<float> alternating_sequence();
+
+    struct pattern_break {
+      uint64_t position;  /* first block where the check failed */
+      uint64_t length;    /* samples until the pattern was back */
+      int64_t slip;       /* samples missing modulo the period, or -1
+                             when the pattern was gone too long to say */
+    };
+
+    /*!
+     * \brief Finds where a looped pattern of fixed period breaks.
+     *
+     * Every sample of an intact loop matches the one a period earlier
+     * up to the phase the channel adds, so blocks of 64 samples are
+     * compared with the period before them, turned by that phase, and
+     * a block is good while what is left is small next to a typical
+     * block. Lost or repeated samples put a period of bad blocks where
+     * the samples after the slip are compared with those before it;
+     * the first bad block gives the position and, once the pattern is
+     * back, the lag that best matches the samples after the slip with
+     * those before it gives the slip, to the sample at a good SNR and
+     * within a sample or so in noise, the pulses being 64 samples
+     * wide. The alternating.m pattern repeats every 512 samples but
+     * where its filter starts, so a slip of a multiple of 512 is only
+     * seen there, up to a period late. A break much longer than a
+     * period, where the signal went away or changed, is reported with
+     * no slip. Takes input in blocks
+     * of any size and keeps eight periods of history.
+     */
+    class alternating_checker
+    {
+     public:
+      alternating_checker(size_t period = 4096, float threshold = 0.7f);
+
+      void process(const std::complex<float> *in, size_t n);
+
+      /* Close a break still open at the end of the input */
+      void finish();
+
+      const std::vector<pattern_break> &breaks() const { return d_breaks; }
+
+      uint64_t samples() const { return d_samples; }
+      /* Samples in blocks that matched the period before them */
+      uint64_t good_samples() const { return d_good_samples; }
+      bool locked() const { return d_state == LOCKED; }
+
+     private:
+      enum state { SEARCHING, LOCKED, BROKEN };
+
+      size_t d_period;
+      float d_threshold;
+      std::vector<std::complex<float> > d_history;   /* ring */
+      size_t d_mask;
+      uint64_t d_samples;
+      uint64_t d_good_samples;
+
+      /* Sums over the block being filled */
+      std::complex<double> d_product;
+      double d_energy;
+      double d_prev_energy;
+
+      /* The last window of blocks, for acquiring the pattern */
+      std::vector<std::complex<double> > d_win_product;
+      std::vector<double> d_win_energy;
+      std::vector<double> d_win_prev_energy;
+      size_t d_win_pos;
+      size_t d_win_fill;
+
+      enum state d_state;
+      std::complex<double> d_reference;   /* unit phase while locked */
+      double d_level;                     /* mean block energy */
+      bool d_break_open;
+      uint64_t d_break_start;
+      uint64_t d_break_end;               /* when locked again */
+      std::vector<pattern_break> d_breaks;
+
+      void end_block();
+      bool window_coherent() const;
+      int64_t estimate_slip(uint64_t start) const;
+      void close_break(uint64_t end);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_ALTERNATING_CHECKER_H */
@@ -0,0 +1,396 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "batch_receiver.h"
+#include "sample_convert.h"
+#include "sc16_file.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Frames handed to a slice's receiver at a time */
+    static const size_t BLOCK_FRAMES = 65536;
+
+    /* Where a slice's receiver reports to */
+    struct slice_sink {
+      const frs_receiver *rx;
+      size_t recording;
+      double offset;        /* receiver time 0 in the recording */
+      bool warm;            /* past the run in */
+      std::vector<float> *tone;
+      std::vector<struct batch_event> *events;
+    };
+
+    static void
+    discard_audio(const struct frs_channel &ch, const float *audio,
+                  size_t n)
+    {
+    }
+
+    static void
+    push_event(slice_sink *k, const struct frs_channel &ch, double time,
+               enum batch_event_type type, float value)
+    {
+      struct batch_event e;
+      e.recording = k->recording;
+      e.time = k->offset + time;
+      e.channel = ch.number;
+      e.frequency = ch.frequency;
+      e.type = type;
+      e.value = value;
+      k->events->push_back(e);
+    }
+
+    static void
+    on_event(slice_sink *k, const struct frs_channel &ch, double time,
+             const struct squelch_event &e)
+    {
+      if (!k->warm) {
+        if (!e.open) {
+          (*k->tone)[&ch - &k->rx->channels()[0]] = 0;
+        }
+        return;
+      }
+      push_event(k, ch, time, e.open ? BATCH_OPEN : BATCH_CLOSE,
+                 e.power_db);
+    }
+
+    static void
+    on_tone(slice_sink *k, const struct frs_channel &ch, double time,
+            float tone)
+    {
+      if (!k->warm) {
+        (*k->tone)[&ch - &k->rx->channels()[0]] = tone;
+        return;
+      }
+      push_event(k, ch, time, BATCH_TONE, tone);
+    }
+
+    static bool
+    earlier(const struct batch_event &a, const struct batch_event &b)
+    {
+      return a.time < b.time;
+    }
+
+    batch_receiver::batch_receiver(const struct batch_config &config)
+      : d_config(config),
+        d_frames(0)
+    {
+      if (config.rx.channels.empty()) {
+        throw std::invalid_argument("batch_receiver: no channels");
+      }
+      if (config.slice_seconds <= 0 || config.overlap_seconds < 0) {
+        throw std::invalid_argument("batch_receiver: bad slice or "
+                                    "overlap length");
+      }
+    }
+
+    batch_receiver::~batch_receiver()
+    {
+      for (size_t i = 0; i < d_sources.size(); i++) {
+        if (d_sources[i].fd >= 0) {
+          close(d_sources[i].fd);
+        }
+      }
+    }
+
+    std::string
+    batch_receiver::check(const struct batch_recording &r) const
+    {
+      if (r.samp_rate <= 0) {
+        return " has no sample rate";
+      }
+      /* Half a channel inside the edges, as frs_rxd has it */
+      for (size_t i = 0; i < d_config.rx.channels.size(); i++) {
+        const struct frs_channel &ch = d_config.rx.channels[i];
+        if (fabs(ch.frequency - r.center_freq) >= r.samp_rate / 2 - 12.5e3) {
+          char msg[64];
+          snprintf(msg, sizeof(msg), " does not cover channel %d",
+                   ch.number);
+          return msg;
+        }
+      }
+      return "";
+    }
+
+    size_t
+    batch_receiver::add(const std::string &path)
+    {
+      struct batch_recording r;
+      struct source src;
+      r.path = path;
+      r.samp_rate = d_config.rx.samp_rate;
+      r.center_freq = d_config.rx.center_freq;
+      r.start_time = 0;
+
+      src.fd = open(path.c_str(), O_RDONLY);
+      if (src.fd < 0) {
+        throw std::runtime_error("batch_receiver: unable to open " + path);
+      }
+      char magic[sizeof(SC16_FILE_MAGIC)];
+      struct stat st;
+      if (fstat(src.fd, &st) != 0) {
+        close(src.fd);
+        throw std::runtime_error("batch_receiver: unable to stat " + path);
+      }
+      if (pread(src.fd, magic, sizeof(magic), 0) == sizeof(magic) &&
+          memcmp(magic, SC16_FILE_MAGIC, sizeof(magic)) == 0) {
+        close(src.fd);
+        src.fd = -1;
+        src.compressed.reset(new sc16_file_reader(path));
+        const struct sc16_file_header &h = src.compressed->header();
+        if (h.nchan != 1) {
+          throw std::invalid_argument("batch_receiver: " + path +
+                                      " has more than one channel");
+        }
+        r.frames = src.compressed->frames();
+        if (h.samp_rate > 0) {
+          r.samp_rate = h.samp_rate;
+          r.center_freq = h.center_freq;
+        }
+        r.start_time = h.start_time;
+      } else {
+        r.frames = st.st_size / 4;
+        /* Slices read at random, not front to back */
+        posix_fadvise(src.fd, 0, 0, POSIX_FADV_RANDOM);
+      }
+      std::string error = check(r);
+      if (!error.empty()) {
+        if (src.fd >= 0) {
+          close(src.fd);
+        }
+        throw std::invalid_argument("batch_receiver: " + path + error);
+      }
+
+      const size_t index = d_recordings.size();
+      d_recordings.push_back(r);
+      d_sources.push_back(src);
+      d_frames += r.frames;
+
+      const uint64_t length =
+        std::max((uint64_t)1, (uint64_t)(d_config.slice_seconds *
+                                          r.samp_rate));
+      const uint64_t overlap = (uint64_t)(d_config.overlap_seconds *
+                                          r.samp_rate);
+      for (uint64_t start = 0; start < r.frames; start += length) {
+        struct slice s;
+        s.recording = index;
+        s.warm = start > overlap ? start - overlap : 0;
+        s.start = start;
+        s.end = std::min(r.frames, start + length);
+        d_slices.push_back(s);
+      }
+      return index;
+    }
+
+    bool
+    batch_receiver::read(const struct source &src, uint64_t pos, size_t n,
+                         int16_t *out) const
+    {
+      if (src.compressed) {
+        return src.compressed->read(pos, n, out);
+      }
+
+      char *p = (char *)out;
+      size_t left = n * 4;
+      off_t offset = pos * 4;
+      while (left > 0) {
+        ssize_t got = pread(src.fd, p, left, offset);
+        if (got <= 0) {
+          return false;
+        }
+        p += got;
+        offset += got;
+        left -= got;
+      }
+      return true;
+    }
+
+    void
+    batch_receiver::receive_slice(struct slice &s)
+    {
+      const struct batch_recording &r = d_recordings[s.recording];
+      struct frs_receiver_config rc = d_config.rx;
+      rc.samp_rate = r.samp_rate;
+      rc.center_freq = r.center_freq;
+      rc.max_block = BLOCK_FRAMES;
+      rc.threads = 0;
+      rc.cpus.clear();
+      rc.rt_priority = 0;
+      const size_t nchan = rc.channels.size();
+
+      slice_sink k;
+      k.rx = NULL;
+      k.recording = s.recording;
+      k.offset = s.warm / r.samp_rate;
+      k.warm = false;
+      k.tone = &s.tone_start;
+      k.events = &s.events;
+      s.tone_start.assign(nchan, 0);
+
+      frs_receiver::tone_fn tone;
+      if (rc.ctcss) {
+        tone = boost::bind(&on_tone, &k, _1, _2, _3);
+      }
+      frs_receiver rx(rc, &discard_audio,
+                      boost::bind(&on_event, &k, _1, _2, _3), tone);
+      k.rx = &rx;
+
+      std::vector<int16_t> frames(2 * BLOCK_FRAMES);
+      std::vector<std::complex<float> > samples(d_config.fixed ? 0
+                                                : BLOCK_FRAMES);
+      for (uint64_t pos = s.warm; pos < s.end; ) {
+        if (pos == s.start) {
+          s.open_start.resize(nchan);
+          s.power_start.resize(nchan);
+          for (size_t ch = 0; ch < nchan; ch++) {
+            s.open_start[ch] = rx.squelch_open(ch);
+            s.power_start[ch] = rx.power_db(ch);
+          }
+          k.warm = true;
+        }
+
+        /* Blocks end exactly at the slice start */
+        const uint64_t stop = pos < s.start ? s.start : s.end;
+        const size_t n = std::min((uint64_t)BLOCK_FRAMES, stop - pos);
+        if (!read(d_sources[s.recording], pos, n, &frames[0])) {
+          throw std::runtime_error("batch_receiver: unable to read " +
+                                   r.path);
+        }
+        if (d_config.fixed) {
+          rx.process(&frames[0], n);
+        } else {
+          std::complex<float> *out = &samples[0];
+          sc16_to_fc32(&frames[0], &out, n, 1, SC16_Q11_SCALE);
+          rx.process(&samples[0], n);
+        }
+        pos += n;
+      }
+    }
+
+    void
+    batch_receiver::process_slice(size_t i)
+    {
+      /* A worker thread must not throw; run() does it instead */
+      try {
+        receive_slice(d_slices[i]);
+      } catch (const std::exception &e) {
+        d_slices[i].error = e.what();
+      }
+    }
+
+    void
+    batch_receiver::stitch(std::vector<struct batch_event> &events) const
+    {
+      const std::vector<struct frs_channel> &channels = d_config.rx.channels;
+      const size_t nchan = channels.size();
+      std::vector<char> open;
+      std::vector<float> tone;
+      size_t first = events.size();
+
+      for (size_t i = 0; i < d_slices.size(); i++) {
+        const struct slice &s = d_slices[i];
+
+        if (i == 0 || d_slices[i - 1].recording != s.recording) {
+          /* A receiver reports block by block, channel after channel */
+          std::stable_sort(events.begin() + first, events.end(),
+                           &earlier);
+          first = events.size();
+          open.assign(nchan, 0);
+          tone.assign(nchan, 0);
+        } else {
+          /* Whatever changed across the boundary happened at it */
+          struct batch_event e;
+          e.recording = s.recording;
+          e.time = s.start / d_recordings[s.recording].samp_rate;
+          for (size_t ch = 0; ch < nchan; ch++) {
+            e.channel = channels[ch].number;
+            e.frequency = channels[ch].frequency;
+            if (open[ch] != s.open_start[ch]) {
+              open[ch] = s.open_start[ch];
+              e.type = open[ch] ? BATCH_OPEN : BATCH_CLOSE;
+              e.value = s.power_start[ch];
+              events.push_back(e);
+              tone[ch] = 0;
+            }
+            if (open[ch] && s.tone_start[ch] != 0 &&
+                s.tone_start[ch] != tone[ch]) {
+              tone[ch] = s.tone_start[ch];
+              e.type = BATCH_TONE;
+              e.value = tone[ch];
+              events.push_back(e);
+            }
+          }
+        }
+
+        for (size_t j = 0; j < s.events.size(); j++) {
+          const struct batch_event &e = s.events[j];
+          size_t ch = 0;
+          while (channels[ch].number != e.channel) {
+            ch++;
+          }
+          if (e.type == BATCH_TONE) {
+            if (e.value == tone[ch]) {
+              continue;
+            }
+            tone[ch] = e.value;
+          } else {
+            open[ch] = e.type == BATCH_OPEN;
+            tone[ch] = 0;
+          }
+          events.push_back(e);
+        }
+      }
+      std::stable_sort(events.begin() + first, events.end(), &earlier);
+    }
+
+    void
+    batch_receiver::run(std::vector<struct batch_event> &events)
+    {
+      worker_pool pool(d_config.rx.threads, d_config.rx.cpus,
+                       d_config.rx.rt_priority);
+      pool.run(d_slices.size(),
+               boost::bind(&batch_receiver::process_slice, this, _1));
+
+      for (size_t i = 0; i < d_slices.size(); i++) {
+        if (!d_slices[i].error.empty()) {
+          throw std::runtime_error(d_slices[i].error);
+        }
+      }
+      stitch(events);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,146 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_BATCH_RECEIVER_H
+#define INCLUDED_BLADERF_BATCH_RECEIVER_H
+
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "frs_receiver.h"
+
+namespace gr {
+  namespace bladerf {
+
+    class sc16_file_reader;
+
+    struct batch_config {
+      /* samp_rate and center_freq apply to raw recordings, compressed
+       * ones carry their own; threads, cpus and rt_priority size the
+       * pool the slices run on, each slice's receiver runs on one */
+      struct frs_receiver_config rx;
+      bool fixed;               /* hand the receiver SC16, not floats */
+      double slice_seconds;     /* input per task */
+      double overlap_seconds;   /* run in before each slice */
+    };
+
+    enum batch_event_type {
+      BATCH_OPEN,
+      BATCH_CLOSE,
+      BATCH_TONE
+    };
+
+    struct batch_event {
+      size_t recording;         /* index in the order added */
+      double time;              /* seconds into the recording */
+      int channel;
+      double frequency;
+      enum batch_event_type type;
+      float value;              /* power dB, or the tone in Hz */
+    };
+
+    struct batch_recording {
+      std::string path;
+      uint64_t frames;
+      double samp_rate;
+      double center_freq;
+      double start_time;        /* Unix time of the first frame, or 0 */
+    };
+
+    /*!
+     * \brief Runs the FRS receiver over recordings faster than real time.
+     *
+     * Every recording is cut into slices that are received
+     * independently, one task each on a worker_pool, so a day of
+     * recordings keeps every core busy until the last slice. A slice's
+     * receiver starts overlap_seconds early so its filters, squelch
+     * averages and CTCSS windows have settled by the time the slice
+     * proper begins; what it reports before then is dropped, apart
+     * from the squelch state and tone it ends up in. Stitching then
+     * walks the slices in order and emits an open or close where a
+     * squelch state differs across a boundary, and drops a tone a
+     * slice merely finds again, so the events come out the same
+     * whatever the scheduling and, but for CTCSS windows being aligned
+     * to the slice rather than the recording, the same as one receiver
+     * run over the whole recording.
+     */
+    class batch_receiver
+    {
+     public:
+      batch_receiver(const struct batch_config &config);
+      ~batch_receiver();
+
+      /* Queue a raw sc16 recording or a compressed one (.sc16z), told
+       * apart by content; returns its index */
+      size_t add(const std::string &path);
+
+      /* Receive everything queued and append the events to events,
+       * by recording and then by time. Throws if a slice failed. */
+      void run(std::vector<struct batch_event> &events);
+
+      const struct batch_recording &recording(size_t i) const
+      {
+        return d_recordings[i];
+      }
+      size_t recordings() const { return d_recordings.size(); }
+      size_t slices() const { return d_slices.size(); }
+      uint64_t frames() const { return d_frames; }
+
+     private:
+      struct source {
+        int fd;
+        boost::shared_ptr<sc16_file_reader> compressed;
+      };
+
+      struct slice {
+        size_t recording;
+        uint64_t warm;          /* where the receiver starts */
+        uint64_t start;         /* where its events start to count */
+        uint64_t end;
+        std::vector<struct batch_event> events;
+        /* Per channel, once warm */
+        std::vector<char> open_start;
+        std::vector<float> power_start;
+        std::vector<float> tone_start;
+        std::string error;
+      };
+
+      struct batch_config d_config;
+      std::vector<struct batch_recording> d_recordings;
+      std::vector<struct source> d_sources;
+      std::vector<struct slice> d_slices;
+      uint64_t d_frames;
+
+      std::string check(const struct batch_recording &r) const;
+      void process_slice(size_t i);
+      void receive_slice(struct slice &s);
+      bool read(const struct source &src, uint64_t pos, size_t n,
+                int16_t *out) const;
+      void stitch(std::vector<struct batch_event> &events) const;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_BATCH_RECEIVER_H */
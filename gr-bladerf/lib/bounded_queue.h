@@ -0,0 +1,134 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_BOUNDED_QUEUE_H
+#define INCLUDED_BLADERF_BOUNDED_QUEUE_H
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <deque>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Fixed capacity FIFO between two pipeline stages.
+     *
+     * push() blocks while the queue is full, which is what gives the
+     * pipeline its backpressure: a slow stage stalls the one feeding it
+     * instead of letting memory grow. close() wakes every waiter so the
+     * stage threads can exit.
+     */
+    template <class T>
+    class bounded_queue
+    {
+     public:
+      bounded_queue(size_t capacity)
+        : d_capacity(capacity), d_closed(false)
+      {
+      }
+
+      /* Returns false if the queue was closed while waiting */
+      bool push(const T &item)
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        while (d_items.size() >= d_capacity && !d_closed) {
+          d_not_full.wait(lock);
+        }
+        if (d_closed) {
+          return false;
+        }
+        d_items.push_back(item);
+        d_not_empty.notify_one();
+        return true;
+      }
+
+      /* For producers that must not stall: false instead of waiting
+       * when the queue is full */
+      bool try_push(const T &item)
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        if (d_items.size() >= d_capacity || d_closed) {
+          return false;
+        }
+        d_items.push_back(item);
+        d_not_empty.notify_one();
+        return true;
+      }
+
+      /* Returns false if nothing arrived before the timeout or close() */
+      bool pop(T &item, unsigned int timeout_ms)
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        boost::system_time const deadline = boost::get_system_time() +
+          boost::posix_time::milliseconds(timeout_ms);
+        while (d_items.empty() && !d_closed) {
+          if (!d_not_empty.timed_wait(lock, deadline)) {
+            return false;
+          }
+        }
+        if (d_items.empty()) {
+          return false;
+        }
+        item = d_items.front();
+        d_items.pop_front();
+        d_not_full.notify_one();
+        return true;
+      }
+
+      void close()
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        d_closed = true;
+        d_not_empty.notify_all();
+        d_not_full.notify_all();
+      }
+
+      void reopen()
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        d_items.clear();
+        d_closed = false;
+      }
+
+      size_t size()
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        return d_items.size();
+      }
+
+      size_t capacity() const { return d_capacity; }
+
+     private:
+      size_t d_capacity;
+      bool d_closed;
+      std::deque<T> d_items;
+      boost::mutex d_mutex;
+      boost::condition_variable d_not_empty;
+      boost::condition_variable d_not_full;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_BOUNDED_QUEUE_H */
@@ -0,0 +1,128 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include <pmt/pmt.h>
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "bus_source_impl.h"
+#include "sample_convert.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Longest work() waits for the publisher */
+    static const unsigned int WAIT_MS = 100;
+
+    bus_source::sptr
+    bus_source::make(const std::string &bus, int channels)
+    {
+      return gnuradio::get_initial_sptr
+        (new bus_source_impl(bus, channels));
+    }
+
+    /*
+     * The private constructor
+     */
+    bus_source_impl::bus_source_impl(const std::string &bus, int channels)
+      : gr::sync_block("bus_source",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(channels, channels,
+                                     sizeof(gr_complex))),
+        _tag_time(true)
+    {
+      _reader.reset(new iq_bus_reader(bus));
+      if ((size_t)channels != _reader->nchan()) {
+        throw std::invalid_argument("bus_source: the bus carries a "
+                                    "different number of channels");
+      }
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    bus_source_impl::~bus_source_impl()
+    {
+    }
+
+    void
+    bus_source_impl::tag_gap(int offset, uint64_t lost)
+    {
+      for (size_t n = 0; n < _reader->nchan(); n++) {
+        add_item_tag(n, nitems_written(n) + offset, pmt::intern("rx_gap"),
+                     pmt::from_uint64(lost));
+      }
+    }
+
+    int
+    bus_source_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      gr_complex **out = reinterpret_cast<gr_complex **>(&output_items[0]);
+      const uint64_t dropped = _reader->dropped();
+      size_t n;
+
+      const int16_t *frames = _reader->acquire(noutput_items, &n, WAIT_MS);
+      if (frames == NULL) {
+        return 0;
+      }
+
+      /* acquire() skipped ahead: the next sample is not the one after
+       * the last we delivered */
+      if (_reader->dropped() != dropped) {
+        tag_gap(0, _reader->dropped() - dropped);
+        _tag_time = true;
+      }
+      if (_tag_time) {
+        double t = _reader->start_time() +
+                   _reader->position() / _reader->samp_rate();
+        double secs = floor(t);
+        pmt::pmt_t time = pmt::make_tuple(
+          pmt::from_uint64((uint64_t)secs), pmt::from_double(t - secs));
+        for (size_t c = 0; c < _reader->nchan(); c++) {
+          add_item_tag(c, nitems_written(c), pmt::intern("rx_time"), time);
+        }
+        _tag_time = false;
+      }
+
+      sc16_to_fc32(frames, out, n, _reader->nchan(), SC16_Q11_SCALE);
+
+      /* Overwritten while converting: deliver silence in its place */
+      if (!_reader->release(n)) {
+        for (size_t c = 0; c < _reader->nchan(); c++) {
+          std::fill(out[c], out[c] + n, gr_complex(0, 0));
+        }
+        tag_gap(0, n);
+      }
+
+      // Tell runtime system how many output items we produced.
+      return n;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,53 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_BUS_SOURCE_IMPL_H
+#define INCLUDED_BLADERF_BUS_SOURCE_IMPL_H
+
+#include <bladerf/bus_source.h>
+#include <boost/shared_ptr.hpp>
+#include "iq_bus.h"
+
+namespace gr {
+  namespace bladerf {
+
+    class bus_source_impl : public bus_source
+    {
+     private:
+      boost::shared_ptr<iq_bus_reader> _reader;
+      bool _tag_time;
+
+      void tag_gap(int offset, uint64_t lost);
+
+     public:
+      bus_source_impl(const std::string &bus, int channels);
+      ~bus_source_impl();
+
+      int work(int noutput_items,
+               gr_vector_const_void_star &input_items,
+               gr_vector_void_star &output_items);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_BUS_SOURCE_IMPL_H */
@@ -0,0 +1,255 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "capture_queue.h"
+#include "thread_utils.h"
+
+namespace gr {
+  namespace bladerf {
+
+    capture_queue::capture_queue(size_t nbuffers, size_t frames_per_buffer,
+                                 size_t nchan)
+      : d_frames_per_buffer(frames_per_buffer),
+        d_nchan(nchan),
+        d_pool(nbuffers),
+        d_have_origin(false),
+        d_origin(0),
+        d_overflows(0),
+        d_gap_frames(0)
+    {
+      size_t i = 0;
+      try {
+        for (; i < d_pool.size(); i++) {
+          d_pool[i].samples = (int16_t *)alloc_buffer(buffer_bytes());
+          d_pool[i].start = 0;
+          d_pool[i].nframes = 0;
+          d_free.push_back(&d_pool[i]);
+        }
+      } catch (const std::bad_alloc &) {
+        /* No destructor runs for a constructor that throws */
+        for (size_t j = 0; j < i; j++) {
+          free_buffer(d_pool[j].samples, buffer_bytes());
+        }
+        throw;
+      }
+    }
+
+    capture_queue::~capture_queue()
+    {
+      for (size_t i = 0; i < d_pool.size(); i++) {
+        free_buffer(d_pool[i].samples, buffer_bytes());
+      }
+    }
+
+    void
+    capture_queue::prefault()
+    {
+      for (size_t i = 0; i < d_pool.size(); i++) {
+        touch_buffer(d_pool[i].samples, buffer_bytes());
+      }
+    }
+
+    capture_queue::buffer *
+    capture_queue::find(int16_t *samples)
+    {
+      for (size_t i = 0; i < d_pool.size(); i++) {
+        if (d_pool[i].samples == samples) {
+          return &d_pool[i];
+        }
+      }
+      return NULL;
+    }
+
+    uint64_t
+    capture_queue::end_locked() const
+    {
+      if (d_ready.empty()) {
+        return 0;
+      }
+      return d_ready.back()->start + d_ready.back()->nframes;
+    }
+
+    int16_t *
+    capture_queue::acquire()
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+
+      if (d_free.empty()) {
+        /* The consumer fell behind: sacrifice the oldest buffer. The hole it
+         * leaves on the timeline is zero-filled by read(). */
+        if (d_ready.empty()) {
+          return NULL;
+        }
+        d_free.push_back(d_ready.front());
+        d_ready.pop_front();
+        d_overflows++;
+      }
+
+      buffer *b = d_free.front();
+      d_free.pop_front();
+      return b->samples;
+    }
+
+    void
+    capture_queue::commit(int16_t *buf, uint64_t timestamp, size_t nframes)
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+
+      buffer *b = find(buf);
+      if (b == NULL) {
+        return;
+      }
+
+      if (!d_have_origin) {
+        d_origin = timestamp;
+        d_have_origin = true;
+      }
+
+      b->start = timestamp - d_origin;
+      b->nframes = std::min(nframes, d_frames_per_buffer);
+
+      /* Timestamps only move forward; anything else is a stale buffer */
+      if (!d_ready.empty() && b->start < end_locked()) {
+        d_free.push_back(b);
+        return;
+      }
+
+      d_ready.push_back(b);
+      d_cond.notify_all();
+    }
+
+    void
+    capture_queue::release(int16_t *buf)
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+
+      buffer *b = find(buf);
+      if (b != NULL) {
+        d_free.push_back(b);
+      }
+    }
+
+    uint64_t
+    capture_queue::available(uint64_t pos)
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+
+      uint64_t end = end_locked();
+      return end > pos ? end - pos : 0;
+    }
+
+    uint64_t
+    capture_queue::wait(uint64_t pos, unsigned int timeout_ms)
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      boost::system_time const deadline = boost::get_system_time() +
+        boost::posix_time::milliseconds(timeout_ms);
+
+      while (end_locked() <= pos) {
+        if (!d_cond.timed_wait(lock, deadline)) {
+          break;
+        }
+      }
+
+      uint64_t end = end_locked();
+      return end > pos ? end - pos : 0;
+    }
+
+    size_t
+    capture_queue::read(uint64_t pos, size_t nframes, int16_t *out)
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+
+      const size_t frame_len = d_nchan * 2;
+      const uint64_t stop = pos + nframes;
+      uint64_t cur = pos;
+      size_t zeros = 0;
+
+      /* Buffers entirely behind the read position are done with */
+      while (!d_ready.empty() &&
+             d_ready.front()->start + d_ready.front()->nframes <= pos) {
+        d_free.push_back(d_ready.front());
+        d_ready.pop_front();
+      }
+
+      for (size_t i = 0; i < d_ready.size() && cur < stop; i++) {
+        buffer *b = d_ready[i];
+        uint64_t b_end = b->start + b->nframes;
+
+        if (b->start > cur) {
+          size_t gap = (size_t)(std::min(b->start, stop) - cur);
+          memset(out + (cur - pos) * frame_len, 0,
+                 gap * frame_len * sizeof(int16_t));
+          zeros += gap;
+          cur += gap;
+        }
+        if (cur >= stop) {
+          break;
+        }
+
+        size_t n = (size_t)(std::min(b_end, stop) - cur);
+        memcpy(out + (cur - pos) * frame_len,
+               b->samples + (cur - b->start) * frame_len,
+               n * frame_len * sizeof(int16_t));
+        cur += n;
+      }
+
+      if (cur < stop) {
+        memset(out + (cur - pos) * frame_len, 0,
+               (size_t)(stop - cur) * frame_len * sizeof(int16_t));
+        zeros += (size_t)(stop - cur);
+      }
+
+      while (!d_ready.empty() &&
+             d_ready.front()->start + d_ready.front()->nframes <= stop) {
+        d_free.push_back(d_ready.front());
+        d_ready.pop_front();
+      }
+
+      d_gap_frames += zeros;
+      return zeros;
+    }
+
+    void
+    capture_queue::reset()
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+
+      while (!d_ready.empty()) {
+        d_free.push_back(d_ready.front());
+        d_ready.pop_front();
+      }
+      d_have_origin = false;
+      d_origin = 0;
+      d_overflows = 0;
+      d_gap_frames = 0;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
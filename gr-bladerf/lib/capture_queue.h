@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_BLADERF_CAPTURE_QUEUE_H
+#define INCLUDED_BLADERF_CAPTURE_QUEUE_H
+
+#include <bladerf/api.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Timestamped SC16 buffers of one device, read on a sample timeline.
+     *
+     * A capture thread acquire()s a buffer, fills it with bladerf_sync_rx()
+     * and commit()s it together with the hardware timestamp of its first
+     * sample. The timestamp of the very first committed buffer becomes the
+     * origin of the timeline, so position 0 is the first sample after the
+     * trigger fired. read() returns samples by timeline position and fills
+     * any hole left by a dropped buffer with zeros, which keeps several
+     * devices sample aligned even when one of them loses data.
+     *
+     * Positions and counts are in frames: one frame holds one I/Q pair per
+     * channel.
+     */
+    class BLADERF_API capture_queue
+    {
+     public:
+      capture_queue(size_t nbuffers, size_t frames_per_buffer, size_t nchan);
+      ~capture_queue();
+
+      /* Producer side */
+      int16_t *acquire();
+      void commit(int16_t *buf, uint64_t timestamp, size_t nframes);
+      void release(int16_t *buf);
+
+      /* Consumer side */
+      uint64_t available(uint64_t pos);
+      uint64_t wait(uint64_t pos, unsigned int timeout_ms);
+      size_t read(uint64_t pos, size_t nframes, int16_t *out);
+
+      void reset();
+
+      /* Populate the buffer pages from the calling (capture) thread */
+      void prefault();
+
+      size_t frames_per_buffer() const { return d_frames_per_buffer; }
+      size_t nchan() const { return d_nchan; }
+      uint64_t origin() const { return d_origin; }
+      uint64_t overflows() const { return d_overflows; }
+      uint64_t gap_frames() const { return d_gap_frames; }
+
+     private:
+      struct buffer {
+        int16_t *samples;
+        uint64_t start; /* timeline position of the first frame */
+        size_t nframes;
+      };
+
+      size_t d_frames_per_buffer;
+      size_t d_nchan;
+      std::vector<buffer> d_pool;
+      std::deque<buffer *> d_free;
+      std::deque<buffer *> d_ready;
+
+      bool d_have_origin;
+      uint64_t d_origin;
+      uint64_t d_overflows;
+      uint64_t d_gap_frames;
+
+      boost::mutex d_mutex;
+      boost::condition_variable d_cond;
+
+      size_t buffer_bytes() const
+      {
+        return d_frames_per_buffer * d_nchan * 2 * sizeof(int16_t);
+      }
+      buffer *find(int16_t *samples);
+      uint64_t end_locked() const;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_CAPTURE_QUEUE_H */
@@ -0,0 +1,370 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "channel_decimator.h"
+#include "sample_convert.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace gr {
+  namespace bladerf {
+
+    static const unsigned int CIC_ORDER = 4;
+
+    /* The CIC output rate stays at least this many times the channel
+     * rate, which keeps its aliases below -65 dB at order 4 */
+    static const unsigned int MIN_CIC_RATIO = 4;
+
+    /* The float NCO is reseeded from the double phase this often */
+    static const size_t NCO_CHUNK = 512;
+
+    /* Fixed point NCO: a quarter wave would do, but a full table of
+     * packed Q14 phasors keeps the inner loop to two loads a sample */
+    static const unsigned int NCO_TABLE_BITS = 12;
+    static const float NCO_AMPLITUDE = 16384.0f;
+
+    /* Q11 samples times Q14 phasors, shifted down to leave the CIC the
+     * same headroom as the float path */
+    static const int MIX_SHIFT = 6;
+    static const float MIX_SCALE = SC16_Q11_SCALE * NCO_AMPLITUDE /
+                                   (1 << MIX_SHIFT);
+
+    /* Each entry holds two int16 so one _mm_madd_epi16 against an I/Q
+     * pair gives a product component: (cos, -sin) for the real part,
+     * (sin, cos) for the imaginary part */
+    struct nco_table {
+      std::vector<uint32_t> re;
+      std::vector<uint32_t> im;
+    };
+
+    static uint32_t
+    pack(int lo, int hi)
+    {
+      return (uint32_t)(uint16_t)(int16_t)lo |
+             ((uint32_t)(uint16_t)(int16_t)hi << 16);
+    }
+
+    static struct nco_table
+    make_nco_table()
+    {
+      struct nco_table t;
+      const size_t size = (size_t)1 << NCO_TABLE_BITS;
+      for (size_t k = 0; k < size; k++) {
+        double w = 2 * M_PI * k / size;
+        int c = (int)lrint(NCO_AMPLITUDE * cos(w));
+        int s = (int)lrint(NCO_AMPLITUDE * sin(w));
+        t.re.push_back(pack(c, -s));
+        t.im.push_back(pack(s, c));
+      }
+      return t;
+    }
+
+    static const struct nco_table &
+    nco_table()
+    {
+      static const struct nco_table table = make_nco_table();
+      return table;
+    }
+
+    /* Radians to a 32-bit phase accumulator value, wrapping */
+    static uint32_t
+    to_phase(double angle)
+    {
+      return (uint32_t)(int64_t)llrint(angle / (2 * M_PI) * 4294967296.0);
+    }
+
+    static inline uint32_t
+    table_index(uint32_t phase)
+    {
+      const int shift = 32 - NCO_TABLE_BITS;
+      return ((phase + (1u << (shift - 1))) >> shift) &
+             ((1u << NCO_TABLE_BITS) - 1);
+    }
+
+#ifdef __SSE2__
+    /* Two complex products at once: x = [a0 b0 a1 b1], p = [c0 d0 c1 d1] */
+    static inline __m128
+    cmul2(__m128 x, __m128 p)
+    {
+      const __m128 neg = _mm_setr_ps(-0.0f, 0.0f, -0.0f, 0.0f);
+      __m128 re = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+      __m128 im = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+      __m128 xs = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1));
+      return _mm_add_ps(_mm_mul_ps(x, re),
+                        _mm_xor_ps(_mm_mul_ps(xs, im), neg));
+    }
+#endif
+
+    channel_decimator::channel_decimator(double samp_rate, double offset,
+                                         unsigned int decim,
+                                         double passband, double stopband,
+                                         size_t max_input)
+      : d_samp_rate(samp_rate),
+        d_decim(decim),
+        d_max_input(max_input),
+        d_angle(0),
+        d_omega(-2 * M_PI * offset / samp_rate),
+        d_amplitude(1.0f)
+    {
+      if (decim < 1 || passband >= stopband) {
+        throw std::invalid_argument("channel_decimator: bad decimation or "
+                                    "band edges");
+      }
+
+      /* The CIC takes the largest factor that leaves the rest at or
+       * above MIN_CIC_RATIO */
+      unsigned int cic = 1;
+      for (unsigned int r = decim / MIN_CIC_RATIO; r >= 2; r--) {
+        if (decim % r == 0) {
+          cic = r;
+          break;
+        }
+      }
+      if (cic > 1) {
+        d_cic.reset(new cic_decimator(cic, CIC_ORDER));
+        d_amplitude = cic_decimator::input_scale();
+      }
+
+      /* Halfbands while two or more factors of two remain; each one only
+       * has to keep what would alias into the final stopband */
+      unsigned int rest = decim / cic;
+      double rate = samp_rate / cic;
+      size_t n = max_input / cic + 1;
+      while (rest % 2 == 0 && rest > 2) {
+        d_halfbands.push_back(boost::shared_ptr<halfband_decimator>(
+          new halfband_decimator(rate, stopband, n)));
+        rest /= 2;
+        rate /= 2;
+        n = n / 2 + 1;
+      }
+
+      /* Final FIR: the channel filter, convolved with a three tap
+       * inverse of the CIC droop matched at the passband edge */
+      std::vector<float> taps = fir_decimator::lowpass(
+        1.0, rate, (passband + stopband) / 2, stopband - passband);
+      if (d_cic) {
+        double droop = d_cic->response(passband, samp_rate);
+        double a = (1 / droop - 1) /
+                   (2 * (1 - cos(2 * M_PI * passband / rate)));
+        std::vector<float> comp(taps.size() + 2, 0.0f);
+        for (size_t i = 0; i < taps.size(); i++) {
+          comp[i] -= (float)(a * taps[i]);
+          comp[i + 1] += (float)((1 + 2 * a) * taps[i]);
+          comp[i + 2] -= (float)(a * taps[i]);
+        }
+        taps = comp;
+      }
+      d_fir.reset(new fir_decimator(taps, rest, n));
+
+      d_work[0].resize(max_input);
+      d_work[1].resize(max_input);
+      if (d_cic) {
+        d_mixed.resize(2 * NCO_CHUNK);
+        nco_table();
+      }
+    }
+
+    void
+    channel_decimator::reset()
+    {
+      d_angle = 0;
+      if (d_cic) {
+        d_cic->reset();
+      }
+      for (size_t i = 0; i < d_halfbands.size(); i++) {
+        d_halfbands[i]->reset();
+      }
+      d_fir->reset();
+    }
+
+    unsigned int
+    channel_decimator::cic_decimation() const
+    {
+      return d_cic ? d_cic->decimation() : 1;
+    }
+
+    double
+    channel_decimator::multiplies() const
+    {
+      /* NCO: one complex product per sample, one rotation per two */
+      double m = 6;
+      double decim = cic_decimation();
+      for (size_t i = 0; i < d_halfbands.size(); i++) {
+        decim *= 2;
+        m += d_halfbands[i]->multiplies() / decim;
+      }
+      m += 2.0 * d_fir->ntaps() / d_decim;
+      return m;
+    }
+
+    void
+    channel_decimator::mix(const std::complex<float> *in, size_t n,
+                           std::complex<float> *out)
+    {
+      for (size_t start = 0; start < n; start += NCO_CHUNK) {
+        const size_t m = std::min(NCO_CHUNK, n - start);
+        const float *x = reinterpret_cast<const float *>(in + start);
+        float *y = reinterpret_cast<float *>(out + start);
+        std::complex<float> p =
+          std::polar(d_amplitude, (float)d_angle);
+        size_t i = 0;
+
+#ifdef __SSE2__
+        std::complex<float> p1 = std::polar(d_amplitude,
+                                            (float)(d_angle + d_omega));
+        std::complex<float> s2 = std::polar(1.0f, (float)(2 * d_omega));
+        __m128 vp = _mm_setr_ps(p.real(), p.imag(), p1.real(), p1.imag());
+        const __m128 vs = _mm_setr_ps(s2.real(), s2.imag(),
+                                      s2.real(), s2.imag());
+        for (; i + 2 <= m; i += 2) {
+          _mm_storeu_ps(y + 2 * i, cmul2(_mm_loadu_ps(x + 2 * i), vp));
+          vp = cmul2(vp, vs);
+        }
+        float last[4];
+        _mm_storeu_ps(last, vp);
+        p = std::complex<float>(last[0], last[1]);
+#endif
+        const std::complex<float> s = std::polar(1.0f, (float)d_omega);
+        for (; i < m; i++) {
+          out[start + i] = in[start + i] * p;
+          p *= s;
+        }
+
+        d_angle = fmod(d_angle + d_omega * m, 2 * M_PI);
+      }
+    }
+
+    void
+    channel_decimator::mix_sc16(const int16_t *in, size_t n,
+                                uint32_t *phase, uint32_t step,
+                                int32_t *out)
+    {
+      const struct nco_table &t = nco_table();
+      uint32_t p = *phase;
+      size_t i = 0;
+
+#ifdef __SSE2__
+      /* Four samples per iteration: eight int16 in, eight int32 out */
+      for (; i + 4 <= n; i += 4) {
+        uint32_t k0 = table_index(p);
+        uint32_t k1 = table_index(p + step);
+        uint32_t k2 = table_index(p + 2 * step);
+        uint32_t k3 = table_index(p + 3 * step);
+        p += 4 * step;
+
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + 2 * i));
+        __m128i re = _mm_madd_epi16(x, _mm_setr_epi32(
+          (int)t.re[k0], (int)t.re[k1], (int)t.re[k2], (int)t.re[k3]));
+        __m128i im = _mm_madd_epi16(x, _mm_setr_epi32(
+          (int)t.im[k0], (int)t.im[k1], (int)t.im[k2], (int)t.im[k3]));
+        re = _mm_srai_epi32(re, MIX_SHIFT);
+        im = _mm_srai_epi32(im, MIX_SHIFT);
+        _mm_storeu_si128((__m128i *)(out + 2 * i),
+                         _mm_unpacklo_epi32(re, im));
+        _mm_storeu_si128((__m128i *)(out + 2 * i + 4),
+                         _mm_unpackhi_epi32(re, im));
+      }
+#endif
+      for (; i < n; i++) {
+        uint32_t k = table_index(p);
+        int32_t c = (int16_t)(t.re[k] & 0xffff);
+        int32_t s = (int16_t)(t.im[k] & 0xffff);
+        int32_t x = in[2 * i], y = in[2 * i + 1];
+        out[2 * i] = (x * c - y * s) >> MIX_SHIFT;
+        out[2 * i + 1] = (x * s + y * c) >> MIX_SHIFT;
+        p += step;
+      }
+      *phase = p;
+    }
+
+    size_t
+    channel_decimator::finish(int w, size_t n, std::complex<float> *out)
+    {
+      std::complex<float> *buf = &d_work[w][0];
+
+      for (size_t i = 0; i < d_halfbands.size(); i++) {
+        w ^= 1;
+        n = d_halfbands[i]->filter(buf, n, &d_work[w][0]);
+        buf = &d_work[w][0];
+      }
+      return d_fir->filter(buf, n, out);
+    }
+
+    size_t
+    channel_decimator::process(const std::complex<float> *in, size_t n,
+                               std::complex<float> *out)
+    {
+      int w = 0;
+
+      if (n > d_max_input) {
+        throw std::invalid_argument("channel_decimator: block too large");
+      }
+
+      mix(in, n, &d_work[0][0]);
+      if (d_cic) {
+        w = 1;
+        n = d_cic->filter(&d_work[0][0], n, &d_work[w][0]);
+      }
+      return finish(w, n, out);
+    }
+
+    size_t
+    channel_decimator::process_sc16(const int16_t *in, size_t n,
+                                    std::complex<float> *out)
+    {
+      if (n > d_max_input) {
+        throw std::invalid_argument("channel_decimator: block too large");
+      }
+
+      /* process() mixes out of d_work[1] before anything writes it */
+      if (!d_cic) {
+        std::complex<float> *conv = &d_work[1][0];
+        sc16_to_fc32(in, &conv, n, 1, SC16_Q11_SCALE);
+        return process(conv, n, out);
+      }
+
+      /* The accumulator is reseeded from the double phase every call,
+       * as the float NCO is every chunk */
+      uint32_t phase = to_phase(d_angle);
+      const uint32_t step = to_phase(d_omega);
+      size_t nout = 0;
+      for (size_t start = 0; start < n; start += NCO_CHUNK) {
+        const size_t m = std::min(NCO_CHUNK, n - start);
+        mix_sc16(in + 2 * start, m, &phase, step, &d_mixed[0]);
+        nout += d_cic->filter(&d_mixed[0], m, &d_work[0][nout], MIX_SCALE);
+      }
+      d_angle = fmod(d_angle + d_omega * n, 2 * M_PI);
+
+      return finish(0, nout, out);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,112 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_CHANNEL_DECIMATOR_H
+#define INCLUDED_BLADERF_CHANNEL_DECIMATOR_H
+
+#include <boost/shared_ptr.hpp>
+#include <complex>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "cic_decimator.h"
+#include "fir_decimator.h"
+#include "halfband_decimator.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Bring one channel to baseband and decimate it.
+     *
+     * Replaces the xlating FIR and decimating FIR of the flowgraph with
+     * an SSE NCO, a CIC stage doing most of the decimation without
+     * multiplies, halfband stages while the remaining factor is even, and
+     * a final real-tap FIR that sets the channel shape and flattens the
+     * CIC droop. Every stage only computes the outputs it keeps.
+     */
+    class channel_decimator
+    {
+     public:
+      /*!
+       * \param samp_rate input rate
+       * \param offset    channel centre relative to the input's, Hz
+       * \param decim     total decimation
+       * \param passband  edge of the flat part of the channel, Hz
+       * \param stopband  where the channel must be fully attenuated, Hz
+       * \param max_input largest process() call
+       */
+      channel_decimator(double samp_rate, double offset, unsigned int decim,
+                        double passband, double stopband, size_t max_input);
+
+      /* Mix and decimate n <= max_input samples; returns outputs written */
+      size_t process(const std::complex<float> *in, size_t n,
+                     std::complex<float> *out);
+
+      /* The same on raw SC16 Q11 samples (interleaved I/Q). The NCO and
+       * CIC run in integer arithmetic on the buffer as it came from the
+       * device and only the CIC output is converted to float, so the
+       * full rate stream is read at half the bytes and never written.
+       * Without a CIC stage the samples are converted first. */
+      size_t process_sc16(const int16_t *in, size_t n,
+                          std::complex<float> *out);
+
+      void reset();
+
+      size_t max_output(size_t n) const { return n / d_decim + 1; }
+
+      /* Real multiplies per input sample, NCO included */
+      double multiplies() const;
+
+      /* Decimation of the CIC stage (1 without one), halfband count */
+      unsigned int cic_decimation() const;
+      size_t halfbands() const { return d_halfbands.size(); }
+
+     private:
+      double d_samp_rate;
+      unsigned int d_decim;
+      size_t d_max_input;
+
+      /* NCO phase at the start of the next call and its per sample step;
+       * the phasor's magnitude carries the CIC input scale */
+      double d_angle;
+      double d_omega;
+      float d_amplitude;
+
+      boost::shared_ptr<cic_decimator> d_cic;
+      std::vector<boost::shared_ptr<halfband_decimator> > d_halfbands;
+      boost::shared_ptr<fir_decimator> d_fir;
+
+      std::vector<std::complex<float> > d_work[2];
+      std::vector<int32_t> d_mixed;
+
+      void mix(const std::complex<float> *in, size_t n,
+               std::complex<float> *out);
+      void mix_sc16(const int16_t *in, size_t n, uint32_t *phase,
+                    uint32_t step, int32_t *out);
+      size_t finish(int w, size_t n, std::complex<float> *out);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_CHANNEL_DECIMATOR_H */
@@ -0,0 +1,225 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include <stdio.h>
+#include "channel_plan.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Largest process() call the plan sizes the channelizer for */
+    static const size_t PLAN_MAX_INPUT = 65536;
+
+    struct lo_candidate {
+      double freq;
+      double distance;   /* from the middle of the channels */
+      size_t image_hits;
+    };
+
+    static bool
+    closer(const struct lo_candidate &a, const struct lo_candidate &b)
+    {
+      return a.distance < b.distance;
+    }
+
+    static bool
+    dc_clear(const std::vector<struct frs_channel> &channels, double lo,
+             double bandwidth, double guard)
+    {
+      for (size_t i = 0; i < channels.size(); i++) {
+        if (fabs(channels[i].frequency - lo) < bandwidth / 2 + guard) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /* Channels whose mirror about the LO lands inside another one */
+    static size_t
+    image_hits(const std::vector<struct frs_channel> &channels, double lo,
+               double bandwidth)
+    {
+      size_t hits = 0;
+      for (size_t i = 0; i < channels.size(); i++) {
+        double image = 2 * lo - channels[i].frequency;
+        for (size_t j = 0; j < channels.size(); j++) {
+          if (j != i && fabs(image - channels[j].frequency) < bandwidth / 2) {
+            hits++;
+            break;
+          }
+        }
+      }
+      return hits;
+    }
+
+    struct plan_limits
+    default_plan_limits()
+    {
+      struct plan_limits l;
+      l.min_rate = 160e3;
+      l.max_rate = 40e6;
+      l.min_freq = 237.5e6;
+      l.max_freq = 3.8e9;
+      l.usable_fraction = 0.8;
+      l.dc_guard = 50e3;
+      l.lo_step = 1e3;
+      return l;
+    }
+
+    struct channel_plan
+    make_channel_plan(const std::vector<struct frs_channel> &channels,
+                      double bandwidth, double out_rate,
+                      const struct plan_limits &limits)
+    {
+      if (channels.empty() || out_rate <= 0 || limits.lo_step <= 0) {
+        throw std::invalid_argument("make_channel_plan: no channels or "
+                                    "bad rates");
+      }
+
+      double low = channels[0].frequency, high = channels[0].frequency;
+      for (size_t i = 1; i < channels.size(); i++) {
+        low = std::min(low, channels[i].frequency);
+        high = std::max(high, channels[i].frequency);
+      }
+      low -= bandwidth / 2;
+      high += bandwidth / 2;
+      const double mid = (low + high) / 2;
+      const double span = high - low;
+
+      /* Every usable LO the fastest rate could reach, nearest the middle
+       * first; a rate's window is symmetric about the middle, so it
+       * takes a prefix of this list */
+      std::vector<struct lo_candidate> los;
+      const double reach = limits.usable_fraction * limits.max_rate / 2;
+      const double first = floor((mid - reach) / limits.lo_step);
+      const double last = ceil((mid + reach) / limits.lo_step);
+      for (double k = first; k <= last; k++) {
+        struct lo_candidate c;
+        c.freq = k * limits.lo_step;
+        c.distance = fabs(c.freq - mid);
+        if (c.freq < limits.min_freq || c.freq > limits.max_freq ||
+            !dc_clear(channels, c.freq, bandwidth, limits.dc_guard)) {
+          continue;
+        }
+        c.image_hits = image_hits(channels, c.freq, bandwidth);
+        los.push_back(c);
+      }
+      std::stable_sort(los.begin(), los.end(), closer);
+
+      struct channel_plan best;
+      bool found = false;
+      const unsigned int dmin =
+        (unsigned int)std::max(1.0, ceil(limits.min_rate / out_rate));
+      const unsigned int dmax = (unsigned int)floor(limits.max_rate / out_rate);
+
+      for (unsigned int d = dmin; d <= dmax; d++) {
+        const double rate = d * out_rate;
+        const double slack = limits.usable_fraction * rate / 2 - span / 2;
+        if (slack < 0) {
+          continue;
+        }
+
+        /* Nearest LO without image hits, else the one with fewest */
+        const struct lo_candidate *lo = NULL;
+        for (size_t i = 0; i < los.size() && los[i].distance <= slack;
+             i++) {
+          if (lo == NULL || los[i].image_hits < lo->image_hits) {
+            lo = &los[i];
+          }
+          if (lo->image_hits == 0) {
+            break;
+          }
+        }
+        if (lo == NULL || (found && lo->image_hits > best.image_hits)) {
+          continue;
+        }
+
+        struct channelizer_config cc;
+        cc.samp_rate = rate;
+        cc.out_rate = out_rate;
+        cc.max_input = PLAN_MAX_INPUT;
+        for (size_t i = 0; i < channels.size(); i++) {
+          struct channel_spec s = { channels[i].frequency - lo->freq,
+                                    bandwidth };
+          cc.channels.push_back(s);
+        }
+        double nco = channelizer::nco_cost(cc);
+        double fft = channelizer::fft_cost(cc);
+        cc.method = fft < nco ? CHANNELIZER_FFT : CHANNELIZER_NCO;
+        double cost = std::min(nco, fft) * rate;
+
+        if (!found || lo->image_hits < best.image_hits ||
+            cost < best.cost) {
+          best.center_freq = lo->freq;
+          best.samp_rate = rate;
+          best.bandwidth = limits.usable_fraction * rate;
+          best.image_hits = lo->image_hits;
+          best.cost = cost;
+          best.channelizer = cc;
+          found = true;
+        }
+      }
+
+      if (!found) {
+        throw std::invalid_argument("make_channel_plan: channels do not "
+                                    "fit the device limits");
+      }
+      return best;
+    }
+
+    std::string
+    format_channel_plan(const struct channel_plan &plan,
+                        const std::vector<struct frs_channel> &channels)
+    {
+      std::string s;
+      char line[128];
+
+      snprintf(line, sizeof(line),
+               "# %zu channels, %s channelizer, %.1f Mmul/s, "
+               "%zu image hits\n",
+               channels.size(),
+               plan.channelizer.method == CHANNELIZER_FFT ? "FFT" : "NCO",
+               plan.cost / 1e6, plan.image_hits);
+      s += line;
+      snprintf(line, sizeof(line), "rf_rx_freq = %.0f\n", plan.center_freq);
+      s += line;
+      snprintf(line, sizeof(line), "samp_rate = %.0f\n", plan.samp_rate);
+      s += line;
+      snprintf(line, sizeof(line), "rx_bandwidth = %.0f\n", plan.bandwidth);
+      s += line;
+      for (size_t i = 0; i < channels.size(); i++) {
+        snprintf(line, sizeof(line), "rx_ch%d_offset = %.0f\n",
+                 channels[i].number, plan.channelizer.channels[i].offset);
+        s += line;
+      }
+      return s;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
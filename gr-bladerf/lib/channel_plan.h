@@ -0,0 +1,82 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_CHANNEL_PLAN_H
+#define INCLUDED_BLADERF_CHANNEL_PLAN_H
+
+#include <string>
+#include <vector>
+#include "channelizer.h"
+#include "frs_channels.h"
+
+namespace gr {
+  namespace bladerf {
+
+    struct plan_limits {
+      double min_rate, max_rate;  /* device sample rate range */
+      double min_freq, max_freq;  /* LO tuning range */
+      double usable_fraction;     /* share of the rate inside the
+                                   * anti-alias filter's flat part */
+      double dc_guard;            /* LO to nearest channel edge, Hz */
+      double lo_step;             /* LO tuning resolution */
+    };
+
+    struct channel_plan {
+      double center_freq;         /* LO */
+      double samp_rate;
+      double bandwidth;           /* analog filter */
+      size_t image_hits;          /* channels with another's IQ image */
+      double cost;                /* multiplies per second */
+      struct channelizer_config channelizer;  /* method chosen, offsets in
+                                               * table order */
+    };
+
+    /* bladeRF (LMS6002D) rate and tuning range, 80% usable, 50 kHz
+     * clear of the LO */
+    struct plan_limits default_plan_limits();
+
+    /*!
+     * Choose the LO and sample rate for a set of channels, each
+     * bandwidth wide, delivered at out_rate.
+     *
+     * Every rate the device supports that is a multiple of out_rate is
+     * tried. For each, the LO is placed as close to the middle of the
+     * channels as the DC guard allows while keeping them inside the
+     * usable band, preferring positions where no channel's IQ image
+     * lands on another channel. The plan with the fewest multiplies per
+     * second wins, whichever channelizer method that takes. Throws
+     * std::invalid_argument when nothing fits.
+     */
+    struct channel_plan make_channel_plan(
+      const std::vector<struct frs_channel> &channels, double bandwidth,
+      double out_rate, const struct plan_limits &limits);
+
+    /* The plan as GRC style variable assignments (rf_rx_freq,
+     * samp_rate, rx_chN_offset...) */
+    std::string format_channel_plan(
+      const struct channel_plan &plan,
+      const std::vector<struct frs_channel> &channels);
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_CHANNEL_PLAN_H */
@@ -0,0 +1,415 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include <string.h>
+#include "channelizer.h"
+#include "fir_decimator.h"
+#include "sample_convert.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Every overlap-save block inverse transforms at least this many
+     * bins per channel */
+    static const size_t MIN_BINS = 4;
+
+    /* Transform sizes tried, as multiples of the first stage filter */
+    static const size_t MIN_SIZE_RATIO = 2;
+    static const size_t MAX_SIZE_RATIO = 32;
+
+    struct fft_plan {
+      unsigned int d1;
+      size_t size;
+      std::vector<float> taps;
+      double cost;
+    };
+
+    static unsigned int
+    total_decimation(const struct channelizer_config &config)
+    {
+      double d = config.samp_rate / config.out_rate;
+      unsigned int decim = (unsigned int)floor(d + 0.5);
+      if (config.out_rate <= 0 || decim < 1 || fabs(d - decim) > 1e-6) {
+        throw std::invalid_argument("channelizer: output rate must divide "
+                                    "the sample rate");
+      }
+      return decim;
+    }
+
+    static double
+    max_passband(const struct channelizer_config &config)
+    {
+      double pass = 0;
+      for (size_t i = 0; i < config.channels.size(); i++) {
+        pass = std::max(pass, config.channels[i].bandwidth / 2);
+      }
+      return pass;
+    }
+
+    /* Summed cost of one channel_decimator per channel. Offsets do not
+     * change the cost and lists mostly repeat one bandwidth, so equal
+     * neighbours share a design */
+    static double
+    decimators_cost(const struct channelizer_config &config,
+                    double samp_rate, unsigned int decim)
+    {
+      double total = 0, cost = 0, bandwidth = 0;
+      for (size_t i = 0; i < config.channels.size(); i++) {
+        if (i == 0 || config.channels[i].bandwidth != bandwidth) {
+          bandwidth = config.channels[i].bandwidth;
+          channel_decimator c(samp_rate, 0, decim, bandwidth / 2,
+                              config.out_rate / 2, 1);
+          cost = c.multiplies();
+        }
+        total += cost;
+      }
+      return total;
+    }
+
+    static size_t
+    blocks_for(size_t n, size_t size, size_t hop)
+    {
+      return (n + size) / hop + 1;
+    }
+
+    /* Pick the bin decimation and transform size with the fewest
+     * multiplies; false if the decimation has no power of two factor
+     * leaving a factor of four for the second stage */
+    static bool
+    plan_fft(const struct channelizer_config &config, struct fft_plan *plan)
+    {
+      const unsigned int decim = total_decimation(config);
+      const double stop = config.out_rate / 2;
+      const double pass = max_passband(config);
+      bool found = false;
+
+      for (unsigned int d1 = 2; d1 <= decim / 4; d1 *= 2) {
+        if (decim % d1 != 0) {
+          break;
+        }
+
+        /* The first stage only has to keep what would alias into the
+         * channel after decimating by d1; the second cleans up */
+        const double r1 = config.samp_rate / d1;
+        std::vector<float> taps = fir_decimator::lowpass(
+          1.0, config.samp_rate, (pass + r1 - stop) / 2, r1 - stop - pass);
+
+        /* Second stage cost per first stage output */
+        double stage2 = decimators_cost(config, r1, decim / d1);
+
+        size_t size = 1;
+        while (size < MIN_SIZE_RATIO * taps.size() ||
+               size < MIN_BINS * d1) {
+          size *= 2;
+        }
+        for (; size <= MAX_SIZE_RATIO * taps.size(); size *= 2) {
+          const size_t bins = size / d1;
+          const size_t start = (taps.size() - 1 + d1 - 1) / d1;
+          if (start >= bins) {
+            continue;
+          }
+          const double hop = (double)(size - start * d1);
+
+          /* Forward transform shared; per channel the folded product
+           * over 2 * bins, the inverse, and the block phase */
+          double cost = 4.0 * (size / 2) * log2((double)size) / hop;
+          double per = 8.0 * bins + 4.0 * (bins / 2) * log2((double)bins) +
+                       4.0 * (bins - start);
+          cost += config.channels.size() * per / hop + stage2 / d1;
+
+          if (!found || cost < plan->cost) {
+            plan->d1 = d1;
+            plan->size = size;
+            plan->taps = taps;
+            plan->cost = cost;
+            found = true;
+          }
+        }
+      }
+      return found;
+    }
+
+    double
+    channelizer::nco_cost(const struct channelizer_config &config)
+    {
+      return decimators_cost(config, config.samp_rate,
+                             total_decimation(config));
+    }
+
+    double
+    channelizer::fft_cost(const struct channelizer_config &config)
+    {
+      struct fft_plan plan;
+      if (!plan_fft(config, &plan)) {
+        return HUGE_VAL;
+      }
+      return plan.cost;
+    }
+
+    channelizer::channelizer(const struct channelizer_config &config)
+      : d_config(config),
+        d_method(config.method),
+        d_decim(total_decimation(config)),
+        d_max_output(0),
+        d_in(NULL),
+        d_in16(NULL),
+        d_n(0),
+        d_d1(1),
+        d_size(0),
+        d_bins(0),
+        d_start(0),
+        d_hop(0),
+        d_fill(0),
+        d_blocks(0)
+    {
+      if (config.channels.empty() || config.max_input < 1) {
+        throw std::invalid_argument("channelizer: no channels or empty "
+                                    "blocks");
+      }
+      for (size_t i = 0; i < config.channels.size(); i++) {
+        const struct channel_spec &c = config.channels[i];
+        if (fabs(c.offset) >= config.samp_rate / 2 || c.bandwidth <= 0 ||
+            c.bandwidth >= config.out_rate) {
+          throw std::invalid_argument("channelizer: channel outside the "
+                                      "capture or wider than the output");
+        }
+      }
+
+      if (d_method == CHANNELIZER_AUTO) {
+        d_method = fft_cost(config) < nco_cost(config) ?
+                   CHANNELIZER_FFT : CHANNELIZER_NCO;
+      }
+      if (d_method == CHANNELIZER_FFT) {
+        setup_fft();
+      }
+      else {
+        setup_nco();
+      }
+    }
+
+    void
+    channelizer::setup_nco()
+    {
+      const double stop = d_config.out_rate / 2;
+      for (size_t i = 0; i < d_config.channels.size(); i++) {
+        const struct channel_spec &c = d_config.channels[i];
+        d_decimators.push_back(boost::shared_ptr<channel_decimator>(
+          new channel_decimator(d_config.samp_rate, c.offset, d_decim,
+                                c.bandwidth / 2, stop,
+                                d_config.max_input)));
+      }
+      d_max_output = d_decimators[0]->max_output(d_config.max_input);
+    }
+
+    void
+    channelizer::setup_fft()
+    {
+      struct fft_plan plan;
+      if (!plan_fft(d_config, &plan)) {
+        throw std::invalid_argument("channelizer: decimation has no power "
+                                    "of two factor for the FFT method");
+      }
+
+      const double fs = d_config.samp_rate;
+      const size_t nch = d_config.channels.size();
+      d_d1 = plan.d1;
+      d_size = plan.size;
+      d_bins = d_size / d_d1;
+      d_start = (plan.taps.size() - 1 + d_d1 - 1) / d_d1;
+      d_hop = d_size - d_start * d_d1;
+      d_forward.reset(new radix2_fft(d_size, true));
+      d_inverse.reset(new radix2_fft(d_bins, false));
+
+      /* First stage response over the 2 * bins folded into each output,
+       * with the inverse transform's 1 / N folded in */
+      std::vector<std::complex<float> > h(d_size);
+      for (size_t i = 0; i < plan.taps.size(); i++) {
+        h[i] = plan.taps[i];
+      }
+      d_forward->execute(&h[0]);
+      d_response.resize(2 * d_bins);
+      for (size_t i = 0; i < 2 * d_bins; i++) {
+        size_t k = (i + d_size - d_bins) % d_size;
+        d_response[i] = h[k] / (float)d_size;
+      }
+
+      /* History of size - hop samples, then room for a full call */
+      d_stage.resize(d_size + d_config.max_input);
+      d_fill = d_size - d_hop;
+      const size_t max_blocks = blocks_for(d_config.max_input, d_size,
+                                           d_hop);
+      d_spectra.resize(max_blocks * d_size);
+
+      const size_t max_mid = max_blocks * (d_bins - d_start);
+      const double r1 = fs / d_d1;
+      for (size_t i = 0; i < nch; i++) {
+        const struct channel_spec &c = d_config.channels[i];
+        long b = lrint(c.offset * d_size / fs);
+        d_centre_bin.push_back(b);
+        d_decimators.push_back(boost::shared_ptr<channel_decimator>(
+          new channel_decimator(r1, c.offset - b * fs / d_size,
+                                d_decim / d_d1, c.bandwidth / 2,
+                                d_config.out_rate / 2, max_mid)));
+      }
+      d_block_angle.assign(nch, 0.0);
+      d_bin_buf.resize(nch, std::vector<std::complex<float> >(d_bins));
+      d_mid.resize(nch, std::vector<std::complex<float> >(max_mid));
+      d_max_output = d_decimators[0]->max_output(max_mid);
+    }
+
+    double
+    channelizer::multiplies() const
+    {
+      return d_method == CHANNELIZER_FFT ? fft_cost(d_config) :
+                                            nco_cost(d_config);
+    }
+
+    std::complex<float> *
+    channelizer::stage(size_t n)
+    {
+      if (n > d_config.max_input) {
+        throw std::invalid_argument("channelizer: block too large");
+      }
+
+      /* Drop the input the previous round's blocks moved past */
+      const size_t used = d_blocks * d_hop;
+      memmove(&d_stage[0], &d_stage[used],
+              (d_fill - used) * sizeof(std::complex<float>));
+      d_fill -= used;
+
+      std::complex<float> *dst = &d_stage[d_fill];
+      d_fill += n;
+      d_blocks = d_fill >= d_size ? (d_fill - d_size) / d_hop + 1 : 0;
+      return dst;
+    }
+
+    size_t
+    channelizer::begin(const std::complex<float> *in, size_t n)
+    {
+      if (d_method != CHANNELIZER_FFT) {
+        if (n > d_config.max_input) {
+          throw std::invalid_argument("channelizer: block too large");
+        }
+        d_in = in;
+        d_in16 = NULL;
+        d_n = n;
+        return 0;
+      }
+
+      memcpy(stage(n), in, n * sizeof(std::complex<float>));
+      return d_blocks;
+    }
+
+    size_t
+    channelizer::begin(const int16_t *in, size_t n)
+    {
+      if (d_method != CHANNELIZER_FFT) {
+        if (n > d_config.max_input) {
+          throw std::invalid_argument("channelizer: block too large");
+        }
+        d_in = NULL;
+        d_in16 = in;
+        d_n = n;
+        return 0;
+      }
+
+      std::complex<float> *dst = stage(n);
+      sc16_to_fc32(in, &dst, n, 1, SC16_Q11_SCALE);
+      return d_blocks;
+    }
+
+    void
+    channelizer::transform(size_t block)
+    {
+      std::complex<float> *spec = &d_spectra[block * d_size];
+      memcpy(spec, &d_stage[block * d_hop],
+             d_size * sizeof(std::complex<float>));
+      d_forward->execute(spec);
+    }
+
+    size_t
+    channelizer::channel(size_t ch, std::complex<float> *out)
+    {
+      if (d_method != CHANNELIZER_FFT) {
+        if (d_in16 != NULL) {
+          return d_decimators[ch]->process_sc16(d_in16, d_n, out);
+        }
+        return d_decimators[ch]->process(d_in, d_n, out);
+      }
+
+      const long n = (long)d_size;
+      const long bins = (long)d_bins;
+      const double step = -2 * M_PI * (double)d_centre_bin[ch] *
+                          (double)d_hop / (double)d_size;
+      std::complex<float> *buf = &d_bin_buf[ch][0];
+      std::complex<float> *mid = &d_mid[ch][0];
+      size_t nmid = 0;
+
+      for (size_t block = 0; block < d_blocks; block++) {
+        const std::complex<float> *spec = &d_spectra[block * d_size];
+
+        /* Bins within +-bins of the centre, folded onto bins outputs:
+         * the decimated circular convolution, exactly as long as the
+         * response outside that span is negligible */
+        std::fill(buf, buf + d_bins, std::complex<float>(0, 0));
+        for (long i = -bins; i < bins; i++) {
+          long k = ((d_centre_bin[ch] + i) % n + n) % n;
+          buf[(i + bins) % bins] += spec[k] * d_response[i + bins];
+        }
+        d_inverse->execute(buf);
+
+        /* Undo the centre bin's phase at this block's start */
+        const std::complex<float> p =
+          std::polar(1.0f, (float)d_block_angle[ch]);
+        for (size_t j = d_start; j < d_bins; j++) {
+          mid[nmid++] = buf[j] * p;
+        }
+        d_block_angle[ch] = fmod(d_block_angle[ch] + step, 2 * M_PI);
+      }
+
+      return d_decimators[ch]->process(mid, nmid, out);
+    }
+
+    size_t
+    channelizer::process(const std::complex<float> *in, size_t n,
+                         std::complex<float> *const *out)
+    {
+      size_t blocks = begin(in, n);
+      size_t nout = 0;
+      for (size_t b = 0; b < blocks; b++) {
+        transform(b);
+      }
+      for (size_t ch = 0; ch < channels(); ch++) {
+        nout = channel(ch, out[ch]);
+      }
+      return nout;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,151 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_CHANNELIZER_H
+#define INCLUDED_BLADERF_CHANNELIZER_H
+
+#include <boost/shared_ptr.hpp>
+#include <complex>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "channel_decimator.h"
+#include "radix2_fft.h"
+
+namespace gr {
+  namespace bladerf {
+
+    enum channelizer_method {
+      CHANNELIZER_AUTO,  /* whichever costs fewer multiplies */
+      CHANNELIZER_NCO,   /* one channel_decimator per channel */
+      CHANNELIZER_FFT    /* shared overlap-save FFT, bins per channel */
+    };
+
+    struct channel_spec {
+      double offset;     /* centre relative to the LO, Hz */
+      double bandwidth;  /* occupied bandwidth, flat to half of it */
+    };
+
+    struct channelizer_config {
+      double samp_rate;
+      double out_rate;   /* common output rate, must divide samp_rate */
+      std::vector<struct channel_spec> channels;
+      channelizer_method method;
+      size_t max_input;  /* largest call */
+    };
+
+    /*!
+     * \brief Channelizer for an explicit list of channel centres.
+     *
+     * Unlike a uniform polyphase filter bank, only the requested channels
+     * are computed and their centres need not sit on a grid. Two methods
+     * are available:
+     *
+     * NCO: every channel gets its own channel_decimator. Cost grows
+     * linearly with the channel count from a low start.
+     *
+     * FFT: the input is transformed once per overlap-save block; each
+     * channel multiplies the bins around its centre by the first stage
+     * filter and inverse transforms only those, which decimates by a
+     * power of two. The rest of the decimation, and the offset between
+     * the channel centre and its bin, is left to a channel_decimator at
+     * the reduced rate. The shared transform dominates, so this wins
+     * once there are a handful of channels.
+     *
+     * process() does everything on the calling thread. A worker pool
+     * can instead call begin(), then transform() for each block it
+     * returns, then channel() for each channel; calls within a phase
+     * are independent.
+     */
+    class channelizer
+    {
+     public:
+      channelizer(const struct channelizer_config &config);
+
+      /* Channelize n <= max_input samples into out[ch]; returns the
+       * outputs written per channel */
+      size_t process(const std::complex<float> *in, size_t n,
+                     std::complex<float> *const *out);
+
+      /* in must stay valid until every channel() call of this round */
+      size_t begin(const std::complex<float> *in, size_t n);
+
+      /* The same on raw SC16 Q11 samples: the NCO method runs its
+       * decimators' fixed point path on them, the FFT method converts
+       * them straight into its staging buffer */
+      size_t begin(const int16_t *in, size_t n);
+      void transform(size_t block);
+      size_t channel(size_t ch, std::complex<float> *out);
+
+      channelizer_method method() const { return d_method; }
+      size_t channels() const { return d_config.channels.size(); }
+
+      /* Largest per channel output of one call */
+      size_t max_output() const { return d_max_output; }
+
+      /* Real multiplies per input sample, all channels together */
+      double multiplies() const;
+
+      /* Cost of either method for a configuration, HUGE_VAL when the
+       * FFT method does not apply */
+      static double nco_cost(const struct channelizer_config &config);
+      static double fft_cost(const struct channelizer_config &config);
+
+     private:
+      struct channelizer_config d_config;
+      channelizer_method d_method;
+      unsigned int d_decim;
+      size_t d_max_output;
+      std::vector<boost::shared_ptr<channel_decimator> > d_decimators;
+
+      /* NCO method: the current call's input */
+      const std::complex<float> *d_in;
+      const int16_t *d_in16;
+      size_t d_n;
+
+      /* FFT method */
+      unsigned int d_d1;         /* decimation by bin selection */
+      size_t d_size;             /* forward transform size N */
+      size_t d_bins;             /* bins kept per channel, N / d1 */
+      size_t d_start;            /* first valid output of a block */
+      size_t d_hop;              /* new input per block */
+      boost::shared_ptr<radix2_fft> d_forward;
+      boost::shared_ptr<radix2_fft> d_inverse;
+      std::vector<std::complex<float> > d_response;  /* d_bins, scaled */
+      std::vector<std::complex<float> > d_stage;     /* pending input */
+      size_t d_fill;
+      size_t d_blocks;           /* blocks in the current round */
+      std::vector<std::complex<float> > d_spectra;
+      std::vector<long> d_centre_bin;
+      std::vector<double> d_block_angle;
+      std::vector<std::vector<std::complex<float> > > d_bin_buf;
+      std::vector<std::vector<std::complex<float> > > d_mid;
+
+      void setup_nco();
+      void setup_fft();
+      std::complex<float> *stage(size_t n);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_CHANNELIZER_H */
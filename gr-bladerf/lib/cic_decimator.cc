@@ -0,0 +1,190 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdexcept>
+#include <math.h>
+#include <string.h>
+#include "cic_decimator.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace gr {
+  namespace bladerf {
+
+    cic_decimator::cic_decimator(unsigned int decim, unsigned int order)
+      : d_decim(decim),
+        d_order(order)
+    {
+      if (decim < 2 || order < 1 || order > MAX_ORDER) {
+        throw std::invalid_argument("cic_decimator: bad decimation or "
+                                    "order");
+      }
+      d_out_scale = (float)(1.0 / (pow((double)decim, (double)order) *
+                                   input_scale()));
+      reset();
+    }
+
+    void
+    cic_decimator::reset()
+    {
+      memset(d_integ, 0, sizeof(d_integ));
+      memset(d_comb, 0, sizeof(d_comb));
+      d_phase = 0;
+    }
+
+    double
+    cic_decimator::response(double f, double samp_rate) const
+    {
+      double x = M_PI * f / samp_rate;
+      if (fabs(sin(x)) < 1e-12) {
+        return 1.0;
+      }
+      return pow(fabs(sin(d_decim * x) / (d_decim * sin(x))),
+                 (double)d_order);
+    }
+
+    /* Both input types widen to the same 64-bit integrator lanes */
+#ifdef __SSE2__
+    static inline __m128i
+    load_pair(const float *x)
+    {
+      __m128i v = _mm_cvtps_epi32(_mm_castpd_ps(
+        _mm_load_sd((const double *)x)));
+      return _mm_unpacklo_epi32(v, _mm_srai_epi32(v, 31));
+    }
+
+    static inline __m128i
+    load_pair(const int32_t *x)
+    {
+      __m128i v = _mm_loadl_epi64((const __m128i *)x);
+      return _mm_unpacklo_epi32(v, _mm_srai_epi32(v, 31));
+    }
+#endif
+
+    static inline int64_t
+    load_one(const float *x)
+    {
+      return (int64_t)lrintf(*x);
+    }
+
+    static inline int64_t
+    load_one(const int32_t *x)
+    {
+      return *x;
+    }
+
+    template <typename T>
+    size_t
+    cic_decimator::integrate(const T *x, size_t n,
+                             std::complex<float> *out, float out_scale)
+    {
+      const unsigned int order = d_order;
+      size_t nout = 0;
+
+#ifdef __SSE2__
+      /* One 128-bit register holds the I and Q integrators of a stage */
+      __m128i acc[MAX_ORDER];
+      for (unsigned int k = 0; k < order; k++) {
+        acc[k] = _mm_loadu_si128((const __m128i *)d_integ[k]);
+      }
+
+      for (size_t i = 0; i < n; i++) {
+        __m128i v = load_pair(x + 2 * i);
+
+        acc[0] = _mm_add_epi64(acc[0], v);
+        for (unsigned int k = 1; k < order; k++) {
+          acc[k] = _mm_add_epi64(acc[k], acc[k - 1]);
+        }
+
+        if (++d_phase == d_decim) {
+          int64_t c[2];
+          d_phase = 0;
+          _mm_storeu_si128((__m128i *)c, acc[order - 1]);
+          for (unsigned int k = 0; k < order; k++) {
+            for (int q = 0; q < 2; q++) {
+              int64_t prev = d_comb[k][q];
+              d_comb[k][q] = c[q];
+              c[q] = (int64_t)((uint64_t)c[q] - (uint64_t)prev);
+            }
+          }
+          out[nout++] = std::complex<float>(c[0] * out_scale,
+                                            c[1] * out_scale);
+        }
+      }
+
+      for (unsigned int k = 0; k < order; k++) {
+        _mm_storeu_si128((__m128i *)d_integ[k], acc[k]);
+      }
+#else
+      for (size_t i = 0; i < n; i++) {
+        /* Unsigned adds wrap without undefined behaviour */
+        for (int q = 0; q < 2; q++) {
+          uint64_t v = (uint64_t)load_one(x + 2 * i + q);
+          for (unsigned int k = 0; k < order; k++) {
+            v += (uint64_t)d_integ[k][q];
+            d_integ[k][q] = (int64_t)v;
+          }
+        }
+
+        if (++d_phase == d_decim) {
+          int64_t c[2] = { d_integ[order - 1][0], d_integ[order - 1][1] };
+          d_phase = 0;
+          for (unsigned int k = 0; k < order; k++) {
+            for (int q = 0; q < 2; q++) {
+              int64_t prev = d_comb[k][q];
+              d_comb[k][q] = c[q];
+              c[q] = (int64_t)((uint64_t)c[q] - (uint64_t)prev);
+            }
+          }
+          out[nout++] = std::complex<float>(c[0] * out_scale,
+                                            c[1] * out_scale);
+        }
+      }
+#endif
+
+      return nout;
+    }
+
+    size_t
+    cic_decimator::filter(const std::complex<float> *in, size_t n,
+                          std::complex<float> *out)
+    {
+      return integrate(reinterpret_cast<const float *>(in), n, out,
+                       d_out_scale);
+    }
+
+    size_t
+    cic_decimator::filter(const int32_t *in, size_t n,
+                          std::complex<float> *out, float in_scale)
+    {
+      return integrate(in, n, out, (float)(1.0 / (
+        pow((double)d_decim, (double)d_order) * in_scale)));
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
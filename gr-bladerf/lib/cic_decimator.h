@@ -0,0 +1,87 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_CIC_DECIMATOR_H
+#define INCLUDED_BLADERF_CIC_DECIMATOR_H
+
+#include <complex>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Multiplier-free CIC decimator on a complex stream.
+     *
+     * The integrators and combs run on 64-bit integers and are allowed to
+     * wrap; the combs undo the wrap as long as the output fits, which 64
+     * bits guarantee for any practical rate. Input is expected already
+     * multiplied by input_scale() (the NCO in front folds that in for
+     * free); output is back at unit gain.
+     */
+    class cic_decimator
+    {
+     public:
+      static const unsigned int MAX_ORDER = 6;
+
+      cic_decimator(unsigned int decim, unsigned int order = 4);
+
+      /* Decimate n scaled samples; returns the outputs written */
+      size_t filter(const std::complex<float> *in, size_t n,
+                    std::complex<float> *out);
+
+      /* The same on interleaved I/Q integers already at in_scale, as
+       * produced by a fixed point mixer */
+      size_t filter(const int32_t *in, size_t n, std::complex<float> *out,
+                    float in_scale);
+
+      void reset();
+
+      unsigned int decimation() const { return d_decim; }
+      unsigned int order() const { return d_order; }
+
+      /* Fixed point scale of the input, 2^20 */
+      static float input_scale() { return 1048576.0f; }
+
+      /* Magnitude response at f (Hz) for an input rate of samp_rate */
+      double response(double f, double samp_rate) const;
+
+     private:
+      unsigned int d_decim;
+      unsigned int d_order;
+      unsigned int d_phase;      /* inputs since the last output */
+      float d_out_scale;
+
+      /* I and Q side by side, integrators then comb delays */
+      int64_t d_integ[MAX_ORDER][2];
+      int64_t d_comb[MAX_ORDER][2];
+
+      template <typename T>
+      size_t integrate(const T *x, size_t n, std::complex<float> *out,
+                       float out_scale);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_CIC_DECIMATOR_H */
@@ -0,0 +1,413 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/static_assert.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "adpcm.h"
+#include "clip_store.h"
+
+namespace gr {
+  namespace bladerf {
+
+    BOOST_STATIC_ASSERT(sizeof(struct clip_index_header) == 32);
+    BOOST_STATIC_ASSERT(sizeof(struct clip_record) == 32);
+
+    static const char MAGIC[8] = { 'F', 'R', 'S', 'C', 'L', 'I', 'P', '1' };
+
+    /* Same headroom as frs_rxd's raw audio files */
+    static const float AUDIO_SCALE = 29000.0f;
+
+    /* Float rounding of start + duration between records */
+    static const double END_SLACK = 1e-3;
+
+    static std::string
+    index_path(const std::string &directory)
+    {
+      return directory + "/clips.idx";
+    }
+
+    static std::string
+    data_path(const std::string &directory)
+    {
+      return directory + "/clips.adpcm";
+    }
+
+    clip_store::clip_store(const struct clip_store_config &config)
+      : d_config(config),
+        d_index(NULL),
+        d_data(NULL),
+        d_offset(0),
+        d_clips(0)
+    {
+      if (config.audio_rate <= 0 || config.max_duration <= 0 ||
+          config.channels.empty()) {
+        throw std::invalid_argument("clip_store: bad rate, duration or "
+                                    "channels");
+      }
+
+      int top = *std::max_element(config.channels.begin(),
+                                  config.channels.end());
+      d_slot.assign(top + 1, -1);
+      for (size_t i = 0; i < config.channels.size(); i++) {
+        if (config.channels[i] < 0) {
+          throw std::invalid_argument("clip_store: bad channel number");
+        }
+        d_slot[config.channels[i]] = (int)i;
+      }
+      d_state.resize(config.channels.size());
+      for (size_t i = 0; i < d_state.size(); i++) {
+        d_state[i].open = false;
+      }
+
+      const std::string idx = index_path(config.directory);
+      struct clip_index_header h;
+      d_index = fopen(idx.c_str(), "r+b");
+      if (d_index == NULL) {
+        d_index = fopen(idx.c_str(), "w+b");
+        if (d_index == NULL) {
+          throw std::runtime_error("clip_store: unable to create " + idx);
+        }
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.record_size = sizeof(struct clip_record);
+        h.audio_rate = config.audio_rate;
+        h.max_duration = config.max_duration;
+      } else if (fread(&h, sizeof(h), 1, d_index) != 1 ||
+                 memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+                 h.record_size != sizeof(struct clip_record) ||
+                 h.audio_rate != config.audio_rate) {
+        fclose(d_index);
+        throw std::runtime_error("clip_store: " + idx + " is not a clip "
+                                 "index at this audio rate");
+      } else {
+        h.max_duration = std::max(h.max_duration, config.max_duration);
+      }
+      rewind(d_index);
+      fwrite(&h, sizeof(h), 1, d_index);
+
+      /* Drop a record cut short by a crash */
+      fseeko(d_index, 0, SEEK_END);
+      off_t records = (ftello(d_index) - (off_t)sizeof(h)) /
+                      (off_t)sizeof(struct clip_record);
+      fflush(d_index);
+      if (ftruncate(fileno(d_index), (off_t)sizeof(h) +
+                    records * (off_t)sizeof(struct clip_record)) != 0) {
+        perror(idx.c_str());
+      }
+      fseeko(d_index, 0, SEEK_END);
+
+      const std::string data = data_path(config.directory);
+      d_data = fopen(data.c_str(), "ab");
+      if (d_data == NULL) {
+        fclose(d_index);
+        throw std::runtime_error("clip_store: unable to open " + data);
+      }
+      fseeko(d_data, 0, SEEK_END);
+      d_offset = (uint64_t)ftello(d_data);
+    }
+
+    clip_store::~clip_store()
+    {
+      fclose(d_data);
+      fclose(d_index);
+    }
+
+    struct clip_store::channel_state *
+    clip_store::state(int channel)
+    {
+      if (channel < 0 || channel >= (int)d_slot.size() ||
+          d_slot[channel] < 0) {
+        return NULL;
+      }
+      return &d_state[d_slot[channel]];
+    }
+
+    void
+    clip_store::audio(int channel, const float *audio, size_t n)
+    {
+      struct channel_state *s = state(channel);
+      if (s == NULL) {
+        return;
+      }
+      size_t old = s->pcm.size();
+      s->pcm.resize(old + n);
+      for (size_t i = 0; i < n; i++) {
+        float x = std::max(-1.0f, std::min(1.0f, audio[i]));
+        s->pcm[old + i] = (int16_t)lrintf(x * AUDIO_SCALE);
+      }
+    }
+
+    void
+    clip_store::squelch(int channel, double time, bool open,
+                        float power_db)
+    {
+      struct channel_state *s = state(channel);
+      if (s == NULL || open == s->open) {
+        return;
+      }
+      if (open) {
+        s->open = true;
+        s->start = time;
+        s->tone = 0;
+        s->power_sum = pow(10.0, power_db / 10);
+        s->power_count = 1;
+      } else {
+        cut(channel, time);
+        s->open = false;
+      }
+    }
+
+    void
+    clip_store::tone(int channel, double time, float tone)
+    {
+      struct channel_state *s = state(channel);
+      if (s == NULL || !s->open || tone == 0 || tone == s->tone) {
+        return;
+      }
+      /* The first tone found names the clip; another one means a new
+       * transmitter took over without the squelch closing */
+      if (s->tone != 0) {
+        cut(channel, time);
+      }
+      s->tone = tone;
+    }
+
+    void
+    clip_store::level(int channel, double time, float power_db)
+    {
+      struct channel_state *s = state(channel);
+      if (s == NULL || !s->open) {
+        return;
+      }
+      s->power_sum += pow(10.0, power_db / 10);
+      s->power_count++;
+      while (time - s->start >= d_config.max_duration) {
+        cut(channel, s->start + d_config.max_duration);
+      }
+    }
+
+    void
+    clip_store::close(double time)
+    {
+      for (size_t i = 0; i < d_config.channels.size(); i++) {
+        squelch(d_config.channels[i], time, false, 0);
+      }
+    }
+
+    /* Write the open clip up to time and start the next one there */
+    void
+    clip_store::cut(int channel, double time)
+    {
+      struct channel_state *s = state(channel);
+      size_t n = (size_t)std::max(0.0, floor((time - s->start) *
+                                             d_config.audio_rate + 0.5));
+      n = std::min(n, s->pcm.size());
+
+      if (n > 0) {
+        std::vector<uint8_t> coded(adpcm_state::bytes(n));
+        adpcm_state coder;
+        coder.encode(&s->pcm[0], n, &coded[0]);
+
+        struct clip_record r;
+        memset(&r, 0, sizeof(r));
+        r.start = d_config.start_time + s->start;
+        r.duration = (float)(n / d_config.audio_rate);
+        r.rssi_db = (float)(10 * log10(s->power_sum / s->power_count +
+                                       1e-20));
+        r.offset = d_offset;
+        r.samples = (uint32_t)n;
+        r.channel = (uint16_t)channel;
+        r.ctcss = (uint16_t)lrintf(s->tone * 10);
+
+        if (fwrite(&coded[0], 1, coded.size(), d_data) == coded.size() &&
+            fflush(d_data) == 0) {
+          fwrite(&r, sizeof(r), 1, d_index);
+          fflush(d_index);
+          d_clips++;
+        } else {
+          perror("clip_store");
+        }
+        d_offset += coded.size();
+      }
+
+      /* The next clip starts out at this one's mean power */
+      s->pcm.erase(s->pcm.begin(), s->pcm.begin() + n);
+      s->start = time;
+      s->power_sum /= s->power_count;
+      s->power_count = 1;
+    }
+
+    clip_index::clip_index(const std::string &directory)
+      : d_directory(directory),
+        d_map(NULL),
+        d_map_size(0),
+        d_header(NULL),
+        d_records(NULL),
+        d_count(0)
+    {
+      const std::string idx = index_path(directory);
+      d_fd = open(idx.c_str(), O_RDONLY);
+      if (d_fd < 0) {
+        throw std::runtime_error("clip_index: unable to open " + idx);
+      }
+      d_data = fopen(data_path(directory).c_str(), "rb");
+      if (refresh() == 0 && d_header == NULL) {
+        unmap();
+        ::close(d_fd);
+        if (d_data != NULL) {
+          fclose(d_data);
+        }
+        throw std::runtime_error("clip_index: " + idx + " is not a clip "
+                                 "index");
+      }
+    }
+
+    clip_index::~clip_index()
+    {
+      unmap();
+      ::close(d_fd);
+      if (d_data != NULL) {
+        fclose(d_data);
+      }
+    }
+
+    void
+    clip_index::unmap()
+    {
+      if (d_map != NULL) {
+        munmap(d_map, d_map_size);
+      }
+      d_map = NULL;
+      d_map_size = 0;
+      d_header = NULL;
+      d_records = NULL;
+      d_count = 0;
+    }
+
+    size_t
+    clip_index::refresh()
+    {
+      struct stat st;
+      if (fstat(d_fd, &st) != 0 || (size_t)st.st_size == d_map_size) {
+        return d_count;
+      }
+
+      unmap();
+      if ((size_t)st.st_size < sizeof(struct clip_index_header)) {
+        return 0;
+      }
+      void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, d_fd, 0);
+      if (map == MAP_FAILED) {
+        return 0;
+      }
+      const struct clip_index_header *h =
+        (const struct clip_index_header *)map;
+      if (memcmp(h->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+          h->record_size != sizeof(struct clip_record)) {
+        munmap(map, st.st_size);
+        return 0;
+      }
+
+      d_map = map;
+      d_map_size = st.st_size;
+      d_header = h;
+      d_records = (const struct clip_record *)(h + 1);
+      d_count = (st.st_size - sizeof(*h)) / sizeof(struct clip_record);
+      return d_count;
+    }
+
+    static inline double
+    end_time(const struct clip_record &r)
+    {
+      return r.start + r.duration;
+    }
+
+    std::vector<size_t>
+    clip_index::find(double begin, double end,
+                     const std::vector<int> &channels) const
+    {
+      std::vector<size_t> found;
+      if (d_header == NULL) {
+        return found;
+      }
+
+      /* First record ending after begin */
+      size_t lo = 0, hi = d_count;
+      while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (end_time(d_records[mid]) + END_SLACK <= begin) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+
+      const double last_end = end + d_header->max_duration + END_SLACK;
+      for (size_t i = lo; i < d_count; i++) {
+        const struct clip_record &r = d_records[i];
+        if (end_time(r) > last_end) {
+          break;
+        }
+        if (r.start >= end || end_time(r) <= begin) {
+          continue;
+        }
+        if (channels.empty() ||
+            std::find(channels.begin(), channels.end(), (int)r.channel) !=
+            channels.end()) {
+          found.push_back(i);
+        }
+      }
+      return found;
+    }
+
+    bool
+    clip_index::audio(size_t i, std::vector<int16_t> &out) const
+    {
+      if (i >= d_count || d_data == NULL) {
+        return false;
+      }
+      const struct clip_record &r = d_records[i];
+      std::vector<uint8_t> coded(adpcm_state::bytes(r.samples));
+
+      if (fseeko(d_data, (off_t)r.offset, SEEK_SET) != 0 ||
+          fread(&coded[0], 1, coded.size(), d_data) != coded.size()) {
+        return false;
+      }
+      out.resize(r.samples);
+      adpcm_state decoder;
+      decoder.decode(&coded[0], r.samples, &out[0]);
+      return true;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
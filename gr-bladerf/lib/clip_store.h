@@ -0,0 +1,173 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_CLIP_STORE_H
+#define INCLUDED_BLADERF_CLIP_STORE_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*
+     * <dir>/clips.idx is this header followed by one clip_record per
+     * transmission, native byte order, appended as each clip ends so
+     * the records are in order of end time. <dir>/clips.adpcm holds the
+     * clips' audio back to back, each coded on its own by adpcm_state.
+     */
+    struct clip_index_header {
+      char magic[8];          /* "FRSCLIP1" */
+      uint32_t record_size;
+      uint32_t reserved;
+      double audio_rate;
+      double max_duration;    /* no clip is longer, which bounds queries */
+    };
+
+    struct clip_record {
+      double start;           /* Unix time of the first sample */
+      float duration;         /* seconds */
+      float rssi_db;          /* mean channel power while open */
+      uint64_t offset;        /* first byte in clips.adpcm */
+      uint32_t samples;       /* audio samples, (samples + 1) / 2 bytes */
+      uint16_t channel;
+      uint16_t ctcss;         /* tone in 0.1 Hz, 0 for none */
+    };
+
+    struct clip_store_config {
+      std::string directory;
+      std::vector<int> channels;  /* channel numbers that may appear */
+      double audio_rate;
+      double start_time;          /* Unix time of receiver time 0 */
+      double max_duration;        /* longer transmissions are split */
+    };
+
+    /*!
+     * \brief Cuts each channel's audio into one clip per transmission.
+     *
+     * Fed the receiver's gated audio and its squelch and CTCSS events,
+     * it keeps each channel's audio while the squelch is open and
+     * writes it out as a clip with an index record when the squelch
+     * closes, the CTCSS tone changes to another one, or the clip
+     * reaches max_duration. Clip data is flushed before its record, so
+     * after a crash every record still points at whole audio. An
+     * existing store is appended to.
+     *
+     * audio() may run on any thread but, like the receiver's callbacks,
+     * never concurrently for one channel nor with the other calls for
+     * it; everything else belongs to one thread. Times are receiver
+     * seconds.
+     */
+    class clip_store
+    {
+     public:
+      clip_store(const struct clip_store_config &config);
+      ~clip_store();
+
+      void audio(int channel, const float *audio, size_t n);
+      void squelch(int channel, double time, bool open, float power_db);
+      void tone(int channel, double time, float tone);
+
+      /* Channel power while open, for the RSSI; also ends clips that
+       * reach max_duration */
+      void level(int channel, double time, float power_db);
+
+      /* End every open clip at time */
+      void close(double time);
+
+      uint64_t clips() const { return d_clips; }
+
+     private:
+      struct channel_state {
+        bool open;
+        double start;
+        float tone;
+        double power_sum;
+        size_t power_count;
+        std::vector<int16_t> pcm;
+      };
+
+      struct clip_store_config d_config;
+      std::vector<int> d_slot;               /* by channel number */
+      std::vector<struct channel_state> d_state;
+      FILE *d_index;
+      FILE *d_data;
+      uint64_t d_offset;
+      uint64_t d_clips;
+
+      struct channel_state *state(int channel);
+      void cut(int channel, double time);
+    };
+
+    /*!
+     * \brief Read-only view of a clip store.
+     *
+     * Maps clips.idx and answers time range queries by binary search
+     * on the records' end times: a clip overlapping [begin, end) must
+     * end after begin and, being at most max_duration long, before
+     * end + max_duration, so only that run of records is looked at.
+     * refresh() picks up records appended since.
+     */
+    class clip_index
+    {
+     public:
+      clip_index(const std::string &directory);
+      ~clip_index();
+
+      /* Remap if the store has grown; returns the record count */
+      size_t refresh();
+
+      size_t size() const { return d_count; }
+      const struct clip_index_header &header() const { return *d_header; }
+      const struct clip_record &operator[](size_t i) const
+      {
+        return d_records[i];
+      }
+
+      /* Records overlapping [begin, end) in Unix time on any of the
+       * channels, all channels if empty, in index order */
+      std::vector<size_t> find(double begin, double end,
+                               const std::vector<int> &channels) const;
+
+      /* Decode record i's audio; false on a read error */
+      bool audio(size_t i, std::vector<int16_t> &out) const;
+
+     private:
+      std::string d_directory;
+      int d_fd;
+      FILE *d_data;
+      void *d_map;
+      size_t d_map_size;
+      const struct clip_index_header *d_header;
+      const struct clip_record *d_records;
+      size_t d_count;
+
+      void unmap();
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_CLIP_STORE_H */
@@ -0,0 +1,215 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <bladerf/core_layout.h>
+#include <algorithm>
+#include <map>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <string.h>
+
+namespace gr {
+  namespace bladerf {
+
+    static int
+    read_int(const char *path, int fallback)
+    {
+      int value = fallback;
+      FILE *f = fopen(path, "r");
+      if (f != NULL) {
+        if (fscanf(f, "%d", &value) != 1) {
+          value = fallback;
+        }
+        fclose(f);
+      }
+      return value;
+    }
+
+    /* The node of a CPU shows up as a nodeN link in its sysfs directory */
+    static int
+    cpu_node(int cpu)
+    {
+      char path[128];
+      int node = 0;
+
+      snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+      DIR *dir = opendir(path);
+      if (dir == NULL) {
+        return 0;
+      }
+      struct dirent *ent;
+      while ((ent = readdir(dir)) != NULL) {
+        if (strncmp(ent->d_name, "node", 4) == 0 &&
+            sscanf(ent->d_name + 4, "%d", &node) == 1) {
+          break;
+        }
+      }
+      closedir(dir);
+      return node;
+    }
+
+    static bool
+    topology_order(const cpu_info &a, const cpu_info &b)
+    {
+      if (a.node != b.node) return a.node < b.node;
+      if (a.package != b.package) return a.package < b.package;
+      if (a.core != b.core) return a.core < b.core;
+      return a.cpu < b.cpu;
+    }
+
+    std::vector<cpu_info>
+    core_layout::probe()
+    {
+      std::vector<cpu_info> cpus;
+      char path[128];
+
+      /* Online CPUs need not be numbered 0..n-1, and a cpuset may leave
+       * this process only some of them; take exactly those it may use */
+      cpu_set_t allowed;
+      CPU_ZERO(&allowed);
+      if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < n && cpu < CPU_SETSIZE; cpu++) {
+          CPU_SET(cpu, &allowed);
+        }
+      }
+
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+          continue;
+        }
+        cpu_info info;
+        info.cpu = cpu;
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        info.core = read_int(path, cpu);
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+                 cpu);
+        info.package = read_int(path, 0);
+        info.node = cpu_node(cpu);
+        cpus.push_back(info);
+      }
+
+      return cpus;
+    }
+
+    core_layout::core_layout(int nchannels)
+      : d_nchannels(nchannels)
+    {
+      plan(probe());
+    }
+
+    core_layout::core_layout(const std::vector<cpu_info> &cpus, int nchannels)
+      : d_nchannels(nchannels)
+    {
+      plan(cpus);
+    }
+
+    void
+    core_layout::plan(const std::vector<cpu_info> &all)
+    {
+      if (all.empty()) {
+        return;
+      }
+
+      /* Stay on the node with the most CPUs */
+      std::map<int, int> per_node;
+      for (size_t i = 0; i < all.size(); i++) {
+        per_node[all[i].node]++;
+      }
+      int node = all[0].node;
+      for (std::map<int, int>::const_iterator it = per_node.begin();
+           it != per_node.end(); ++it) {
+        if (it->second > per_node[node]) {
+          node = it->first;
+        }
+      }
+
+      std::vector<cpu_info> cpus;
+      for (size_t i = 0; i < all.size(); i++) {
+        if (all[i].node == node) {
+          cpus.push_back(all[i]);
+        }
+      }
+      std::sort(cpus.begin(), cpus.end(), topology_order);
+
+      /* First logical CPU of every physical core; the remaining
+       * hyper-threads remember which primary they share a core with */
+      std::vector<int> primary;
+      std::vector<std::pair<int, int> > siblings;
+      for (size_t i = 0; i < cpus.size(); i++) {
+        bool first = (i == 0 || cpus[i].core != cpus[i - 1].core ||
+                      cpus[i].package != cpus[i - 1].package);
+        if (first) {
+          primary.push_back(cpus[i].cpu);
+        } else {
+          siblings.push_back(std::make_pair(cpus[i].cpu, primary.back()));
+        }
+      }
+
+      std::vector<int> usable(primary);
+      if (usable.size() >= 4 && usable[0] == 0) {
+        usable.erase(usable.begin());
+      }
+
+      d_capture.assign(1, usable[0]);
+      if (usable.size() == 1) {
+        d_output = d_capture;
+        d_dsp = d_capture;
+        return;
+      }
+
+      d_output.assign(1, usable[1]);
+      if (usable.size() == 2) {
+        d_dsp = d_output;
+        return;
+      }
+
+      /* Siblings of the capture and output cores stay idle */
+      d_dsp.assign(usable.begin() + 2, usable.end());
+      const size_t nphysical = d_dsp.size();
+      for (size_t i = 0; i < siblings.size(); i++) {
+        if (std::find(d_dsp.begin(), d_dsp.begin() + nphysical,
+                      siblings[i].second) != d_dsp.begin() + nphysical) {
+          d_dsp.push_back(siblings[i].first);
+        }
+      }
+    }
+
+    std::vector<int>
+    core_layout::channel(int ch) const
+    {
+      if (d_dsp.empty() || ch < 0) {
+        return std::vector<int>();
+      }
+      return std::vector<int>(1, d_dsp[ch % d_dsp.size()]);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
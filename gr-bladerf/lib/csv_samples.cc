@@ -0,0 +1,267 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "csv_samples.h"
+#include "worker_pool.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace gr {
+  namespace bladerf {
+
+    /* Text per chunk; a few hundred thousand lines */
+    static const size_t CHUNK_BYTES = 4 << 20;
+
+    static inline bool
+    blank(char c)
+    {
+      return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    const char *
+    parse_csv_line(const char *p, const char *end, size_t columns,
+                   int16_t *out)
+    {
+      for (size_t c = 0; c < columns; c++) {
+        while (p < end && blank(*p)) {
+          p++;
+        }
+        if (c > 0) {
+          if (p == end || *p != ',') {
+            return NULL;
+          }
+          p++;
+          while (p < end && blank(*p)) {
+            p++;
+          }
+        }
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+          negative = *p == '-';
+          p++;
+        }
+        const char *digits = p;
+        int v = 0;
+        while (p < end && (unsigned)(*p - '0') < 10) {
+          v = v * 10 + (*p - '0');
+          if (v > 32768) {
+            return NULL;
+          }
+          p++;
+        }
+        if (p == digits) {
+          return NULL;
+        }
+        v = negative ? -v : v;
+        if (v > 32767) {
+          return NULL;
+        }
+        out[c] = (int16_t)v;
+      }
+
+      while (p < end && blank(*p)) {
+        p++;
+      }
+      if (p == end) {
+        return p;
+      }
+      return *p == '\n' ? p + 1 : NULL;
+    }
+
+    size_t
+    count_newlines(const char *p, const char *end)
+    {
+      size_t n = 0;
+#ifdef __SSE2__
+      const __m128i nl = _mm_set1_epi8('\n');
+      for (; end - p >= 64; p += 64) {
+        const __m128i *v = (const __m128i *)p;
+        uint64_t mask =
+          (uint64_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(v), nl)) |
+          (uint64_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(v + 1), nl)) << 16 |
+          (uint64_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(v + 2), nl)) << 32 |
+          (uint64_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128(v + 3), nl)) << 48;
+        n += __builtin_popcountll(mask);
+      }
+#endif
+      return n + std::count(p, end, '\n');
+    }
+
+    csv_samples::csv_samples(const std::string &path, worker_pool *pool)
+      : d_path(path),
+        d_map(NULL),
+        d_size(0),
+        d_columns(0),
+        d_frames(0)
+    {
+      d_fd = open(path.c_str(), O_RDONLY);
+      if (d_fd < 0) {
+        throw std::runtime_error("csv_samples: unable to open " + path);
+      }
+      struct stat st;
+      if (fstat(d_fd, &st) != 0 || st.st_size == 0) {
+        close(d_fd);
+        throw std::runtime_error("csv_samples: " + path + " is empty");
+      }
+      d_size = st.st_size;
+      d_map = mmap(NULL, d_size, PROT_READ, MAP_PRIVATE, d_fd, 0);
+      if (d_map == MAP_FAILED) {
+        close(d_fd);
+        throw std::runtime_error("csv_samples: unable to map " + path);
+      }
+      madvise(d_map, d_size, MADV_SEQUENTIAL);
+
+      const char *begin = (const char *)d_map;
+      const char *end = begin + d_size;
+      while (end > begin && (blank(end[-1]) || end[-1] == '\n')) {
+        end--;
+      }
+
+      /* The first line decides the layout */
+      const char *eol = (const char *)memchr(begin, '\n', end - begin);
+      d_columns = std::count(begin, eol ? eol : end, ',') + 1;
+      if (end == begin || (d_columns != 2 && d_columns != 4)) {
+        munmap(d_map, d_size);
+        close(d_fd);
+        throw std::runtime_error("csv_samples: " + path +
+                                 " does not hold one or two channels "
+                                 "of I, Q");
+      }
+
+      for (const char *p = begin; p < end; ) {
+        struct chunk c;
+        c.begin = p;
+        c.end = end;
+        if ((size_t)(end - p) > CHUNK_BYTES) {
+          const char *nl = (const char *)memchr(p + CHUNK_BYTES, '\n',
+                                                end - p - CHUNK_BYTES);
+          if (nl != NULL) {
+            c.end = nl + 1;
+          }
+        }
+        c.start = 0;
+        c.frames = 0;
+        d_chunks.push_back(c);
+        p = c.end;
+      }
+
+      if (pool != NULL) {
+        pool->run(d_chunks.size(),
+                  boost::bind(&csv_samples::count_chunk, this, _1));
+      } else {
+        for (size_t i = 0; i < d_chunks.size(); i++) {
+          count_chunk(i);
+        }
+      }
+      for (size_t i = 0; i < d_chunks.size(); i++) {
+        d_chunks[i].start = d_frames;
+        d_frames += d_chunks[i].frames;
+      }
+    }
+
+    csv_samples::~csv_samples()
+    {
+      munmap(d_map, d_size);
+      close(d_fd);
+    }
+
+    void
+    csv_samples::count_chunk(size_t i)
+    {
+      struct chunk &c = d_chunks[i];
+      /* Every chunk but the last ends in a newline, the last one in
+       * the last value */
+      c.frames = count_newlines(c.begin, c.end) + (c.end[-1] != '\n');
+    }
+
+    void
+    csv_samples::read_chunk(size_t i, int16_t *out) const
+    {
+      const struct chunk &c = d_chunks[i];
+      const char *p = c.begin;
+      for (size_t k = 0; k < c.frames; k++) {
+        p = parse_csv_line(p, c.end, d_columns, out + k * d_columns);
+        if (p == NULL) {
+          char line[32];
+          snprintf(line, sizeof(line), "%llu",
+                   (unsigned long long)(c.start + k + 1));
+          throw std::runtime_error("csv_samples: " + d_path + " line " +
+                                   line + " is not " +
+                                   (d_columns == 2 ? "I, Q"
+                                                   : "I1, Q1, I2, Q2"));
+        }
+      }
+    }
+
+    void
+    csv_samples::read_task(int16_t *out, std::vector<std::string> *errors,
+                           size_t i) const
+    {
+      try {
+        read_chunk(i, out + d_chunks[i].start * d_columns);
+      } catch (const std::exception &e) {
+        (*errors)[i] = e.what();
+      }
+    }
+
+    void
+    csv_samples::read(int16_t *out, worker_pool *pool) const
+    {
+      std::vector<std::string> errors(d_chunks.size());
+      if (pool != NULL) {
+        pool->run(d_chunks.size(),
+                  boost::bind(&csv_samples::read_task, this, out, &errors,
+                              _1));
+      } else {
+        for (size_t i = 0; i < d_chunks.size(); i++) {
+          read_task(out, &errors, i);
+        }
+      }
+      for (size_t i = 0; i < errors.size(); i++) {
+        if (!errors[i].empty()) {
+          throw std::runtime_error(errors[i]);
+        }
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
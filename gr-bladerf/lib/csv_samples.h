@@ -0,0 +1,101 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_CSV_SAMPLES_H
+#define INCLUDED_BLADERF_CSV_SAMPLES_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace bladerf {
+
+    class worker_pool;
+
+    /* Parse one CSV line of exactly columns integers in the int16 range
+     * starting at p, separated by commas and blanks; returns the start
+     * of the next line, or NULL if the line is malformed */
+    const char *parse_csv_line(const char *p, const char *end,
+                               size_t columns, int16_t *out);
+
+    /* Number of '\n' in [p, end) */
+    size_t count_newlines(const char *p, const char *end);
+
+    /*!
+     * \brief Samples saved by bladeRF-cli with format=csv.
+     *
+     * One line per frame, "I, Q" for one channel and "I1, Q1, I2, Q2"
+     * for two. The file is mapped and cut at line boundaries into
+     * chunks of a few megabytes whose lines are counted up front, on a
+     * worker_pool when given one, so every chunk knows where its frames
+     * go and chunks can be parsed independently and in any order.
+     */
+    class csv_samples
+    {
+     public:
+      csv_samples(const std::string &path, worker_pool *pool = NULL);
+      ~csv_samples();
+
+      /* Values per line, 2 or 4, and the channels they make */
+      size_t columns() const { return d_columns; }
+      size_t nchan() const { return d_columns / 2; }
+      uint64_t frames() const { return d_frames; }
+      size_t file_size() const { return d_size; }
+
+      size_t chunks() const { return d_chunks.size(); }
+      uint64_t chunk_start(size_t i) const { return d_chunks[i].start; }
+      size_t chunk_frames(size_t i) const { return d_chunks[i].frames; }
+
+      /* Parse chunk i into chunk_frames(i) frames at out; throws
+       * std::runtime_error naming the first bad line */
+      void read_chunk(size_t i, int16_t *out) const;
+
+      /* Parse the whole file into frames() frames at out */
+      void read(int16_t *out, worker_pool *pool = NULL) const;
+
+     private:
+      struct chunk {
+        const char *begin;
+        const char *end;
+        uint64_t start;         /* first frame, which is line start + 1 */
+        size_t frames;
+      };
+
+      std::string d_path;
+      int d_fd;
+      void *d_map;
+      size_t d_size;
+      size_t d_columns;
+      uint64_t d_frames;
+      std::vector<struct chunk> d_chunks;
+
+      void count_chunk(size_t i);
+      void read_task(int16_t *out, std::vector<std::string> *errors,
+                     size_t i) const;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_CSV_SAMPLES_H */
@@ -0,0 +1,161 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdexcept>
+#include <math.h>
+#include <string.h>
+#include "ctcss_detector.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const double DECIMATED_RATE = 1000;
+    static const double LOWPASS_HZ = 300;
+
+    const double ctcss_detector::WINDOW_SECONDS = 0.4;
+
+    const std::vector<float> &
+    ctcss_tones()
+    {
+      static const float tones[38] = {
+        67.0f, 71.9f, 74.4f, 77.0f, 79.7f, 82.5f, 85.4f, 88.5f, 91.5f,
+        94.8f, 97.4f, 100.0f, 103.5f, 107.2f, 110.9f, 114.8f, 118.8f,
+        123.0f, 127.3f, 131.8f, 136.5f, 141.3f, 146.2f, 151.4f, 156.7f,
+        162.2f, 167.9f, 173.8f, 179.9f, 186.2f, 192.8f, 203.5f, 210.7f,
+        218.1f, 225.7f, 233.6f, 241.8f, 250.3f
+      };
+      static const std::vector<float> table(tones, tones + 38);
+      return table;
+    }
+
+    ctcss_detector::ctcss_detector(double audio_rate, float min_fraction)
+      : d_min_fraction(min_fraction)
+    {
+      d_decim = (unsigned int)floor(audio_rate / DECIMATED_RATE);
+      if (d_decim < 1) {
+        throw std::invalid_argument("ctcss_detector: audio rate below "
+                                    "1 kHz");
+      }
+      const double rate = audio_rate / d_decim;
+      d_window = (size_t)(WINDOW_SECONDS * rate);
+
+      /* Fourth order Butterworth as two bilinear biquads with Q of
+       * 0.541 and 1.307 */
+      static const double q[2] = { 0.5411961, 1.3065630 };
+      const double w = 2 * M_PI * LOWPASS_HZ / audio_rate;
+      for (int s = 0; s < 2; s++) {
+        double alpha = sin(w) / (2 * q[s]);
+        double a0 = 1 + alpha;
+        d_b[s][0] = (1 - cos(w)) / 2 / a0;
+        d_b[s][1] = (1 - cos(w)) / a0;
+        d_b[s][2] = d_b[s][0];
+        d_a[s][0] = 1;
+        d_a[s][1] = -2 * cos(w) / a0;
+        d_a[s][2] = (1 - alpha) / a0;
+      }
+
+      const std::vector<float> &tones = ctcss_tones();
+      for (size_t i = 0; i < tones.size(); i++) {
+        d_coeff.push_back((float)(2 * cos(2 * M_PI * tones[i] / rate)));
+      }
+      d_buf.reserve(d_window);
+      reset();
+    }
+
+    void
+    ctcss_detector::reset()
+    {
+      memset(d_z, 0, sizeof(d_z));
+      d_phase = 0;
+      d_acc = 0;
+      d_buf.clear();
+      d_tone = 0;
+    }
+
+    void
+    ctcss_detector::process(const float *audio, size_t n,
+                            std::vector<struct ctcss_event> &events)
+    {
+      for (size_t i = 0; i < n; i++) {
+        /* Transposed direct form II */
+        double x = audio[i];
+        for (int s = 0; s < 2; s++) {
+          double y = d_b[s][0] * x + d_z[s][0];
+          d_z[s][0] = d_b[s][1] * x - d_a[s][1] * y + d_z[s][1];
+          d_z[s][1] = d_b[s][2] * x - d_a[s][2] * y;
+          x = y;
+        }
+        d_acc += (float)x;
+        if (++d_phase < d_decim) {
+          continue;
+        }
+        d_buf.push_back(d_acc / d_decim);
+        d_phase = 0;
+        d_acc = 0;
+        if (d_buf.size() < d_window) {
+          continue;
+        }
+
+        /* Goertzel per tone: |X|^2 of a pure tone is energy * N / 2, so
+         * that ratio is the fraction of power in the tone */
+        float energy = 0;
+        for (size_t k = 0; k < d_window; k++) {
+          energy += d_buf[k] * d_buf[k];
+        }
+        float best = 0;
+        size_t best_tone = 0;
+        for (size_t t = 0; t < d_coeff.size(); t++) {
+          const float c = d_coeff[t];
+          float s1 = 0, s2 = 0;
+          for (size_t k = 0; k < d_window; k++) {
+            float s0 = d_buf[k] + c * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+          }
+          float power = s1 * s1 + s2 * s2 - c * s1 * s2;
+          if (power > best) {
+            best = power;
+            best_tone = t;
+          }
+        }
+        d_buf.clear();
+
+        float tone = 0;
+        if (energy > 0 && 2 * best / (d_window * energy) > d_min_fraction) {
+          tone = ctcss_tones()[best_tone];
+        }
+        if (tone != d_tone) {
+          struct ctcss_event e;
+          e.index = i;
+          e.tone = tone;
+          events.push_back(e);
+          d_tone = tone;
+        }
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
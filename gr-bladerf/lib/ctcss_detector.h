@@ -0,0 +1,86 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_CTCSS_DETECTOR_H
+#define INCLUDED_BLADERF_CTCSS_DETECTOR_H
+
+#include <vector>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    struct ctcss_event {
+      size_t index;      /* audio sample where the decision changed */
+      float tone;        /* Hz, 0 when none is present */
+    };
+
+    /* The 38 EIA tones, which are also FRS/GMRS privacy codes 1-38 */
+    const std::vector<float> &ctcss_tones();
+
+    /*!
+     * \brief Finds the CTCSS tone under demodulated FM audio.
+     *
+     * The audio is low passed below 300 Hz and decimated to about
+     * 1 kHz, then each window of WINDOW_SECONDS runs one Goertzel filter
+     * per standard tone. The strongest tone is reported when it holds
+     * more than min_fraction of the window's low band power, which
+     * keeps voice and noise from being taken for a tone. Feed it the
+     * audio before the squelch's CTCSS high pass.
+     */
+    class ctcss_detector
+    {
+     public:
+      static const double WINDOW_SECONDS;
+
+      ctcss_detector(double audio_rate, float min_fraction = 0.5f);
+
+      /* Append a ctcss_event to events whenever a window's decision
+       * differs from the last one */
+      void process(const float *audio, size_t n,
+                   std::vector<struct ctcss_event> &events);
+
+      /* Forget the tone and filter state, e.g. when the squelch closes */
+      void reset();
+
+      float tone() const { return d_tone; }
+
+     private:
+      unsigned int d_decim;
+      size_t d_window;
+      float d_min_fraction;
+
+      /* Two cascaded biquads; b and a per section, a0 = 1 */
+      double d_b[2][3], d_a[2][3];
+      double d_z[2][2];
+
+      unsigned int d_phase;
+      float d_acc;
+      std::vector<float> d_buf;   /* decimated samples of this window */
+      std::vector<float> d_coeff; /* 2 cos(w) per tone */
+      float d_tone;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_CTCSS_DETECTOR_H */
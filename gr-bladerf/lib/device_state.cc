@@ -0,0 +1,447 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include "device_state.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const bladerf_correction CORRECTIONS[NUM_CORRECTIONS] = {
+      BLADERF_CORR_DCOFF_I,
+      BLADERF_CORR_DCOFF_Q,
+      BLADERF_CORR_PHASE,
+      BLADERF_CORR_GAIN
+    };
+
+    /* Quick-tune entries are stored as raw bytes; their layout differs
+     * between bladeRF 1 and 2, and profiles are tied to one serial. */
+    static std::string
+    to_hex(const void *data, size_t len)
+    {
+      const unsigned char *p = (const unsigned char *)data;
+      std::string s;
+      char b[3];
+      for (size_t i = 0; i < len; i++) {
+        snprintf(b, sizeof(b), "%02x", p[i]);
+        s += b;
+      }
+      return s;
+    }
+
+    static bool
+    from_hex(const std::string &s, void *data, size_t len)
+    {
+      unsigned char *p = (unsigned char *)data;
+      if (s.size() != 2 * len) {
+        return false;
+      }
+      for (size_t i = 0; i < len; i++) {
+        unsigned int v;
+        if (sscanf(s.c_str() + 2 * i, "%2x", &v) != 1) {
+          return false;
+        }
+        p[i] = (unsigned char)v;
+      }
+      return true;
+    }
+
+    int
+    save_profile(const std::string &path, const struct device_profile &p)
+    {
+      std::ofstream f(path.c_str());
+      if (!f) {
+        fprintf(stderr, "Unable to write profile %s\n", path.c_str());
+        return BLADERF_ERR_IO;
+      }
+
+      f << "# bladeRF device profile\n";
+      f << "serial " << p.serial << "\n";
+
+      std::map<bladerf_channel, struct channel_state>::const_iterator it;
+      for (it = p.channels.begin(); it != p.channels.end(); ++it) {
+        const struct channel_state &s = it->second;
+        f << "channel " << it->first << " " << s.config.frequency << " "
+          << s.config.bandwidth << " " << s.config.samplerate << " "
+          << s.config.gain << " " << s.actual.frequency << " "
+          << s.actual.bandwidth << " " << s.actual.samplerate << " "
+          << s.actual.gain << "\n";
+        f << "correction " << it->first;
+        for (int i = 0; i < NUM_CORRECTIONS; i++) {
+          f << " " << s.corrections[i];
+        }
+        f << "\n";
+        for (size_t i = 0; i < s.quick_tunes.size(); i++) {
+          f << "quick_tune " << it->first << " "
+            << s.quick_tunes[i].frequency << " "
+            << to_hex(&s.quick_tunes[i].qt, sizeof(struct bladerf_quick_tune))
+            << "\n";
+        }
+      }
+
+      return f.good() ? 0 : BLADERF_ERR_IO;
+    }
+
+    int
+    load_profile(const std::string &path, struct device_profile &p)
+    {
+      std::ifstream f(path.c_str());
+      std::string line;
+      unsigned int lineno = 0;
+
+      if (!f) {
+        return BLADERF_ERR_NO_FILE;
+      }
+
+      p.serial.clear();
+      p.channels.clear();
+
+      while (std::getline(f, line)) {
+        std::istringstream in(line);
+        std::string key;
+        int ch;
+        bool ok = true;
+
+        lineno++;
+        if (!(in >> key) || key[0] == '#') {
+          continue;
+        }
+
+        if (key == "serial") {
+          ok = (bool)(in >> p.serial);
+        } else if (key == "channel") {
+          ok = (bool)(in >> ch);
+          if (ok) {
+            struct channel_state &c = p.channels[ch];
+            c.config.channel = ch;
+            ok = (bool)(in >> c.config.frequency >> c.config.bandwidth
+                           >> c.config.samplerate >> c.config.gain);
+            /* Older profiles have no read-backs; taking the requests for
+             * them only ever skips settings the hardware has exactly */
+            c.actual.channel = ch;
+            if (ok && !(in >> c.actual.frequency >> c.actual.bandwidth
+                           >> c.actual.samplerate >> c.actual.gain)) {
+              c.actual = c.config;
+            }
+          }
+        } else if (key == "correction") {
+          ok = (bool)(in >> ch);
+          for (int i = 0; ok && i < NUM_CORRECTIONS; i++) {
+            ok = (bool)(in >> p.channels[ch].corrections[i]);
+          }
+        } else if (key == "quick_tune") {
+          struct quick_tune_entry e;
+          std::string hex;
+          ok = (bool)(in >> ch >> e.frequency >> hex) &&
+               from_hex(hex, &e.qt, sizeof(e.qt));
+          if (ok) {
+            p.channels[ch].quick_tunes.push_back(e);
+          }
+        }
+
+        if (!ok) {
+          fprintf(stderr, "%s:%u: malformed %s entry\n", path.c_str(),
+                  lineno, key.c_str());
+          return BLADERF_ERR_INVAL;
+        }
+      }
+
+      return 0;
+    }
+
+    device_state::device_state(struct bladerf *dev)
+      : d_dev(dev),
+        d_applied(0),
+        d_skipped(0)
+    {
+    }
+
+    int
+    device_state::read_channel(bladerf_channel ch, struct channel_state &s)
+    {
+      int status;
+      bladerf_frequency frequency;
+      bladerf_bandwidth bandwidth;
+      bladerf_sample_rate samplerate;
+      int gain;
+
+      status = bladerf_get_frequency(d_dev, ch, &frequency);
+      if (status == 0) {
+        status = bladerf_get_bandwidth(d_dev, ch, &bandwidth);
+      }
+      if (status == 0) {
+        status = bladerf_get_sample_rate(d_dev, ch, &samplerate);
+      }
+      if (status == 0) {
+        status = bladerf_get_gain(d_dev, ch, &gain);
+      }
+      if (status != 0) {
+        fprintf(stderr, "Failed to read back channel %d: %s\n", ch,
+                bladerf_strerror(status));
+        return status;
+      }
+
+      s.actual.channel    = ch;
+      s.actual.frequency  = (unsigned int)frequency;
+      s.actual.bandwidth  = bandwidth;
+      s.actual.samplerate = samplerate;
+      s.actual.gain       = gain;
+
+      /* Whatever was asked for is unknown; a request for exactly what
+       * the hardware has is met already */
+      s.config = s.actual;
+
+      /* Not every board has every correction; leave those at zero */
+      for (int i = 0; i < NUM_CORRECTIONS; i++) {
+        if (bladerf_get_correction(d_dev, ch, CORRECTIONS[i],
+                                   &s.corrections[i]) != 0) {
+          s.corrections[i] = 0;
+        }
+      }
+      return 0;
+    }
+
+    struct channel_state *
+    device_state::cached(bladerf_channel ch)
+    {
+      std::map<bladerf_channel, struct channel_state>::iterator it =
+        d_channels.find(ch);
+      if (it != d_channels.end()) {
+        return &it->second;
+      }
+
+      struct channel_state s;
+      if (read_channel(ch, s) != 0) {
+        return NULL;
+      }
+      return &(d_channels[ch] = s);
+    }
+
+    int
+    device_state::tune(bladerf_channel ch, struct channel_state &s,
+                       bladerf_frequency frequency)
+    {
+      int status;
+
+      for (size_t i = 0; i < s.quick_tunes.size(); i++) {
+        if (s.quick_tunes[i].frequency == frequency) {
+          status = bladerf_schedule_retune(d_dev, ch, BLADERF_RETUNE_NOW,
+                                           frequency, &s.quick_tunes[i].qt);
+          if (status == 0) {
+            return 0;
+          }
+          /* A stale entry is dropped and the slow path used instead */
+          s.quick_tunes.erase(s.quick_tunes.begin() + i);
+          break;
+        }
+      }
+
+      status = bladerf_set_frequency(d_dev, ch, frequency);
+      if (status != 0) {
+        fprintf(stderr, "Failed to set frequency = %llu: %s\n",
+                (unsigned long long)frequency, bladerf_strerror(status));
+        return status;
+      }
+
+      struct quick_tune_entry e;
+      e.frequency = frequency;
+      if (bladerf_get_quick_tune(d_dev, ch, &e.qt) == 0) {
+        s.quick_tunes.push_back(e);
+      }
+      return 0;
+    }
+
+    int
+    device_state::apply(const struct channel_config *c)
+    {
+      int status;
+      struct channel_state *s = cached(c->channel);
+
+      if (s == NULL) {
+        /* No read-back; fall back to setting everything */
+        d_applied += 4;
+        return configure_channel(d_dev, c);
+      }
+
+      /* Each setting is compared as requested, never against its
+       * rounded read-back; the read-back is kept for restore() */
+      if (s->config.frequency != c->frequency) {
+        status = tune(c->channel, *s, c->frequency);
+        if (status != 0) {
+          return status;
+        }
+        bladerf_frequency frequency;
+        s->config.frequency = c->frequency;
+        s->actual.frequency =
+          bladerf_get_frequency(d_dev, c->channel, &frequency) == 0
+          ? (unsigned int)frequency : c->frequency;
+        d_applied++;
+      } else {
+        d_skipped++;
+      }
+
+      if (s->config.samplerate != c->samplerate) {
+        bladerf_sample_rate actual;
+        status = bladerf_set_sample_rate(d_dev, c->channel, c->samplerate,
+                                         &actual);
+        if (status != 0) {
+          fprintf(stderr, "Failed to set samplerate = %u: %s\n",
+                  c->samplerate, bladerf_strerror(status));
+          return status;
+        }
+        s->config.samplerate = c->samplerate;
+        s->actual.samplerate = actual;
+        d_applied++;
+      } else {
+        d_skipped++;
+      }
+
+      if (s->config.bandwidth != c->bandwidth) {
+        bladerf_bandwidth actual;
+        status = bladerf_set_bandwidth(d_dev, c->channel, c->bandwidth,
+                                       &actual);
+        if (status != 0) {
+          fprintf(stderr, "Failed to set bandwidth = %u: %s\n",
+                  c->bandwidth, bladerf_strerror(status));
+          return status;
+        }
+        s->config.bandwidth = c->bandwidth;
+        s->actual.bandwidth = actual;
+        d_applied++;
+      } else {
+        d_skipped++;
+      }
+
+      if (s->config.gain != c->gain) {
+        int gain;
+        status = bladerf_set_gain(d_dev, c->channel, c->gain);
+        if (status != 0) {
+          fprintf(stderr, "Failed to set gain: %s\n",
+                  bladerf_strerror(status));
+          return status;
+        }
+        s->config.gain = c->gain;
+        s->actual.gain = bladerf_get_gain(d_dev, c->channel, &gain) == 0
+                         ? gain : c->gain;
+        d_applied++;
+      } else {
+        d_skipped++;
+      }
+
+      return 0;
+    }
+
+    int
+    device_state::snapshot(struct device_profile &p)
+    {
+      char serial[BLADERF_SERIAL_LENGTH];
+      int status;
+
+      if (bladerf_get_serial(d_dev, serial) == 0) {
+        p.serial = serial;
+      }
+
+      std::map<bladerf_channel, struct channel_state>::iterator it;
+      for (it = d_channels.begin(); it != d_channels.end(); ++it) {
+        struct channel_state s;
+        status = read_channel(it->first, s);
+        if (status != 0) {
+          return status;
+        }
+        /* What was asked for gets restored, and what it read back as
+         * tells restore() whether the hardware still has it */
+        s.config = it->second.config;
+        s.actual = it->second.actual;
+        s.quick_tunes = it->second.quick_tunes;
+        p.channels[it->first] = s;
+      }
+      return 0;
+    }
+
+    int
+    device_state::restore(const struct device_profile &p)
+    {
+      char serial[BLADERF_SERIAL_LENGTH];
+      int status;
+
+      if (!p.serial.empty() && bladerf_get_serial(d_dev, serial) == 0 &&
+          p.serial != serial) {
+        fprintf(stderr, "Profile is for device %s, not %s; ignoring it\n",
+                p.serial.c_str(), serial);
+        return BLADERF_ERR_INVAL;
+      }
+
+      std::map<bladerf_channel, struct channel_state>::const_iterator it;
+      for (it = p.channels.begin(); it != p.channels.end(); ++it) {
+        const struct channel_state &saved = it->second;
+        struct channel_state *s = cached(it->first);
+        if (s != NULL) {
+          s->quick_tunes = saved.quick_tunes;
+          /* Where the hardware reads back what the saved request did,
+           * that request is in place already */
+          if (s->actual.frequency == saved.actual.frequency) {
+            s->config.frequency = saved.config.frequency;
+          }
+          if (s->actual.samplerate == saved.actual.samplerate) {
+            s->config.samplerate = saved.config.samplerate;
+          }
+          if (s->actual.bandwidth == saved.actual.bandwidth) {
+            s->config.bandwidth = saved.config.bandwidth;
+          }
+          if (s->actual.gain == saved.actual.gain) {
+            s->config.gain = saved.config.gain;
+          }
+        }
+
+        status = apply(&it->second.config);
+        if (status != 0) {
+          return status;
+        }
+
+        for (int i = 0; s != NULL && i < NUM_CORRECTIONS; i++) {
+          if (s->corrections[i] == it->second.corrections[i]) {
+            d_skipped++;
+            continue;
+          }
+          status = bladerf_set_correction(d_dev, it->first, CORRECTIONS[i],
+                                          it->second.corrections[i]);
+          if (status != 0) {
+            fprintf(stderr, "Failed to restore correction %d on channel "
+                    "%d: %s\n", i, it->first, bladerf_strerror(status));
+            return status;
+          }
+          s->corrections[i] = it->second.corrections[i];
+          d_applied++;
+        }
+      }
+      return 0;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
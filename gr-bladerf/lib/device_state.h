@@ -0,0 +1,113 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_DEVICE_STATE_H
+#define INCLUDED_BLADERF_DEVICE_STATE_H
+
+#include <libbladeRF.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "device_utils.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Number of bladerf_correction values kept per channel */
+    static const int NUM_CORRECTIONS = 4;
+
+    /* A quick-tune snapshot taken right after tuning to frequency */
+    struct quick_tune_entry {
+      bladerf_frequency frequency;
+      struct bladerf_quick_tune qt;
+    };
+
+    /* Hardware rounds frequency, rate, bandwidth and gain, so what was
+     * asked for is kept next to what it read back as */
+    struct channel_state {
+      struct channel_config config;   /* requested */
+      struct channel_config actual;   /* read back with config in place */
+      bladerf_correction_value corrections[NUM_CORRECTIONS];
+      std::vector<struct quick_tune_entry> quick_tunes;
+    };
+
+    /* Everything needed to bring a device back to a known configuration */
+    struct device_profile {
+      std::string serial;
+      std::map<bladerf_channel, struct channel_state> channels;
+    };
+
+    /* Write or read a profile as text; return 0 or a libbladeRF status */
+    int save_profile(const std::string &path, const struct device_profile &p);
+    int load_profile(const std::string &path, struct device_profile &p);
+
+    /*!
+     * \brief Cached view of a device's RF configuration.
+     *
+     * Each channel is read back from the hardware the first time it is
+     * touched. After that apply() only issues the libbladeRF calls for
+     * settings whose request differs from the one last made, so
+     * reopening a flowgraph on a device that is already configured
+     * costs a handful of reads instead of a full retune. A cold cache
+     * knows no requests, only read-backs; restore() fills them in from
+     * a profile wherever the hardware still reads back what it recorded
+     * for them. Frequencies that have been tuned once are kept as
+     * quick-tune entries and revisited with bladerf_schedule_retune(),
+     * which skips the PLL search.
+     */
+    class device_state
+    {
+     public:
+      device_state(struct bladerf *dev);
+
+      /* Bring a channel to config, touching only what changed */
+      int apply(const struct channel_config *config);
+
+      /* Read back every channel in the profile, calibration included */
+      int snapshot(struct device_profile &p);
+
+      /* Apply a saved profile; its quick-tune tables seed the cache */
+      int restore(const struct device_profile &p);
+
+      /* Forget the cache, e.g. after something else touched the device */
+      void invalidate() { d_channels.clear(); }
+
+      /* Settings written to / skipped because they already matched */
+      unsigned int applied() const { return d_applied; }
+      unsigned int skipped() const { return d_skipped; }
+
+     private:
+      struct bladerf *d_dev;
+      std::map<bladerf_channel, struct channel_state> d_channels;
+      unsigned int d_applied;
+      unsigned int d_skipped;
+
+      int read_channel(bladerf_channel ch, struct channel_state &s);
+      struct channel_state *cached(bladerf_channel ch);
+      int tune(bladerf_channel ch, struct channel_state &s,
+               bladerf_frequency frequency);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_DEVICE_STATE_H */
@@ -0,0 +1,191 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "device_utils.h"
+
+namespace gr {
+  namespace bladerf {
+
+    const struct stream_config default_stream_config = {
+      16,    /* num_buffers */
+      4096,  /* buffer_size */
+      8,     /* num_transfers */
+      3500   /* timeout_ms */
+    };
+
+    int
+    open_device(struct bladerf **dev, const std::string &serial)
+    {
+      int status;
+      struct bladerf_devinfo dev_info;
+
+      /* Initialize the information used to identify the desired device
+       * to all wildcard (i.e., "any device") values */
+      bladerf_init_devinfo(&dev_info);
+
+      /* Request a device with the provided serial number.
+       * Invalid strings should simply fail to match a device. */
+      if (!serial.empty()) {
+        strncpy(dev_info.serial, serial.c_str(), sizeof(dev_info.serial) - 1);
+      }
+
+      status = bladerf_open_with_devinfo(dev, &dev_info);
+      if (status != 0) {
+        fprintf(stderr, "Unable to open device %s: %s\n",
+                serial.empty() ? "(any)" : serial.c_str(),
+                bladerf_strerror(status));
+      }
+      return status;
+    }
+
+    int
+    configure_channel(struct bladerf *dev, const struct channel_config *c)
+    {
+      int status;
+      status = bladerf_set_frequency(dev, c->channel, c->frequency);
+      if (status != 0) {
+        fprintf(stderr, "Failed to set frequency = %u: %s\n", c->frequency,
+                bladerf_strerror(status));
+        return status;
+      }
+      status = bladerf_set_sample_rate(dev, c->channel, c->samplerate, NULL);
+      if (status != 0) {
+        fprintf(stderr, "Failed to set samplerate = %u: %s\n", c->samplerate,
+                bladerf_strerror(status));
+        return status;
+      }
+      status = bladerf_set_bandwidth(dev, c->channel, c->bandwidth, NULL);
+      if (status != 0) {
+        fprintf(stderr, "Failed to set bandwidth = %u: %s\n", c->bandwidth,
+                bladerf_strerror(status));
+        return status;
+      }
+      status = bladerf_set_gain(dev, c->channel, c->gain);
+      if (status != 0) {
+        fprintf(stderr, "Failed to set gain: %s\n", bladerf_strerror(status));
+        return status;
+      }
+      return status;
+    }
+
+    int
+    init_sync(struct bladerf *dev, bladerf_channel_layout layout,
+              bladerf_format format, const struct stream_config *s)
+    {
+      int status;
+      /* It is important to remember that TX buffers will not be submitted to
+       * the hardware until `buffer_size` samples are provided via the
+       * bladerf_sync_tx call.  Similarly, samples will not be available to
+       * RX via bladerf_sync_rx() until a block of `buffer_size` samples has
+       * been received. */
+      status = bladerf_sync_config(dev, layout, format, s->num_buffers,
+                                   s->buffer_size, s->num_transfers,
+                                   s->timeout_ms);
+      if (status != 0) {
+        fprintf(stderr, "Failed to configure sync interface: %s\n",
+                bladerf_strerror(status));
+      }
+      return status;
+    }
+
+    int
+    enable_rx_channels(struct bladerf *dev, unsigned int nchan, bool enable)
+    {
+      int ret = 0;
+      for (unsigned int ch = 0; ch < nchan; ch++) {
+        int status = bladerf_enable_module(dev, BLADERF_CHANNEL_RX(ch),
+                                           enable);
+        if (status != 0) {
+          fprintf(stderr, "Failed to %s RX%u: %s\n",
+                  enable ? "enable" : "disable", ch, bladerf_strerror(status));
+          if (enable) {
+            return status;
+          }
+          if (ret == 0) {
+            ret = status;
+          }
+        }
+      }
+      return ret;
+    }
+
+    int
+    plan_rx_stream(int channel_mask, struct rx_stream_plan *plan)
+    {
+      if (channel_mask < 0x1 || channel_mask > 0x3) {
+        return BLADERF_ERR_INVAL;
+      }
+      plan->channels.clear();
+      for (int ch = 0; ch < 2; ch++) {
+        if (channel_mask & (1 << ch)) {
+          plan->channels.push_back(BLADERF_CHANNEL_RX(ch));
+        }
+      }
+      plan->layout = plan->channels.size() > 1 ? BLADERF_RX_X2
+                                               : BLADERF_RX_X1;
+      return 0;
+    }
+
+    int
+    enable_rx_stream(struct bladerf *dev, const struct rx_stream_plan &plan,
+                     bool enable)
+    {
+      int ret = 0;
+      for (size_t i = 0; i < plan.channels.size(); i++) {
+        int status = bladerf_enable_module(dev, plan.channels[i], enable);
+        if (status != 0) {
+          fprintf(stderr, "Failed to %s RX%d: %s\n",
+                  enable ? "enable" : "disable", plan.channels[i] >> 1,
+                  bladerf_strerror(status));
+          if (enable) {
+            return status;
+          }
+          if (ret == 0) {
+            ret = status;
+          }
+        }
+      }
+      return ret;
+    }
+
+    int
+    enable_tx_channels(struct bladerf *dev, unsigned int nchan, bool enable)
+    {
+      int status = 0;
+      for (unsigned int ch = 0; ch < nchan; ch++) {
+        status = bladerf_enable_module(dev, BLADERF_CHANNEL_TX(ch), enable);
+        if (status != 0) {
+          fprintf(stderr, "Failed to %s TX%u: %s\n",
+                  enable ? "enable" : "disable", ch, bladerf_strerror(status));
+          return status;
+        }
+      }
+      return status;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,90 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_BLADERF_DEVICE_UTILS_H
+#define INCLUDED_BLADERF_DEVICE_UTILS_H
+
+#include <libbladeRF.h>
+#include <string>
+#include <vector>
+
+namespace gr {
+  namespace bladerf {
+
+    /* The RX and TX channels are configured independently for these parameters */
+    struct channel_config {
+      bladerf_channel channel;
+      unsigned int frequency;
+      unsigned int bandwidth;
+      unsigned int samplerate;
+      int gain;
+    };
+
+    /* These items configure the underlying asynch stream used by the sync
+     * interface. The "buffer" here refers to those used internally by worker
+     * threads, not the user's sample buffers. */
+    struct stream_config {
+      unsigned int num_buffers;
+      unsigned int buffer_size; /* Must be a multiple of 1024 */
+      unsigned int num_transfers;
+      unsigned int timeout_ms;
+    };
+
+    /* Defaults used by the RX blocks of this module */
+    extern const struct stream_config default_stream_config;
+
+    /* Open a device by serial number (or any device when serial is empty) */
+    int open_device(struct bladerf **dev, const std::string &serial);
+
+    int configure_channel(struct bladerf *dev, const struct channel_config *c);
+
+    int init_sync(struct bladerf *dev, bladerf_channel_layout layout,
+                  bladerf_format format, const struct stream_config *s);
+
+    /* How a mask of RX channels (bit n for RX n) is streamed: any one
+     * channel alone with the X1 layout, both with X2 */
+    struct rx_stream_plan {
+      bladerf_channel_layout layout;
+      std::vector<bladerf_channel> channels;  /* in stream order */
+    };
+
+    /* Fill plan for mask; BLADERF_ERR_INVAL unless it is 0x1, 0x2 or 0x3 */
+    int plan_rx_stream(int channel_mask, struct rx_stream_plan *plan);
+
+    /* Enable or disable just the channels of a plan, with the same
+     * failure handling as enable_rx_channels() */
+    int enable_rx_stream(struct bladerf *dev,
+                         const struct rx_stream_plan &plan, bool enable);
+
+    /* Enable or disable the first nchan RX channels of a device.
+     * Enabling stops at the first failure; disabling carries on past
+     * it and returns the first error. */
+    int enable_rx_channels(struct bladerf *dev, unsigned int nchan,
+                           bool enable);
+
+    /* The same for the TX channels */
+    int enable_tx_channels(struct bladerf *dev, unsigned int nchan,
+                           bool enable);
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_DEVICE_UTILS_H */
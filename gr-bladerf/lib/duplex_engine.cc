@@ -0,0 +1,407 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string.h>
+#include "duplex_engine.h"
+#include "thread_utils.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* How long the TX thread waits on an empty queue before rechecking
+     * d_running, and how often it looks at the clock while it waits
+     * for the samples of a buffer */
+    static const unsigned int STOP_POLL_MS = 100;
+    static const unsigned int TX_POLL_MS = 1;
+
+    static const int64_t NO_LEAD = std::numeric_limits<int64_t>::max();
+
+    static boost::posix_time::ptime
+    wall_now()
+    {
+      return boost::posix_time::microsec_clock::universal_time();
+    }
+
+    duplex_engine::duplex_engine(const struct duplex_config &config,
+                                 receive_fn receive, transmit_fn transmit)
+      : d_config(config),
+        d_receive(receive),
+        d_transmit(transmit),
+        d_queued(0),
+        d_next_id(0),
+        d_have_clock(false),
+        d_clock_ts(0),
+        d_running(false),
+        d_rx_frames(0),
+        d_rx_errors(0),
+        d_rx_gaps(0),
+        d_rx_gap_frames(0)
+    {
+      if (config.rx_nchan < 1 || config.tx_nchan < 1 ||
+          config.rx_frames == 0 || config.tx_frames == 0 ||
+          config.tx_queue_frames == 0) {
+        throw std::invalid_argument("duplex_engine: bad geometry");
+      }
+      if (config.samp_rate <= 0) {
+        throw std::invalid_argument("duplex_engine: bad sample rate");
+      }
+      memset(&d_tx_stats, 0, sizeof(d_tx_stats));
+      d_tx_stats.tx_min_lead = NO_LEAD;
+    }
+
+    duplex_engine::~duplex_engine()
+    {
+      stop();
+    }
+
+    void
+    duplex_engine::start(const std::vector<int> &rx_cpus,
+                         const std::vector<int> &tx_cpus, int rt_priority)
+    {
+      if (d_running) {
+        return;
+      }
+
+      d_running = true;
+      d_rx_thread.reset(new boost::thread(
+        boost::bind(&duplex_engine::rx_loop, this, rx_cpus, rt_priority)));
+      d_tx_thread.reset(new boost::thread(
+        boost::bind(&duplex_engine::tx_loop, this, tx_cpus, rt_priority)));
+    }
+
+    void
+    duplex_engine::stop()
+    {
+      if (!d_running) {
+        return;
+      }
+
+      d_running = false;
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        d_tx_cond.notify_all();
+        d_space_cond.notify_all();
+      }
+      d_rx_thread->join();
+      d_tx_thread->join();
+      d_rx_thread.reset();
+      d_tx_thread.reset();
+
+      /* Bursts not yet sent go with the stream */
+      boost::mutex::scoped_lock lock(d_mutex);
+      d_bursts.clear();
+      d_queued = 0;
+      d_space_cond.notify_all();
+      boost::mutex::scoped_lock clock(d_clock_mutex);
+      d_have_clock = false;
+    }
+
+    bool
+    duplex_engine::now(uint64_t *tx_time)
+    {
+      boost::mutex::scoped_lock lock(d_clock_mutex);
+      if (!d_have_clock) {
+        return false;
+      }
+      const double elapsed =
+        (wall_now() - d_clock_wall).total_microseconds() * 1e-6;
+      *tx_time = d_clock_ts + (uint64_t)(elapsed * d_config.samp_rate) +
+                 d_config.tx_offset;
+      return true;
+    }
+
+    void
+    duplex_engine::end_open()
+    {
+      if (d_bursts.empty() || d_bursts.back().ended) {
+        return;
+      }
+      struct burst &b = d_bursts.back();
+      b.samples.insert(b.samples.end(), 2 * d_config.tx_nchan, 0);
+      b.ended = true;
+      d_queued++;
+      d_tx_cond.notify_all();
+    }
+
+    uint64_t
+    duplex_engine::schedule(uint64_t tx_time)
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      end_open();
+
+      struct burst b;
+      memset(&b.report, 0, sizeof(b.report));
+      b.report.id = d_next_id++;
+      b.report.requested = tx_time;
+      b.report.start = tx_time;
+      b.report.min_lead = NO_LEAD;
+      b.read = 0;
+      b.started = false;
+      b.ended = false;
+      d_bursts.push_back(b);
+      d_tx_cond.notify_all();
+      return b.report.id;
+    }
+
+    size_t
+    duplex_engine::push(const int16_t *frames, size_t nframes,
+                        unsigned int timeout_ms)
+    {
+      const size_t frame_len = 2 * d_config.tx_nchan;
+      boost::mutex::scoped_lock lock(d_mutex);
+      if (d_bursts.empty() || d_bursts.back().ended) {
+        return 0;
+      }
+      const uint64_t id = d_bursts.back().report.id;
+      const boost::system_time deadline = boost::get_system_time() +
+        boost::posix_time::milliseconds(timeout_ms);
+
+      size_t done = 0;
+      while (done < nframes) {
+        /* The burst may have failed and been dropped while waiting */
+        if (d_bursts.empty() || d_bursts.back().ended ||
+            d_bursts.back().report.id != id) {
+          break;
+        }
+        if (d_queued >= d_config.tx_queue_frames) {
+          if (!d_space_cond.timed_wait(lock, deadline)) {
+            break;
+          }
+          continue;
+        }
+        const size_t n = std::min(d_config.tx_queue_frames - d_queued,
+                                  nframes - done);
+        struct burst &b = d_bursts.back();
+        b.samples.insert(b.samples.end(), frames + done * frame_len,
+                         frames + (done + n) * frame_len);
+        d_queued += n;
+        done += n;
+        d_tx_cond.notify_all();
+      }
+      return done;
+    }
+
+    void
+    duplex_engine::end_burst()
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      end_open();
+    }
+
+    std::vector<struct duplex_burst_report>
+    duplex_engine::take_reports()
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      std::vector<struct duplex_burst_report> reports;
+      reports.swap(d_reports);
+      return reports;
+    }
+
+    struct duplex_stats
+    duplex_engine::stats()
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      struct duplex_stats s = d_tx_stats;
+      if (s.tx_min_lead == NO_LEAD) {
+        s.tx_min_lead = 0;
+      }
+      s.rx_frames = d_rx_frames;
+      s.rx_errors = d_rx_errors;
+      s.rx_gaps = d_rx_gaps;
+      s.rx_gap_frames = d_rx_gap_frames;
+      return s;
+    }
+
+    void
+    duplex_engine::rx_loop(std::vector<int> cpus, int rt_priority)
+    {
+      setup_current_thread("duplex rx", cpus, rt_priority);
+      const size_t nframes = d_config.rx_frames;
+      std::vector<int16_t> buf(nframes * d_config.rx_nchan * 2);
+      bool have_expected = false;
+      uint64_t expected = 0;
+
+      while (d_running) {
+        uint64_t ts = 0;
+        int status = d_receive(&buf[0], nframes * d_config.rx_nchan, &ts);
+        if (status != 0) {
+          d_rx_errors++;
+          continue;
+        }
+
+        /* Frames the hardware dropped show as a jump in the timestamps */
+        if (have_expected && ts != expected) {
+          d_rx_gaps++;
+          if (ts > expected) {
+            d_rx_gap_frames += ts - expected;
+          }
+        }
+        expected = ts + nframes;
+        have_expected = true;
+        {
+          boost::mutex::scoped_lock lock(d_clock_mutex);
+          d_clock_ts = expected;
+          d_clock_wall = wall_now();
+          d_have_clock = true;
+        }
+        d_rx_frames += nframes;
+
+        if (d_handler) {
+          d_handler(&buf[0], nframes, ts);
+        }
+      }
+    }
+
+    void
+    duplex_engine::finish_burst(int status)
+    {
+      struct burst &b = d_bursts.front();
+      b.report.status = status;
+      if (status != 0) {
+        d_tx_stats.tx_errors++;
+        d_queued -= b.samples.size() / (2 * d_config.tx_nchan) - b.read;
+      }
+      if (b.report.min_lead == NO_LEAD) {
+        b.report.min_lead = 0;
+      }
+      d_tx_stats.tx_bursts++;
+      d_reports.push_back(b.report);
+      d_bursts.pop_front();
+      d_space_cond.notify_all();
+    }
+
+    void
+    duplex_engine::tx_loop(std::vector<int> cpus, int rt_priority)
+    {
+      setup_current_thread("duplex tx", cpus, rt_priority);
+      const size_t frame_len = 2 * d_config.tx_nchan;
+      const size_t nframes = d_config.tx_frames;
+      const int64_t lead = (int64_t)d_config.tx_lead;
+      std::vector<int16_t> buf(nframes * frame_len);
+
+      boost::mutex::scoped_lock lock(d_mutex);
+      while (d_running) {
+        if (d_bursts.empty()) {
+          d_tx_cond.timed_wait(lock,
+            boost::posix_time::milliseconds(STOP_POLL_MS));
+          continue;
+        }
+        uint64_t now;
+        if (!this->now(&now)) {
+          d_tx_cond.timed_wait(lock,
+            boost::posix_time::milliseconds(TX_POLL_MS));
+          continue;
+        }
+
+        struct burst &b = d_bursts.front();
+        if (!b.started) {
+          /* Handing a burst over long before it is due would leave this
+           * thread blocked in the transmit with later bursts behind it */
+          if ((int64_t)(b.report.requested - now) > 2 * lead) {
+            d_tx_cond.timed_wait(lock,
+              boost::posix_time::milliseconds(TX_POLL_MS));
+            continue;
+          }
+          b.started = true;
+          if ((int64_t)(b.report.requested - now) < lead) {
+            b.report.start = now + lead;
+            d_tx_stats.tx_late++;
+          }
+        }
+
+        const uint64_t next = b.report.start + b.report.frames;
+        const int64_t margin = (int64_t)(next - now);
+        const size_t avail = b.samples.size() / frame_len - b.read;
+        size_t n, pad = 0;
+        bool last = false;
+        if (b.ended && avail <= nframes) {
+          n = avail;
+          last = true;
+        } else if (avail >= nframes) {
+          n = nframes;
+        } else if (margin <= lead) {
+          /* Due and short: pad rather than let the hardware run dry */
+          n = avail;
+          pad = nframes - avail;
+        } else {
+          d_tx_cond.timed_wait(lock,
+            boost::posix_time::milliseconds(TX_POLL_MS));
+          continue;
+        }
+
+        memcpy(&buf[0], &b.samples[b.read * frame_len],
+               n * frame_len * sizeof(int16_t));
+        memset(&buf[n * frame_len], 0, pad * frame_len * sizeof(int16_t));
+        b.read += n;
+        d_queued -= n;
+        if (b.read * 2 >= b.samples.size() / frame_len) {
+          b.samples.erase(b.samples.begin(),
+                          b.samples.begin() + b.read * frame_len);
+          b.read = 0;
+        }
+        d_space_cond.notify_all();
+
+        uint32_t flags = 0;
+        if (b.report.frames == 0) {
+          flags |= BLADERF_META_FLAG_TX_BURST_START;
+          b.report.lead = margin;
+        }
+        if (last) {
+          flags |= BLADERF_META_FLAG_TX_BURST_END;
+        }
+        b.report.frames += n + pad;
+        b.report.min_lead = std::min(b.report.min_lead, margin);
+        d_tx_stats.tx_frames += n + pad;
+        d_tx_stats.tx_min_lead = std::min(d_tx_stats.tx_min_lead, margin);
+        if (pad > 0) {
+          b.report.padded += pad;
+          b.report.underruns++;
+          d_tx_stats.tx_padded += pad;
+          d_tx_stats.tx_underruns++;
+        }
+
+        /* Only this thread takes bursts off the front, so b is still
+         * there once the lock is back */
+        lock.unlock();
+        int status = d_transmit(&buf[0], (n + pad) * d_config.tx_nchan,
+                                next, flags);
+        lock.lock();
+        if (!d_running) {
+          break;
+        }
+        if (status != 0 || last) {
+          finish_burst(status);
+        }
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
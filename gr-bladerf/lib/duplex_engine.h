@@ -0,0 +1,201 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_DUPLEX_ENGINE_H
+#define INCLUDED_BLADERF_DUPLEX_ENGINE_H
+
+#include <libbladeRF.h>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <deque>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace bladerf {
+
+    struct duplex_config {
+      size_t rx_nchan;          /* channels interleaved in each direction */
+      size_t tx_nchan;
+      size_t rx_frames;         /* frames per receive */
+      size_t tx_frames;         /* frames per transmit */
+      double samp_rate;
+      /* Frames ahead of the hardware clock a TX buffer has to be handed
+       * over; a burst whose samples are short by then is padded */
+      uint64_t tx_lead;
+      /* Frames queued for bursts before push() waits */
+      size_t tx_queue_frames;
+      /* TX timestamp minus RX timestamp at the same instant */
+      int64_t tx_offset;
+    };
+
+    /* How a burst went out, in frames of the TX clock */
+    struct duplex_burst_report {
+      uint64_t id;
+      uint64_t requested;       /* start asked for */
+      uint64_t start;           /* start it went out at */
+      uint64_t frames;          /* sent, zeros included */
+      uint64_t padded;          /* zeros sent for want of samples */
+      uint64_t underruns;       /* buffers that needed padding */
+      int64_t lead;             /* first buffer handed over this early */
+      int64_t min_lead;         /* least margin over its buffers */
+      int status;               /* libbladeRF status that cut it short */
+    };
+
+    struct duplex_stats {
+      uint64_t rx_frames;
+      uint64_t rx_errors;
+      uint64_t rx_gaps;         /* timestamp jumps, i.e. overruns */
+      uint64_t rx_gap_frames;
+      uint64_t tx_bursts;
+      uint64_t tx_frames;
+      uint64_t tx_errors;
+      uint64_t tx_underruns;
+      uint64_t tx_padded;
+      uint64_t tx_late;         /* bursts scheduled too late to make it */
+      int64_t tx_min_lead;
+    };
+
+    /*!
+     * \brief Runs the RX and TX streams of one device on threads of
+     * their own and sends TX bursts at hardware timestamps.
+     *
+     * The RX thread reads with metadata, counts timestamp jumps as
+     * overruns and hands every block to the RX handler. Its timestamps
+     * also drive the clock the TX side works to: the end of the last
+     * block received, moved on by the wall clock since and by the TX
+     * offset, is "now" on the TX clock.
+     *
+     * Bursts are sent one after another in the order they were
+     * scheduled. Samples for a burst can arrive while it is on the air,
+     * as PTT audio does: when a buffer is due, tx_lead frames before it
+     * goes out, and the samples for it are not there, what is there is
+     * padded with zeros so the burst keeps its timeline, and the
+     * padding is counted. A burst scheduled for a time less than
+     * tx_lead away is late and starts tx_lead from now instead. Every
+     * burst ends with a zero frame so the DAC is not left holding its
+     * last sample.
+     */
+    class duplex_engine
+    {
+     public:
+      /* Read nsamples (counting every channel) into buf and set
+       * *timestamp to the time of its first frame; a libbladeRF status */
+      typedef boost::function<int (void *buf, unsigned int nsamples,
+                                   uint64_t *timestamp)> receive_fn;
+
+      /* Send nsamples with the BLADERF_META_FLAG_TX_BURST_START and
+       * _END flags given; timestamp is that of the first frame and only
+       * matters on a burst start */
+      typedef boost::function<int (const void *buf, unsigned int nsamples,
+                                   uint64_t timestamp, uint32_t flags)>
+        transmit_fn;
+
+      /* Every received block, on the RX thread */
+      typedef boost::function<void (const int16_t *frames, size_t nframes,
+                                    uint64_t timestamp)> rx_handler;
+
+      duplex_engine(const struct duplex_config &config, receive_fn receive,
+                    transmit_fn transmit);
+      ~duplex_engine();
+
+      /* Set before start() */
+      void set_rx_handler(rx_handler handler) { d_handler = handler; }
+
+      void start(const std::vector<int> &rx_cpus,
+                 const std::vector<int> &tx_cpus, int rt_priority);
+      void stop();
+
+      /* The hardware time on the TX clock; false until the first block
+       * has been received */
+      bool now(uint64_t *tx_time);
+
+      /* Open a burst to start at tx_time and return its id. A burst
+       * still open is ended first. */
+      uint64_t schedule(uint64_t tx_time);
+
+      /* Queue frames for the open burst, waiting up to timeout_ms while
+       * the queue is full; returns how many were taken, 0 when no burst
+       * is open */
+      size_t push(const int16_t *frames, size_t nframes,
+                  unsigned int timeout_ms);
+
+      /* The open burst ends after what has been pushed */
+      void end_burst();
+
+      /* Reports of the bursts finished since the last call */
+      std::vector<struct duplex_burst_report> take_reports();
+
+      struct duplex_stats stats();
+
+     private:
+      struct burst {
+        struct duplex_burst_report report;
+        std::vector<int16_t> samples;
+        size_t read;            /* frames of samples already sent */
+        bool started;
+        bool ended;             /* the closing zero is queued */
+      };
+
+      struct duplex_config d_config;
+      receive_fn d_receive;
+      transmit_fn d_transmit;
+      rx_handler d_handler;
+
+      boost::mutex d_mutex;     /* bursts, reports and TX counters */
+      boost::condition_variable d_tx_cond;
+      boost::condition_variable d_space_cond;
+      std::deque<struct burst> d_bursts;
+      std::vector<struct duplex_burst_report> d_reports;
+      size_t d_queued;
+      uint64_t d_next_id;
+      struct duplex_stats d_tx_stats;
+
+      boost::mutex d_clock_mutex;
+      bool d_have_clock;
+      uint64_t d_clock_ts;      /* RX time at the end of the last block */
+      boost::posix_time::ptime d_clock_wall;
+
+      boost::atomic<bool> d_running;
+      boost::atomic<uint64_t> d_rx_frames;
+      boost::atomic<uint64_t> d_rx_errors;
+      boost::atomic<uint64_t> d_rx_gaps;
+      boost::atomic<uint64_t> d_rx_gap_frames;
+      boost::shared_ptr<boost::thread> d_rx_thread;
+      boost::shared_ptr<boost::thread> d_tx_thread;
+
+      void rx_loop(std::vector<int> cpus, int rt_priority);
+      void tx_loop(std::vector<int> cpus, int rt_priority);
+      void end_open();
+      void finish_burst(int status);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_DUPLEX_ENGINE_H */
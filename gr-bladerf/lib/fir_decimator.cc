@@ -0,0 +1,133 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include "fir_decimator.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace gr {
+  namespace bladerf {
+
+    fir_decimator::fir_decimator(const std::vector<float> &taps,
+                                 unsigned int decim, size_t max_input)
+      : d_taps(taps.rbegin(), taps.rend()),
+        d_decim(decim),
+        d_buf(taps.size() - 1 + max_input),
+        d_offset(0)
+    {
+      /* Each tap twice, lined up with the I and Q of a sample */
+      d_taps2.resize(2 * d_taps.size());
+      for (size_t j = 0; j < d_taps.size(); j++) {
+        d_taps2[2 * j] = d_taps2[2 * j + 1] = d_taps[j];
+      }
+    }
+
+    void
+    fir_decimator::reset()
+    {
+      std::fill(d_buf.begin(), d_buf.end(), std::complex<float>(0, 0));
+      d_offset = 0;
+    }
+
+    size_t
+    fir_decimator::filter(const std::complex<float> *in, size_t n,
+                          std::complex<float> *out)
+    {
+      const size_t hist = d_taps.size() - 1;
+      const size_t len = hist + n;
+      const float *t = &d_taps[0];
+      const size_t ntaps = d_taps.size();
+      size_t nout = 0;
+      size_t p;
+
+      memcpy(&d_buf[hist], in, n * sizeof(std::complex<float>));
+
+      for (p = d_offset; p + ntaps <= len; p += d_decim) {
+        const float *x = reinterpret_cast<const float *>(&d_buf[p]);
+        float re = 0, im = 0;
+        size_t j = 0;
+#ifdef __SSE2__
+        /* Two samples per multiply, I and Q lanes summed at the end */
+        const float *t2 = &d_taps2[0];
+        __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+        for (; j + 4 <= ntaps; j += 4) {
+          acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + 2 * j),
+                                             _mm_loadu_ps(t2 + 2 * j)));
+          acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + 2 * j + 4),
+                                             _mm_loadu_ps(t2 + 2 * j + 4)));
+        }
+        acc0 = _mm_add_ps(acc0, acc1);
+        acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+        float sum[4];
+        _mm_storeu_ps(sum, acc0);
+        re = sum[0];
+        im = sum[1];
+#endif
+        for (; j < ntaps; j++) {
+          re += t[j] * x[2 * j];
+          im += t[j] * x[2 * j + 1];
+        }
+        out[nout++] = std::complex<float>(re, im);
+      }
+
+      /* Keep the tail as history for the next call */
+      d_offset = p - n;
+      memmove(&d_buf[0], &d_buf[n], hist * sizeof(std::complex<float>));
+      return nout;
+    }
+
+    std::vector<float>
+    fir_decimator::lowpass(double gain, double samp_rate, double cutoff,
+                           double transition)
+    {
+      int ntaps = (int)ceil(3.3 * samp_rate / transition);
+      ntaps |= 1;
+
+      std::vector<float> taps(ntaps);
+      const double fc = cutoff / samp_rate;
+      const int m = ntaps / 2;
+      double sum = 0;
+
+      for (int i = 0; i < ntaps; i++) {
+        int k = i - m;
+        double h = (k == 0) ? 2 * fc : sin(2 * M_PI * fc * k) / (M_PI * k);
+        h *= 0.54 - 0.46 * cos(2 * M_PI * i / (ntaps - 1));
+        taps[i] = (float)h;
+        sum += h;
+      }
+      for (int i = 0; i < ntaps; i++) {
+        taps[i] = (float)(taps[i] * gain / sum);
+      }
+      return taps;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
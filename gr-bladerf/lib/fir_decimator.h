@@ -0,0 +1,70 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_FIR_DECIMATOR_H
+#define INCLUDED_BLADERF_FIR_DECIMATOR_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Decimating FIR filter with real taps on a complex stream.
+     *
+     * Only every decim'th output is computed. The filter history lives in
+     * a buffer sized at construction for max_input samples per call, so
+     * filter() never allocates.
+     */
+    class fir_decimator
+    {
+     public:
+      fir_decimator(const std::vector<float> &taps, unsigned int decim,
+                    size_t max_input);
+
+      /* Filter n <= max_input samples; returns the outputs written */
+      size_t filter(const std::complex<float> *in, size_t n,
+                    std::complex<float> *out);
+
+      void reset();
+
+      unsigned int decimation() const { return d_decim; }
+      size_t ntaps() const { return d_taps.size(); }
+
+      /* Windowed-sinc (Hamming) low pass; transition sets the length */
+      static std::vector<float> lowpass(double gain, double samp_rate,
+                                        double cutoff, double transition);
+
+     private:
+      std::vector<float> d_taps;  /* reversed, so a dot product filters */
+      std::vector<float> d_taps2; /* d_taps with every tap doubled */
+      unsigned int d_decim;
+      std::vector<std::complex<float> > d_buf;
+      size_t d_offset;            /* start of the next output in d_buf */
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_FIR_DECIMATOR_H */
@@ -0,0 +1,290 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "fm_discriminator.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace gr {
+  namespace bladerf {
+
+    /* Minimax atan on [0, 1], odd powers 1..11 */
+    static const float ATAN_C[6] = {
+      0.99997726f, -0.33262347f, 0.19354346f,
+      -0.11643287f, 0.05265332f, -0.01172120f
+    };
+    static const float ATAN_FAST_K = 0.273f;
+    static const float TINY = 1e-30f;
+
+    /* Phase of z = x * conj(last); xr/xi is the current sample, which
+     * only the cross product discriminator needs */
+    template <fm_accuracy A>
+    static inline float
+    step_scalar(float zr, float zi, float xr, float xi)
+    {
+      if (A == FM_EXACT) {
+        return atan2f(zi, zr);
+      }
+      if (A == FM_CROSS) {
+        return zi / std::max(xr * xr + xi * xi, TINY);
+      }
+
+      float ax = fabsf(zr), ay = fabsf(zi);
+      float t = std::min(ax, ay) / std::max(std::max(ax, ay), TINY);
+      float p;
+      if (A == FM_POLY) {
+        float s = t * t;
+        p = t * (ATAN_C[0] + s * (ATAN_C[1] + s * (ATAN_C[2] +
+            s * (ATAN_C[3] + s * (ATAN_C[4] + s * ATAN_C[5])))));
+      } else {
+        p = t * ((float)M_PI_4 + ATAN_FAST_K * (1 - t));
+      }
+      if (ay > ax) {
+        p = (float)M_PI_2 - p;
+      }
+      if (zr < 0) {
+        p = (float)M_PI - p;
+      }
+      return zi < 0 ? -p : p;
+    }
+
+#ifdef __SSE2__
+    static inline __m128
+    select(__m128 mask, __m128 a, __m128 b)
+    {
+      return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    template <fm_accuracy A>
+    static inline __m128
+    step_sse(__m128 zr, __m128 zi, __m128 xr, __m128 xi)
+    {
+      if (A == FM_EXACT) {
+        float r[4], i[4];
+        _mm_storeu_ps(r, zr);
+        _mm_storeu_ps(i, zi);
+        for (int k = 0; k < 4; k++) {
+          r[k] = atan2f(i[k], r[k]);
+        }
+        return _mm_loadu_ps(r);
+      }
+      if (A == FM_CROSS) {
+        __m128 m = _mm_add_ps(_mm_mul_ps(xr, xr), _mm_mul_ps(xi, xi));
+        return _mm_mul_ps(zi, _mm_rcp_ps(_mm_max_ps(m, _mm_set1_ps(TINY))));
+      }
+
+      const __m128 sign = _mm_set1_ps(-0.0f);
+      __m128 ax = _mm_andnot_ps(sign, zr);
+      __m128 ay = _mm_andnot_ps(sign, zi);
+      __m128 mx = _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(TINY));
+      __m128 mn = _mm_min_ps(ax, ay);
+      __m128 p;
+      if (A == FM_POLY) {
+        __m128 t = _mm_div_ps(mn, mx);
+        __m128 s = _mm_mul_ps(t, t);
+        p = _mm_set1_ps(ATAN_C[5]);
+        for (int k = 4; k >= 0; k--) {
+          p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(ATAN_C[k]));
+        }
+        p = _mm_mul_ps(p, t);
+      } else {
+        /* The first order fit swamps the reciprocal estimate's error */
+        __m128 t = _mm_mul_ps(mn, _mm_rcp_ps(mx));
+        p = _mm_mul_ps(t, _mm_add_ps(_mm_set1_ps((float)M_PI_4),
+              _mm_mul_ps(_mm_set1_ps(ATAN_FAST_K),
+                         _mm_sub_ps(_mm_set1_ps(1.0f), t))));
+      }
+      p = select(_mm_cmpgt_ps(ay, ax),
+                 _mm_sub_ps(_mm_set1_ps((float)M_PI_2), p), p);
+      p = select(_mm_cmplt_ps(zr, _mm_setzero_ps()),
+                 _mm_sub_ps(_mm_set1_ps((float)M_PI), p), p);
+      return _mm_xor_ps(p, _mm_and_ps(zi, sign));
+    }
+#endif
+
+    /* State of the four lanes of one group */
+    struct lanes {
+      float *last_re, *last_im, *x1, *y1;
+      float gain, b0, p1;
+    };
+
+    template <fm_accuracy A>
+    static void
+    demod_lanes(const float *const *in, float *const *out, size_t n,
+                const lanes &s)
+    {
+      size_t i = 0;
+
+#ifdef __SSE2__
+      /* Four samples of four channels per pass: deinterleave each
+       * channel and transpose so every vector holds one instant */
+      __m128 lre = _mm_loadu_ps(s.last_re);
+      __m128 lim = _mm_loadu_ps(s.last_im);
+      __m128 x1 = _mm_loadu_ps(s.x1);
+      __m128 y1 = _mm_loadu_ps(s.y1);
+      const __m128 gain = _mm_set1_ps(s.gain);
+      const __m128 b0 = _mm_set1_ps(s.b0);
+      const __m128 p1 = _mm_set1_ps(s.p1);
+
+      for (; i + 4 <= n; i += 4) {
+        __m128 re[4], im[4], y[4];
+        for (int l = 0; l < 4; l++) {
+          __m128 a = _mm_loadu_ps(in[l] + 2 * i);
+          __m128 b = _mm_loadu_ps(in[l] + 2 * i + 4);
+          re[l] = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+          im[l] = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        }
+        _MM_TRANSPOSE4_PS(re[0], re[1], re[2], re[3]);
+        _MM_TRANSPOSE4_PS(im[0], im[1], im[2], im[3]);
+
+        for (int t = 0; t < 4; t++) {
+          __m128 zr = _mm_add_ps(_mm_mul_ps(re[t], lre),
+                                 _mm_mul_ps(im[t], lim));
+          __m128 zi = _mm_sub_ps(_mm_mul_ps(im[t], lre),
+                                 _mm_mul_ps(re[t], lim));
+          lre = re[t];
+          lim = im[t];
+
+          __m128 x = _mm_mul_ps(gain, step_sse<A>(zr, zi, re[t], im[t]));
+          y1 = _mm_add_ps(_mm_mul_ps(b0, _mm_add_ps(x, x1)),
+                          _mm_mul_ps(p1, y1));
+          x1 = x;
+          y[t] = y1;
+        }
+
+        _MM_TRANSPOSE4_PS(y[0], y[1], y[2], y[3]);
+        for (int l = 0; l < 4; l++) {
+          _mm_storeu_ps(out[l] + i, y[l]);
+        }
+      }
+
+      _mm_storeu_ps(s.last_re, lre);
+      _mm_storeu_ps(s.last_im, lim);
+      _mm_storeu_ps(s.x1, x1);
+      _mm_storeu_ps(s.y1, y1);
+#endif
+
+      for (size_t l = 0; l < fm_discriminator::LANES; l++) {
+        float lr = s.last_re[l], li = s.last_im[l];
+        float xp = s.x1[l], yp = s.y1[l];
+        for (size_t k = i; k < n; k++) {
+          float xr = in[l][2 * k], xi = in[l][2 * k + 1];
+          float x = s.gain * step_scalar<A>(xr * lr + xi * li,
+                                            xi * lr - xr * li, xr, xi);
+          lr = xr;
+          li = xi;
+          yp = s.b0 * (x + xp) + s.p1 * yp;
+          xp = x;
+          out[l][k] = yp;
+        }
+        s.last_re[l] = lr;
+        s.last_im[l] = li;
+        s.x1[l] = xp;
+        s.y1[l] = yp;
+      }
+    }
+
+    fm_discriminator::fm_discriminator(size_t nchan, size_t max_n,
+                                       double audio_rate, double max_dev,
+                                       double tau, fm_accuracy accuracy)
+      : d_nchan(nchan),
+        d_max_n(max_n),
+        d_accuracy(accuracy),
+        d_discard(max_n)
+    {
+      if (nchan == 0) {
+        throw std::invalid_argument("fm_discriminator: no channels");
+      }
+
+      size_t padded = (nchan + LANES - 1) / LANES * LANES;
+      d_last_re.resize(padded);
+      d_last_im.resize(padded);
+      d_x1.resize(padded);
+      d_y1.resize(padded);
+      reset();
+
+      d_gain = (float)(audio_rate / (2 * M_PI * max_dev));
+
+      /* fm_deemph: bilinear single pole at 1/tau */
+      double wc = 1.0 / tau;
+      double wca = 2.0 * audio_rate * tan(wc / (2.0 * audio_rate));
+      double k = -wca / (2.0 * audio_rate);
+      d_p1 = (float)((1.0 + k) / (1.0 - k));
+      d_b0 = (float)(-k / (1.0 - k));
+    }
+
+    void
+    fm_discriminator::reset()
+    {
+      std::fill(d_last_re.begin(), d_last_re.end(), 0.0f);
+      std::fill(d_last_im.begin(), d_last_im.end(), 0.0f);
+      std::fill(d_x1.begin(), d_x1.end(), 0.0f);
+      std::fill(d_y1.begin(), d_y1.end(), 0.0f);
+    }
+
+    void
+    fm_discriminator::demod(const std::complex<float> *const *in,
+                            float *const *out, size_t n)
+    {
+      if (n > d_max_n) {
+        throw std::invalid_argument("fm_discriminator: block too large");
+      }
+
+      for (size_t g = 0; g < d_nchan; g += LANES) {
+        const float *gin[LANES];
+        float *gout[LANES];
+        struct lanes s;
+
+        /* Lanes past the last channel repeat its input into d_discard */
+        for (size_t l = 0; l < LANES; l++) {
+          size_t ch = std::min(g + l, d_nchan - 1);
+          gin[l] = reinterpret_cast<const float *>(in[ch]);
+          gout[l] = (g + l < d_nchan) ? out[ch] : &d_discard[0];
+        }
+        s.last_re = &d_last_re[g];
+        s.last_im = &d_last_im[g];
+        s.x1 = &d_x1[g];
+        s.y1 = &d_y1[g];
+        s.gain = d_gain;
+        s.b0 = d_b0;
+        s.p1 = d_p1;
+
+        switch (d_accuracy) {
+        case FM_EXACT: demod_lanes<FM_EXACT>(gin, gout, n, s); break;
+        case FM_POLY:  demod_lanes<FM_POLY>(gin, gout, n, s); break;
+        case FM_FAST:  demod_lanes<FM_FAST>(gin, gout, n, s); break;
+        case FM_CROSS: demod_lanes<FM_CROSS>(gin, gout, n, s); break;
+        }
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
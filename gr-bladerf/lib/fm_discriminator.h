@@ -0,0 +1,87 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_FM_DISCRIMINATOR_H
+#define INCLUDED_BLADERF_FM_DISCRIMINATOR_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /* How the phase step between samples is computed */
+    enum fm_accuracy {
+      FM_EXACT,  /* atan2f, the quadrature_demod reference */
+      FM_POLY,   /* 11th order polynomial atan, error below 2e-6 rad */
+      FM_FAST,   /* first order atan, error below 4e-3 rad */
+      FM_CROSS   /* Im(z)/|x|^2: sin of the step, for small deviations */
+    };
+
+    /*!
+     * \brief Polar FM discriminator with de-emphasis for several
+     * channels at once.
+     *
+     * Channels are processed four at a time, one per SSE lane: every
+     * step of the loop takes the next sample of four channels, so the
+     * de-emphasis IIR, which is serial in time, still vectorizes. The
+     * output is the phase step scaled so that max_dev gives 1.0, run
+     * through the fm_deemph single pole.
+     */
+    class fm_discriminator
+    {
+     public:
+      static const size_t LANES = 4;
+
+      fm_discriminator(size_t nchan, size_t max_n, double audio_rate,
+                       double max_dev, double tau, fm_accuracy accuracy);
+
+      /* Demodulate n <= max_n samples of every channel from in[ch] to
+       * out[ch] */
+      void demod(const std::complex<float> *const *in, float *const *out,
+                 size_t n);
+
+      void reset();
+
+      size_t channels() const { return d_nchan; }
+      fm_accuracy accuracy() const { return d_accuracy; }
+
+     private:
+      size_t d_nchan;
+      size_t d_max_n;
+      fm_accuracy d_accuracy;
+      float d_gain;
+      float d_b0, d_p1;
+
+      /* Per lane state, padded to a whole number of groups */
+      std::vector<float> d_last_re, d_last_im;
+      std::vector<float> d_x1, d_y1;
+
+      /* Output of the unused lanes of the last group */
+      std::vector<float> d_discard;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_FM_DISCRIMINATOR_H */
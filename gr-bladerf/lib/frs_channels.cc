@@ -0,0 +1,82 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include "frs_channels.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const double FRS_SPACING = 25e3;
+    static const double FRS_LOW_BASE = 462.5625e6;
+    static const double FRS_HIGH_BASE = 467.5625e6;
+    static const double GMRS_BASE = 462.5500e6;
+
+    static std::vector<struct frs_channel>
+    make_table(int count)
+    {
+      std::vector<struct frs_channel> table;
+      for (int i = 0; i < count; i++) {
+        struct frs_channel c;
+        c.number = i + 1;
+        if (i < 14) {
+          c.frequency = (i < 7 ? FRS_LOW_BASE : FRS_HIGH_BASE) +
+                        (i % 7) * FRS_SPACING;
+        } else {
+          c.frequency = GMRS_BASE + (i - 14) * FRS_SPACING;
+        }
+        table.push_back(c);
+      }
+      return table;
+    }
+
+    const std::vector<struct frs_channel> &
+    frs_channel_table()
+    {
+      static const std::vector<struct frs_channel> table = make_table(14);
+      return table;
+    }
+
+    const std::vector<struct frs_channel> &
+    frs_gmrs_channel_table()
+    {
+      static const std::vector<struct frs_channel> table = make_table(22);
+      return table;
+    }
+
+    double
+    frs_center_frequency(const std::vector<struct frs_channel> &ch)
+    {
+      double lo = ch.front().frequency, hi = ch.front().frequency;
+      for (size_t i = 1; i < ch.size(); i++) {
+        lo = std::min(lo, ch[i].frequency);
+        hi = std::max(hi, ch[i].frequency);
+      }
+      return (lo + hi) / 2;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
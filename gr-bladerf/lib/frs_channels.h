@@ -0,0 +1,50 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_FRS_CHANNELS_H
+#define INCLUDED_BLADERF_FRS_CHANNELS_H
+
+#include <vector>
+
+namespace gr {
+  namespace bladerf {
+
+    struct frs_channel {
+      int number;        /* channel number as printed on the radios */
+      double frequency;  /* center frequency in Hz */
+    };
+
+    /* FRS channels 1-14: 1-7 from 462.5625 MHz and 8-14 from
+     * 467.5625 MHz, 25 kHz apart */
+    const std::vector<struct frs_channel> &frs_channel_table();
+
+    /* All 22 FRS/GMRS channels: 1-14 above plus 15-22 from
+     * 462.5500 MHz, interleaved with 1-7 */
+    const std::vector<struct frs_channel> &frs_gmrs_channel_table();
+
+    /* Midpoint of the lowest and highest channel, the natural LO */
+    double frs_center_frequency(const std::vector<struct frs_channel> &ch);
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_FRS_CHANNELS_H */
@@ -0,0 +1,205 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include "frs_receiver.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Squelch changes expected per channel and block, before growing */
+    static const size_t EVENTS_RESERVED = 16;
+
+    frs_receiver::frs_receiver(const struct frs_receiver_config &config,
+                               audio_fn audio, event_fn event,
+                               tone_fn tone)
+      : d_config(config),
+        d_audio(audio),
+        d_event(event),
+        d_tone(tone),
+        d_pool(config.threads, config.cpus, config.rt_priority),
+        d_nbase(0),
+        d_samples(0)
+    {
+      if (config.channels.empty()) {
+        throw std::invalid_argument("frs_receiver: no channels");
+      }
+
+      struct channelizer_config cc;
+      cc.samp_rate = config.samp_rate;
+      cc.out_rate = config.demod.audio_rate;
+      cc.method = config.method;
+      cc.max_input = config.max_block;
+      for (size_t i = 0; i < config.channels.size(); i++) {
+        struct channel_spec c;
+        c.offset = config.channels[i].frequency - config.center_freq;
+        c.bandwidth = config.demod.bandwidth;
+        if (2 * std::abs(c.offset) >= config.samp_rate) {
+          throw std::invalid_argument("frs_receiver: channel outside the "
+                                      "captured band");
+        }
+        cc.channels.push_back(c);
+      }
+      d_chan.reset(new channelizer(cc));
+
+      for (size_t i = 0; i < config.channels.size(); i++) {
+        d_baseband.push_back(std::vector<std::complex<float> >(
+          d_chan->max_output()));
+        d_demod.push_back(std::vector<float>(d_chan->max_output()));
+        d_audio_buf.push_back(std::vector<float>(d_chan->max_output()));
+        d_events.push_back(std::vector<struct squelch_event>());
+        d_events.back().reserve(EVENTS_RESERVED);
+        d_gates.push_back(boost::shared_ptr<squelch_gate>(
+          new squelch_gate(config.demod.squelch_db,
+                           config.demod.squelch_alpha, config.demod.hpf,
+                           config.demod.audio_rate)));
+        if (config.ctcss) {
+          d_ctcss.push_back(boost::shared_ptr<ctcss_detector>(
+            new ctcss_detector(config.demod.audio_rate)));
+          d_tones.push_back(std::vector<struct ctcss_event>());
+        }
+      }
+
+      /* Every channel decimates to the same rate, so a group's lanes
+       * always hold the same number of samples */
+      const size_t lanes = fm_discriminator::LANES;
+      const size_t nch = config.channels.size();
+      for (size_t g = 0; g < nch; g += lanes) {
+        size_t n = std::min(lanes, nch - g);
+        d_discs.push_back(boost::shared_ptr<fm_discriminator>(
+          new fm_discriminator(n, d_demod[g].size(),
+                               config.demod.audio_rate,
+                               config.demod.max_dev, config.demod.tau,
+                               config.demod.accuracy)));
+      }
+
+      d_transform_task = boost::bind(&channelizer::transform,
+                                     d_chan.get(), _1);
+      d_channel_task = boost::bind(&frs_receiver::decimate_channel,
+                                   this, _1);
+      d_demod_task = boost::bind(&frs_receiver::demod_group, this, _1);
+    }
+
+    void
+    frs_receiver::decimate_channel(size_t ch)
+    {
+      size_t n = d_chan->channel(ch, &d_baseband[ch][0]);
+      if (ch == 0) {
+        d_nbase = n;
+      }
+    }
+
+    void
+    frs_receiver::demod_group(size_t group)
+    {
+      const size_t first = group * fm_discriminator::LANES;
+      const size_t nchan = d_discs[group]->channels();
+      const std::complex<float> *in[fm_discriminator::LANES] = { NULL };
+      float *out[fm_discriminator::LANES] = { NULL };
+
+      for (size_t i = 0; i < nchan; i++) {
+        in[i] = &d_baseband[first + i][0];
+        out[i] = &d_demod[first + i][0];
+      }
+      d_discs[group]->demod(in, out, d_nbase);
+
+      for (size_t i = 0; i < nchan; i++) {
+        size_t ch = first + i;
+        size_t n = d_gates[ch]->process(&d_baseband[ch][0],
+                                        &d_demod[ch][0], d_nbase,
+                                        &d_audio_buf[ch][0], d_events[ch]);
+        if (n > 0 && !d_audio.empty()) {
+          d_audio(d_config.channels[ch], &d_audio_buf[ch][0], n);
+        }
+
+        /* The tone is looked for under the demodulated audio, before
+         * the gate's high pass removes it */
+        if (!d_ctcss.empty()) {
+          if (n > 0 || d_gates[ch]->open()) {
+            d_ctcss[ch]->process(&d_demod[ch][0], d_nbase, d_tones[ch]);
+          } else {
+            d_ctcss[ch]->reset();
+          }
+        }
+      }
+    }
+
+    void
+    frs_receiver::process(const std::complex<float> *in, size_t n)
+    {
+      if (n > d_config.max_block) {
+        throw std::invalid_argument("frs_receiver: block too large");
+      }
+      run(d_chan->begin(in, n), n);
+    }
+
+    void
+    frs_receiver::process(const int16_t *in, size_t n)
+    {
+      if (n > d_config.max_block) {
+        throw std::invalid_argument("frs_receiver: block too large");
+      }
+      run(d_chan->begin(in, n), n);
+    }
+
+    void
+    frs_receiver::run(size_t blocks, size_t n)
+    {
+      const double audio_rate = d_config.demod.audio_rate;
+      const double start = d_samples / d_config.samp_rate;
+
+      d_pool.run(blocks, d_transform_task);
+      d_pool.run(d_chan->channels(), d_channel_task);
+      d_pool.run(d_discs.size(), d_demod_task);
+      d_samples += n;
+
+      for (size_t ch = 0; ch < d_events.size(); ch++) {
+        for (size_t i = 0; i < d_events[ch].size(); i++) {
+          if (!d_event.empty()) {
+            d_event(d_config.channels[ch],
+                    start + d_events[ch][i].index / audio_rate,
+                    d_events[ch][i]);
+          }
+        }
+        d_events[ch].clear();
+
+        if (!d_ctcss.empty()) {
+          for (size_t i = 0; i < d_tones[ch].size(); i++) {
+            if (!d_tone.empty()) {
+              d_tone(d_config.channels[ch],
+                     start + d_tones[ch][i].index / audio_rate,
+                     d_tones[ch][i].tone);
+            }
+          }
+          d_tones[ch].clear();
+        }
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
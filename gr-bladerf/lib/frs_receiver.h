@@ -0,0 +1,136 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_FRS_RECEIVER_H
+#define INCLUDED_BLADERF_FRS_RECEIVER_H
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <complex>
+#include <vector>
+#include <stdint.h>
+#include "channelizer.h"
+#include "ctcss_detector.h"
+#include "frs_channels.h"
+#include "nbfm_channel.h"
+#include "squelch_gate.h"
+#include "worker_pool.h"
+
+namespace gr {
+  namespace bladerf {
+
+    struct frs_receiver_config {
+      double samp_rate;
+      double center_freq;                 /* LO frequency */
+      std::vector<struct frs_channel> channels;
+      struct nbfm_config demod;           /* rate and offset are filled in */
+      channelizer_method method;          /* how channels are split out */
+      bool ctcss;                         /* report CTCSS tones */
+      size_t max_block;                   /* largest process() call */
+      size_t threads;                     /* workers besides the caller */
+      std::vector<int> cpus;
+      int rt_priority;
+    };
+
+    /*!
+     * \brief Multi-channel FRS receiver with no GNU Radio dependency.
+     *
+     * A channelizer splits each wideband block into the FRS channels on
+     * a fixed worker pool, first its shared transforms and then one task
+     * per channel. Once every channel is decimated, a last pass
+     * demodulates them in groups of four SIMD lanes and applies each
+     * channel's squelch. Audio is handed to the audio
+     * callback from the worker that produced it, so callbacks for
+     * different channels run concurrently; squelch events are reported
+     * from the caller's thread after the block, in channel order. With
+     * ctcss set, changes of a channel's tone while its squelch is open
+     * follow its squelch events the same way.
+     */
+    class frs_receiver
+    {
+     public:
+      typedef boost::function<void (const struct frs_channel &ch,
+                                    const float *audio, size_t n)> audio_fn;
+      typedef boost::function<void (const struct frs_channel &ch,
+                                    double time,
+                                    const struct squelch_event &e)> event_fn;
+      typedef boost::function<void (const struct frs_channel &ch,
+                                    double time, float tone)> tone_fn;
+
+      frs_receiver(const struct frs_receiver_config &config,
+                   audio_fn audio, event_fn event, tone_fn tone = tone_fn());
+
+      void process(const std::complex<float> *in, size_t n);
+
+      /* Raw SC16 Q11 samples, kept in fixed point until the channelizer
+       * has decimated them */
+      void process(const int16_t *in, size_t n);
+
+      const std::vector<struct frs_channel> &channels() const
+      {
+        return d_config.channels;
+      }
+
+      /* Wideband samples consumed so far */
+      uint64_t samples() const { return d_samples; }
+
+      /* Channelizer method in use and its cost per wideband sample */
+      channelizer_method method() const { return d_chan->method(); }
+      double multiplies() const { return d_chan->multiplies(); }
+
+      /* Squelch state and averaged power of channel ch, by index into
+       * the configured channels */
+      bool squelch_open(size_t ch) const { return d_gates[ch]->open(); }
+      float power_db(size_t ch) const { return d_gates[ch]->power_db(); }
+
+     private:
+      struct frs_receiver_config d_config;
+      audio_fn d_audio;
+      event_fn d_event;
+      tone_fn d_tone;
+
+      boost::shared_ptr<channelizer> d_chan;
+      std::vector<std::vector<std::complex<float> > > d_baseband;
+      std::vector<boost::shared_ptr<squelch_gate> > d_gates;
+      std::vector<boost::shared_ptr<fm_discriminator> > d_discs;
+      std::vector<std::vector<float> > d_demod;
+      std::vector<std::vector<float> > d_audio_buf;
+      std::vector<std::vector<struct squelch_event> > d_events;
+      std::vector<boost::shared_ptr<ctcss_detector> > d_ctcss;
+      std::vector<std::vector<struct ctcss_event> > d_tones;
+      worker_pool d_pool;
+      worker_pool::task_fn d_transform_task;
+      worker_pool::task_fn d_channel_task;
+      worker_pool::task_fn d_demod_task;
+
+      size_t d_nbase;
+      uint64_t d_samples;
+
+      void run(size_t blocks, size_t n);
+      void decimate_channel(size_t ch);
+      void demod_group(size_t group);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_FRS_RECEIVER_H */
@@ -0,0 +1,93 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include "frs_simulator.h"
+
+namespace gr {
+  namespace bladerf {
+
+    const double frs_simulator::CTCSS_DEVIATION = 500;
+
+    frs_simulator::frs_simulator(double samp_rate, float noise_rms,
+                                 uint32_t seed)
+      : d_samp_rate(samp_rate),
+        d_noise(noise_rms * sqrtf(3.0f)),
+        d_seed(seed ? seed : 1)
+    {
+    }
+
+    void
+    frs_simulator::add_signal(const struct sim_signal &s)
+    {
+      carrier c;
+      c.sig = s;
+      c.phase = 0;
+      c.tone_phase = 0;
+      c.ctcss_phase = 0;
+      d_carriers.push_back(c);
+    }
+
+    /* xorshift32 mapped to [-1, 1) */
+    float
+    frs_simulator::uniform()
+    {
+      d_seed ^= d_seed << 13;
+      d_seed ^= d_seed >> 17;
+      d_seed ^= d_seed << 5;
+      return (float)(d_seed * (2.0 / 4294967296.0) - 1.0);
+    }
+
+    void
+    frs_simulator::generate(std::complex<float> *out, size_t n)
+    {
+      for (size_t i = 0; i < n; i++) {
+        out[i] = std::complex<float>(d_noise * uniform(), d_noise * uniform());
+      }
+
+      for (size_t k = 0; k < d_carriers.size(); k++) {
+        carrier &c = d_carriers[k];
+        const double w = 2 * M_PI * c.sig.offset / d_samp_rate;
+        const double wt = 2 * M_PI * c.sig.tone / d_samp_rate;
+        const double dev = 2 * M_PI * c.sig.deviation / d_samp_rate;
+        const double wc = 2 * M_PI * c.sig.ctcss / d_samp_rate;
+        const double cdev = c.sig.ctcss > 0
+          ? 2 * M_PI * CTCSS_DEVIATION / d_samp_rate : 0;
+
+        for (size_t i = 0; i < n; i++) {
+          out[i] += std::polar(c.sig.amplitude, (float)c.phase);
+          c.phase += w + dev * cos(c.tone_phase) + cdev * cos(c.ctcss_phase);
+          c.tone_phase += wt;
+          c.ctcss_phase += wc;
+        }
+        c.phase = fmod(c.phase, 2 * M_PI);
+        c.tone_phase = fmod(c.tone_phase, 2 * M_PI);
+        c.ctcss_phase = fmod(c.ctcss_phase, 2 * M_PI);
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
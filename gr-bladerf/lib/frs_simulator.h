@@ -0,0 +1,77 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_FRS_SIMULATOR_H
+#define INCLUDED_BLADERF_FRS_SIMULATOR_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /* An FM carrier modulated by a single tone, plus optionally a
+     * CTCSS tone at CTCSS_DEVIATION */
+    struct sim_signal {
+      double offset;     /* carrier relative to the LO, Hz */
+      double tone;       /* modulating tone, Hz */
+      double deviation;  /* peak deviation, Hz */
+      double ctcss;      /* sub-audible tone, Hz, 0 for none */
+      float amplitude;
+    };
+
+    /*!
+     * \brief Synthetic wideband capture for running the receiver without
+     * hardware: tone modulated FM carriers over uniform noise.
+     */
+    class frs_simulator
+    {
+     public:
+      static const double CTCSS_DEVIATION;
+
+      frs_simulator(double samp_rate, float noise_rms, uint32_t seed = 1);
+
+      void add_signal(const struct sim_signal &s);
+      void generate(std::complex<float> *out, size_t n);
+
+     private:
+      struct carrier {
+        struct sim_signal sig;
+        double phase;       /* carrier phase, radians */
+        double tone_phase;
+        double ctcss_phase;
+      };
+
+      double d_samp_rate;
+      float d_noise;
+      uint32_t d_seed;
+      std::vector<carrier> d_carriers;
+
+      float uniform();
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_FRS_SIMULATOR_H */
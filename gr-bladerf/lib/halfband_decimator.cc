@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include <string.h>
+#include "halfband_decimator.h"
+
+namespace gr {
+  namespace bladerf {
+
+    halfband_decimator::halfband_decimator(double samp_rate,
+                                           double passband,
+                                           size_t max_input)
+      : d_offset(0)
+    {
+      double transition = samp_rate / 2 - 2 * passband;
+      if (transition <= 0) {
+        throw std::invalid_argument("halfband_decimator: passband must be "
+                                    "below a quarter of the rate");
+      }
+
+      /* Same length rule as fir_decimator::lowpass, rounded up to 4K-1 */
+      size_t ntaps = (size_t)ceil(3.3 * samp_rate / transition);
+      size_t k = std::max((ntaps + 1 + 3) / 4, (size_t)1);
+      ntaps = 4 * k - 1;
+
+      /* Hamming windowed sinc at a quarter of the rate; the odd taps are
+       * scaled so the DC gain is exactly one */
+      const int m = (int)ntaps / 2;
+      double sum = 0;
+      d_coeffs.resize(k);
+      for (size_t i = 0; i < k; i++) {
+        int t = 2 * (int)i + 1;
+        double h = sin(M_PI * t / 2) / (M_PI * t);
+        h *= 0.54 - 0.46 * cos(2 * M_PI * (m + t) / (ntaps - 1));
+        d_coeffs[i] = (float)h;
+        sum += 2 * h;
+      }
+      for (size_t i = 0; i < k; i++) {
+        d_coeffs[i] = (float)(d_coeffs[i] * 0.5 / sum);
+      }
+
+      d_buf.resize(ntaps - 1 + max_input);
+    }
+
+    void
+    halfband_decimator::reset()
+    {
+      std::fill(d_buf.begin(), d_buf.end(), std::complex<float>(0, 0));
+      d_offset = 0;
+    }
+
+    size_t
+    halfband_decimator::filter(const std::complex<float> *in, size_t n,
+                               std::complex<float> *out)
+    {
+      const size_t taps = ntaps();
+      const size_t hist = taps - 1;
+      const size_t len = hist + n;
+      const size_t centre = taps / 2;
+      const size_t k = d_coeffs.size();
+      size_t nout = 0;
+      size_t p;
+
+      memcpy(&d_buf[hist], in, n * sizeof(std::complex<float>));
+
+      for (p = d_offset; p + taps <= len; p += 2) {
+        const std::complex<float> *c = &d_buf[p + centre];
+        float re = 0.5f * c[0].real(), im = 0.5f * c[0].imag();
+        for (size_t i = 0; i < k; i++) {
+          const size_t t = 2 * i + 1;
+          re += d_coeffs[i] * (c[-(ptrdiff_t)t].real() + c[t].real());
+          im += d_coeffs[i] * (c[-(ptrdiff_t)t].imag() + c[t].imag());
+        }
+        out[nout++] = std::complex<float>(re, im);
+      }
+
+      d_offset = p - n;
+      memmove(&d_buf[0], &d_buf[n], hist * sizeof(std::complex<float>));
+      return nout;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,68 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_HALFBAND_DECIMATOR_H
+#define INCLUDED_BLADERF_HALFBAND_DECIMATOR_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Decimate-by-two halfband filter on a complex stream.
+     *
+     * Every other tap of a halfband filter is zero and the rest are
+     * symmetric, so an output costs one multiply per pair of nonzero taps
+     * plus the centre tap. Like fir_decimator, history is kept in a
+     * buffer sized for max_input samples per call.
+     */
+    class halfband_decimator
+    {
+     public:
+      /* Flat to passband (Hz) at an input rate of samp_rate */
+      halfband_decimator(double samp_rate, double passband,
+                         size_t max_input);
+
+      size_t filter(const std::complex<float> *in, size_t n,
+                    std::complex<float> *out);
+
+      void reset();
+
+      size_t ntaps() const { return 4 * d_coeffs.size() - 1; }
+
+      /* Real multiplies per output sample */
+      size_t multiplies() const { return 2 * (d_coeffs.size() + 1); }
+
+     private:
+      /* Taps at odd distances 1, 3, 5... from the centre */
+      std::vector<float> d_coeffs;
+      std::vector<std::complex<float> > d_buf;
+      size_t d_offset;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_HALFBAND_DECIMATOR_H */
@@ -0,0 +1,427 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/static_assert.hpp>
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "iq_bus.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Other processes share the counters, so they must not hide a lock */
+    BOOST_STATIC_ASSERT(BOOST_ATOMIC_INT32_LOCK_FREE == 2);
+    BOOST_STATIC_ASSERT(BOOST_ATOMIC_INT64_LOCK_FREE == 2);
+
+    static const char MAGIC[8] = { 'I', 'Q', 'B', 'U', 'S', '0', '1', 0 };
+
+    /* Segment sizes are whole huge pages so hugetlbfs accepts them */
+    static const size_t HUGE_PAGE = 2 << 20;
+    static const size_t PAGE = 4096;
+
+    /* Reader poll interval while waiting for the writer */
+    static const unsigned int POLL_US = 500;
+
+    static size_t
+    round_up(size_t n, size_t to)
+    {
+      return (n + to - 1) / to * to;
+    }
+
+    static bool
+    is_file(const std::string &name)
+    {
+      return name.find('/', 1) != std::string::npos;
+    }
+
+    static std::string
+    shm_name(const std::string &name)
+    {
+      return name[0] == '/' ? name : "/" + name;
+    }
+
+    static int
+    open_segment(const std::string &name, int flags)
+    {
+      if (is_file(name)) {
+        return open(name.c_str(), flags, 0644);
+      }
+      return shm_open(shm_name(name).c_str(), flags, 0644);
+    }
+
+    static void
+    remove_segment(const std::string &name)
+    {
+      if (is_file(name)) {
+        unlink(name.c_str());
+      } else {
+        shm_unlink(shm_name(name).c_str());
+      }
+    }
+
+    static bool
+    process_alive(int32_t pid)
+    {
+      return pid != 0 && (kill(pid, 0) == 0 || errno == EPERM);
+    }
+
+    static void
+    copy_frames(int16_t *out, const int16_t *in, size_t values)
+    {
+      memcpy(out, in, values * sizeof(int16_t));
+    }
+
+    static void
+    copy_frames(int16_t *out, const int8_t *in, size_t values)
+    {
+      for (size_t i = 0; i < values; i++) {
+        out[i] = (int16_t)(in[i] * 16);
+      }
+    }
+
+    iq_bus_writer::iq_bus_writer(const struct iq_bus_config &config)
+      : d_name(config.name)
+    {
+      if (config.name.empty() || config.capacity < 1 || config.nchan < 1) {
+        throw std::invalid_argument("iq_bus_writer: bad name, capacity or "
+                                    "channels");
+      }
+
+      /* A bus left by a writer that died is replaced; readers of it see
+       * the writer gone and can attach again */
+      int fd = open_segment(config.name, O_RDWR);
+      if (fd >= 0) {
+        char buf[sizeof(struct iq_bus_header)];
+        const struct iq_bus_header *old = (const struct iq_bus_header *)buf;
+        ssize_t got = pread(fd, buf, sizeof(buf), 0);
+        close(fd);
+        if (got == (ssize_t)sizeof(buf) &&
+            memcmp(old->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+            old->writer_pid != getpid() && process_alive(old->writer_pid)) {
+          throw std::runtime_error("iq_bus_writer: " + config.name +
+                                   " already has a writer");
+        }
+        remove_segment(config.name);
+      }
+
+      const size_t data_offset = round_up(sizeof(struct iq_bus_header),
+                                          PAGE);
+      d_map_size = round_up(data_offset + config.capacity * config.nchan *
+                            2 * sizeof(int16_t), HUGE_PAGE);
+
+      fd = open_segment(config.name, O_RDWR | O_CREAT | O_EXCL);
+      if (fd < 0) {
+        throw std::runtime_error("iq_bus_writer: unable to create " +
+                                 config.name + ": " + strerror(errno));
+      }
+      if (ftruncate(fd, d_map_size) != 0) {
+        close(fd);
+        remove_segment(config.name);
+        throw std::runtime_error("iq_bus_writer: unable to size " +
+                                 config.name);
+      }
+      void *map = mmap(NULL, d_map_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, 0);
+      close(fd);
+      if (map == MAP_FAILED) {
+        remove_segment(config.name);
+        throw std::runtime_error("iq_bus_writer: unable to map " +
+                                 config.name);
+      }
+
+      d_header = new (map) struct iq_bus_header;
+      d_header->data_offset = (uint32_t)data_offset;
+      d_header->nchan = (uint32_t)config.nchan;
+      d_header->capacity = config.capacity;
+      d_header->samp_rate = config.samp_rate;
+      d_header->center_freq = config.center_freq;
+      d_header->start_time = config.start_time;
+      d_header->writer_pid = getpid();
+      d_header->writing.store(0);
+      d_header->written.store(0);
+      for (size_t i = 0; i < IQ_BUS_MAX_READERS; i++) {
+        d_header->readers[i].pid.store(0);
+      }
+      d_data = (int16_t *)((char *)map + data_offset);
+
+      /* Readers check the magic last */
+      boost::atomic_thread_fence(boost::memory_order_release);
+      memcpy(d_header->magic, MAGIC, sizeof(MAGIC));
+    }
+
+    iq_bus_writer::~iq_bus_writer()
+    {
+      d_header->writer_pid = 0;
+      munmap(d_header, d_map_size);
+      remove_segment(d_name);
+    }
+
+    template <typename T>
+    void
+    iq_bus_writer::put(const T *frames, size_t n)
+    {
+      const size_t cap = d_header->capacity;
+      const size_t width = 2 * d_header->nchan;
+      uint64_t pos = d_header->written.load(boost::memory_order_relaxed);
+
+      if (n > cap) {
+        frames += (n - cap) * width;
+        pos += n - cap;
+        n = cap;
+      }
+
+      d_header->writing.store(pos + n, boost::memory_order_relaxed);
+      boost::atomic_thread_fence(boost::memory_order_release);
+
+      size_t slot = (size_t)(pos % cap);
+      size_t first = std::min(n, cap - slot);
+      copy_frames(d_data + slot * width, frames, first * width);
+      copy_frames(d_data, frames + first * width, (n - first) * width);
+
+      d_header->written.store(pos + n, boost::memory_order_release);
+    }
+
+    void
+    iq_bus_writer::write(const int16_t *frames, size_t n)
+    {
+      put(frames, n);
+    }
+
+    void
+    iq_bus_writer::write(const int8_t *frames, size_t n)
+    {
+      put(frames, n);
+    }
+
+    void
+    iq_bus_writer::gap(uint64_t n)
+    {
+      const size_t cap = d_header->capacity;
+      const size_t width = 2 * d_header->nchan;
+      const uint64_t end = d_header->written.load(
+        boost::memory_order_relaxed) + n;
+      const size_t zeros = (size_t)std::min(n, (uint64_t)cap);
+
+      d_header->writing.store(end, boost::memory_order_relaxed);
+      boost::atomic_thread_fence(boost::memory_order_release);
+
+      size_t slot = (size_t)((end - zeros) % cap);
+      size_t first = std::min(zeros, cap - slot);
+      memset(d_data + slot * width, 0, first * width * sizeof(int16_t));
+      memset(d_data, 0, (zeros - first) * width * sizeof(int16_t));
+
+      d_header->written.store(end, boost::memory_order_release);
+    }
+
+    uint64_t
+    iq_bus_writer::written() const
+    {
+      return d_header->written.load(boost::memory_order_relaxed);
+    }
+
+    size_t
+    iq_bus_writer::readers() const
+    {
+      size_t n = 0;
+      for (size_t i = 0; i < IQ_BUS_MAX_READERS; i++) {
+        if (process_alive(d_header->readers[i].pid.load())) {
+          n++;
+        }
+      }
+      return n;
+    }
+
+    uint64_t
+    iq_bus_writer::max_lag() const
+    {
+      const uint64_t written = this->written();
+      uint64_t lag = 0;
+      for (size_t i = 0; i < IQ_BUS_MAX_READERS; i++) {
+        const struct iq_bus_slot &s = d_header->readers[i];
+        if (process_alive(s.pid.load())) {
+          uint64_t pos = s.position.load(boost::memory_order_relaxed);
+          lag = std::max(lag, written > pos ? written - pos : 0);
+        }
+      }
+      return lag;
+    }
+
+    iq_bus_reader::iq_bus_reader(const std::string &name)
+      : d_slot(NULL),
+        d_dropped(0)
+    {
+      int fd = open_segment(name, O_RDWR);
+      if (fd < 0) {
+        throw std::runtime_error("iq_bus_reader: no bus " + name);
+      }
+
+      struct stat st;
+      void *map = MAP_FAILED;
+      if (fstat(fd, &st) == 0 &&
+          (size_t)st.st_size >= sizeof(struct iq_bus_header)) {
+        d_map_size = st.st_size;
+        map = mmap(NULL, d_map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+      }
+      close(fd);
+      if (map == MAP_FAILED) {
+        throw std::runtime_error("iq_bus_reader: unable to map " + name);
+      }
+
+      d_header = (struct iq_bus_header *)map;
+      const bool ok = memcmp(d_header->magic, MAGIC, sizeof(MAGIC)) == 0;
+      boost::atomic_thread_fence(boost::memory_order_acquire);
+      if (!ok || d_header->data_offset + d_header->capacity *
+          d_header->nchan * 2 * sizeof(int16_t) > d_map_size) {
+        munmap(map, d_map_size);
+        throw std::runtime_error("iq_bus_reader: " + name +
+                                 " is not a ready IQ bus");
+      }
+      d_data = (const int16_t *)((const char *)map + d_header->data_offset);
+
+      /* Free slots first, then those of readers that died */
+      const int32_t self = getpid();
+      for (int pass = 0; pass < 2 && d_slot == NULL; pass++) {
+        for (size_t i = 0; i < IQ_BUS_MAX_READERS; i++) {
+          struct iq_bus_slot &s = d_header->readers[i];
+          int32_t pid = s.pid.load();
+          if ((pass == 0 && pid == 0) ||
+              (pass == 1 && pid != 0 && !process_alive(pid))) {
+            if (s.pid.compare_exchange_strong(pid, self)) {
+              d_slot = &s;
+              break;
+            }
+          }
+        }
+      }
+      if (d_slot == NULL) {
+        munmap(map, d_map_size);
+        throw std::runtime_error("iq_bus_reader: " + name +
+                                 " has no free reader slot");
+      }
+
+      d_pos = d_header->written.load(boost::memory_order_acquire);
+      publish();
+    }
+
+    iq_bus_reader::~iq_bus_reader()
+    {
+      d_slot->pid.store(0);
+      munmap(d_header, d_map_size);
+    }
+
+    void
+    iq_bus_reader::publish()
+    {
+      d_slot->position.store(d_pos, boost::memory_order_relaxed);
+      d_slot->dropped.store(d_dropped, boost::memory_order_relaxed);
+    }
+
+    bool
+    iq_bus_reader::writer_alive() const
+    {
+      return process_alive(d_header->writer_pid);
+    }
+
+    const int16_t *
+    iq_bus_reader::acquire(size_t max, size_t *n, unsigned int timeout_ms)
+    {
+      const uint64_t cap = d_header->capacity;
+      const size_t width = 2 * d_header->nchan;
+      unsigned int waited_us = 0;
+
+      while (true) {
+        uint64_t written = d_header->written.load(
+          boost::memory_order_acquire);
+        uint64_t writing = d_header->writing.load(
+          boost::memory_order_acquire);
+        uint64_t oldest = writing > cap ? writing - cap : 0;
+
+        if (d_pos < oldest) {
+          uint64_t resume = std::max(oldest, written > cap / 2
+                                             ? written - cap / 2 : 0);
+          d_dropped += resume - d_pos;
+          d_pos = resume;
+          publish();
+        }
+        if (d_pos < written) {
+          size_t slot = (size_t)(d_pos % cap);
+          *n = (size_t)std::min((uint64_t)max,
+                                std::min(written - d_pos, cap - slot));
+          return d_data + slot * width;
+        }
+        if (waited_us >= timeout_ms * 1000) {
+          *n = 0;
+          return NULL;
+        }
+        usleep(POLL_US);
+        waited_us += POLL_US;
+      }
+    }
+
+    bool
+    iq_bus_reader::release(size_t n)
+    {
+      /* Frame pos is gone once the writer has started on pos + capacity */
+      boost::atomic_thread_fence(boost::memory_order_acquire);
+      bool valid = d_header->writing.load(boost::memory_order_relaxed) <=
+                   d_pos + d_header->capacity;
+      d_pos += n;
+      if (!valid) {
+        d_dropped += n;
+      }
+      publish();
+      return valid;
+    }
+
+    size_t
+    iq_bus_reader::read(int16_t *out, size_t max, unsigned int timeout_ms)
+    {
+      const size_t width = 2 * d_header->nchan;
+      size_t n;
+
+      while (true) {
+        const int16_t *frames = acquire(max, &n, timeout_ms);
+        if (frames == NULL) {
+          return 0;
+        }
+        memcpy(out, frames, n * width * sizeof(int16_t));
+        if (release(n)) {
+          return n;
+        }
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
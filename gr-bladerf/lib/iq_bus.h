@@ -0,0 +1,166 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_IQ_BUS_H
+#define INCLUDED_BLADERF_IQ_BUS_H
+
+#include <boost/atomic.hpp>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace gr {
+  namespace bladerf {
+
+    static const size_t IQ_BUS_MAX_READERS = 16;
+
+    /* One attached reader, as seen by everyone mapping the bus */
+    struct iq_bus_slot {
+      boost::atomic<int32_t> pid;       /* 0 when free */
+      boost::atomic<uint64_t> position; /* next frame it will read */
+      boost::atomic<uint64_t> dropped;  /* frames it lost to the writer */
+    };
+
+    /* Start of the shared segment; the ring follows at data_offset */
+    struct iq_bus_header {
+      char magic[8];                    /* "IQBUS01" */
+      uint32_t data_offset;
+      uint32_t nchan;
+      uint64_t capacity;                /* frames */
+      double samp_rate;
+      double center_freq;
+      double start_time;                /* Unix time of position 0 */
+      int32_t writer_pid;
+      uint32_t reserved;
+      boost::atomic<uint64_t> writing;  /* as in iq_ring */
+      boost::atomic<uint64_t> written;
+      struct iq_bus_slot readers[IQ_BUS_MAX_READERS];
+    };
+
+    struct iq_bus_config {
+      std::string name;    /* shm name, or a file path, e.g. on hugetlbfs */
+      size_t capacity;     /* frames */
+      size_t nchan;
+      double samp_rate;
+      double center_freq;
+      double start_time;
+    };
+
+    /*!
+     * \brief Publishes raw SC16 frames to other processes.
+     *
+     * The iq_ring protocol in a shared memory segment: the one writer,
+     * the thread that owns the radio, never waits for anybody, and each
+     * reader keeps its own cursor and finds out for itself whether the
+     * writer lapped it. A plain name ("frs") is a POSIX shared memory
+     * object; a name with a directory in it is a file, so the ring can
+     * live on a hugetlbfs mount. The segment is removed when the writer
+     * goes away; readers still attached keep their mapping.
+     */
+    class iq_bus_writer
+    {
+     public:
+      iq_bus_writer(const struct iq_bus_config &config);
+      ~iq_bus_writer();
+
+      void write(const int16_t *frames, size_t n);
+
+      /* SC8 Q7 frames, widened to Q11 on the way in */
+      void write(const int8_t *frames, size_t n);
+
+      /* n frames the radio lost, published as zeros */
+      void gap(uint64_t n);
+
+      uint64_t written() const;
+
+      /* Live readers, and the frames the slowest one is behind */
+      size_t readers() const;
+      uint64_t max_lag() const;
+
+     private:
+      std::string d_name;
+      struct iq_bus_header *d_header;
+      int16_t *d_data;
+      size_t d_map_size;
+
+      template <typename T>
+      void put(const T *frames, size_t n);
+    };
+
+    /*!
+     * \brief One reader of an iq_bus.
+     *
+     * acquire() hands out frames in place in the shared ring, so
+     * readers copy nothing they do not want to; release() then tells
+     * whether the writer reached them before the caller was done, in
+     * which case whatever was made of them must be thrown away. A
+     * reader lapped between calls skips to half a ring behind the
+     * writer and counts what it missed. Readers attach at the newest
+     * frame and occupy one of IQ_BUS_MAX_READERS slots, which a later
+     * reader may take over once its process has died.
+     */
+    class iq_bus_reader
+    {
+     public:
+      iq_bus_reader(const std::string &name);
+      ~iq_bus_reader();
+
+      /* Up to max contiguous frames at the cursor, waiting up to
+       * timeout_ms for the writer; NULL with *n = 0 on timeout */
+      const int16_t *acquire(size_t max, size_t *n,
+                             unsigned int timeout_ms);
+
+      /* Move past n acquired frames; false if they were overwritten */
+      bool release(size_t n);
+
+      /* Copying acquire()/release(); frames lost in the copy are
+       * counted as dropped and not returned */
+      size_t read(int16_t *out, size_t max, unsigned int timeout_ms);
+
+      uint64_t position() const { return d_pos; }
+      uint64_t dropped() const { return d_dropped; }
+
+      size_t nchan() const { return d_header->nchan; }
+      size_t capacity() const { return d_header->capacity; }
+      double samp_rate() const { return d_header->samp_rate; }
+      double center_freq() const { return d_header->center_freq; }
+      double start_time() const { return d_header->start_time; }
+
+      /* False once the publishing process has exited */
+      bool writer_alive() const;
+
+     private:
+      struct iq_bus_header *d_header;
+      const int16_t *d_data;
+      size_t d_map_size;
+      struct iq_bus_slot *d_slot;
+      uint64_t d_pos;
+      uint64_t d_dropped;
+
+      void publish();
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_IQ_BUS_H */
@@ -0,0 +1,107 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include "iq_ring.h"
+
+namespace gr {
+  namespace bladerf {
+
+    iq_ring::iq_ring(size_t capacity, size_t nchan)
+      : d_capacity(capacity),
+        d_nchan(nchan),
+        d_writing(0),
+        d_written(0)
+    {
+      if (capacity < 1 || nchan < 1) {
+        throw std::invalid_argument("iq_ring: empty ring");
+      }
+      d_buf.resize(capacity * nchan * 2);
+    }
+
+    void
+    iq_ring::write(const int16_t *frames, size_t n)
+    {
+      const size_t width = 2 * d_nchan;
+      uint64_t pos = d_written.load(boost::memory_order_relaxed);
+
+      /* Only the last capacity frames of an oversized write survive */
+      if (n > d_capacity) {
+        frames += (n - d_capacity) * width;
+        pos += n - d_capacity;
+        n = d_capacity;
+      }
+
+      d_writing.store(pos + n, boost::memory_order_relaxed);
+      boost::atomic_thread_fence(boost::memory_order_release);
+
+      size_t slot = (size_t)(pos % d_capacity);
+      size_t first = std::min(n, d_capacity - slot);
+      memcpy(&d_buf[slot * width], frames, first * width * sizeof(int16_t));
+      memcpy(&d_buf[0], frames + first * width,
+             (n - first) * width * sizeof(int16_t));
+
+      d_written.store(pos + n, boost::memory_order_release);
+    }
+
+    uint64_t
+    iq_ring::written() const
+    {
+      return d_written.load(boost::memory_order_acquire);
+    }
+
+    uint64_t
+    iq_ring::oldest() const
+    {
+      uint64_t writing = d_writing.load(boost::memory_order_acquire);
+      return writing > d_capacity ? writing - d_capacity : 0;
+    }
+
+    bool
+    iq_ring::read(uint64_t pos, size_t n, int16_t *out) const
+    {
+      const size_t width = 2 * d_nchan;
+
+      if (n > d_capacity || pos + n > written() || pos < oldest()) {
+        return false;
+      }
+
+      size_t slot = (size_t)(pos % d_capacity);
+      size_t first = std::min(n, d_capacity - slot);
+      memcpy(out, &d_buf[slot * width], first * width * sizeof(int16_t));
+      memcpy(out + first * width, &d_buf[0],
+             (n - first) * width * sizeof(int16_t));
+
+      /* Frame pos is gone once the writer has started on pos + capacity */
+      boost::atomic_thread_fence(boost::memory_order_acquire);
+      return d_writing.load(boost::memory_order_relaxed) <=
+             pos + d_capacity;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,76 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_IQ_RING_H
+#define INCLUDED_BLADERF_IQ_RING_H
+
+#include <boost/atomic.hpp>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Ring of the most recent raw SC16 frames.
+     *
+     * A single writer, normally the RX thread, appends with write(),
+     * which never blocks and takes no lock: it announces how far it is
+     * about to write, copies, then publishes the new total. Readers on
+     * other threads copy frames out by absolute position and find out
+     * afterwards whether the writer lapped them during the copy, the
+     * same way a seqlock reader does. Positions count frames from the
+     * first write; a frame holds one I/Q pair per channel.
+     */
+    class iq_ring
+    {
+     public:
+      iq_ring(size_t capacity, size_t nchan);
+
+      /* Writer side */
+      void write(const int16_t *frames, size_t n);
+
+      /* Frames written so far, and the oldest one still held */
+      uint64_t written() const;
+      uint64_t oldest() const;
+
+      /* Copy frames [pos, pos + n) to out. Returns false, with out
+       * undefined, unless all of them were written and none was
+       * overwritten before the copy finished. */
+      bool read(uint64_t pos, size_t n, int16_t *out) const;
+
+      size_t capacity() const { return d_capacity; }
+      size_t nchan() const { return d_nchan; }
+
+     private:
+      size_t d_capacity;
+      size_t d_nchan;
+      std::vector<int16_t> d_buf;
+      boost::atomic<uint64_t> d_writing;  /* end of the write under way */
+      boost::atomic<uint64_t> d_written;  /* end of the last whole write */
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_IQ_RING_H */
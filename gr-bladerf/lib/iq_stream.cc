@@ -0,0 +1,799 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <endian.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "bounded_queue.h"
+#include "iq_stream.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const char HELLO_MAGIC[8] = "IQSTRM1";
+    static const char BLOCK_MAGIC[4] = { 'I', 'Q', 'B', 'K' };
+
+    /* Raw bytes of a block sent over UDP; bigger blocks are split */
+    static const size_t UDP_PAYLOAD = 8192;
+
+    /* How long the threads sleep between looking at the running flag,
+     * and how long a peer may stall a message once it has begun */
+    static const int POLL_MS = 100;
+    static const int STALL_MS = 5000;
+
+    static inline void
+    put16(uint8_t *p, uint16_t v)
+    {
+      v = htole16(v);
+      memcpy(p, &v, sizeof(v));
+    }
+
+    static inline void
+    put32(uint8_t *p, uint32_t v)
+    {
+      v = htole32(v);
+      memcpy(p, &v, sizeof(v));
+    }
+
+    static inline void
+    put64(uint8_t *p, uint64_t v)
+    {
+      v = htole64(v);
+      memcpy(p, &v, sizeof(v));
+    }
+
+    static inline void
+    put_double(uint8_t *p, double d)
+    {
+      uint64_t v;
+      memcpy(&v, &d, sizeof(v));
+      put64(p, v);
+    }
+
+    static inline uint16_t
+    get16(const uint8_t *p)
+    {
+      uint16_t v;
+      memcpy(&v, p, sizeof(v));
+      return le16toh(v);
+    }
+
+    static inline uint32_t
+    get32(const uint8_t *p)
+    {
+      uint32_t v;
+      memcpy(&v, p, sizeof(v));
+      return le32toh(v);
+    }
+
+    static inline uint64_t
+    get64(const uint8_t *p)
+    {
+      uint64_t v;
+      memcpy(&v, p, sizeof(v));
+      return le64toh(v);
+    }
+
+    static inline double
+    get_double(const uint8_t *p)
+    {
+      uint64_t v = get64(p);
+      double d;
+      memcpy(&d, &v, sizeof(d));
+      return d;
+    }
+
+    static void
+    put_hello(uint8_t *p, const struct iq_stream_hello &h)
+    {
+      memset(p, 0, IQ_STREAM_HELLO_BYTES);
+      memcpy(p, HELLO_MAGIC, sizeof(HELLO_MAGIC));
+      put32(p + 8, h.nchan);
+      put32(p + 12, h.block_frames);
+      put_double(p + 16, h.samp_rate);
+      put_double(p + 24, h.center_freq);
+      put_double(p + 32, h.start_time);
+    }
+
+    static bool
+    get_hello(const uint8_t *p, size_t len, struct iq_stream_hello *h)
+    {
+      if (len != IQ_STREAM_HELLO_BYTES ||
+          memcmp(p, HELLO_MAGIC, sizeof(HELLO_MAGIC)) != 0) {
+        return false;
+      }
+      h->nchan = get32(p + 8);
+      h->block_frames = get32(p + 12);
+      h->samp_rate = get_double(p + 16);
+      h->center_freq = get_double(p + 24);
+      h->start_time = get_double(p + 32);
+      return h->nchan > 0 && h->block_frames > 0 && h->samp_rate > 0;
+    }
+
+    static void
+    put_header(uint8_t *p, const struct iq_stream_header &h)
+    {
+      memset(p, 0, IQ_STREAM_HEADER_BYTES);
+      memcpy(p, BLOCK_MAGIC, sizeof(BLOCK_MAGIC));
+      put16(p + 4, h.codec);
+      put16(p + 6, h.nchan);
+      put32(p + 8, h.seq);
+      put32(p + 12, h.nframes);
+      put64(p + 16, h.position);
+      put64(p + 24, h.dropped);
+      put32(p + 32, h.bytes);
+    }
+
+    static bool
+    get_header(const uint8_t *p, size_t len, struct iq_stream_header *h)
+    {
+      if (len < IQ_STREAM_HEADER_BYTES ||
+          memcmp(p, BLOCK_MAGIC, sizeof(BLOCK_MAGIC)) != 0) {
+        return false;
+      }
+      h->codec = get16(p + 4);
+      h->nchan = get16(p + 6);
+      h->seq = get32(p + 8);
+      h->nframes = get32(p + 12);
+      h->position = get64(p + 16);
+      h->dropped = get64(p + 24);
+      h->bytes = get32(p + 32);
+      return true;
+    }
+
+    static int64_t
+    now_ms()
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    /* 1 when fd is readable, 0 on timeout, -1 on error */
+    static int
+    wait_readable(int fd, int timeout_ms)
+    {
+      struct pollfd pfd;
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+      for (;;) {
+        int r = poll(&pfd, 1, timeout_ms);
+        if (r < 0 && errno == EINTR) {
+          continue;
+        }
+        return r < 0 ? -1 : (r > 0 ? 1 : 0);
+      }
+    }
+
+    static bool
+    send_all(int fd, const uint8_t *p, size_t n, int flags)
+    {
+      while (n > 0) {
+        ssize_t r = send(fd, p, n, flags | MSG_NOSIGNAL);
+        if (r < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return false;
+        }
+        p += r;
+        n -= r;
+      }
+      return true;
+    }
+
+    static bool
+    recv_all(int fd, uint8_t *p, size_t n)
+    {
+      while (n > 0) {
+        if (wait_readable(fd, STALL_MS) <= 0) {
+          return false;
+        }
+        ssize_t r = recv(fd, p, n, 0);
+        if (r < 0 && errno == EINTR) {
+          continue;
+        }
+        if (r <= 0) {
+          return false;
+        }
+        p += r;
+        n -= r;
+      }
+      return true;
+    }
+
+    /* A socket of type connected to (or, passive, bound to) address */
+    static int
+    open_socket(const std::string &address, int type, bool passive,
+                const char *who)
+    {
+      std::string host;
+      unsigned short port;
+      if (!parse_stream_address(address, &host, &port)) {
+        throw std::invalid_argument(std::string(who) + ": bad address " +
+                                    address);
+      }
+
+      struct addrinfo hints, *res;
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = type;
+      hints.ai_flags = passive ? AI_PASSIVE : 0;
+      char service[8];
+      snprintf(service, sizeof(service), "%u", port);
+      int err = getaddrinfo(host.empty() ? NULL : host.c_str(), service,
+                            &hints, &res);
+      if (err != 0) {
+        throw std::runtime_error(std::string(who) + ": " + address + ": " +
+                                 gai_strerror(err));
+      }
+
+      int fd = -1;
+      int saved = 0;
+      for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+          saved = errno;
+          continue;
+        }
+        int one = 1;
+        if (passive) {
+          setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        }
+        if ((passive ? bind(fd, ai->ai_addr, ai->ai_addrlen)
+                     : connect(fd, ai->ai_addr, ai->ai_addrlen)) == 0) {
+          break;
+        }
+        saved = errno;
+        close(fd);
+        fd = -1;
+      }
+      freeaddrinfo(res);
+
+      if (fd < 0) {
+        throw std::runtime_error(std::string(who) + ": " + address + ": " +
+                                 strerror(saved));
+      }
+      return fd;
+    }
+
+    bool
+    parse_stream_address(const std::string &address, std::string *host,
+                         unsigned short *port)
+    {
+      size_t colon = address.rfind(':');
+      std::string p = colon == std::string::npos ? address
+                                                 : address.substr(colon + 1);
+      char *end;
+      long v = strtol(p.c_str(), &end, 10);
+      if (p.empty() || *end != '\0' || v < 0 || v > 65535) {
+        return false;
+      }
+      *host = colon == std::string::npos ? "" : address.substr(0, colon);
+      /* [::1]:port */
+      if (host->size() >= 2 && (*host)[0] == '[' &&
+          (*host)[host->size() - 1] == ']') {
+        *host = host->substr(1, host->size() - 2);
+      }
+      *port = (unsigned short)v;
+      return true;
+    }
+
+    struct iq_stream_config
+    default_iq_stream_config(unsigned short port, double samp_rate)
+    {
+      struct iq_stream_config c;
+      c.port = port;
+      c.codec = SC16_CODEC_NONE;
+      c.block_frames = 16384;
+      c.queue_blocks = 64;
+      c.block_when_full = false;
+      c.nchan = 1;
+      c.samp_rate = samp_rate;
+      c.center_freq = 0;
+      c.start_time = 0;
+      return c;
+    }
+
+    /*
+     * Server
+     */
+
+    struct iq_stream_server::session {
+      session(int fd, bool datagram, size_t depth)
+        : fd(fd), datagram(datagram), queue(depth), alive(true),
+          dropped(0), seq(0), next_hello(0)
+      {
+      }
+
+      int fd;
+      bool datagram;
+      bounded_queue<block_ptr> queue;
+      boost::atomic<bool> alive;
+      boost::atomic<uint64_t> dropped;
+      uint32_t seq;
+      uint64_t next_hello;         /* UDP: position of the next hello */
+      boost::thread thread;
+    };
+
+    iq_stream_server::iq_stream_server(const struct iq_stream_config &config)
+      : d_config(config),
+        d_listen(-1),
+        d_port(0),
+        d_running(true),
+        d_fill(0),
+        d_position(0),
+        d_dropped(0),
+        d_raw_bytes(0),
+        d_encoded_bytes(0)
+    {
+      if (config.nchan < 1 || config.nchan > 0xffff ||
+          config.block_frames < 1 || config.queue_blocks < 1 ||
+          config.samp_rate <= 0) {
+        throw std::invalid_argument("iq_stream_server: bad configuration");
+      }
+      if (!config.udp.empty()) {
+        d_config.block_frames = std::max((size_t)1, std::min(
+          config.block_frames, UDP_PAYLOAD / (4 * config.nchan)));
+      }
+      d_pending.resize(d_config.block_frames * 2 * d_config.nchan);
+
+      struct iq_stream_hello h;
+      h.nchan = d_config.nchan;
+      h.block_frames = d_config.block_frames;
+      h.samp_rate = d_config.samp_rate;
+      h.center_freq = d_config.center_freq;
+      h.start_time = d_config.start_time;
+      d_hello.resize(IQ_STREAM_HELLO_BYTES);
+      put_hello(&d_hello[0], h);
+
+      if (!config.udp.empty()) {
+        add_session(open_socket(config.udp, SOCK_DGRAM, false,
+                                "iq_stream_server"), true);
+        return;
+      }
+
+      char address[8];
+      snprintf(address, sizeof(address), ":%u", config.port);
+      d_listen = open_socket(address, SOCK_STREAM, true, "iq_stream_server");
+      struct sockaddr_storage sa;
+      socklen_t len = sizeof(sa);
+      if (listen(d_listen, 8) != 0 ||
+          getsockname(d_listen, (struct sockaddr *)&sa, &len) != 0) {
+        int err = errno;
+        close(d_listen);
+        throw std::runtime_error(std::string("iq_stream_server: unable to "
+                                             "listen: ") + strerror(err));
+      }
+      d_port = ntohs(sa.ss_family == AF_INET6
+                     ? ((struct sockaddr_in6 *)&sa)->sin6_port
+                     : ((struct sockaddr_in *)&sa)->sin_port);
+      d_accept_thread = boost::thread(
+        boost::bind(&iq_stream_server::accept_loop, this));
+    }
+
+    iq_stream_server::~iq_stream_server()
+    {
+      flush();
+      d_running = false;
+      d_accept_thread.join();
+      if (d_listen >= 0) {
+        close(d_listen);
+      }
+
+      /* Senders finish what is queued, or give up on a stalled peer */
+      std::vector<session_ptr> sessions;
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        sessions.swap(d_sessions);
+      }
+      for (size_t i = 0; i < sessions.size(); i++) {
+        sessions[i]->queue.close();
+        sessions[i]->thread.join();
+      }
+    }
+
+    iq_stream_server::session_ptr
+    iq_stream_server::add_session(int fd, bool datagram)
+    {
+      session_ptr s(new session(fd, datagram, d_config.queue_blocks));
+      s->thread = boost::thread(
+        boost::bind(&iq_stream_server::send_loop, this, s));
+      boost::mutex::scoped_lock lock(d_mutex);
+      d_sessions.push_back(s);
+      return s;
+    }
+
+    void
+    iq_stream_server::accept_loop()
+    {
+      while (d_running) {
+        if (wait_readable(d_listen, POLL_MS) <= 0) {
+          continue;
+        }
+        int fd = accept(d_listen, NULL, NULL);
+        if (fd < 0) {
+          continue;
+        }
+        int one = 1;
+        struct timeval tv;
+        tv.tv_sec = STALL_MS / 1000;
+        tv.tv_usec = 0;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        add_session(fd, false);
+      }
+    }
+
+    void
+    iq_stream_server::send_loop(session_ptr s)
+    {
+      uint8_t header[IQ_STREAM_HEADER_BYTES];
+
+      if (!s->datagram && !send_all(s->fd, &d_hello[0], d_hello.size(), 0)) {
+        s->alive = false;
+      }
+
+      while (s->alive) {
+        block_ptr b;
+        if (!s->queue.pop(b, POLL_MS)) {
+          if (!d_running) {
+            break;
+          }
+          continue;
+        }
+
+        if (s->datagram && b->position >= s->next_hello) {
+          send(s->fd, &d_hello[0], d_hello.size(), MSG_NOSIGNAL);
+          s->next_hello = b->position + (uint64_t)d_config.samp_rate;
+        }
+
+        struct iq_stream_header h;
+        h.codec = b->codec;
+        h.nchan = d_config.nchan;
+        h.seq = s->seq++;
+        h.nframes = b->nframes;
+        h.position = b->position;
+        h.dropped = s->dropped;
+        h.bytes = b->payload.size();
+        put_header(header, h);
+
+        if (s->datagram) {
+          /* Nobody listening yet is not an error for UDP */
+          struct iovec iov[2];
+          struct msghdr msg;
+          iov[0].iov_base = header;
+          iov[0].iov_len = sizeof(header);
+          iov[1].iov_base = (void *)&b->payload[0];
+          iov[1].iov_len = b->payload.size();
+          memset(&msg, 0, sizeof(msg));
+          msg.msg_iov = iov;
+          msg.msg_iovlen = 2;
+          sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+        } else if (!send_all(s->fd, header, sizeof(header), MSG_MORE) ||
+                   !send_all(s->fd, &b->payload[0], b->payload.size(), 0)) {
+          s->alive = false;
+        }
+      }
+
+      /* Wakes a writer waiting on a full queue */
+      s->alive = false;
+      s->queue.close();
+      close(s->fd);
+    }
+
+    void
+    iq_stream_server::dispatch(block_ptr b)
+    {
+      std::vector<session_ptr> live, dead;
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        for (size_t i = 0; i < d_sessions.size(); i++) {
+          (d_sessions[i]->alive ? live : dead).push_back(d_sessions[i]);
+        }
+        d_sessions = live;
+      }
+      for (size_t i = 0; i < dead.size(); i++) {
+        dead[i]->thread.join();
+      }
+
+      for (size_t i = 0; i < live.size(); i++) {
+        bool queued = d_config.block_when_full ? live[i]->queue.push(b)
+                                               : live[i]->queue.try_push(b);
+        if (!queued && live[i]->alive) {
+          live[i]->dropped += b->nframes;
+          d_dropped += b->nframes;
+        }
+      }
+    }
+
+    void
+    iq_stream_server::write(const int16_t *frames, size_t n)
+    {
+      const size_t stride = 2 * d_config.nchan;
+      while (n > 0) {
+        size_t k = std::min(n, d_config.block_frames - d_fill);
+        memcpy(&d_pending[d_fill * stride], frames,
+               k * stride * sizeof(int16_t));
+        d_fill += k;
+        frames += k * stride;
+        n -= k;
+        if (d_fill == d_config.block_frames) {
+          flush();
+        }
+      }
+    }
+
+    void
+    iq_stream_server::gap(uint64_t n)
+    {
+      flush();
+      d_position += n;
+    }
+
+    void
+    iq_stream_server::flush()
+    {
+      if (d_fill == 0) {
+        return;
+      }
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        if (d_sessions.empty()) {
+          d_position += d_fill;
+          d_fill = 0;
+          return;
+        }
+      }
+
+      boost::shared_ptr<block> b(new block);
+      const size_t raw = d_fill * 4 * d_config.nchan;
+      b->codec = sc16_encode(d_config.codec, &d_pending[0], d_fill,
+                             d_config.nchan, b->payload);
+      b->nframes = d_fill;
+      b->position = d_position;
+      d_raw_bytes += raw;
+      d_encoded_bytes += b->payload.size();
+
+      d_position += d_fill;
+      d_fill = 0;
+      dispatch(b);
+    }
+
+    size_t
+    iq_stream_server::clients()
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      size_t n = 0;
+      for (size_t i = 0; i < d_sessions.size(); i++) {
+        n += d_sessions[i]->alive && !d_sessions[i]->datagram;
+      }
+      return n;
+    }
+
+    /*
+     * Client
+     */
+
+    iq_stream_client::iq_stream_client(const std::string &address, bool udp,
+                                       unsigned int timeout_ms)
+      : d_fd(-1),
+        d_udp(udp),
+        d_connected(true),
+        d_msg_len(0),
+        d_frames(0),
+        d_offset(0),
+        d_started(false),
+        d_pos(0),
+        d_pending_gap(0),
+        d_lost(0),
+        d_server_dropped(0),
+        d_discarded(0)
+    {
+      memset(&d_hello, 0, sizeof(d_hello));
+      d_fd = open_socket(address, udp ? SOCK_DGRAM : SOCK_STREAM, udp,
+                         "iq_stream_client");
+      if (udp) {
+        /* Enough for a good fraction of a second at full rate */
+        int size = 8 << 20;
+        setsockopt(d_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        d_msg.resize(65536);
+      } else {
+        d_msg.resize(IQ_STREAM_HELLO_BYTES);
+      }
+
+      /* Over UDP blocks ahead of the first hello are of no use */
+      const int64_t deadline = now_ms() + timeout_ms;
+      for (;;) {
+        int64_t left = deadline - now_ms();
+        if (left < 0 || !receive_message(left)) {
+          close(d_fd);
+          throw std::runtime_error("iq_stream_client: no stream at " +
+                                   address);
+        }
+        if (get_hello(&d_msg[0], d_msg_len, &d_hello)) {
+          break;
+        }
+        if (!udp) {
+          close(d_fd);
+          throw std::runtime_error("iq_stream_client: " + address +
+                                   " is not an IQ stream");
+        }
+      }
+    }
+
+    iq_stream_client::~iq_stream_client()
+    {
+      close(d_fd);
+    }
+
+    bool
+    iq_stream_client::receive_message(unsigned int timeout_ms)
+    {
+      if (!d_connected) {
+        return false;
+      }
+      int r = wait_readable(d_fd, timeout_ms);
+      if (r == 0) {
+        return false;
+      }
+      if (r < 0) {
+        d_connected = false;
+        return false;
+      }
+
+      if (d_udp) {
+        ssize_t n = recv(d_fd, &d_msg[0], d_msg.size(), 0);
+        d_msg_len = n > 0 ? n : 0;
+        return true;
+      }
+
+      /* A stream: the magic says how much more belongs to the message */
+      uint8_t *p = &d_msg[0];
+      size_t have = 4;
+      if (!recv_all(d_fd, p, have)) {
+        d_connected = false;
+        return false;
+      }
+      if (memcmp(p, HELLO_MAGIC, 4) == 0) {
+        d_msg_len = IQ_STREAM_HELLO_BYTES;
+      } else if (memcmp(p, BLOCK_MAGIC, 4) == 0 && d_hello.nchan > 0) {
+        d_msg.resize(std::max(d_msg.size(), IQ_STREAM_HEADER_BYTES));
+        p = &d_msg[0];
+        if (!recv_all(d_fd, p + 4, IQ_STREAM_HEADER_BYTES - 4)) {
+          d_connected = false;
+          return false;
+        }
+        struct iq_stream_header h;
+        if (!get_header(p, IQ_STREAM_HEADER_BYTES, &h) ||
+            h.bytes > sc16_max_encoded(SC16_CODEC_NONE,
+                                       d_hello.block_frames, d_hello.nchan)) {
+          d_connected = false;
+          return false;
+        }
+        d_msg_len = IQ_STREAM_HEADER_BYTES + h.bytes;
+        have = IQ_STREAM_HEADER_BYTES;
+      } else {
+        d_connected = false;
+        return false;
+      }
+
+      d_msg.resize(std::max(d_msg.size(), d_msg_len));
+      if (!recv_all(d_fd, &d_msg[have], d_msg_len - have)) {
+        d_connected = false;
+        return false;
+      }
+      return true;
+    }
+
+    bool
+    iq_stream_client::receive(unsigned int timeout_ms)
+    {
+      const int64_t deadline = now_ms() + timeout_ms;
+
+      for (;;) {
+        int64_t left = std::max(deadline - now_ms(), (int64_t)0);
+        if (!receive_message(left)) {
+          return false;
+        }
+
+        struct iq_stream_hello hello;
+        if (get_hello(&d_msg[0], d_msg_len, &hello)) {
+          continue;
+        }
+
+        struct iq_stream_header h;
+        bool ok = get_header(&d_msg[0], d_msg_len, &h) &&
+                  h.nchan == d_hello.nchan && h.nframes > 0 &&
+                  h.nframes <= d_hello.block_frames &&
+                  d_msg_len == IQ_STREAM_HEADER_BYTES + h.bytes;
+        if (ok) {
+          d_block.resize(h.nframes * 2 * d_hello.nchan);
+          ok = sc16_decode((enum sc16_codec_type)h.codec,
+                           &d_msg[IQ_STREAM_HEADER_BYTES], h.bytes,
+                           h.nframes, d_hello.nchan, &d_block[0]);
+        }
+        if (!ok) {
+          /* A TCP stream out of step cannot be resynchronised */
+          if (!d_udp) {
+            d_connected = false;
+            return false;
+          }
+          d_discarded++;
+          continue;
+        }
+
+        /* Datagrams overtaken by later ones */
+        if (d_started && h.position < d_pos) {
+          d_discarded++;
+          continue;
+        }
+        if (d_started && h.position > d_pos) {
+          d_pending_gap += h.position - d_pos;
+          d_lost += h.position - d_pos;
+        }
+        d_server_dropped = h.dropped;
+        d_started = true;
+        d_pos = h.position;
+        d_frames = h.nframes;
+        d_offset = 0;
+        return true;
+      }
+    }
+
+    size_t
+    iq_stream_client::read(int16_t *out, size_t max, unsigned int timeout_ms,
+                           uint64_t *gap)
+    {
+      *gap = 0;
+      if (d_offset == d_frames && !receive(timeout_ms)) {
+        return 0;
+      }
+
+      const size_t stride = 2 * d_hello.nchan;
+      size_t n = std::min(max, d_frames - d_offset);
+      memcpy(out, &d_block[d_offset * stride], n * stride * sizeof(int16_t));
+      *gap = d_pending_gap;
+      d_pending_gap = 0;
+      d_offset += n;
+      d_pos += n;
+      return n;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
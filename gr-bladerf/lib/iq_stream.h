@@ -0,0 +1,226 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_IQ_STREAM_H
+#define INCLUDED_BLADERF_IQ_STREAM_H
+
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "sc16_codec.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /*
+     * Wire format, every field little-endian. A TCP connection starts
+     * with a hello from the server and then carries blocks; over UDP
+     * each datagram is one of the two, and the hello is repeated about
+     * once a second so a client can join at any time.
+     */
+    static const size_t IQ_STREAM_HELLO_BYTES = 48;
+    static const size_t IQ_STREAM_HEADER_BYTES = 40;
+
+    struct iq_stream_hello {
+      /* "IQSTRM1" on the wire */
+      uint32_t nchan;
+      uint32_t block_frames;       /* most frames in one block */
+      double samp_rate;
+      double center_freq;
+      double start_time;           /* Unix time of position 0 */
+    };
+
+    struct iq_stream_header {
+      /* "IQBK" on the wire */
+      uint16_t codec;              /* sc16_codec_type of the payload */
+      uint16_t nchan;
+      uint32_t seq;                /* per client, or per datagram */
+      uint32_t nframes;
+      uint64_t position;           /* stream position of the first frame */
+      uint64_t dropped;            /* frames dropped for this client */
+      uint32_t bytes;              /* payload following the header */
+    };
+
+    struct iq_stream_config {
+      unsigned short port;         /* TCP port to listen on, 0 for any */
+      std::string udp;             /* "host:port" to send UDP to instead */
+      enum sc16_codec_type codec;
+      size_t block_frames;
+      size_t queue_blocks;         /* per client */
+      bool block_when_full;        /* wait for slow clients, not drop */
+      size_t nchan;
+      double samp_rate;
+      double center_freq;
+      double start_time;
+    };
+
+    /* A config for a one channel TCP server on port with no compression */
+    struct iq_stream_config default_iq_stream_config(unsigned short port,
+                                                     double samp_rate);
+
+    /* Split "host:port"; an empty host means any local address */
+    bool parse_stream_address(const std::string &address,
+                              std::string *host, unsigned short *port);
+
+    /*!
+     * \brief Serves an SC16 stream to clients on other machines.
+     *
+     * write() collects frames into blocks, encodes each block once and
+     * queues it for every client; one sender thread per client moves
+     * its queue to the socket, so the caller, typically the thread that
+     * owns the radio, only ever waits on the encoder. A client whose
+     * socket does not keep up fills its queue, and what does not fit is
+     * then dropped for that client alone and accounted in the next block
+     * it gets, or, with block_when_full, holds the writer back instead,
+     * which is what a file being served wants. Lost radio samples
+     * (gap()) are not sent at all: the block positions jump over them.
+     */
+    class iq_stream_server
+    {
+     public:
+      iq_stream_server(const struct iq_stream_config &config);
+      ~iq_stream_server();
+
+      void write(const int16_t *frames, size_t n);
+      void gap(uint64_t n);
+
+      /* Send the partial block now */
+      void flush();
+
+      /* TCP port actually listened on */
+      unsigned short port() const { return d_port; }
+
+      size_t clients();
+      uint64_t position() const { return d_position + d_fill; }
+
+      /* Frames dropped across all clients, bytes queued before and
+       * after encoding */
+      uint64_t dropped() const { return d_dropped; }
+      uint64_t raw_bytes() const { return d_raw_bytes; }
+      uint64_t encoded_bytes() const { return d_encoded_bytes; }
+
+     private:
+      struct block {
+        uint16_t codec;
+        uint32_t nframes;
+        uint64_t position;
+        std::vector<uint8_t> payload;
+      };
+      struct session;
+      typedef boost::shared_ptr<const block> block_ptr;
+      typedef boost::shared_ptr<session> session_ptr;
+
+      struct iq_stream_config d_config;
+      std::vector<uint8_t> d_hello;
+      int d_listen;
+      unsigned short d_port;
+      boost::atomic<bool> d_running;
+      boost::thread d_accept_thread;
+
+      boost::mutex d_mutex;
+      std::vector<session_ptr> d_sessions;
+
+      std::vector<int16_t> d_pending;
+      size_t d_fill;
+      uint64_t d_position;
+      boost::atomic<uint64_t> d_dropped;
+      uint64_t d_raw_bytes;
+      uint64_t d_encoded_bytes;
+
+      void accept_loop();
+      void send_loop(session_ptr s);
+      session_ptr add_session(int fd, bool datagram);
+      void dispatch(block_ptr b);
+    };
+
+    /*!
+     * \brief Receives a stream from an iq_stream_server.
+     *
+     * Blocks are decoded as they arrive and handed out in frames by
+     * read(), which never returns frames from both sides of a hole: the
+     * frames missing before the first one it returns are reported in
+     * *gap, whether the server dropped them, the radio lost them or a
+     * datagram did not arrive. Over UDP the client binds the port the
+     * server sends to and waits for a hello before it returns.
+     */
+    class iq_stream_client
+    {
+     public:
+      /* "host:port" to connect to, or with udp the local "host:port"
+       * to bind, host optional */
+      iq_stream_client(const std::string &address, bool udp = false,
+                       unsigned int timeout_ms = 5000);
+      ~iq_stream_client();
+
+      /* Up to max frames, waiting up to timeout_ms for a block; 0 on
+       * timeout or once the server is gone */
+      size_t read(int16_t *out, size_t max, unsigned int timeout_ms,
+                  uint64_t *gap);
+
+      /* Stream position of the next frame read() returns */
+      uint64_t position() const { return d_pos; }
+
+      /* Frames missing from the stream so far, and of those the ones
+       * the server says it dropped */
+      uint64_t lost() const { return d_lost; }
+      uint64_t server_dropped() const { return d_server_dropped; }
+
+      /* Datagrams that arrived too late or failed to decode */
+      uint64_t discarded() const { return d_discarded; }
+
+      bool connected() const { return d_connected; }
+
+      size_t nchan() const { return d_hello.nchan; }
+      double samp_rate() const { return d_hello.samp_rate; }
+      double center_freq() const { return d_hello.center_freq; }
+      double start_time() const { return d_hello.start_time; }
+
+     private:
+      int d_fd;
+      bool d_udp;
+      bool d_connected;
+      struct iq_stream_hello d_hello;
+      std::vector<uint8_t> d_msg;
+      size_t d_msg_len;
+      std::vector<int16_t> d_block;
+      size_t d_frames;             /* frames in d_block */
+      size_t d_offset;             /* frames of it read already */
+      bool d_started;
+      uint64_t d_pos;
+      uint64_t d_pending_gap;
+      uint64_t d_lost;
+      uint64_t d_server_dropped;
+      uint64_t d_discarded;
+
+      bool receive(unsigned int timeout_ms);
+      bool receive_message(unsigned int timeout_ms);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_IQ_STREAM_H */
@@ -0,0 +1,239 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include <string.h>
+#include "loopback_sim.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static boost::posix_time::ptime
+    wall_now()
+    {
+      return boost::posix_time::microsec_clock::universal_time();
+    }
+
+    loopback_sim::loopback_sim(const struct loopback_sim_config &config)
+      : d_config(config),
+        d_start(wall_now()),
+        d_usb_frames((uint64_t)(config.usb_latency * config.samp_rate)),
+        d_placed(false),
+        d_now(false),
+        d_burst_time(0),
+        d_tx_busy(0),
+        d_late(0),
+        d_rx_started(false),
+        d_rx_next(0),
+        d_rng(0x2545f491)
+    {
+      if (config.samp_rate <= 0 || config.stream.buffer_size == 0 ||
+          config.stream.num_buffers == 0) {
+        throw std::invalid_argument("loopback_sim: bad configuration");
+      }
+    }
+
+    uint64_t
+    loopback_sim::now() const
+    {
+      return (uint64_t)((wall_now() - d_start).total_microseconds() *
+                        1e-6 * d_config.samp_rate);
+    }
+
+    void
+    loopback_sim::wait_until(uint64_t t) const
+    {
+      uint64_t n;
+      while ((n = now()) < t) {
+        boost::this_thread::sleep(boost::posix_time::microseconds(
+          (int64_t)((t - n) / d_config.samp_rate * 1e6) + 1));
+      }
+    }
+
+    static int16_t
+    clamp_q11(float v)
+    {
+      return (int16_t)std::max(-2047.0f, std::min(2047.0f, floorf(v + 0.5f)));
+    }
+
+    /* Box-Muller on a xorshift generator, so runs repeat */
+    float
+    loopback_sim::gaussian()
+    {
+      double u[2];
+      for (int i = 0; i < 2; i++) {
+        d_rng ^= d_rng << 13;
+        d_rng ^= d_rng >> 17;
+        d_rng ^= d_rng << 5;
+        u[i] = (d_rng + 1.0) / 4294967297.0;
+      }
+      return (float)(sqrt(-2 * log(u[0])) * cos(2 * M_PI * u[1]));
+    }
+
+    int
+    loopback_sim::receive(void *buf, unsigned int nsamples,
+                          struct bladerf_metadata *meta)
+    {
+      const uint64_t bs = d_config.stream.buffer_size;
+      const uint64_t depth = d_config.stream.num_buffers * bs;
+      uint32_t status = 0;
+
+      uint64_t t = now();
+      if (!d_rx_started) {
+        d_rx_next = t / bs * bs;
+        d_rx_started = true;
+      }
+      uint64_t p = d_rx_next;
+      if (t > p + depth) {
+        /* The buffers filled up and the oldest were reused */
+        p = (t - depth) / bs * bs + bs;
+        status |= BLADERF_META_STATUS_OVERRUN;
+      }
+
+      /* The noise is made while waiting, so the block is not late */
+      int16_t *out = (int16_t *)buf;
+      if (d_config.noise > 0) {
+        for (unsigned int k = 0; k < 2 * nsamples; k++) {
+          out[k] = clamp_q11(d_config.noise * gaussian());
+        }
+      } else {
+        memset(out, 0, 2 * nsamples * sizeof(int16_t));
+      }
+
+      /* Handed out once the last buffer under it is full and across */
+      wait_until((p + nsamples + bs - 1) / bs * bs + d_usb_frames);
+
+      /* Add back whatever went out path_delay earlier */
+      if (p + nsamples > d_config.path_delay) {
+        const uint64_t lo = p > d_config.path_delay ? p - d_config.path_delay
+                                                    : 0;
+        const uint64_t hi = p + nsamples - d_config.path_delay;
+        boost::mutex::scoped_lock lock(d_mutex);
+        std::map<uint64_t, std::vector<int16_t> >::const_iterator it =
+          d_sent.upper_bound(lo);
+        if (it != d_sent.begin()) {
+          --it;
+        }
+        for (; it != d_sent.end() && it->first < hi; ++it) {
+          const uint64_t start = it->first;
+          const uint64_t end = start + it->second.size() / 2;
+          for (uint64_t s = std::max(start, lo); s < std::min(end, hi);
+               s++) {
+            const size_t o = 2 * (s + d_config.path_delay - p);
+            const size_t i = 2 * (s - start);
+            for (int c = 0; c < 2; c++) {
+              out[o + c] = clamp_q11(out[o + c] +
+                                     d_config.gain * it->second[i + c]);
+            }
+          }
+        }
+      }
+
+      d_rx_next = p + nsamples;
+      if (meta != NULL) {
+        meta->timestamp = p;
+        meta->actual_count = nsamples;
+        meta->status = status;
+      }
+      return 0;
+    }
+
+    void
+    loopback_sim::flush(size_t nframes)
+    {
+      const uint64_t arrive = now() + d_usb_frames;
+      if (!d_placed) {
+        /* The first buffer of the burst fixes where the rest go */
+        d_placed = true;
+        if (d_now) {
+          d_burst_time = std::max(arrive, d_tx_busy);
+        } else if (d_burst_time < arrive) {
+          d_late++;
+          d_burst_time = arrive;
+        }
+      }
+      d_sent[d_burst_time].assign(d_pending.begin(),
+                                  d_pending.begin() + 2 * nframes);
+      d_pending.erase(d_pending.begin(), d_pending.begin() + 2 * nframes);
+      d_burst_time += nframes;
+      d_tx_busy = std::max(d_tx_busy, d_burst_time);
+    }
+
+    int
+    loopback_sim::transmit(const void *buf, unsigned int nsamples,
+                           struct bladerf_metadata *meta)
+    {
+      const uint64_t bs = d_config.stream.buffer_size;
+      const uint64_t depth = d_config.stream.num_buffers * bs;
+      /* Without metadata every call is a burst of its own */
+      const uint32_t flags = meta != NULL ? meta->flags
+                             : BLADERF_META_FLAG_TX_BURST_START |
+                               BLADERF_META_FLAG_TX_BURST_END |
+                               BLADERF_META_FLAG_TX_NOW;
+
+      /* Wait for room in the queue, as the sync interface does */
+      uint64_t busy;
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        busy = d_tx_busy;
+      }
+      if (busy > depth) {
+        wait_until(busy - depth);
+      }
+
+      boost::mutex::scoped_lock lock(d_mutex);
+      if (flags & BLADERF_META_FLAG_TX_BURST_START) {
+        d_pending.clear();
+        d_placed = false;
+        d_now = (flags & BLADERF_META_FLAG_TX_NOW) != 0;
+        d_burst_time = meta != NULL ? meta->timestamp : 0;
+      }
+      const int16_t *in = (const int16_t *)buf;
+      d_pending.insert(d_pending.end(), in, in + 2 * nsamples);
+      while (d_pending.size() >= 2 * bs) {
+        flush(bs);
+      }
+      if ((flags & BLADERF_META_FLAG_TX_BURST_END) && !d_pending.empty()) {
+        flush(d_pending.size() / 2);
+      }
+
+      /* Forget what RX can no longer reach */
+      const uint64_t t = now();
+      const uint64_t keep = d_config.path_delay + 2 * depth;
+      while (!d_sent.empty() && t > keep &&
+             d_sent.begin()->first + d_sent.begin()->second.size() / 2 <
+             t - keep) {
+        d_sent.erase(d_sent.begin());
+      }
+      return 0;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,107 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_LOOPBACK_SIM_H
+#define INCLUDED_BLADERF_LOOPBACK_SIM_H
+
+#include <libbladeRF.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "device_utils.h"
+
+namespace gr {
+  namespace bladerf {
+
+    struct loopback_sim_config {
+      double samp_rate;
+      struct stream_config stream;
+      uint64_t path_delay;      /* frames from the DAC to the ADC */
+      double usb_latency;       /* seconds a transfer spends on the bus */
+      float gain;               /* of the looped back signal */
+      float noise;              /* rms of I and of Q, in sc16 units */
+    };
+
+    /*!
+     * \brief A bladeRF with TX looped back to RX, in real time, for
+     * testing without hardware.
+     *
+     * receive() and transmit() stand in for bladerf_sync_rx() and
+     * bladerf_sync_tx() on one channel of SC16 samples with metadata.
+     * The hardware clock is wall time since construction. A received
+     * block is handed out once the buffers holding it have filled and
+     * crossed the bus; a reader more than num_buffers buffers behind
+     * loses the oldest samples and sees BLADERF_META_STATUS_OVERRUN.
+     * Transmitted samples are sent a buffer at a time, the last one
+     * when the burst ends, reach the hardware one bus latency later and
+     * go out at their timestamp, or with BLADERF_META_FLAG_TX_NOW as
+     * soon as they arrive; transmit() waits while more than
+     * num_buffers buffers are queued. What goes out comes back
+     * path_delay frames later, scaled and with noise added.
+     * num_transfers is not modelled.
+     */
+    class loopback_sim
+    {
+     public:
+      loopback_sim(const struct loopback_sim_config &config);
+
+      int receive(void *buf, unsigned int nsamples,
+                  struct bladerf_metadata *meta);
+      int transmit(const void *buf, unsigned int nsamples,
+                   struct bladerf_metadata *meta);
+
+      /* Frames since construction */
+      uint64_t now() const;
+
+      /* Bursts whose timestamp had passed when they arrived */
+      uint64_t late_bursts() const { return d_late; }
+
+     private:
+      struct loopback_sim_config d_config;
+      boost::posix_time::ptime d_start;
+      uint64_t d_usb_frames;
+
+      boost::mutex d_mutex;     /* the TX side, which RX reads back */
+      std::map<uint64_t, std::vector<int16_t> > d_sent;
+      std::vector<int16_t> d_pending;
+      bool d_placed;            /* the open burst has a buffer out */
+      bool d_now;               /* the open burst goes out on arrival */
+      uint64_t d_burst_time;    /* where the next buffer of it goes */
+      uint64_t d_tx_busy;       /* end of what is queued to go out */
+      uint64_t d_late;
+
+      bool d_rx_started;
+      uint64_t d_rx_next;
+      uint32_t d_rng;
+
+      void flush(size_t nframes);
+      void wait_until(uint64_t t) const;
+      float gaussian();
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_LOOPBACK_SIM_H */
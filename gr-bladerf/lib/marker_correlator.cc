@@ -0,0 +1,182 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "marker_correlator.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* FFT size as a multiple of the marker length; larger wastes less
+     * of each transform on the overlap */
+    static const size_t FFT_MARKERS = 8;
+
+    std::vector<std::complex<float> >
+    zadoff_chu(size_t length, unsigned int root)
+    {
+      if (length < 2 || root == 0) {
+        throw std::invalid_argument("zadoff_chu: bad length or root");
+      }
+      std::vector<std::complex<float> > out(length);
+      const double q = (double)(length % 2);
+      for (size_t n = 0; n < length; n++) {
+        const double phase = -M_PI * root * n * (n + q) / length;
+        out[n] = std::complex<float>((float)cos(phase), (float)sin(phase));
+      }
+      return out;
+    }
+
+    static size_t
+    fft_size(size_t length)
+    {
+      size_t size = 1;
+      while (size < FFT_MARKERS * length) {
+        size <<= 1;
+      }
+      return size;
+    }
+
+    marker_correlator::marker_correlator(
+      const std::vector<std::complex<float> > &marker, float threshold)
+      : d_length(marker.size()),
+        d_threshold(threshold),
+        d_marker_energy(0),
+        d_forward(fft_size(marker.size()), true),
+        d_inverse(fft_size(marker.size()), false),
+        d_fill(0),
+        d_base(0),
+        d_samples(0),
+        d_peak_open(false),
+        d_holdoff(0)
+    {
+      if (marker.empty()) {
+        throw std::invalid_argument("marker_correlator: empty marker");
+      }
+      if (threshold <= 0 || threshold >= 1) {
+        throw std::invalid_argument("marker_correlator: bad threshold");
+      }
+      const size_t size = d_forward.size();
+      d_spectrum.assign(size, 0);
+      for (size_t i = 0; i < d_length; i++) {
+        d_spectrum[i] = marker[i];
+        d_marker_energy += std::norm(marker[i]);
+      }
+      d_forward.execute(&d_spectrum[0]);
+      for (size_t i = 0; i < size; i++) {
+        d_spectrum[i] = std::conj(d_spectrum[i]);
+      }
+      d_input.resize(size);
+      d_work.resize(size);
+      d_energy.resize(size + 1);
+      d_peak.position = 0;
+      d_peak.score = 0;
+    }
+
+    void
+    marker_correlator::reset()
+    {
+      d_fill = 0;
+      d_base = 0;
+      d_samples = 0;
+      d_peak_open = false;
+      d_holdoff = 0;
+    }
+
+    void
+    marker_correlator::process(const std::complex<float> *in, size_t n)
+    {
+      const size_t size = d_input.size();
+      while (n > 0) {
+        size_t k = std::min(n, size - d_fill);
+        std::copy(in, in + k, d_input.begin() + d_fill);
+        d_fill += k;
+        d_samples += k;
+        in += k;
+        n -= k;
+        if (d_fill == size) {
+          correlate();
+        }
+      }
+    }
+
+    void
+    marker_correlator::correlate()
+    {
+      const size_t size = d_input.size();
+      const size_t lags = size - d_length + 1;
+
+      std::copy(d_input.begin(), d_input.end(), d_work.begin());
+      d_forward.execute(&d_work[0]);
+      for (size_t i = 0; i < size; i++) {
+        d_work[i] *= d_spectrum[i];
+      }
+      d_inverse.execute(&d_work[0]);
+
+      d_energy[0] = 0;
+      for (size_t i = 0; i < size; i++) {
+        d_energy[i + 1] = d_energy[i] + std::norm(d_input[i]);
+      }
+
+      /* Neither transform is normalized, so the correlation comes out
+       * size times too large and its square size^2 times */
+      const double scale = 1.0 / ((double)size * size * d_marker_energy);
+      for (size_t k = 0; k < lags; k++) {
+        const double energy = d_energy[k + d_length] - d_energy[k];
+        float s = 0;
+        if (energy > 0) {
+          s = (float)(std::norm(d_work[k]) * scale / energy);
+        }
+        score(d_base + k, s);
+      }
+
+      /* Keep the samples the next lags still need */
+      std::copy(d_input.begin() + lags, d_input.end(), d_input.begin());
+      d_fill = d_length - 1;
+      d_base += lags;
+    }
+
+    void
+    marker_correlator::score(uint64_t lag, float s)
+    {
+      if (d_peak_open && lag >= d_peak.position + d_length) {
+        d_hits.push_back(d_peak);
+        d_peak_open = false;
+        d_holdoff = d_peak.position + d_length;
+      }
+      if (lag < d_holdoff || s < d_threshold) {
+        return;
+      }
+      if (!d_peak_open || s > d_peak.score) {
+        d_peak_open = true;
+        d_peak.position = lag;
+        d_peak.score = s;
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,100 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_MARKER_CORRELATOR_H
+#define INCLUDED_BLADERF_MARKER_CORRELATOR_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "radix2_fft.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* A Zadoff-Chu sequence of unit amplitude; root and length have to
+     * be coprime for its autocorrelation to be an impulse */
+    std::vector<std::complex<float> > zadoff_chu(size_t length,
+                                                 unsigned int root);
+
+    struct marker_hit {
+      uint64_t position;        /* sample of the stream the marker starts at */
+      float score;              /* normalized correlation, 0..1 */
+    };
+
+    /*!
+     * \brief Finds a known marker in a stream of samples.
+     *
+     * The stream is correlated with the marker by overlap-save FFTs.
+     * Each lag is scored by |correlation|^2 over the energies of the
+     * marker and of the samples under it, so the score is 1 where the
+     * marker is, whatever the gain, and small in noise and silence.
+     * Where the score crosses the threshold the best lag within one
+     * marker length is reported, and nothing within a marker length
+     * after it.
+     */
+    class marker_correlator
+    {
+     public:
+      marker_correlator(const std::vector<std::complex<float> > &marker,
+                        float threshold = 0.5f);
+
+      void process(const std::complex<float> *in, size_t n);
+
+      /* Start the stream over at position 0 */
+      void reset();
+
+      /* Hits so far; clear_hits() once they have been used */
+      const std::vector<struct marker_hit> &hits() const { return d_hits; }
+      void clear_hits() { d_hits.clear(); }
+
+      size_t marker_length() const { return d_length; }
+      uint64_t samples() const { return d_samples; }
+
+     private:
+      size_t d_length;
+      float d_threshold;
+      double d_marker_energy;
+      radix2_fft d_forward;
+      radix2_fft d_inverse;
+      std::vector<std::complex<float> > d_spectrum;  /* conj(FFT(marker)) */
+      std::vector<std::complex<float> > d_input;     /* size() samples */
+      std::vector<std::complex<float> > d_work;
+      std::vector<double> d_energy;                  /* running sums */
+      size_t d_fill;
+      uint64_t d_base;          /* position of d_input[0] */
+      uint64_t d_samples;
+
+      bool d_peak_open;
+      struct marker_hit d_peak;
+      uint64_t d_holdoff;       /* no new peak before this lag */
+      std::vector<struct marker_hit> d_hits;
+
+      void correlate();
+      void score(uint64_t lag, float s);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_MARKER_CORRELATOR_H */
@@ -0,0 +1,407 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "multi_rx_impl.h"
+#include "thread_utils.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Number of capture buffers queued per device */
+    static const size_t QUEUE_DEPTH = 32;
+
+    /* How long work() waits for the slowest device before returning */
+    static const unsigned int WORK_TIMEOUT_MS = 100;
+
+    static bladerf_trigger_signal
+    str2trigger(const std::string &trigger)
+    {
+      if (trigger == "j51-1") {
+        return BLADERF_TRIG_J51_1;
+      } else if (trigger == "j71-4") {
+        return BLADERF_TRIG_J71_4;
+      } else if (trigger == "miniexp-1") {
+        return BLADERF_TRIG_MINI_EXP_1;
+      }
+      return BLADERF_TRIG_INVALID;
+    }
+
+    multi_rx::sptr
+    multi_rx::make(const std::vector<std::string> &serials,
+                   int nchan, double freq, double samp_rate,
+                   double bandwidth, int gain,
+                   const std::string &ref, const std::string &trigger,
+                   const std::vector<int> &cores, int rt_priority)
+    {
+      return gnuradio::get_initial_sptr
+        (new multi_rx_impl(serials, nchan, freq, samp_rate, bandwidth, gain,
+                           ref, trigger, cores, rt_priority));
+    }
+
+    /*
+     * The private constructor
+     */
+    multi_rx_impl::multi_rx_impl(const std::vector<std::string> &serials,
+                                 int nchan, double freq, double samp_rate,
+                                 double bandwidth, int gain,
+                                 const std::string &ref,
+                                 const std::string &trigger,
+                                 const std::vector<int> &cores,
+                                 int rt_priority)
+      : gr::sync_block("multi_rx",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(serials.size() * nchan,
+                                     serials.size() * nchan,
+                                     sizeof(gr_complex))),
+        _cores(cores),
+        _rt_priority(rt_priority),
+        _nchan(nchan),
+        _layout(nchan > 1 ? BLADERF_RX_X2 : BLADERF_RX_X1),
+        _stream(default_stream_config),
+        _use_trigger(trigger != "none"),
+        _trigger_signal(str2trigger(trigger)),
+        _running(false),
+        _pos(0),
+        _scratch(NULL)
+    {
+      if (serials.empty()) {
+        throw std::invalid_argument("multi_rx: at least one device is required");
+      }
+      if (nchan < 1 || nchan > 2) {
+        throw std::invalid_argument("multi_rx: nchan must be 1 or 2");
+      }
+      if (_use_trigger && _trigger_signal == BLADERF_TRIG_INVALID) {
+        throw std::invalid_argument("multi_rx: unknown trigger " + trigger);
+      }
+
+      set_max_noutput_items(_stream.buffer_size);
+
+      for (size_t i = 0; i < serials.size(); i++) {
+        struct bladerf *dev = NULL;
+        if (open_device(&dev, serials[i]) != 0) {
+          for (size_t j = 0; j < _devs.size(); j++) {
+            bladerf_close(_devs[j]);
+          }
+          throw std::runtime_error("multi_rx: unable to open " + serials[i]);
+        }
+        _devs.push_back(dev);
+        _states.push_back(boost::shared_ptr<device_state>(
+          new device_state(dev)));
+      }
+
+      setup_reference(ref);
+
+      for (size_t i = 0; i < _devs.size(); i++) {
+        for (unsigned int ch = 0; ch < _nchan; ch++) {
+          struct channel_config config;
+          config.channel    = BLADERF_CHANNEL_RX(ch);
+          config.frequency  = (unsigned int)freq;
+          config.bandwidth  = (unsigned int)bandwidth;
+          config.samplerate = (unsigned int)samp_rate;
+          config.gain       = gain;
+          if (_states[i]->apply(&config) != 0) {
+            fprintf(stderr, "Failed to configure RX%u of device %zu.\n",
+                    ch, i);
+          }
+        }
+
+        _queues.push_back(boost::shared_ptr<capture_queue>(
+          new capture_queue(QUEUE_DEPTH, _stream.buffer_size, _nchan)));
+      }
+
+      _scratch = (int16_t *)malloc(_stream.buffer_size * _nchan * 2 *
+                                   sizeof(int16_t));
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    multi_rx_impl::~multi_rx_impl()
+    {
+      stop();
+      for (size_t i = 0; i < _devs.size(); i++) {
+        bladerf_close(_devs[i]);
+      }
+      free(_scratch);
+    }
+
+    /* Share one reference clock so the devices sample coherently. bladeRF 2
+     * boards have a dedicated clock output/select; on bladeRF 1 the SMB
+     * connector carries the 38.4 MHz reference instead. */
+    void
+    multi_rx_impl::setup_reference(const std::string &ref)
+    {
+      int status;
+
+      if (ref == "internal") {
+        return;
+      }
+
+      for (size_t i = 0; i < _devs.size(); i++) {
+        bool master = (i == 0 && ref == "master");
+
+        if (master) {
+          status = bladerf_set_clock_output(_devs[i], true);
+          if (status == BLADERF_ERR_UNSUPPORTED) {
+            status = bladerf_set_smb_mode(_devs[i], BLADERF_SMB_MODE_OUTPUT);
+          }
+        } else {
+          status = bladerf_set_clock_select(_devs[i], CLOCK_SELECT_EXTERNAL);
+          if (status == BLADERF_ERR_UNSUPPORTED) {
+            status = bladerf_set_smb_mode(_devs[i], BLADERF_SMB_MODE_INPUT);
+          }
+        }
+
+        if (status != 0) {
+          fprintf(stderr, "Failed to set up %s reference on device %zu: %s\n",
+                  master ? "master" : "external", i,
+                  bladerf_strerror(status));
+        }
+      }
+    }
+
+    /* Slaves are armed before the master so none of them can miss the
+     * master's trigger; disarming goes the same way. A failure to arm
+     * disarms what was armed already and leaves _triggers empty;
+     * disarming carries on past failures so every device is tried. */
+    bool
+    multi_rx_impl::arm_triggers(bool arm)
+    {
+      int status;
+
+      if (arm) {
+        _triggers.resize(_devs.size());
+        for (size_t i = 0; i < _devs.size(); i++) {
+          status = bladerf_trigger_init(_devs[i], BLADERF_CHANNEL_RX(0),
+                                        _trigger_signal, &_triggers[i]);
+          if (status != 0) {
+            fprintf(stderr, "Failed to init trigger on device %zu: %s\n",
+                    i, bladerf_strerror(status));
+            _triggers.clear();
+            return false;
+          }
+          _triggers[i].role = (i == 0) ? BLADERF_TRIG_ROLE_MASTER
+                                       : BLADERF_TRIG_ROLE_SLAVE;
+        }
+      }
+
+      bool ok = true;
+      for (size_t n = 0; n < _triggers.size(); n++) {
+        size_t i = (n + 1) % _triggers.size();
+        status = bladerf_trigger_arm(_devs[i], &_triggers[i], arm, 0, 0);
+        if (status == 0) {
+          continue;
+        }
+        fprintf(stderr, "Failed to %s trigger on device %zu: %s\n",
+                arm ? "arm" : "disarm", i, bladerf_strerror(status));
+        ok = false;
+        if (arm) {
+          for (size_t m = 0; m < n; m++) {
+            size_t j = (m + 1) % _triggers.size();
+            bladerf_trigger_arm(_devs[j], &_triggers[j], false, 0, 0);
+          }
+          _triggers.clear();
+          break;
+        }
+      }
+
+      return ok;
+    }
+
+    bool
+    multi_rx_impl::start()
+    {
+      int status;
+
+      for (size_t i = 0; i < _devs.size(); i++) {
+        status = init_sync(_devs[i], _layout, BLADERF_FORMAT_SC16_Q11_META,
+                           &_stream);
+        if (status != 0) {
+          return false;
+        }
+        _queues[i]->reset();
+      }
+
+      if (_use_trigger && !arm_triggers(true)) {
+        return false;
+      }
+
+      for (size_t i = 0; i < _devs.size(); i++) {
+        if (enable_rx_channels(_devs[i], _nchan, true) != 0) {
+          /* Leave every device as it was found, this one included as
+           * it may have enabled some of its channels */
+          for (size_t j = 0; j <= i; j++) {
+            enable_rx_channels(_devs[j], _nchan, false);
+          }
+          if (_use_trigger) {
+            arm_triggers(false);
+            _triggers.clear();
+          }
+          return false;
+        }
+      }
+
+      _pos = 0;
+      _running = true;
+      for (size_t i = 0; i < _devs.size(); i++) {
+        _threads.push_back(boost::shared_ptr<boost::thread>(
+          new boost::thread(boost::bind(&multi_rx_impl::capture, this, i))));
+      }
+
+      /* Every stream is gated until this point; they all start on the
+       * same sample clock edge. */
+      if (_use_trigger) {
+        status = bladerf_trigger_fire(_devs[0], &_triggers[0]);
+        if (status != 0) {
+          fprintf(stderr, "Failed to fire trigger: %s\n",
+                  bladerf_strerror(status));
+          stop();
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    bool
+    multi_rx_impl::stop()
+    {
+      if (!_running && _threads.empty()) {
+        return true;
+      }
+
+      _running = false;
+      for (size_t i = 0; i < _threads.size(); i++) {
+        _threads[i]->join();
+      }
+      _threads.clear();
+
+      if (_use_trigger && !_triggers.empty()) {
+        arm_triggers(false);
+        _triggers.clear();
+      }
+
+      for (size_t i = 0; i < _devs.size(); i++) {
+        enable_rx_channels(_devs[i], _nchan, false);
+      }
+
+      return true;
+    }
+
+    uint64_t
+    multi_rx_impl::overflows(int device)
+    {
+      return _queues.at(device)->overflows();
+    }
+
+    void
+    multi_rx_impl::capture(size_t dev)
+    {
+      boost::shared_ptr<capture_queue> q = _queues[dev];
+      struct bladerf_metadata meta;
+      int status;
+
+      std::vector<int> cpus;
+      if (!_cores.empty()) {
+        cpus.push_back(_cores[dev % _cores.size()]);
+      }
+      setup_current_thread("multi_rx capture", cpus, _rt_priority);
+      q->prefault();
+
+      while (_running) {
+        int16_t *buf = q->acquire();
+        if (buf == NULL) {
+          boost::this_thread::yield();
+          continue;
+        }
+
+        memset(&meta, 0, sizeof(meta));
+        meta.flags = BLADERF_META_FLAG_RX_NOW;
+        status = bladerf_sync_rx(_devs[dev], buf,
+                                 _stream.buffer_size * _nchan, &meta,
+                                 _stream.timeout_ms);
+        if (status != 0) {
+          if (status != BLADERF_ERR_TIMEOUT) {
+            fprintf(stderr, "Device %zu: bladerf_sync_rx error: %s\n",
+                    dev, bladerf_strerror(status));
+          }
+          q->release(buf);
+          continue;
+        }
+
+        if (meta.status & BLADERF_META_STATUS_OVERRUN) {
+          fprintf(stderr, "Device %zu: overrun at %" PRIu64 "\n",
+                  dev, (uint64_t)meta.timestamp);
+        }
+
+        q->commit(buf, meta.timestamp, meta.actual_count / _nchan);
+      }
+    }
+
+    int
+    multi_rx_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      gr_complex **out = reinterpret_cast<gr_complex **>(&output_items[0]);
+      uint64_t n = noutput_items;
+
+      /* Only hand out the part of the timeline every device has reached */
+      for (size_t i = 0; i < _queues.size() && n > 0; i++) {
+        n = std::min(n, _queues[i]->wait(_pos, WORK_TIMEOUT_MS));
+      }
+      if (n == 0) {
+        return 0;
+      }
+
+      for (size_t i = 0; i < _queues.size(); i++) {
+        _queues[i]->read(_pos, (size_t)n, _scratch);
+
+        for (unsigned int ch = 0; ch < _nchan; ch++) {
+          gr_complex *o = out[i * _nchan + ch];
+          const int16_t *in = _scratch + 2 * ch;
+          for (size_t k = 0; k < n; k++) {
+            o[k] = gr_complex((float)in[0] / 2048, (float)in[1] / 2048);
+            in += 2 * _nchan;
+          }
+        }
+      }
+
+      _pos += n;
+
+      // Tell runtime system how many output items we produced.
+      return (int)n;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
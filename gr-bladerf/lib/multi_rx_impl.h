@@ -0,0 +1,83 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_BLADERF_MULTI_RX_IMPL_H
+#define INCLUDED_BLADERF_MULTI_RX_IMPL_H
+
+#include <bladerf/multi_rx.h>
+#include <libbladeRF.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/atomic.hpp>
+#include "capture_queue.h"
+#include "device_utils.h"
+#include "device_state.h"
+
+namespace gr {
+  namespace bladerf {
+
+    class multi_rx_impl : public multi_rx
+    {
+     private:
+      std::vector<struct bladerf *> _devs;
+      std::vector<boost::shared_ptr<device_state> > _states;
+      std::vector<struct bladerf_trigger> _triggers;
+      std::vector<boost::shared_ptr<capture_queue> > _queues;
+      std::vector<boost::shared_ptr<boost::thread> > _threads;
+      std::vector<int> _cores;
+      int _rt_priority;
+
+      unsigned int _nchan;
+      bladerf_channel_layout _layout;
+      struct stream_config _stream;
+      bool _use_trigger;
+      bladerf_trigger_signal _trigger_signal;
+
+      boost::atomic<bool> _running;
+      uint64_t _pos;
+      int16_t *_scratch;
+
+      void setup_reference(const std::string &ref);
+      bool arm_triggers(bool arm);
+      void capture(size_t dev);
+
+     public:
+      multi_rx_impl(const std::vector<std::string> &serials,
+                    int nchan, double freq, double samp_rate,
+                    double bandwidth, int gain,
+                    const std::string &ref, const std::string &trigger,
+                    const std::vector<int> &cores, int rt_priority);
+      ~multi_rx_impl();
+
+      bool start();
+      bool stop();
+
+      uint64_t overflows(int device);
+
+      int work(int noutput_items,
+         gr_vector_const_void_star &input_items,
+         gr_vector_void_star &output_items);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_MULTI_RX_IMPL_H */
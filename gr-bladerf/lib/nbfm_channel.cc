@@ -0,0 +1,97 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdexcept>
+#include <math.h>
+#include "nbfm_channel.h"
+
+namespace gr {
+  namespace bladerf {
+
+    struct nbfm_config
+    nbfm_channel::default_config()
+    {
+      struct nbfm_config c;
+      c.samp_rate     = 2e6;
+      c.offset        = 0;
+      c.bandwidth     = 12.5e3;
+      c.audio_rate    = 25e3;
+      c.max_dev       = 2.5e3;
+      c.tau           = 5e-6;
+      c.squelch_db    = -45;
+      c.squelch_alpha = 0.0125;
+      c.hpf           = true;
+      c.accuracy      = FM_POLY;
+      return c;
+    }
+
+    unsigned int
+    nbfm_channel::decimation(const struct nbfm_config &config)
+    {
+      double ratio = config.samp_rate / config.audio_rate;
+      unsigned int decim = (unsigned int)(ratio + 0.5);
+      if (decim < 1 || fabs(ratio - decim) > 1e-6) {
+        throw std::invalid_argument("nbfm_channel: audio rate must divide "
+                                    "the sample rate");
+      }
+      return decim;
+    }
+
+    nbfm_channel::nbfm_channel(const struct nbfm_config &config,
+                               size_t max_input)
+      : d_config(config),
+        d_decim(decimation(config)),
+        d_gate(config.squelch_db, config.squelch_alpha, config.hpf,
+               config.audio_rate)
+    {
+      /* The decimator only has to protect what the last stage would
+       * fold back into the audio band */
+      d_decimator.reset(new channel_decimator(config.samp_rate,
+                                              config.offset, d_decim,
+                                              config.bandwidth / 2,
+                                              config.audio_rate / 2,
+                                              max_input));
+      d_disc.reset(new fm_discriminator(1, max_audio(max_input),
+                                        config.audio_rate, config.max_dev,
+                                        config.tau, config.accuracy));
+      d_baseband.resize(max_audio(max_input));
+      d_demod.resize(max_audio(max_input));
+    }
+
+    size_t
+    nbfm_channel::process(const std::complex<float> *in, size_t n,
+                          float *audio, std::vector<struct squelch_event> &events)
+    {
+      const std::complex<float> *bb[1] = { &d_baseband[0] };
+      float *demod[1] = { &d_demod[0] };
+
+      n = d_decimator->process(in, n, &d_baseband[0]);
+      d_disc->demod(bb, demod, n);
+      return d_gate.process(&d_baseband[0], &d_demod[0], n, audio, events);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,97 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_NBFM_CHANNEL_H
+#define INCLUDED_BLADERF_NBFM_CHANNEL_H
+
+#include <boost/shared_ptr.hpp>
+#include <complex>
+#include <vector>
+#include <stddef.h>
+#include "channel_decimator.h"
+#include "fm_discriminator.h"
+#include "squelch_gate.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Defaults follow GRC/bladeRF_frs_rx.grc */
+    struct nbfm_config {
+      double samp_rate;     /* input rate */
+      double offset;        /* channel center relative to the LO, Hz */
+      double bandwidth;     /* occupied bandwidth, flat to half of it */
+      double audio_rate;    /* must divide samp_rate */
+      double max_dev;       /* FM deviation for full scale audio */
+      double tau;           /* de-emphasis time constant */
+      double squelch_db;    /* power squelch threshold */
+      double squelch_alpha; /* power averaging constant */
+      bool hpf;             /* drop CTCSS tones below 300 Hz */
+      fm_accuracy accuracy; /* discriminator atan2 approximation */
+    };
+
+    /*!
+     * \brief One narrowband FM channel: mix, decimate, squelch, demod.
+     *
+     * Mirrors the per-channel chain of the FRS flowgraph without GNU
+     * Radio: a channel_decimator brings the channel to baseband at the
+     * audio rate, an fm_discriminator with de-emphasis demodulates it
+     * and a squelch_gate passes the audio while the channel is busy.
+     * Every buffer is sized for max_input samples per process() call
+     * when the channel is built. Receivers handling many channels use
+     * the same parts directly, with a shared channelizer in front.
+     */
+    class nbfm_channel
+    {
+     public:
+      nbfm_channel(const struct nbfm_config &config, size_t max_input);
+
+      /* Process n input samples. Audio is written to audio only while
+       * the squelch is open; returns the number written. Squelch changes
+       * are appended to events, indexed by audio rate sample in this
+       * call whether or not it was written. */
+      size_t process(const std::complex<float> *in, size_t n, float *audio,
+                     std::vector<struct squelch_event> &events);
+
+      bool squelch_open() const { return d_gate.open(); }
+      float power_db() const { return d_gate.power_db(); }
+      size_t max_audio(size_t n) const { return n / d_decim + 1; }
+
+      static struct nbfm_config default_config();
+
+      /* Samples per audio sample, checked against the rates */
+      static unsigned int decimation(const struct nbfm_config &config);
+
+     private:
+      struct nbfm_config d_config;
+      unsigned int d_decim;
+
+      boost::shared_ptr<channel_decimator> d_decimator;
+      boost::shared_ptr<fm_discriminator> d_disc;
+      squelch_gate d_gate;
+      std::vector<std::complex<float> > d_baseband;
+      std::vector<float> d_demod;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_NBFM_CHANNEL_H */
@@ -0,0 +1,208 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include <string.h>
+#include "nbfm_modulator.h"
+#include "fir_decimator.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Width of the audio low pass's roll-off, Hz */
+    static const double AUDIO_TRANSITION = 1000;
+
+    struct nbfm_tx_config
+    nbfm_modulator::default_config()
+    {
+      struct nbfm_tx_config c;
+      c.audio_rate   = 25e3;
+      c.samp_rate    = 2e6;
+      c.offset       = 0;
+      c.max_dev      = 2.5e3;
+      c.tau          = 5e-6;
+      c.audio_cutoff = 3e3;
+      c.ctcss        = 0;
+      c.ctcss_level  = 0.2f;
+      c.amplitude    = 0.5f;
+      return c;
+    }
+
+    unsigned int
+    nbfm_modulator::interpolation(const struct nbfm_tx_config &config)
+    {
+      double ratio = config.samp_rate / config.audio_rate;
+      unsigned int interp = (unsigned int)(ratio + 0.5);
+      if (interp < 1 || fabs(ratio - interp) > 1e-6) {
+        throw std::invalid_argument("nbfm_modulator: audio rate must "
+                                    "divide the sample rate");
+      }
+      return interp;
+    }
+
+    nbfm_modulator::nbfm_modulator(const struct nbfm_tx_config &config,
+                                   size_t max_audio)
+      : d_config(config),
+        d_interp(interpolation(config))
+    {
+      if (config.audio_cutoff <= 0 ||
+          config.audio_cutoff + AUDIO_TRANSITION / 2 >=
+          config.audio_rate / 2) {
+        throw std::invalid_argument("nbfm_modulator: audio cutoff out of "
+                                    "range");
+      }
+      if (config.ctcss < 0 || config.ctcss_level < 0 ||
+          config.ctcss_level >= 1) {
+        throw std::invalid_argument("nbfm_modulator: bad CTCSS tone");
+      }
+
+      /* fm_preemph with fh = -1, the bilinear transform of
+       * (s + 1/tau) / (s + 2 pi fh), scaled to unit gain at DC */
+      d_b0 = 1;
+      d_b1 = 0;
+      d_p1 = 0;
+      if (config.tau > 0) {
+        const double fs = config.audio_rate;
+        const double fh = 0.925 * fs / 2;
+        const double kl = -tan(1.0 / config.tau / (2 * fs));
+        const double kh = -tan(2 * M_PI * fh / (2 * fs));
+        const double z1 = (1 + kl) / (1 - kl);
+        const double p1 = (1 + kh) / (1 - kh);
+        const double b0 = (1 - kl) / (1 - kh);
+        const double g = fabs(1 - p1) / (b0 * fabs(1 - z1));
+        d_b0 = (float)(g * b0);
+        d_b1 = (float)(-g * b0 * z1);
+        d_p1 = (float)p1;
+      }
+
+      std::vector<float> taps =
+        fir_decimator::lowpass(1.0, config.audio_rate, config.audio_cutoff,
+                               AUDIO_TRANSITION);
+      d_audio_taps.assign(taps.rbegin(), taps.rend());
+      d_audio_buf.resize(taps.size() - 1 + max_audio);
+
+      /* The audio is band limited by now, so the interpolator only has
+       * to stop its images, the nearest of which starts audio_cutoff
+       * short of the audio rate */
+      taps = fir_decimator::lowpass(d_interp, config.samp_rate,
+                                    config.audio_rate / 2,
+                                    config.audio_rate -
+                                    2 * config.audio_cutoff);
+      d_branch = (taps.size() + d_interp - 1) / d_interp;
+      d_poly.assign(d_interp * d_branch, 0.0f);
+      for (size_t p = 0; p < d_interp; p++) {
+        for (size_t j = 0; j < d_branch; j++) {
+          const size_t k = p + (d_branch - 1 - j) * d_interp;
+          if (k < taps.size()) {
+            d_poly[p * d_branch + j] = taps[k];
+          }
+        }
+      }
+      d_interp_buf.resize(d_branch - 1 + max_audio);
+      reset();
+    }
+
+    void
+    nbfm_modulator::reset()
+    {
+      d_x1 = 0;
+      d_y1 = 0;
+      std::fill(d_audio_buf.begin(), d_audio_buf.end(), 0.0f);
+      std::fill(d_interp_buf.begin(), d_interp_buf.end(), 0.0f);
+      d_ctcss_phase = 0;
+      d_phase = 0;
+    }
+
+    size_t
+    nbfm_modulator::delay() const
+    {
+      return (d_audio_taps.size() - 1) / 2 * d_interp +
+             ((d_branch * d_interp) - 1) / 2;
+    }
+
+    size_t
+    nbfm_modulator::process(const float *audio, size_t n,
+                            std::complex<float> *out)
+    {
+      const size_t na = d_audio_taps.size();
+      const size_t hist = na - 1;
+      const size_t m = d_branch;
+
+      /* Pre-emphasis and limiter */
+      for (size_t i = 0; i < n; i++) {
+        const float y = d_b0 * audio[i] + d_b1 * d_x1 + d_p1 * d_y1;
+        d_x1 = audio[i];
+        d_y1 = y;
+        d_audio_buf[hist + i] = std::max(-1.0f, std::min(1.0f, y));
+      }
+
+      /* Audio low pass, with the tone added after it */
+      const bool tone = d_config.ctcss > 0;
+      const float voice = tone ? 1.0f - d_config.ctcss_level : 1.0f;
+      const double wc = 2 * M_PI * d_config.ctcss / d_config.audio_rate;
+      const float *t = &d_audio_taps[0];
+      for (size_t i = 0; i < n; i++) {
+        const float *x = &d_audio_buf[i];
+        float s = 0;
+        for (size_t j = 0; j < na; j++) {
+          s += t[j] * x[j];
+        }
+        s *= voice;
+        if (tone) {
+          s += d_config.ctcss_level * (float)cos(d_ctcss_phase);
+          d_ctcss_phase += wc;
+        }
+        d_interp_buf[m - 1 + i] = s;
+      }
+      memmove(&d_audio_buf[0], &d_audio_buf[n], hist * sizeof(float));
+
+      /* Interpolate and modulate, one phase of the filter per output */
+      const double w = 2 * M_PI * d_config.offset / d_config.samp_rate;
+      const double k = 2 * M_PI * d_config.max_dev / d_config.samp_rate;
+      size_t o = 0;
+      for (size_t i = 0; i < n; i++) {
+        const float *x = &d_interp_buf[i];
+        for (size_t p = 0; p < d_interp; p++) {
+          const float *h = &d_poly[p * m];
+          float v = 0;
+          for (size_t j = 0; j < m; j++) {
+            v += h[j] * x[j];
+          }
+          d_phase += w + k * v;
+          out[o++] = std::polar(d_config.amplitude, (float)d_phase);
+        }
+        d_phase = fmod(d_phase, 2 * M_PI);
+      }
+      memmove(&d_interp_buf[0], &d_interp_buf[n], (m - 1) * sizeof(float));
+
+      d_ctcss_phase = fmod(d_ctcss_phase, 2 * M_PI);
+      return o;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,106 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_NBFM_MODULATOR_H
+#define INCLUDED_BLADERF_NBFM_MODULATOR_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /* Defaults follow the TX chain of GRC/bladeRF_frs_modified.grc */
+    struct nbfm_tx_config {
+      double audio_rate;    /* input rate */
+      double samp_rate;     /* output rate, a multiple of audio_rate */
+      double offset;        /* carrier relative to the LO, Hz */
+      double max_dev;       /* FM deviation for full scale audio */
+      double tau;           /* pre-emphasis time constant, 0 for none */
+      double audio_cutoff;  /* audio low pass, Hz */
+      double ctcss;         /* sub-audible tone, Hz, 0 for none */
+      float ctcss_level;    /* its share of the deviation */
+      float amplitude;      /* of the output */
+    };
+
+    /*!
+     * \brief Audio to narrowband FM at the radio's sample rate.
+     *
+     * What analog_nbfm_tx and the filters around it do in the
+     * flowgraph: the audio is pre-emphasized as by fm_preemph, limited
+     * to full scale so it cannot overdeviate, low passed at the audio
+     * rate and joined by the CTCSS tone, the audio taking what share of
+     * the deviation the tone leaves. A polyphase FIR then interpolates
+     * it to samp_rate, and the modulation is done there, so the carrier
+     * offset costs nothing more than a larger phase step and no complex
+     * samples need filtering. Buffers are sized for max_audio samples
+     * per process() call when the modulator is built.
+     */
+    class nbfm_modulator
+    {
+     public:
+      nbfm_modulator(const struct nbfm_tx_config &config, size_t max_audio);
+
+      /* Modulate n <= max_audio samples of audio in -1..1; returns the
+       * n * interpolation() samples written to out */
+      size_t process(const float *audio, size_t n,
+                     std::complex<float> *out);
+
+      /* Start over from silence, with the carrier and tone at phase 0 */
+      void reset();
+
+      unsigned int interpolation() const { return d_interp; }
+      size_t max_output(size_t n) const { return n * d_interp; }
+
+      /* Output samples by which the filters delay the audio */
+      size_t delay() const;
+
+      static struct nbfm_tx_config default_config();
+
+      /* Output samples per audio sample, checked against the rates */
+      static unsigned int interpolation(const struct nbfm_tx_config &config);
+
+     private:
+      struct nbfm_tx_config d_config;
+      unsigned int d_interp;
+
+      /* fm_preemph: y = b0 x + b1 x[-1] + p1 y[-1] */
+      float d_b0, d_b1, d_p1;
+      float d_x1, d_y1;
+
+      std::vector<float> d_audio_taps;  /* reversed */
+      std::vector<float> d_audio_buf;   /* history, then this call */
+
+      /* Interpolator taps by phase, each reversed */
+      size_t d_branch;
+      std::vector<float> d_poly;
+      std::vector<float> d_interp_buf;
+
+      double d_ctcss_phase;
+      double d_phase;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_NBFM_MODULATOR_H */
@@ -0,0 +1,144 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <stdexcept>
+#include <math.h>
+#include <stdlib.h>
+#include "qa_alternating_checker.h"
+#include "alternating_checker.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static float
+    noise()
+    {
+      return (rand() / (float)RAND_MAX - 0.5f) * 0.02f;
+    }
+
+    /* The taps and the sequence alternating.m makes */
+    void
+    qa_alternating_checker::t1()
+    {
+      std::vector<float> taps = srrc_taps(0.5, 6, 64);
+      CPPUNIT_ASSERT_EQUAL((size_t)385, taps.size());
+      double energy = 0;
+      for (size_t i = 0; i < taps.size(); i++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(taps[i], taps[taps.size() - 1 - i],
+                                     1e-7);
+        energy += taps[i] * taps[i];
+      }
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, energy, 1e-6);
+      /* Matched, the pulse is a raised cosine, nearly free of
+       * interference at other symbols */
+      for (size_t lag = 64; lag < 256; lag += 64) {
+        double c = 0;
+        for (size_t i = 0; i + lag < taps.size(); i++) {
+          c += taps[i] * taps[i + lag];
+        }
+        CPPUNIT_ASSERT(fabs(c) < 0.02);
+      }
+
+      std::vector<float> seq = alternating_sequence();
+      CPPUNIT_ASSERT_EQUAL((size_t)4096, seq.size());
+      /* Past the filter's start up the 8 symbol pattern repeats */
+      for (size_t i = 384; i + 512 < seq.size(); i++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(seq[i], seq[i + 512], 1e-6);
+      }
+      CPPUNIT_ASSERT(fabs(seq[0]) < fabs(seq[384 + 192]));
+
+      bool thrown = false;
+      try {
+        alternating_checker bad(1000);
+      } catch (const std::invalid_argument &e) {
+        thrown = true;
+      }
+      CPPUNIT_ASSERT(thrown);
+    }
+
+    /* The looped sequence through a channel with an offset and noise,
+     * losing samples, repeating some and going away for a while */
+    void
+    qa_alternating_checker::t2()
+    {
+      const std::vector<float> seq = alternating_sequence();
+      const size_t period = seq.size();
+      const size_t n = 400000;
+      /* Output sample where source samples are skipped, and how many */
+      const size_t at[6] = { 30000, 70000, 110000, 160000, 220000,
+                             300000 };
+      const long skip[6] = { 1000, 37, -100, 2500, 0, 1536 };
+      const size_t outage = 30000;
+
+      std::vector<std::complex<float> > x(n);
+      srand(9);
+      long j = 0;
+      size_t e = 0;
+      for (size_t i = 0; i < n; i++) {
+        if (e < 6 && i == at[e]) {
+          j += skip[e++];
+        }
+        float s = seq[(size_t)j % period] * 0.5f;
+        double phase = 2 * M_PI * fmod(1.7e-5 * i, 1.0) + 0.3;
+        std::complex<float> c = std::complex<float>(s, s) *
+          std::complex<float>((float)cos(phase), (float)sin(phase));
+        if (i >= at[4] && i < at[4] + outage) {
+          c = 0;
+        }
+        x[i] = c + std::complex<float>(noise(), noise());
+        j++;
+      }
+
+      alternating_checker check;
+      for (size_t i = 0; i < n; i += 5000) {
+        check.process(&x[i], std::min((size_t)5000, n - i));
+      }
+      check.finish();
+      CPPUNIT_ASSERT_EQUAL((uint64_t)n, check.samples());
+      CPPUNIT_ASSERT(check.locked());
+
+      const std::vector<pattern_break> &b = check.breaks();
+      CPPUNIT_ASSERT_EQUAL((size_t)6, b.size());
+      for (size_t k = 0; k < 4; k++) {
+        CPPUNIT_ASSERT(b[k].position + 64 > at[k] &&
+                       b[k].position < at[k] + 64);
+        CPPUNIT_ASSERT_EQUAL((int64_t)((skip[k] + (long)period) %
+                                       (long)period), b[k].slip);
+        CPPUNIT_ASSERT(b[k].length <= period + 128);
+      }
+      CPPUNIT_ASSERT(b[4].position + 64 > at[4] &&
+                     b[4].position < at[4] + 64);
+      CPPUNIT_ASSERT_EQUAL((int64_t)-1, b[4].slip);
+      CPPUNIT_ASSERT(b[4].length >= outage + period - 64 &&
+                     b[4].length <= outage + period + 128);
+      /* Three periods of the 512 sample pattern lost look like none
+       * but where the filter starts, up to a period on */
+      CPPUNIT_ASSERT(b[5].position + 64 > at[5] &&
+                     b[5].position < at[5] + period);
+      CPPUNIT_ASSERT_EQUAL((int64_t)1536, b[5].slip);
+      CPPUNIT_ASSERT(check.good_samples() > n - 8 * period - outage);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
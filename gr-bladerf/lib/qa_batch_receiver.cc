@@ -0,0 +1,263 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <boost/bind.hpp>
+#include <stdexcept>
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "qa_batch_receiver.h"
+#include "batch_receiver.h"
+#include "frs_simulator.h"
+#include "sample_convert.h"
+#include "sc16_file.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const double RATE = 2e6;
+
+    static struct frs_receiver_config
+    receiver_config()
+    {
+      struct frs_receiver_config config;
+      config.samp_rate = RATE;
+      config.channels.assign(frs_channel_table().begin(),
+                             frs_channel_table().begin() + 7);
+      config.center_freq = frs_center_frequency(config.channels);
+      config.demod = nbfm_channel::default_config();
+      config.method = CHANNELIZER_AUTO;
+      config.ctcss = false;
+      config.max_block = 20000;
+      config.threads = 0;
+      config.rt_priority = 0;
+      return config;
+    }
+
+    /* Channel 3 keyed twice, each time across slice boundaries */
+    static std::vector<int16_t>
+    make_recording(const struct frs_receiver_config &config)
+    {
+      const size_t n = (size_t)(1.6 * RATE);
+      frs_simulator sim(RATE, 0.01f);
+      struct sim_signal s;
+      s.offset = config.channels[2].frequency - config.center_freq;
+      s.tone = 1000;
+      s.deviation = 2500;
+      s.ctcss = 0;
+      s.amplitude = 0.5f;
+      sim.add_signal(s);
+
+      std::vector<std::complex<float> > iq(n);
+      sim.generate(&iq[0], n);
+      for (size_t i = 0; i < n; i++) {
+        double t = i / RATE;
+        if (t < 0.1 || (t >= 0.7 && t < 0.9) || t >= 1.4) {
+          iq[i] = std::complex<float>(0, 0);
+        }
+      }
+      std::vector<int16_t> frames(2 * n);
+      fc32_to_sc16(&iq[0], &frames[0], n, SC16_Q11_SCALE);
+      return frames;
+    }
+
+    static void
+    on_event(std::vector<struct batch_event> *events,
+             const struct frs_channel &ch, double time,
+             const struct squelch_event &e)
+    {
+      struct batch_event b;
+      b.recording = 0;
+      b.time = time;
+      b.channel = ch.number;
+      b.frequency = ch.frequency;
+      b.type = e.open ? BATCH_OPEN : BATCH_CLOSE;
+      b.value = e.power_db;
+      events->push_back(b);
+    }
+
+    static void
+    ignore_audio(const struct frs_channel &ch, const float *audio, size_t n)
+    {
+    }
+
+    static std::vector<struct batch_event>
+    run_batch(const std::string &path, size_t threads)
+    {
+      struct batch_config config;
+      config.rx = receiver_config();
+      config.rx.threads = threads;
+      config.fixed = false;
+      config.slice_seconds = 0.25;
+      config.overlap_seconds = 0.1;
+      batch_receiver batch(config);
+      batch.add(path);
+      CPPUNIT_ASSERT_EQUAL((size_t)7, batch.slices());
+      std::vector<struct batch_event> events;
+      batch.run(events);
+      return events;
+    }
+
+    static bool
+    same_events(const std::vector<struct batch_event> &a,
+                const std::vector<struct batch_event> &b, double tolerance)
+    {
+      if (a.size() != b.size()) {
+        return false;
+      }
+      for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].channel != b[i].channel || a[i].type != b[i].type ||
+            fabs(a[i].time - b[i].time) > tolerance) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /* Serial and sliced receivers cut blocks in different places,
+     * which moves events by a few samples and so may reorder those of
+     * different channels */
+    static bool
+    same_per_channel(const std::vector<struct batch_event> &a,
+                     const std::vector<struct batch_event> &b,
+                     double tolerance)
+    {
+      for (int ch = 1; ch <= 7; ch++) {
+        std::vector<struct batch_event> x, y;
+        for (size_t i = 0; i < a.size(); i++) {
+          if (a[i].channel == ch) {
+            x.push_back(a[i]);
+          }
+        }
+        for (size_t i = 0; i < b.size(); i++) {
+          if (b[i].channel == ch) {
+            y.push_back(b[i]);
+          }
+        }
+        if (!same_events(x, y, tolerance)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /* Sliced, on any number of threads and from either kind of file,
+     * the events are those of one receiver run over the whole
+     * recording */
+    void
+    qa_batch_receiver::t1()
+    {
+      const struct frs_receiver_config config = receiver_config();
+      const std::vector<int16_t> frames = make_recording(config);
+      const size_t n = frames.size() / 2;
+
+      std::vector<struct batch_event> serial;
+      {
+        frs_receiver rx(config, &ignore_audio,
+                        boost::bind(&on_event, &serial, _1, _2, _3));
+        std::vector<std::complex<float> > buf(config.max_block);
+        for (size_t pos = 0; pos < n; pos += config.max_block) {
+          size_t m = std::min(n - pos, config.max_block);
+          std::complex<float> *out = &buf[0];
+          sc16_to_fc32(&frames[2 * pos], &out, m, 1, SC16_Q11_SCALE);
+          rx.process(&buf[0], m);
+        }
+      }
+      size_t opens = 0;
+      for (size_t i = 0; i < serial.size(); i++) {
+        if (serial[i].channel == 3 && serial[i].type == BATCH_OPEN) {
+          opens++;
+        }
+      }
+      CPPUNIT_ASSERT_EQUAL((size_t)2, opens);
+
+      char raw[64], packed[64];
+      snprintf(raw, sizeof(raw), "/tmp/qa_batch_%d.sc16", (int)getpid());
+      snprintf(packed, sizeof(packed), "/tmp/qa_batch_%d.sc16z",
+               (int)getpid());
+      FILE *f = fopen(raw, "wb");
+      CPPUNIT_ASSERT(f != NULL);
+      CPPUNIT_ASSERT_EQUAL(n, fwrite(&frames[0], 4, n, f));
+      fclose(f);
+
+      struct sc16_writer_config wc;
+      wc.path = packed;
+      wc.codec = SC16_CODEC_RICE;
+      wc.block_frames = 30000;
+      wc.nchan = 1;
+      wc.samp_rate = RATE;
+      wc.center_freq = config.center_freq;
+      wc.start_time = 0;
+      {
+        sc16_file_writer w(wc);
+        w.write(&frames[0], n);
+        w.close();
+        CPPUNIT_ASSERT(w.ok());
+      }
+
+      std::vector<struct batch_event> one = run_batch(raw, 0);
+      CPPUNIT_ASSERT(same_per_channel(serial, one, 1e-3));
+      for (size_t i = 1; i < one.size(); i++) {
+        CPPUNIT_ASSERT(one[i - 1].time <= one[i].time);
+      }
+
+      std::vector<struct batch_event> many = run_batch(raw, 3);
+      CPPUNIT_ASSERT(same_events(one, many, 0));
+      for (size_t i = 0; i < one.size(); i++) {
+        CPPUNIT_ASSERT_EQUAL(one[i].value, many[i].value);
+      }
+      CPPUNIT_ASSERT(same_events(one, run_batch(packed, 2), 0));
+
+      unlink(raw);
+      unlink(packed);
+    }
+
+    /* Recordings that cannot be received are refused when added */
+    void
+    qa_batch_receiver::t2()
+    {
+      struct batch_config config;
+      config.rx = receiver_config();
+      config.rx.samp_rate = 0;
+      config.fixed = false;
+      config.slice_seconds = 1;
+      config.overlap_seconds = 0.1;
+      batch_receiver batch(config);
+
+      char path[64];
+      snprintf(path, sizeof(path), "/tmp/qa_batch_%d.sc16", (int)getpid());
+      CPPUNIT_ASSERT_THROW(batch.add(path), std::runtime_error);
+      FILE *f = fopen(path, "wb");
+      CPPUNIT_ASSERT(f != NULL);
+      fclose(f);
+      CPPUNIT_ASSERT_THROW(batch.add(path), std::invalid_argument);
+      CPPUNIT_ASSERT_EQUAL((size_t)0, batch.recordings());
+      unlink(path);
+
+      config.slice_seconds = 0;
+      CPPUNIT_ASSERT_THROW(batch_receiver b(config), std::invalid_argument);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
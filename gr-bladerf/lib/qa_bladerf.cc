@@ -28,12 +28,58 @@
 
 #include "qa_bladerf.h"
 #include "qa_single_rx.h"
+#include "qa_capture_queue.h"
+#include "qa_core_layout.h"
+#include "qa_rx_pipeline.h"
+#include "qa_device_state.h"
+#include "qa_sample_convert.h"
+#include "qa_frs_receiver.h"
+#include "qa_fm_discriminator.h"
+#include "qa_channel_decimator.h"
+#include "qa_channelizer.h"
+#include "qa_channel_plan.h"
+#include "qa_iq_ring.h"
+#include "qa_clip_store.h"
+#include "qa_iq_bus.h"
+#include "qa_iq_stream.h"
+#include "qa_sc16_codec.h"
+#include "qa_batch_receiver.h"
+#include "qa_csv_samples.h"
+#include "qa_welch_psd.h"
+#include "qa_alternating_checker.h"
+#include "qa_sequence_auditor.h"
+#include "qa_duplex_engine.h"
+#include "qa_marker_correlator.h"
+#include "qa_nbfm_modulator.h"
 
 CppUnit::TestSuite *
 qa_bladerf::suite()
 {
   CppUnit::TestSuite *s = new CppUnit::TestSuite("bladerf");
   s->addTest(gr::bladerf::qa_single_rx::suite());
+  s->addTest(gr::bladerf::qa_capture_queue::suite());
+  s->addTest(gr::bladerf::qa_core_layout::suite());
+  s->addTest(gr::bladerf::qa_rx_pipeline::suite());
+  s->addTest(gr::bladerf::qa_device_state::suite());
+  s->addTest(gr::bladerf::qa_sample_convert::suite());
+  s->addTest(gr::bladerf::qa_frs_receiver::suite());
+  s->addTest(gr::bladerf::qa_fm_discriminator::suite());
+  s->addTest(gr::bladerf::qa_channel_decimator::suite());
+  s->addTest(gr::bladerf::qa_channelizer::suite());
+  s->addTest(gr::bladerf::qa_channel_plan::suite());
+  s->addTest(gr::bladerf::qa_iq_ring::suite());
+  s->addTest(gr::bladerf::qa_clip_store::suite());
+  s->addTest(gr::bladerf::qa_iq_bus::suite());
+  s->addTest(gr::bladerf::qa_iq_stream::suite());
+  s->addTest(gr::bladerf::qa_sc16_codec::suite());
+  s->addTest(gr::bladerf::qa_batch_receiver::suite());
+  s->addTest(gr::bladerf::qa_csv_samples::suite());
+  s->addTest(gr::bladerf::qa_welch_psd::suite());
+  s->addTest(gr::bladerf::qa_alternating_checker::suite());
+  s->addTest(gr::bladerf::qa_sequence_auditor::suite());
+  s->addTest(gr::bladerf::qa_duplex_engine::suite());
+  s->addTest(gr::bladerf::qa_marker_correlator::suite());
+  s->addTest(gr::bladerf::qa_nbfm_modulator::suite());
 
   return s;
 }
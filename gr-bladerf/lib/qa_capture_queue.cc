@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_capture_queue.h"
+#include "capture_queue.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static void
+    fill(int16_t *buf, size_t nframes, int16_t value)
+    {
+      for (size_t i = 0; i < nframes * 2; i++) {
+        buf[i] = value;
+      }
+    }
+
+    /* Contiguous buffers read back across a buffer boundary */
+    void
+    qa_capture_queue::t1()
+    {
+      capture_queue q(4, 8, 1);
+      int16_t out[2 * 12];
+
+      int16_t *b = q.acquire();
+      fill(b, 8, 1);
+      q.commit(b, 1000, 8);
+      b = q.acquire();
+      fill(b, 8, 2);
+      q.commit(b, 1008, 8);
+
+      CPPUNIT_ASSERT_EQUAL((uint64_t)16, q.available(0));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1000, q.origin());
+      CPPUNIT_ASSERT_EQUAL((size_t)0, q.read(4, 12, out));
+      CPPUNIT_ASSERT_EQUAL((int16_t)1, out[0]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)1, out[2 * 3 + 1]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)2, out[2 * 4]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)2, out[2 * 11 + 1]);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, q.available(16));
+    }
+
+    /* A timestamp jump is zero-filled so the timeline stays aligned */
+    void
+    qa_capture_queue::t2()
+    {
+      capture_queue q(4, 8, 2);
+      int16_t out[4 * 24];
+
+      int16_t *b = q.acquire();
+      fill(b, 16, 5);
+      q.commit(b, 0, 8);
+      b = q.acquire();
+      fill(b, 16, 7);
+      q.commit(b, 16, 8);
+
+      CPPUNIT_ASSERT_EQUAL((uint64_t)24, q.available(0));
+      CPPUNIT_ASSERT_EQUAL((size_t)8, q.read(0, 24, out));
+      CPPUNIT_ASSERT_EQUAL((int16_t)5, out[4 * 7 + 3]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)0, out[4 * 8]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)0, out[4 * 15 + 3]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)7, out[4 * 16]);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)8, q.gap_frames());
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
+
@@ -0,0 +1,152 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <math.h>
+#include "qa_channel_decimator.h"
+#include "channel_decimator.h"
+#include "sample_convert.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const double RATE = 2e6;
+    static const double OFFSET = 100e3;
+    static const unsigned int DECIM = 80;
+    static const size_t BLOCK = 9999;
+
+    static std::vector<std::complex<float> >
+    tone(double freq, size_t n)
+    {
+      std::vector<std::complex<float> > x(n);
+      for (size_t i = 0; i < n; i++) {
+        double ph = fmod(2 * M_PI * freq * i / RATE, 2 * M_PI);
+        x[i] = std::polar(0.5f, (float)ph);
+      }
+      return x;
+    }
+
+    static std::vector<std::complex<float> >
+    run(channel_decimator &d, const std::vector<std::complex<float> > &x,
+        size_t block)
+    {
+      std::vector<std::complex<float> > y(x.size() / DECIM + 2);
+      size_t nout = 0;
+      for (size_t i = 0; i < x.size(); i += block) {
+        size_t n = std::min(block, x.size() - i);
+        nout += d.process(&x[i], n, &y[nout]);
+      }
+      y.resize(nout);
+      return y;
+    }
+
+    /* Gain in dB of a tone f Hz from the channel centre, once settled */
+    static double
+    gain_db(double f)
+    {
+      channel_decimator d(RATE, OFFSET, DECIM, 6.25e3, 12.5e3, BLOCK);
+      std::vector<std::complex<float> > y =
+        run(d, tone(OFFSET + f, 100000), BLOCK);
+      double sum = 0;
+      for (size_t i = 200; i < y.size(); i++) {
+        sum += std::norm(y[i]);
+      }
+      return 10 * log10(sum / (y.size() - 200) / 0.25);
+    }
+
+    /* Flat passband with the CIC droop compensated; stopband, CIC alias
+     * and halfband alias frequencies all rejected */
+    void
+    qa_channel_decimator::t1()
+    {
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, gain_db(0), 0.25);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, gain_db(2e3), 0.25);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, gain_db(-4e3), 0.25);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, gain_db(6e3), 0.25);
+      CPPUNIT_ASSERT(gain_db(20e3) < -50);
+      CPPUNIT_ASSERT(gain_db(-51e3) < -60);
+      CPPUNIT_ASSERT(gain_db(101e3) < -60);
+      CPPUNIT_ASSERT(gain_db(-199e3) < -60);
+    }
+
+    /* Odd block sizes give the same output as large blocks */
+    void
+    qa_channel_decimator::t2()
+    {
+      std::vector<std::complex<float> > x = tone(OFFSET + 1.5e3, 50000);
+      channel_decimator a(RATE, OFFSET, DECIM, 6.25e3, 12.5e3, BLOCK);
+      channel_decimator b(RATE, OFFSET, DECIM, 6.25e3, 12.5e3, BLOCK);
+      std::vector<std::complex<float> > ya = run(a, x, BLOCK);
+      std::vector<std::complex<float> > yb = run(b, x, 777);
+
+      CPPUNIT_ASSERT_EQUAL(ya.size(), yb.size());
+      for (size_t i = 0; i < ya.size(); i++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(ya[i].real(), yb[i].real(), 1e-4);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(ya[i].imag(), yb[i].imag(), 1e-4);
+      }
+    }
+
+    /* The fixed point path follows the float path to within the Q11
+     * quantization of the input */
+    void
+    qa_channel_decimator::t4()
+    {
+      std::vector<std::complex<float> > x = tone(OFFSET + 1.5e3, 50000);
+      std::vector<int16_t> raw(2 * x.size());
+      for (size_t i = 0; i < x.size(); i++) {
+        raw[2 * i] = (int16_t)lrintf(x[i].real() * SC16_Q11_SCALE);
+        raw[2 * i + 1] = (int16_t)lrintf(x[i].imag() * SC16_Q11_SCALE);
+        x[i] = std::complex<float>(raw[2 * i], raw[2 * i + 1]) /
+               SC16_Q11_SCALE;
+      }
+
+      channel_decimator a(RATE, OFFSET, DECIM, 6.25e3, 12.5e3, BLOCK);
+      channel_decimator b(RATE, OFFSET, DECIM, 6.25e3, 12.5e3, BLOCK);
+      std::vector<std::complex<float> > ya = run(a, x, BLOCK);
+      std::vector<std::complex<float> > yb(ya.size() + 2);
+      size_t nout = 0;
+      for (size_t i = 0; i < x.size(); i += 777) {
+        size_t n = std::min((size_t)777, x.size() - i);
+        nout += b.process_sc16(&raw[2 * i], n, &yb[nout]);
+      }
+
+      CPPUNIT_ASSERT_EQUAL(ya.size(), nout);
+      double err = 0, power = 0;
+      for (size_t i = 0; i < nout; i++) {
+        err += std::norm(ya[i] - yb[i]);
+        power += std::norm(ya[i]);
+      }
+      CPPUNIT_ASSERT(10 * log10(err / power) < -60);
+    }
+
+    /* 2 MS/s to 25 kS/s: CIC by 20, one halfband, final FIR by 2 */
+    void
+    qa_channel_decimator::t3()
+    {
+      channel_decimator d(RATE, OFFSET, DECIM, 6.25e3, 12.5e3, BLOCK);
+      CPPUNIT_ASSERT_EQUAL(20u, d.cic_decimation());
+      CPPUNIT_ASSERT_EQUAL((size_t)1, d.halfbands());
+      CPPUNIT_ASSERT(d.multiplies() < 8);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,86 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <stdexcept>
+#include <math.h>
+#include "qa_channel_plan.h"
+#include "channel_plan.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const double BANDWIDTH = 12.5e3;
+    static const double OUT_RATE = 25e3;
+
+    /* Every channel inside the usable band and clear of the LO, no
+     * images on other channels, and no dearer than the hand-made plan
+     * of 6 MS/s around the middle of the band */
+    void
+    qa_channel_plan::t1()
+    {
+      const std::vector<struct frs_channel> &t = frs_channel_table();
+      struct plan_limits l = default_plan_limits();
+      struct channel_plan p = make_channel_plan(t, BANDWIDTH, OUT_RATE, l);
+
+      double decim = p.samp_rate / OUT_RATE;
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(floor(decim + 0.5), decim, 1e-9);
+      CPPUNIT_ASSERT_EQUAL((size_t)0, p.image_hits);
+      CPPUNIT_ASSERT_EQUAL(t.size(), p.channelizer.channels.size());
+      for (size_t i = 0; i < t.size(); i++) {
+        double offset = p.channelizer.channels[i].offset;
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(t[i].frequency - p.center_freq,
+                                     offset, 1e-3);
+        CPPUNIT_ASSERT(fabs(offset) + BANDWIDTH / 2 <=
+                       l.usable_fraction * p.samp_rate / 2);
+        CPPUNIT_ASSERT(fabs(offset) - BANDWIDTH / 2 >= l.dc_guard);
+      }
+
+      struct channelizer_config hand = p.channelizer;
+      hand.samp_rate = 6e6;
+      for (size_t i = 0; i < t.size(); i++) {
+        hand.channels[i].offset = t[i].frequency -
+                                  frs_center_frequency(t);
+      }
+      double cost = std::min(channelizer::nco_cost(hand),
+                             channelizer::fft_cost(hand)) * 6e6;
+      CPPUNIT_ASSERT(p.cost <= cost);
+
+      /* The plan builds a channelizer as it stands */
+      channelizer c(p.channelizer);
+      CPPUNIT_ASSERT(c.method() == p.channelizer.method);
+    }
+
+    /* A band wider than the fastest rate cannot be planned */
+    void
+    qa_channel_plan::t2()
+    {
+      struct plan_limits l = default_plan_limits();
+      l.max_rate = 2e6;
+      CPPUNIT_ASSERT_THROW(make_channel_plan(frs_channel_table(), BANDWIDTH,
+                                             OUT_RATE, l),
+                           std::invalid_argument);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
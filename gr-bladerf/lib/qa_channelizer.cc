@@ -0,0 +1,164 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <math.h>
+#include "qa_channelizer.h"
+#include "channelizer.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const double RATE = 2e6;
+    static const double OUT_RATE = 25e3;
+    static const size_t BLOCK = 9999;
+    static const size_t SETTLE = 200;
+
+    /* Off-grid centres, each carrying a tone 1 kHz up at its own level */
+    static const double OFFSETS[] = { -612.5e3, -37.5e3, 12345.0, 400e3 };
+    static const size_t NCH = sizeof(OFFSETS) / sizeof(OFFSETS[0]);
+
+    static struct channelizer_config
+    config(channelizer_method method)
+    {
+      struct channelizer_config c;
+      c.samp_rate = RATE;
+      c.out_rate = OUT_RATE;
+      c.method = method;
+      c.max_input = BLOCK;
+      for (size_t i = 0; i < NCH; i++) {
+        struct channel_spec s = { OFFSETS[i], 12.5e3 };
+        c.channels.push_back(s);
+      }
+      return c;
+    }
+
+    static std::vector<std::complex<float> >
+    input(size_t n)
+    {
+      std::vector<std::complex<float> > x(n);
+      for (size_t ch = 0; ch < NCH; ch++) {
+        for (size_t i = 0; i < n; i++) {
+          double ph = fmod(2 * M_PI * (OFFSETS[ch] + 1e3) * i / RATE,
+                           2 * M_PI);
+          x[i] += std::polar(0.1f * (ch + 1), (float)ph);
+        }
+      }
+      return x;
+    }
+
+    static std::vector<std::vector<std::complex<float> > >
+    run(channelizer &c, const std::vector<std::complex<float> > &x,
+        size_t block)
+    {
+      std::vector<std::vector<std::complex<float> > > y(NCH);
+      std::vector<std::complex<float> > buf(NCH * c.max_output());
+      std::vector<std::complex<float> *> out(NCH);
+      for (size_t ch = 0; ch < NCH; ch++) {
+        out[ch] = &buf[ch * c.max_output()];
+      }
+      for (size_t i = 0; i < x.size(); i += block) {
+        size_t n = std::min(block, x.size() - i);
+        size_t nout = c.process(&x[i], n, &out[0]);
+        for (size_t ch = 0; ch < NCH; ch++) {
+          y[ch].insert(y[ch].end(), out[ch], out[ch] + nout);
+        }
+      }
+      return y;
+    }
+
+    /* Each channel holds only its own tone, at its level and 1 kHz */
+    static void
+    check_tones(channelizer_method method)
+    {
+      channelizer c(config(method));
+      CPPUNIT_ASSERT(c.method() == method);
+      std::vector<std::vector<std::complex<float> > > y =
+        run(c, input(200000), BLOCK);
+
+      for (size_t ch = 0; ch < NCH; ch++) {
+        double power = 0;
+        std::complex<double> rot = 0;
+        for (size_t i = SETTLE; i + 1 < y[ch].size(); i++) {
+          power += std::norm(y[ch][i]);
+          rot += std::complex<double>(y[ch][i + 1] * std::conj(y[ch][i]));
+        }
+        power /= y[ch].size() - SETTLE - 1;
+        double level = 0.1 * (ch + 1);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(
+          0.0, 10 * log10(power / (level * level)), 0.25);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(
+          1e3, std::arg(rot) * OUT_RATE / (2 * M_PI), 1.0);
+      }
+    }
+
+    /* Both methods channelize off-grid centres correctly */
+    void
+    qa_channelizer::t1()
+    {
+      check_tones(CHANNELIZER_NCO);
+      check_tones(CHANNELIZER_FFT);
+    }
+
+    /* Odd block sizes give the same output as large blocks */
+    void
+    qa_channelizer::t2()
+    {
+      std::vector<std::complex<float> > x = input(60000);
+      channelizer a(config(CHANNELIZER_FFT));
+      channelizer b(config(CHANNELIZER_FFT));
+      std::vector<std::vector<std::complex<float> > > ya =
+        run(a, x, BLOCK);
+      std::vector<std::vector<std::complex<float> > > yb = run(b, x, 777);
+
+      for (size_t ch = 0; ch < NCH; ch++) {
+        CPPUNIT_ASSERT_EQUAL(ya[ch].size(), yb[ch].size());
+        for (size_t i = 0; i < ya[ch].size(); i++) {
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(ya[ch][i].real(), yb[ch][i].real(),
+                                       1e-4);
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(ya[ch][i].imag(), yb[ch][i].imag(),
+                                       1e-4);
+        }
+      }
+    }
+
+    /* Auto picks the NCOs for a single channel and the FFT for a band */
+    void
+    qa_channelizer::t3()
+    {
+      struct channelizer_config c = config(CHANNELIZER_AUTO);
+      c.channels.resize(1);
+      CPPUNIT_ASSERT(channelizer(c).method() == CHANNELIZER_NCO);
+
+      c.channels.clear();
+      for (int i = 0; i < 16; i++) {
+        struct channel_spec s = { -700e3 + i * 87.5e3, 12.5e3 };
+        c.channels.push_back(s);
+      }
+      channelizer many(c);
+      CPPUNIT_ASSERT(many.method() == CHANNELIZER_FFT);
+      CPPUNIT_ASSERT(many.multiplies() < 0.8 * channelizer::nco_cost(c));
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,196 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "qa_clip_store.h"
+#include "adpcm.h"
+#include "clip_store.h"
+#include "ctcss_detector.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const double AUDIO_RATE = 25e3;
+
+    /* CTCSS tone under a louder voice band tone and noise */
+    static std::vector<float>
+    tone_audio(double ctcss, size_t n)
+    {
+      std::vector<float> a(n);
+      uint32_t seed = 1;
+      for (size_t i = 0; i < n; i++) {
+        seed = seed * 1664525 + 1013904223;
+        a[i] = (float)(0.15 * sin(2 * M_PI * ctcss * i / AUDIO_RATE) +
+                       0.5 * sin(2 * M_PI * 1000 * i / AUDIO_RATE) +
+                       0.05 * (seed * (2.0 / 4294967296.0) - 1.0));
+      }
+      return a;
+    }
+
+    /* Neighbouring tones 2.5 Hz apart are told apart; voice alone
+     * finds none */
+    void
+    qa_clip_store::t1()
+    {
+      const double tones[3] = { 71.9, 74.4, 250.3 };
+      for (int t = 0; t < 3; t++) {
+        ctcss_detector d(AUDIO_RATE);
+        std::vector<struct ctcss_event> events;
+        std::vector<float> a = tone_audio(tones[t], 25000);
+        d.process(&a[0], a.size(), events);
+        CPPUNIT_ASSERT_EQUAL((size_t)1, events.size());
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(tones[t], events[0].tone, 0.01);
+        CPPUNIT_ASSERT(events[0].index < 11000);
+      }
+
+      ctcss_detector d(AUDIO_RATE);
+      std::vector<struct ctcss_event> events;
+      std::vector<float> a(25000);
+      for (size_t i = 0; i < a.size(); i++) {
+        a[i] = (float)(0.5 * sin(2 * M_PI * 400 * i / AUDIO_RATE));
+      }
+      d.process(&a[0], a.size(), events);
+      CPPUNIT_ASSERT(events.empty());
+    }
+
+    /* ADPCM of a clip decodes on its own, close to the input */
+    void
+    qa_clip_store::t2()
+    {
+      const size_t n = 2001;
+      std::vector<int16_t> in(n), out(n);
+      std::vector<uint8_t> coded(adpcm_state::bytes(n));
+      for (size_t i = 0; i < n; i++) {
+        in[i] = (int16_t)(20000 * sin(2 * M_PI * 700 * i / AUDIO_RATE));
+      }
+
+      adpcm_state enc, dec;
+      enc.encode(&in[0], n, &coded[0]);
+      dec.decode(&coded[0], n, &out[0]);
+
+      double err = 0, sig = 0;
+      for (size_t i = 100; i < n; i++) {
+        err += (double)(in[i] - out[i]) * (in[i] - out[i]);
+        sig += (double)in[i] * in[i];
+      }
+      CPPUNIT_ASSERT(10 * log10(err / sig) < -20);
+    }
+
+    static void
+    transmit(clip_store &s, int ch, double start, double end, float tone)
+    {
+      const size_t block = 2500;
+      std::vector<float> a(block, 0.25f);
+      s.squelch(ch, start, true, -30);
+      for (double t = start; t < end - 1e-9; t += block / AUDIO_RATE) {
+        size_t n = std::min(block, (size_t)floor((end - t) * AUDIO_RATE +
+                                                 0.5));
+        s.audio(ch, &a[0], n);
+        if (tone != 0) {
+          s.tone(ch, t, tone);
+        }
+        s.level(ch, t + n / AUDIO_RATE, -20);
+      }
+      s.squelch(ch, end, false, -50);
+    }
+
+    /* Clips are cut on squelch, tone change and length, and found by
+     * time and channel after reopening the store */
+    void
+    qa_clip_store::t3()
+    {
+      char dir[] = "/tmp/qa_clip_store_XXXXXX";
+      CPPUNIT_ASSERT(mkdtemp(dir) != NULL);
+
+      struct clip_store_config config;
+      config.directory = dir;
+      config.channels.push_back(1);
+      config.channels.push_back(8);
+      config.audio_rate = AUDIO_RATE;
+      config.start_time = 1000;
+      config.max_duration = 1.0;
+
+      {
+        clip_store s(config);
+        transmit(s, 1, 0.0, 0.5, 67.0f);
+        transmit(s, 8, 0.2, 0.4, 0);
+        transmit(s, 1, 2.0, 4.5, 0);      /* split at 3.0 and 4.0 */
+        CPPUNIT_ASSERT_EQUAL((uint64_t)5, s.clips());
+      }
+      {
+        clip_store s(config);
+        s.squelch(8, 10.0, true, -30);
+        std::vector<float> a(5000, 0.25f);
+        s.audio(8, &a[0], 2500);
+        s.tone(8, 10.1, 100.0f);
+        s.audio(8, &a[0], 5000);
+        s.tone(8, 10.3, 103.5f);          /* new transmitter */
+        s.audio(8, &a[0], 2500);
+        s.close(10.4);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)2, s.clips());
+      }
+
+      clip_index idx(dir);
+      CPPUNIT_ASSERT_EQUAL((size_t)7, idx.size());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, idx.header().max_duration, 1e-9);
+
+      CPPUNIT_ASSERT_EQUAL((uint16_t)1, idx[0].channel);
+      CPPUNIT_ASSERT_EQUAL((uint16_t)670, idx[0].ctcss);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1000.0, idx[0].start, 1e-9);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, idx[0].duration, 1e-6);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(-20.0, idx[0].rssi_db, 1.0);
+      CPPUNIT_ASSERT_EQUAL((uint16_t)1000, idx[5].ctcss);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.3, idx[5].duration, 1e-6);
+      CPPUNIT_ASSERT_EQUAL((uint16_t)1035, idx[6].ctcss);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1010.3, idx[6].start, 1e-9);
+
+      std::vector<int> all, ch8(1, 8);
+      std::vector<size_t> f = idx.find(1000.3, 1000.35, all);
+      CPPUNIT_ASSERT_EQUAL((size_t)2, f.size());
+      f = idx.find(1000.3, 1000.35, ch8);
+      CPPUNIT_ASSERT_EQUAL((size_t)1, f.size());
+      CPPUNIT_ASSERT_EQUAL((uint16_t)8, idx[f[0]].channel);
+      f = idx.find(1003.5, 1003.6, all);
+      CPPUNIT_ASSERT_EQUAL((size_t)1, f.size());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1003.0, idx[f[0]].start, 1e-9);
+      CPPUNIT_ASSERT(idx.find(1005, 1009, all).empty());
+      CPPUNIT_ASSERT_EQUAL((size_t)7, idx.find(0, 2000, all).size());
+
+      std::vector<int16_t> pcm;
+      CPPUNIT_ASSERT(idx.audio(6, pcm));
+      CPPUNIT_ASSERT_EQUAL((size_t)2500, pcm.size());
+      CPPUNIT_ASSERT(abs(pcm.back() - 7250) < 100);
+
+      remove((std::string(dir) + "/clips.idx").c_str());
+      remove((std::string(dir) + "/clips.adpcm").c_str());
+      rmdir(dir);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
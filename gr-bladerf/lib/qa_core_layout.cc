@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include "qa_core_layout.h"
+#include <bladerf/core_layout.h>
+
+namespace gr {
+  namespace bladerf {
+
+    static cpu_info
+    make_cpu(int cpu, int core, int package, int node)
+    {
+      cpu_info info;
+      info.cpu = cpu;
+      info.core = core;
+      info.package = package;
+      info.node = node;
+      return info;
+    }
+
+    /* 4 cores with hyper-threading: CPU 0 is left alone and only the
+     * siblings of DSP cores are used */
+    void
+    qa_core_layout::t1()
+    {
+      std::vector<cpu_info> cpus;
+      for (int i = 0; i < 8; i++) {
+        cpus.push_back(make_cpu(i, i % 4, 0, 0));
+      }
+
+      core_layout layout(cpus, 14);
+      CPPUNIT_ASSERT_EQUAL(1, layout.capture()[0]);
+      CPPUNIT_ASSERT_EQUAL(2, layout.output()[0]);
+      CPPUNIT_ASSERT_EQUAL(3, layout.channel(0)[0]);
+      CPPUNIT_ASSERT_EQUAL(7, layout.channel(1)[0]);
+      CPPUNIT_ASSERT_EQUAL(3, layout.channel(2)[0]);
+    }
+
+    /* Everything stays on the larger NUMA node */
+    void
+    qa_core_layout::t2()
+    {
+      std::vector<cpu_info> cpus;
+      cpus.push_back(make_cpu(0, 0, 0, 0));
+      cpus.push_back(make_cpu(1, 1, 0, 0));
+      for (int i = 2; i < 8; i++) {
+        cpus.push_back(make_cpu(i, i, 1, 1));
+      }
+
+      core_layout layout(cpus, 3);
+      CPPUNIT_ASSERT_EQUAL(2, layout.capture()[0]);
+      CPPUNIT_ASSERT_EQUAL(3, layout.output()[0]);
+      CPPUNIT_ASSERT_EQUAL(4, layout.channel(0)[0]);
+      CPPUNIT_ASSERT_EQUAL(6, layout.channel(2)[0]);
+      CPPUNIT_ASSERT(layout.channel(-1).empty());
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
+
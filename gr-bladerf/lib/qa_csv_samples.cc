@@ -0,0 +1,150 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <algorithm>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "qa_csv_samples.h"
+#include "csv_samples.h"
+#include "worker_pool.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static bool
+    parses(const char *text, size_t columns, const int16_t *expect)
+    {
+      int16_t out[4];
+      const char *end = text + strlen(text);
+      const char *next = parse_csv_line(text, end, columns, out);
+      return next != NULL && (next == end || next[-1] == '\n') &&
+             memcmp(out, expect, columns * sizeof(int16_t)) == 0;
+    }
+
+    /* Lines as bladeRF-cli writes them, and ones it does not */
+    void
+    qa_csv_samples::t1()
+    {
+      const int16_t a[4] = { 12, -34, 2047, -2048 };
+      const int16_t b[2] = { 32767, -32768 };
+      CPPUNIT_ASSERT(parses("12, -34\n", 2, a));
+      CPPUNIT_ASSERT(parses("12,-34", 2, a));
+      CPPUNIT_ASSERT(parses(" 12 ,\t-34 \r\n", 2, a));
+      CPPUNIT_ASSERT(parses("+12, -34, 2047, -2048\n", 4, a));
+      CPPUNIT_ASSERT(parses("32767, -32768\n", 2, b));
+
+      int16_t out[4];
+      const char *bad[7] = {
+        "12\n", "12, -34, 5\n", "12,, -34\n", "\n", "32768, 0\n",
+        "-32769, 0\n", "1x, 2\n"
+      };
+      for (int i = 0; i < 7; i++) {
+        CPPUNIT_ASSERT(parse_csv_line(bad[i], bad[i] + strlen(bad[i]), 2,
+                                      out) == NULL);
+      }
+
+      std::string text;
+      for (int i = 0; i < 1000; i++) {
+        text += (i % 7) ? "1, 2\n" : "-3, 4\r\n";
+      }
+      CPPUNIT_ASSERT_EQUAL((size_t)1000,
+                           count_newlines(text.data(),
+                                          text.data() + text.size()));
+      for (size_t skip = 0; skip < 70; skip += 3) {
+        CPPUNIT_ASSERT_EQUAL((size_t)std::count(text.begin() + skip,
+                                                text.end() - skip, '\n'),
+                             count_newlines(text.data() + skip,
+                                            text.data() + text.size() -
+                                            skip));
+      }
+    }
+
+    /* A dual channel file big enough for several chunks reads back the
+     * same on one thread and on several, and a bad line is named */
+    void
+    qa_csv_samples::t2()
+    {
+      char path[64];
+      snprintf(path, sizeof(path), "/tmp/qa_csv_samples_%d.csv",
+               (int)getpid());
+      const size_t n = 500000;
+      std::vector<int16_t> values(4 * n);
+      FILE *f = fopen(path, "w");
+      CPPUNIT_ASSERT(f != NULL);
+      srand(3);
+      for (size_t i = 0; i < values.size(); i++) {
+        values[i] = (int16_t)(rand() % 4096 - 2048);
+      }
+      for (size_t i = 0; i < n; i++) {
+        fprintf(f, "%d, %d, %d, %d\n", values[4 * i], values[4 * i + 1],
+                values[4 * i + 2], values[4 * i + 3]);
+      }
+      fclose(f);
+
+      worker_pool pool(3, std::vector<int>(), 0);
+      {
+        csv_samples csv(path, &pool);
+        CPPUNIT_ASSERT_EQUAL((size_t)4, csv.columns());
+        CPPUNIT_ASSERT_EQUAL((size_t)2, csv.nchan());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)n, csv.frames());
+        CPPUNIT_ASSERT(csv.chunks() > 2);
+
+        std::vector<int16_t> out(4 * n, 0);
+        csv.read(&out[0], &pool);
+        CPPUNIT_ASSERT(out == values);
+        std::fill(out.begin(), out.end(), 0);
+        csv.read(&out[0]);
+        CPPUNIT_ASSERT(out == values);
+
+        size_t last = csv.chunks() - 1;
+        CPPUNIT_ASSERT_EQUAL((uint64_t)n,
+                             csv.chunk_start(last) + csv.chunk_frames(last));
+      }
+
+      /* Break line 400001 */
+      f = fopen(path, "r+");
+      CPPUNIT_ASSERT(f != NULL);
+      char line[64];
+      for (int i = 0; i < 400000; i++) {
+        CPPUNIT_ASSERT(fgets(line, sizeof(line), f) != NULL);
+      }
+      fputc('x', f);
+      fclose(f);
+      csv_samples broken(path);
+      std::vector<int16_t> out(4 * n);
+      std::string error;
+      try {
+        broken.read(&out[0], &pool);
+      } catch (const std::runtime_error &e) {
+        error = e.what();
+      }
+      CPPUNIT_ASSERT(error.find("line 400001 ") != std::string::npos);
+      unlink(path);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
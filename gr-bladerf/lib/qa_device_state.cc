@@ -0,0 +1,132 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "qa_device_state.h"
+#include "device_state.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* A profile survives a save/load round trip, quick-tune bytes included */
+    void
+    qa_device_state::t1()
+    {
+      struct device_profile p, q;
+      char path[] = "/tmp/qa_device_state_XXXXXX";
+      int fd = mkstemp(path);
+      CPPUNIT_ASSERT(fd >= 0);
+      close(fd);
+
+      p.serial = "0123456789abcdef";
+      for (int ch = 0; ch < 2; ch++) {
+        struct channel_state &s = p.channels[BLADERF_CHANNEL_RX(ch)];
+        s.config.channel    = BLADERF_CHANNEL_RX(ch);
+        s.config.frequency  = 462562500 + ch;
+        s.config.bandwidth  = 6000000;
+        s.config.samplerate = 2000000;
+        s.config.gain       = 30 - ch;
+        s.actual            = s.config;
+        s.actual.frequency  = 462562498 + ch;
+        s.actual.bandwidth  = 5000000;
+        s.actual.samplerate = 1999999;
+        s.actual.gain       = 29 - ch;
+        for (int i = 0; i < NUM_CORRECTIONS; i++) {
+          s.corrections[i] = (bladerf_correction_value)(i * 100 - 150);
+        }
+        struct quick_tune_entry e;
+        memset(&e.qt, 0, sizeof(e.qt));
+        e.frequency = s.config.frequency;
+        e.qt.nios_profile = 0x1234;
+        e.qt.spdt = 0xa5;
+        s.quick_tunes.push_back(e);
+      }
+
+      CPPUNIT_ASSERT_EQUAL(0, save_profile(path, p));
+      CPPUNIT_ASSERT_EQUAL(0, load_profile(path, q));
+      remove(path);
+
+      CPPUNIT_ASSERT_EQUAL(p.serial, q.serial);
+      CPPUNIT_ASSERT_EQUAL(p.channels.size(), q.channels.size());
+      for (int ch = 0; ch < 2; ch++) {
+        struct channel_state &a = p.channels[BLADERF_CHANNEL_RX(ch)];
+        struct channel_state &b = q.channels[BLADERF_CHANNEL_RX(ch)];
+        CPPUNIT_ASSERT_EQUAL(a.config.channel, b.config.channel);
+        CPPUNIT_ASSERT_EQUAL(a.config.frequency, b.config.frequency);
+        CPPUNIT_ASSERT_EQUAL(a.config.bandwidth, b.config.bandwidth);
+        CPPUNIT_ASSERT_EQUAL(a.config.samplerate, b.config.samplerate);
+        CPPUNIT_ASSERT_EQUAL(a.config.gain, b.config.gain);
+        CPPUNIT_ASSERT_EQUAL(a.actual.channel, b.actual.channel);
+        CPPUNIT_ASSERT_EQUAL(a.actual.frequency, b.actual.frequency);
+        CPPUNIT_ASSERT_EQUAL(a.actual.bandwidth, b.actual.bandwidth);
+        CPPUNIT_ASSERT_EQUAL(a.actual.samplerate, b.actual.samplerate);
+        CPPUNIT_ASSERT_EQUAL(a.actual.gain, b.actual.gain);
+        for (int i = 0; i < NUM_CORRECTIONS; i++) {
+          CPPUNIT_ASSERT_EQUAL(a.corrections[i], b.corrections[i]);
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)1, b.quick_tunes.size());
+        CPPUNIT_ASSERT_EQUAL(a.quick_tunes[0].frequency,
+                             b.quick_tunes[0].frequency);
+        CPPUNIT_ASSERT_EQUAL(0, memcmp(&a.quick_tunes[0].qt,
+                                       &b.quick_tunes[0].qt,
+                                       sizeof(struct bladerf_quick_tune)));
+      }
+
+      CPPUNIT_ASSERT_EQUAL(BLADERF_ERR_NO_FILE, load_profile(path, q));
+    }
+
+    /* A profile saved without read-backs takes its requests for them */
+    void
+    qa_device_state::t2()
+    {
+      struct device_profile q;
+      char path[] = "/tmp/qa_device_state_XXXXXX";
+      int fd = mkstemp(path);
+      CPPUNIT_ASSERT(fd >= 0);
+      close(fd);
+
+      FILE *f = fopen(path, "w");
+      CPPUNIT_ASSERT(f != NULL);
+      fprintf(f, "serial 0123456789abcdef\n"
+                 "channel %d 462562500 6000000 2000000 30\n",
+              BLADERF_CHANNEL_RX(0));
+      fclose(f);
+
+      CPPUNIT_ASSERT_EQUAL(0, load_profile(path, q));
+      remove(path);
+
+      CPPUNIT_ASSERT_EQUAL((size_t)1, q.channels.size());
+      struct channel_state &s = q.channels[BLADERF_CHANNEL_RX(0)];
+      CPPUNIT_ASSERT_EQUAL(462562500u, s.config.frequency);
+      CPPUNIT_ASSERT_EQUAL(s.config.channel, s.actual.channel);
+      CPPUNIT_ASSERT_EQUAL(s.config.frequency, s.actual.frequency);
+      CPPUNIT_ASSERT_EQUAL(s.config.bandwidth, s.actual.bandwidth);
+      CPPUNIT_ASSERT_EQUAL(s.config.samplerate, s.actual.samplerate);
+      CPPUNIT_ASSERT_EQUAL(s.config.gain, s.actual.gain);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,249 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <stdexcept>
+#include "qa_duplex_engine.h"
+#include "duplex_engine.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Stands in for the device: receives come at the sample rate with
+     * consecutive timestamps, but for a jump of skip frames once, and
+     * transmits are recorded */
+    struct fake_radio {
+      boost::mutex mutex;
+      uint64_t rx_time;
+      uint64_t skip_at;
+      uint64_t skip;
+      std::vector<uint64_t> tx_times;
+      std::vector<uint32_t> tx_flags;
+      std::vector<int16_t> tx_samples;
+    };
+
+    static const double RATE = 1e6;
+
+    static int
+    fake_receive(fake_radio *r, void *buf, unsigned int nsamples,
+                 uint64_t *timestamp)
+    {
+      boost::this_thread::sleep(boost::posix_time::microseconds(
+        (int64_t)(nsamples / RATE * 1e6)));
+      memset(buf, 0, nsamples * 2 * sizeof(int16_t));
+      boost::mutex::scoped_lock lock(r->mutex);
+      if (r->skip > 0 && r->rx_time >= r->skip_at) {
+        r->rx_time += r->skip;
+        r->skip = 0;
+      }
+      *timestamp = r->rx_time;
+      r->rx_time += nsamples;
+      return 0;
+    }
+
+    static int
+    fake_transmit(fake_radio *r, const void *buf, unsigned int nsamples,
+                  uint64_t timestamp, uint32_t flags)
+    {
+      const int16_t *s = (const int16_t *)buf;
+      boost::mutex::scoped_lock lock(r->mutex);
+      r->tx_times.push_back(timestamp);
+      r->tx_flags.push_back(flags);
+      r->tx_samples.insert(r->tx_samples.end(), s, s + 2 * nsamples);
+      return 0;
+    }
+
+    static struct duplex_config
+    test_config()
+    {
+      struct duplex_config c;
+      c.rx_nchan = 1;
+      c.tx_nchan = 1;
+      c.rx_frames = 1000;
+      c.tx_frames = 1024;
+      c.samp_rate = RATE;
+      c.tx_lead = 20000;
+      c.tx_queue_frames = 1 << 20;
+      c.tx_offset = 0;
+      return c;
+    }
+
+    static std::vector<struct duplex_burst_report>
+    wait_report(duplex_engine &e)
+    {
+      std::vector<struct duplex_burst_report> reports;
+      for (int i = 0; i < 400 && reports.empty(); i++) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+        reports = e.take_reports();
+      }
+      return reports;
+    }
+
+    static uint64_t
+    wait_clock(duplex_engine &e)
+    {
+      uint64_t now = 0;
+      for (int i = 0; i < 400 && !e.now(&now); i++) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+      }
+      return now;
+    }
+
+    void
+    qa_duplex_engine::t1()
+    {
+      fake_radio r;
+      r.rx_time = 5000000;
+      r.skip_at = 5020000;
+      r.skip = 700;
+
+      struct duplex_config c = test_config();
+      c.tx_offset = 1000;
+      duplex_engine e(c, boost::bind(&fake_receive, &r, _1, _2, _3),
+                      boost::bind(&fake_transmit, &r, _1, _2, _3, _4));
+      e.start(std::vector<int>(), std::vector<int>(), 0);
+
+      /* The TX clock follows the RX timestamps, moved by the offset */
+      const uint64_t now = wait_clock(e);
+      CPPUNIT_ASSERT(now >= 5001000 + 1000);
+
+      /* A burst scheduled well ahead goes out whole at its timestamp */
+      const uint64_t start = now + 100000;
+      std::vector<int16_t> samples(2 * 10000);
+      for (size_t k = 0; k < 10000; k++) {
+        samples[2 * k] = (int16_t)(k % 2048);
+        samples[2 * k + 1] = 1;
+      }
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, e.schedule(start));
+      CPPUNIT_ASSERT_EQUAL((size_t)10000, e.push(&samples[0], 10000, 100));
+      e.end_burst();
+      /* Nothing is open any more */
+      CPPUNIT_ASSERT_EQUAL((size_t)0, e.push(&samples[0], 1, 0));
+
+      std::vector<struct duplex_burst_report> reports = wait_report(e);
+      e.stop();
+
+      CPPUNIT_ASSERT_EQUAL((size_t)1, reports.size());
+      CPPUNIT_ASSERT_EQUAL(start, reports[0].requested);
+      CPPUNIT_ASSERT_EQUAL(start, reports[0].start);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)10001, reports[0].frames);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, reports[0].padded);
+      CPPUNIT_ASSERT_EQUAL(0, reports[0].status);
+      CPPUNIT_ASSERT(reports[0].lead > 0 && reports[0].min_lead > 0);
+
+      /* Ten buffers, the first at the start and the last closing it */
+      CPPUNIT_ASSERT_EQUAL((size_t)10, r.tx_times.size());
+      CPPUNIT_ASSERT_EQUAL(start, r.tx_times[0]);
+      CPPUNIT_ASSERT_EQUAL((uint32_t)BLADERF_META_FLAG_TX_BURST_START,
+                           r.tx_flags[0]);
+      for (size_t i = 1; i < 9; i++) {
+        CPPUNIT_ASSERT_EQUAL((uint32_t)0, r.tx_flags[i]);
+        CPPUNIT_ASSERT_EQUAL(start + 1024 * i, r.tx_times[i]);
+      }
+      CPPUNIT_ASSERT_EQUAL((uint32_t)BLADERF_META_FLAG_TX_BURST_END,
+                           r.tx_flags[9]);
+      CPPUNIT_ASSERT_EQUAL((size_t)2 * 10001, r.tx_samples.size());
+      for (size_t k = 0; k < 2 * 10000; k++) {
+        CPPUNIT_ASSERT_EQUAL(samples[k], r.tx_samples[k]);
+      }
+      CPPUNIT_ASSERT_EQUAL((int16_t)0, r.tx_samples[2 * 10000]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)0, r.tx_samples[2 * 10000 + 1]);
+
+      struct duplex_stats s = e.stats();
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, s.tx_bursts);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)10001, s.tx_frames);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, s.tx_late);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, s.tx_underruns);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, s.rx_gaps);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)700, s.rx_gap_frames);
+      CPPUNIT_ASSERT(s.rx_frames > 0);
+    }
+
+    void
+    qa_duplex_engine::t2()
+    {
+      fake_radio r;
+      r.rx_time = 0;
+      r.skip_at = 0;
+      r.skip = 0;
+
+      duplex_engine e(test_config(),
+                      boost::bind(&fake_receive, &r, _1, _2, _3),
+                      boost::bind(&fake_transmit, &r, _1, _2, _3, _4));
+      e.start(std::vector<int>(), std::vector<int>(), 0);
+      const uint64_t now = wait_clock(e);
+
+      /* Scheduled in the past: late, so it starts a lead from now. Its
+       * samples then stop coming for a while, which is padded over. */
+      std::vector<int16_t> samples(2 * 3048, 7);
+      e.schedule(now - 1000);
+      CPPUNIT_ASSERT_EQUAL((size_t)2048, e.push(&samples[0], 2048, 100));
+      boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+      CPPUNIT_ASSERT_EQUAL((size_t)1000, e.push(&samples[0], 1000, 100));
+      e.end_burst();
+
+      std::vector<struct duplex_burst_report> reports = wait_report(e);
+      e.stop();
+
+      CPPUNIT_ASSERT_EQUAL((size_t)1, reports.size());
+      const struct duplex_burst_report &b = reports[0];
+      CPPUNIT_ASSERT(b.start >= now + 20000);
+      CPPUNIT_ASSERT(b.padded > 0 && b.underruns > 0);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)3048 + 1 + b.padded, b.frames);
+      CPPUNIT_ASSERT_EQUAL(b.start, r.tx_times[0]);
+
+      /* The timeline is kept: the padding sits between the samples,
+       * and none of them is lost */
+      CPPUNIT_ASSERT_EQUAL((size_t)2 * b.frames, r.tx_samples.size());
+      size_t nonzero = 0;
+      for (size_t k = 0; k < r.tx_samples.size(); k++) {
+        if (r.tx_samples[k] != 0) {
+          CPPUNIT_ASSERT_EQUAL((int16_t)7, r.tx_samples[k]);
+          nonzero++;
+        }
+      }
+      CPPUNIT_ASSERT_EQUAL((size_t)2 * 3048, nonzero);
+
+      struct duplex_stats s = e.stats();
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, s.tx_late);
+      CPPUNIT_ASSERT_EQUAL(b.padded, s.tx_padded);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, s.rx_gaps);
+
+      /* A bad configuration is refused */
+      struct duplex_config c = test_config();
+      c.tx_frames = 0;
+      bool threw = false;
+      try {
+        duplex_engine bad(c, boost::bind(&fake_receive, &r, _1, _2, _3),
+                          boost::bind(&fake_transmit, &r, _1, _2, _3, _4));
+      } catch (std::invalid_argument &) {
+        threw = true;
+      }
+      CPPUNIT_ASSERT(threw);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
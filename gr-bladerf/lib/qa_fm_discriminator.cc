@@ -0,0 +1,155 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <math.h>
+#include "qa_fm_discriminator.h"
+#include "fm_discriminator.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const size_t NCHAN = 6;
+    static const size_t NSAMP = 1003;
+    static const double RATE = 25e3;
+    static const double DEV = 2.5e3;
+    static const double TAU = 75e-6;
+
+    /* Channel ch steps its phase by up to 0.9 rad per sample, with its
+     * own amplitude so lanes cannot be mixed up unnoticed */
+    static void
+    make_input(std::vector<std::vector<std::complex<float> > > &in)
+    {
+      in.resize(NCHAN);
+      for (size_t ch = 0; ch < NCHAN; ch++) {
+        double phase = 0;
+        in[ch].resize(NSAMP);
+        for (size_t k = 0; k < NSAMP; k++) {
+          phase += 0.9 * sin(2 * M_PI * k / (40.0 + 7 * ch) + ch);
+          in[ch][k] = std::polar((float)(0.3 + 0.1 * ch), (float)phase);
+        }
+      }
+    }
+
+    /* Double precision discriminator and fm_deemph */
+    static std::vector<double>
+    reference(const std::vector<std::complex<float> > &in, bool cross)
+    {
+      double gain = RATE / (2 * M_PI * DEV);
+      double wca = 2.0 * RATE * tan(1.0 / TAU / (2.0 * RATE));
+      double k = -wca / (2.0 * RATE);
+      double p1 = (1.0 + k) / (1.0 - k), b0 = -k / (1.0 - k);
+      std::complex<double> last(0, 0);
+      double x1 = 0, y1 = 0;
+      std::vector<double> out(in.size());
+
+      for (size_t i = 0; i < in.size(); i++) {
+        std::complex<double> x(in[i].real(), in[i].imag());
+        std::complex<double> z = x * std::conj(last);
+        double step = cross ? z.imag() / std::norm(x) : std::arg(z);
+        double v = gain * step;
+        y1 = b0 * (v + x1) + p1 * y1;
+        x1 = v;
+        out[i] = y1;
+        last = x;
+      }
+      return out;
+    }
+
+    static void
+    check(fm_accuracy accuracy, double tolerance)
+    {
+      std::vector<std::vector<std::complex<float> > > in;
+      std::vector<std::vector<float> > out(NCHAN, std::vector<float>(NSAMP));
+      const std::complex<float> *ip[NCHAN];
+      float *op[NCHAN];
+
+      make_input(in);
+      for (size_t ch = 0; ch < NCHAN; ch++) {
+        ip[ch] = &in[ch][0];
+        op[ch] = &out[ch][0];
+      }
+
+      fm_discriminator d(NCHAN, NSAMP, RATE, DEV, TAU, accuracy);
+      d.demod(ip, op, NSAMP);
+
+      for (size_t ch = 0; ch < NCHAN; ch++) {
+        std::vector<double> ref = reference(in[ch], accuracy == FM_CROSS);
+        for (size_t k = 1; k < NSAMP; k++) {
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(ref[k], out[ch][k], tolerance);
+        }
+      }
+    }
+
+    /* Every accuracy against the reference, six channels so the second
+     * group is only half full */
+    void
+    qa_fm_discriminator::t1()
+    {
+      check(FM_EXACT, 1e-4);
+      check(FM_POLY, 1e-4);
+      check(FM_FAST, 1e-2);
+      check(FM_CROSS, 5e-3);
+    }
+
+    /* Splitting a block, including odd sizes that leave the SIMD loop a
+     * remainder, gives the same output as one call */
+    void
+    qa_fm_discriminator::t2()
+    {
+      std::vector<std::vector<std::complex<float> > > in;
+      std::vector<std::vector<float> > a(NCHAN, std::vector<float>(NSAMP));
+      std::vector<std::vector<float> > b(NCHAN, std::vector<float>(NSAMP));
+      const std::complex<float> *ip[NCHAN];
+      float *op[NCHAN];
+      const size_t split[3] = { 1, 501, NSAMP - 502 };
+
+      make_input(in);
+
+      fm_discriminator whole(NCHAN, NSAMP, RATE, DEV, TAU, FM_POLY);
+      for (size_t ch = 0; ch < NCHAN; ch++) {
+        ip[ch] = &in[ch][0];
+        op[ch] = &a[ch][0];
+      }
+      whole.demod(ip, op, NSAMP);
+
+      fm_discriminator parts(NCHAN, NSAMP, RATE, DEV, TAU, FM_POLY);
+      size_t done = 0;
+      for (int s = 0; s < 3; s++) {
+        for (size_t ch = 0; ch < NCHAN; ch++) {
+          ip[ch] = &in[ch][done];
+          op[ch] = &b[ch][done];
+        }
+        parts.demod(ip, op, split[s]);
+        done += split[s];
+      }
+
+      for (size_t ch = 0; ch < NCHAN; ch++) {
+        for (size_t k = 0; k < NSAMP; k++) {
+          CPPUNIT_ASSERT_DOUBLES_EQUAL(a[ch][k], b[ch][k], 1e-5);
+        }
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
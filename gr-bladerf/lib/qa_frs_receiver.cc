@@ -0,0 +1,194 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <boost/bind.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <map>
+#include "qa_frs_receiver.h"
+#include "frs_receiver.h"
+#include "frs_simulator.h"
+
+namespace gr {
+  namespace bladerf {
+
+    struct capture {
+      std::map<int, std::vector<float> > audio;
+      /* channel, open, time */
+      std::vector<boost::tuple<int, bool, double> > events;
+      boost::mutex mutex;
+    };
+
+    static void
+    on_audio(capture *c, const struct frs_channel &ch, const float *audio,
+             size_t n)
+    {
+      boost::mutex::scoped_lock lock(c->mutex);
+      std::vector<float> &v = c->audio[ch.number];
+      v.insert(v.end(), audio, audio + n);
+    }
+
+    static void
+    on_event(capture *c, const struct frs_channel &ch, double time,
+             const struct squelch_event &e)
+    {
+      c->events.push_back(boost::make_tuple(ch.number, e.open, time));
+    }
+
+    static void
+    on_tone(std::vector<boost::tuple<int, float> > *tones,
+            const struct frs_channel &ch, double time, float tone)
+    {
+      tones->push_back(boost::make_tuple(ch.number, tone));
+    }
+
+    /* A 1 kHz tone on channel 3 opens only that channel and comes back
+     * out at 1 kHz */
+    static void
+    check_tone(channelizer_method method)
+    {
+      const double rate = 2e6;
+      const size_t block = 20000;
+      struct frs_receiver_config config;
+      capture c;
+
+      config.samp_rate = rate;
+      config.channels.assign(frs_channel_table().begin(),
+                             frs_channel_table().begin() + 7);
+      config.center_freq = frs_center_frequency(config.channels);
+      config.demod = nbfm_channel::default_config();
+      config.method = method;
+      config.ctcss = false;
+      config.max_block = block;
+      config.threads = 2;
+      config.rt_priority = 0;
+
+      frs_receiver rx(config, boost::bind(&on_audio, &c, _1, _2, _3),
+                      boost::bind(&on_event, &c, _1, _2, _3));
+      CPPUNIT_ASSERT(rx.method() == method);
+
+      frs_simulator sim(rate, 0.01f);
+      struct sim_signal s;
+      s.offset = config.channels[2].frequency - config.center_freq;
+      s.tone = 1000;
+      s.deviation = 2500;
+      s.ctcss = 0;
+      s.amplitude = 0.5f;
+      sim.add_signal(s);
+
+      std::vector<std::complex<float> > buf(block);
+      for (int i = 0; i < 20; i++) {
+        sim.generate(&buf[0], block);
+        rx.process(&buf[0], block);
+      }
+
+      /* The signal switching on splatters into the neighbours for a few
+       * milliseconds; after that only channel 3 may be open */
+      std::map<int, bool> open;
+      for (size_t i = 0; i < c.events.size(); i++) {
+        int ch = c.events[i].get<0>();
+        open[ch] = c.events[i].get<1>();
+        if (ch != 3) {
+          CPPUNIT_ASSERT(c.events[i].get<2>() < 0.01);
+        }
+      }
+      for (std::map<int, bool>::iterator it = open.begin(); it != open.end();
+           ++it) {
+        CPPUNIT_ASSERT_EQUAL(it->first == 3, it->second);
+      }
+      CPPUNIT_ASSERT(open[3]);
+
+      /* Skip the filter start-up, then count zero crossings */
+      std::vector<float> &a = c.audio[3];
+      CPPUNIT_ASSERT(a.size() > 4000);
+      size_t crossings = 0;
+      for (size_t i = 1001; i < a.size(); i++) {
+        if ((a[i - 1] < 0) != (a[i] < 0)) {
+          crossings++;
+        }
+      }
+      double tone = crossings / 2.0 / ((a.size() - 1001) / 25e3);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1000.0, tone, 20.0);
+    }
+
+    /* Per channel decimators */
+    void
+    qa_frs_receiver::t1()
+    {
+      check_tone(CHANNELIZER_NCO);
+    }
+
+    /* Shared FFT channelizer */
+    void
+    qa_frs_receiver::t2()
+    {
+      check_tone(CHANNELIZER_FFT);
+    }
+
+    /* The CTCSS tone under channel 5's audio is found once, on it */
+    void
+    qa_frs_receiver::t3()
+    {
+      const double rate = 2e6;
+      const size_t block = 20000;
+      struct frs_receiver_config config;
+      std::vector<boost::tuple<int, float> > tones;
+
+      config.samp_rate = rate;
+      config.channels.assign(frs_channel_table().begin(),
+                             frs_channel_table().begin() + 7);
+      config.center_freq = frs_center_frequency(config.channels);
+      config.demod = nbfm_channel::default_config();
+      config.method = CHANNELIZER_AUTO;
+      config.ctcss = true;
+      config.max_block = block;
+      config.threads = 2;
+      config.rt_priority = 0;
+
+      frs_receiver rx(config, frs_receiver::audio_fn(),
+                      frs_receiver::event_fn(),
+                      boost::bind(&on_tone, &tones, _1, _2, _3));
+
+      frs_simulator sim(rate, 0.01f);
+      struct sim_signal s;
+      s.offset = config.channels[4].frequency - config.center_freq;
+      s.tone = 1000;
+      s.deviation = 2000;
+      s.ctcss = 88.5;
+      s.amplitude = 0.5f;
+      sim.add_signal(s);
+
+      std::vector<std::complex<float> > buf(block);
+      for (int i = 0; i < 100; i++) {
+        sim.generate(&buf[0], block);
+        rx.process(&buf[0], block);
+      }
+
+      CPPUNIT_ASSERT_EQUAL((size_t)1, tones.size());
+      CPPUNIT_ASSERT_EQUAL(5, tones[0].get<0>());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(88.5, tones[0].get<1>(), 0.01);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,201 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "qa_iq_bus.h"
+#include "iq_bus.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* One channel; every I and Q value encodes its own position */
+    static void
+    counter_frames(uint64_t pos, size_t n, std::vector<int16_t> &out)
+    {
+      out.resize(n * 2);
+      for (size_t i = 0; i < n; i++) {
+        out[2 * i] = (int16_t)(2 * (pos + i));
+        out[2 * i + 1] = (int16_t)(2 * (pos + i) + 1);
+      }
+    }
+
+    static bool
+    is_counter(const int16_t *frames, uint64_t pos, size_t n)
+    {
+      for (size_t i = 0; i < n; i++) {
+        if (frames[2 * i] != (int16_t)(2 * (pos + i)) ||
+            frames[2 * i + 1] != (int16_t)(2 * (pos + i) + 1)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    static struct iq_bus_config
+    test_config(const char *name)
+    {
+      struct iq_bus_config config;
+      char buf[64];
+      snprintf(buf, sizeof(buf), "%s_%d", name, (int)getpid());
+      config.name = buf;
+      config.capacity = 1000;
+      config.nchan = 1;
+      config.samp_rate = 1e6;
+      config.center_freq = 462e6;
+      config.start_time = 0;
+      return config;
+    }
+
+    /* Two readers see the same frames in place; a lapped reader skips
+     * ahead and counts what it missed */
+    void
+    qa_iq_bus::t1()
+    {
+      struct iq_bus_config config = test_config("qa_iq_bus");
+      iq_bus_writer w(config);
+      std::vector<int16_t> in;
+
+      counter_frames(0, 100, in);
+      w.write(&in[0], 100);
+
+      iq_bus_reader a(config.name), b(config.name);
+      CPPUNIT_ASSERT_EQUAL((size_t)2, w.readers());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)100, a.position());
+      CPPUNIT_ASSERT_EQUAL(462e6, a.center_freq());
+
+      size_t n;
+      CPPUNIT_ASSERT(a.acquire(10, &n, 0) == NULL);
+      CPPUNIT_ASSERT_EQUAL((size_t)0, n);
+
+      /* Wrap the ring: frames 100..1099 land at slots 100..99 */
+      counter_frames(100, 1000, in);
+      w.write(&in[0], 1000);
+
+      const int16_t *pb = b.acquire(2000, &n, 0);
+      CPPUNIT_ASSERT_EQUAL((size_t)900, n);
+      CPPUNIT_ASSERT(is_counter(pb, 100, n));
+      const int16_t *pa = a.acquire(2000, &n, 0);
+      CPPUNIT_ASSERT_EQUAL((size_t)900, n);
+      CPPUNIT_ASSERT(is_counter(pa, 100, n));
+      CPPUNIT_ASSERT(a.release(n));
+      pa = a.acquire(2000, &n, 0);
+      CPPUNIT_ASSERT_EQUAL((size_t)100, n);
+      CPPUNIT_ASSERT(is_counter(pa, 1000, n));
+      CPPUNIT_ASSERT(a.release(n));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, a.dropped());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1000, w.max_lag());
+
+      /* b holds frames 100..999 while the writer passes them */
+      counter_frames(1100, 50, in);
+      w.write(&in[0], 50);
+      CPPUNIT_ASSERT(!b.release(900));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)900, b.dropped());
+
+      /* Lapped between calls: resume half a ring back */
+      counter_frames(1150, 2000, in);
+      w.write(&in[0], 2000);
+      pb = b.acquire(2000, &n, 0);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)(3150 - 500), b.position());
+      CPPUNIT_ASSERT(is_counter(pb, 3150 - 500, n));
+
+      /* a's copies stop at the end of the ring */
+      std::vector<int16_t> out(2 * 1000);
+      CPPUNIT_ASSERT_EQUAL((size_t)350, a.read(&out[0], 1000, 0));
+      CPPUNIT_ASSERT(is_counter(&out[0], 2650, 350));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)(2650 - 1100), a.dropped());
+      CPPUNIT_ASSERT_EQUAL((size_t)150, a.read(&out[0], 1000, 0));
+      CPPUNIT_ASSERT(is_counter(&out[0], 3000, 150));
+
+      /* SC8 is widened to Q11, gaps come out as zeros */
+      int8_t sc8[4] = { 1, -2, 127, -128 };
+      w.write(sc8, 2);
+      w.gap(3);
+      CPPUNIT_ASSERT_EQUAL((size_t)5, a.read(&out[0], 10, 0));
+      CPPUNIT_ASSERT_EQUAL((int16_t)16, out[0]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)-32, out[1]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)(127 * 16), out[2]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)(-128 * 16), out[3]);
+      for (int i = 4; i < 10; i++) {
+        CPPUNIT_ASSERT_EQUAL((int16_t)0, out[i]);
+      }
+    }
+
+    /* A reader in another process gets every frame in order */
+    void
+    qa_iq_bus::t2()
+    {
+      struct iq_bus_config config = test_config("qa_iq_bus_fork");
+      config.capacity = 100000;
+      iq_bus_writer w(config);
+      const uint64_t total = 200000;
+
+      pid_t child = fork();
+      CPPUNIT_ASSERT(child >= 0);
+      if (child == 0) {
+        int status = 1;
+        try {
+          iq_bus_reader r(config.name);
+          std::vector<int16_t> out(2 * 4096);
+          uint64_t pos = r.position();
+          while (pos < total) {
+            size_t n = r.read(&out[0], 4096, 5000);
+            if (n == 0 || !is_counter(&out[0], pos, n)) {
+              break;
+            }
+            pos += n;
+          }
+          status = (pos == total && r.dropped() == 0) ? 0 : 2;
+        } catch (...) {
+        }
+        _exit(status);
+      }
+
+      /* Wait for the child to attach, then publish at a steady pace */
+      for (int i = 0; i < 2000 && w.readers() == 0; i++) {
+        usleep(1000);
+      }
+      CPPUNIT_ASSERT_EQUAL((size_t)1, w.readers());
+
+      std::vector<int16_t> in;
+      for (uint64_t pos = 0; pos < total; pos += 1000) {
+        counter_frames(pos, 1000, in);
+        w.write(&in[0], 1000);
+        usleep(100);
+      }
+
+      int status;
+      CPPUNIT_ASSERT_EQUAL(child, waitpid(child, &status, 0));
+      CPPUNIT_ASSERT(WIFEXITED(status));
+      CPPUNIT_ASSERT_EQUAL(0, WEXITSTATUS(status));
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,155 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <boost/thread/thread.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "qa_iq_ring.h"
+#include "iq_ring.h"
+#include "trigger_recorder.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Two channels; every I and Q value encodes its own position */
+    static void
+    counter_frames(uint64_t pos, size_t n, std::vector<int16_t> &out)
+    {
+      out.resize(n * 4);
+      for (size_t i = 0; i < n; i++) {
+        for (int k = 0; k < 4; k++) {
+          out[4 * i + k] = (int16_t)((pos + i) * 4 + k);
+        }
+      }
+    }
+
+    static bool
+    is_counter(const int16_t *frames, uint64_t pos, size_t n)
+    {
+      for (size_t i = 0; i < n; i++) {
+        for (int k = 0; k < 4; k++) {
+          if (frames[4 * i + k] != (int16_t)((pos + i) * 4 + k)) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+
+    /* Reads across the wrap return what was written; frames the writer
+     * has passed, or not reached, are refused */
+    void
+    qa_iq_ring::t1()
+    {
+      iq_ring ring(1000, 2);
+      std::vector<int16_t> in, out(4 * 1000);
+      uint64_t pos = 0;
+
+      while (pos < 2500) {
+        counter_frames(pos, 333, in);
+        ring.write(&in[0], 333);
+        pos += 333;
+      }
+      CPPUNIT_ASSERT_EQUAL(pos, ring.written());
+      CPPUNIT_ASSERT_EQUAL(pos - 1000, ring.oldest());
+
+      CPPUNIT_ASSERT(ring.read(pos - 1000, 1000, &out[0]));
+      CPPUNIT_ASSERT(is_counter(&out[0], pos - 1000, 1000));
+      CPPUNIT_ASSERT(ring.read(pos - 10, 10, &out[0]));
+      CPPUNIT_ASSERT(is_counter(&out[0], pos - 10, 10));
+      CPPUNIT_ASSERT(!ring.read(pos - 1001, 10, &out[0]));
+      CPPUNIT_ASSERT(!ring.read(pos - 5, 10, &out[0]));
+
+      /* An oversized write keeps its tail */
+      counter_frames(pos, 2500, in);
+      ring.write(&in[0], 2500);
+      pos += 2500;
+      CPPUNIT_ASSERT_EQUAL(pos, ring.written());
+      CPPUNIT_ASSERT(ring.read(pos - 1000, 1000, &out[0]));
+      CPPUNIT_ASSERT(is_counter(&out[0], pos - 1000, 1000));
+    }
+
+    /* Overlapping triggers make one file holding exactly the frames
+     * from pre before the first to post after the last */
+    void
+    qa_iq_ring::t2()
+    {
+      char dir[] = "/tmp/qa_iq_ring_XXXXXX";
+      CPPUNIT_ASSERT(mkdtemp(dir) != NULL);
+
+      iq_ring ring(20000, 2);
+      struct trigger_config config;
+      config.samp_rate = 10000;
+      config.pre_seconds = 0.5;
+      config.post_seconds = 0.3;
+      config.start_time = 0;
+      config.directory = dir;
+      config.prefix = "qa";
+      trigger_recorder rec(ring, config);
+
+      std::vector<int16_t> in;
+      uint64_t pos = 0;
+      while (pos < 40000) {
+        if (pos == 12000) {
+          rec.trigger(12000, "first");
+        }
+        if (pos == 14000) {
+          rec.trigger(14000, "second");
+        }
+        counter_frames(pos, 1000, in);
+        ring.write(&in[0], 1000);
+        pos += 1000;
+        boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+      }
+      rec.stop();
+
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, rec.files());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, rec.lost_frames());
+
+      std::string path = std::string(dir) + "/qa_19700101_000000.700.sc16";
+      FILE *f = fopen(path.c_str(), "rb");
+      CPPUNIT_ASSERT(f != NULL);
+      std::vector<int16_t> data(4 * 20000);
+      size_t n = fread(&data[0], 4 * sizeof(int16_t), 20000, f);
+      fclose(f);
+      CPPUNIT_ASSERT_EQUAL((size_t)(17000 - 7000), n);
+      CPPUNIT_ASSERT(is_counter(&data[0], 7000, n));
+
+      std::string log = std::string(dir) + "/qa.log";
+      f = fopen(log.c_str(), "r");
+      CPPUNIT_ASSERT(f != NULL);
+      char line[256];
+      CPPUNIT_ASSERT(fgets(line, sizeof(line), f) != NULL);
+      fclose(f);
+      CPPUNIT_ASSERT(strstr(line, " 7000 10000 0 first,second") != NULL);
+
+      remove(path.c_str());
+      remove(log.c_str());
+      rmdir(dir);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
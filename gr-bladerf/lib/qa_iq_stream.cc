@@ -0,0 +1,297 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <boost/ref.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "qa_iq_stream.h"
+#include "iq_stream.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* One channel; every I and Q value encodes its own position */
+    static void
+    counter_frames(uint64_t pos, size_t n, std::vector<int16_t> &out)
+    {
+      out.resize(n * 2);
+      for (size_t i = 0; i < n; i++) {
+        out[2 * i] = (int16_t)(2 * (pos + i));
+        out[2 * i + 1] = (int16_t)(2 * (pos + i) + 1);
+      }
+    }
+
+    static bool
+    is_counter(const int16_t *frames, uint64_t pos, size_t n)
+    {
+      for (size_t i = 0; i < n; i++) {
+        if (frames[2 * i] != (int16_t)(2 * (pos + i)) ||
+            frames[2 * i + 1] != (int16_t)(2 * (pos + i) + 1)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    static void
+    write_counter(iq_stream_server &s, uint64_t from, uint64_t to)
+    {
+      std::vector<int16_t> in;
+      for (uint64_t pos = from; pos < to; pos += 3000) {
+        size_t n = (size_t)std::min((uint64_t)3000, to - pos);
+        counter_frames(pos, n, in);
+        s.write(&in[0], n);
+      }
+    }
+
+    /* Reads a client until position end or the stream stops, checking
+     * every frame against its position */
+    struct stream_reader {
+      stream_reader(const std::string &address, bool udp, uint64_t end)
+        : address(address), udp(udp), end(end), client(NULL), first(0),
+          frames(0), gaps(0), ok(true)
+      {
+      }
+
+      void operator()()
+      {
+        try {
+          iq_stream_client c(address, udp);
+          client = &c;
+          std::vector<int16_t> out(2 * 5000);
+          uint64_t gap;
+          while (c.position() < end) {
+            size_t n = c.read(&out[0], 5000, 1000, &gap);
+            if (n == 0) {
+              break;
+            }
+            uint64_t pos = c.position() - n;
+            if (frames == 0) {
+              first = pos;
+            } else {
+              gaps += gap;
+            }
+            ok = ok && is_counter(&out[0], pos, n);
+            frames += n;
+          }
+          lost = c.lost();
+          server_dropped = c.server_dropped();
+          last = c.position();
+        } catch (...) {
+          ok = false;
+        }
+        client = NULL;
+      }
+
+      std::string address;
+      bool udp;
+      uint64_t end;
+      iq_stream_client *volatile client;
+      uint64_t first, last;
+      uint64_t frames, gaps, lost, server_dropped;
+      bool ok;
+    };
+
+    static std::string
+    loopback(unsigned short port)
+    {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "127.0.0.1:%u", port);
+      return buf;
+    }
+
+    /* Both codecs return what went in, bad blocks are refused */
+    void
+    qa_iq_stream::t1()
+    {
+      const size_t n = 1000, nchan = 2;
+      std::vector<int16_t> in(n * 2 * nchan), out(in.size());
+      srand(1);
+      for (size_t i = 0; i < in.size(); i++) {
+        in[i] = (int16_t)(rand() % 65536 - 32768);
+      }
+      in[4] = -32768;
+      in[8] = 32767;
+
+      enum sc16_codec_type types[2] = { SC16_CODEC_NONE, SC16_CODEC_DELTA };
+      for (int t = 0; t < 2; t++) {
+        std::vector<uint8_t> enc(3, 0xaa);
+        enum sc16_codec_type used = sc16_encode(types[t], &in[0], n, nchan,
+                                                enc);
+        CPPUNIT_ASSERT(enc.size() - 3 <=
+                       sc16_max_encoded(types[t], n, nchan));
+        CPPUNIT_ASSERT(sc16_decode(used, &enc[3], enc.size() - 3, n,
+                                   nchan, &out[0]));
+        CPPUNIT_ASSERT(in == out);
+        CPPUNIT_ASSERT(!sc16_decode(used, &enc[3], enc.size() - 4, n,
+                                    nchan, &out[0]));
+        enc.push_back(0);
+        CPPUNIT_ASSERT(!sc16_decode(used, &enc[3], enc.size() - 3, n,
+                                    nchan, &out[0]));
+      }
+
+      /* Small steps take a byte a value */
+      std::vector<uint8_t> enc;
+      counter_frames(0, n, in);
+      sc16_encode(SC16_CODEC_DELTA, &in[0], n, 1, enc);
+      CPPUNIT_ASSERT_EQUAL(2 * n, enc.size());
+    }
+
+    /* Two TCP clients get every frame, compressed, and see the hole
+     * the radio left */
+    void
+    qa_iq_stream::t2()
+    {
+      struct iq_stream_config config = default_iq_stream_config(0, 1e6);
+      config.codec = SC16_CODEC_DELTA;
+      config.block_frames = 4096;
+      config.queue_blocks = 4;
+      config.block_when_full = true;
+      config.center_freq = 462e6;
+      iq_stream_server s(config);
+      const uint64_t total = 200000;
+
+      stream_reader ra(loopback(s.port()), false, total);
+      stream_reader rb(loopback(s.port()), false, total);
+      boost::thread ta(boost::ref(ra)), tb(boost::ref(rb));
+      for (int i = 0; i < 2000 && s.clients() < 2; i++) {
+        usleep(1000);
+      }
+      CPPUNIT_ASSERT_EQUAL((size_t)2, s.clients());
+
+      write_counter(s, 0, 50000);
+      s.gap(1000);
+      write_counter(s, 51000, total);
+      s.flush();
+      ta.join();
+      tb.join();
+
+      CPPUNIT_ASSERT(ra.ok && rb.ok);
+      CPPUNIT_ASSERT_EQUAL(total - 1000, ra.frames);
+      CPPUNIT_ASSERT_EQUAL(total - 1000, rb.frames);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1000, ra.gaps);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1000, rb.lost);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, rb.server_dropped);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, s.dropped());
+      CPPUNIT_ASSERT(s.encoded_bytes() < s.raw_bytes() / 2 + 1000);
+    }
+
+    /* A client that stalls loses whole blocks, and knows how many */
+    void
+    qa_iq_stream::t3()
+    {
+      struct iq_stream_config config = default_iq_stream_config(0, 1e6);
+      config.block_frames = 4096;
+      config.queue_blocks = 2;
+      boost::scoped_ptr<iq_stream_server> s(new iq_stream_server(config));
+      const uint64_t total = 8 << 20;
+
+      /* Connected but not reading while the server writes 32 MB */
+      iq_stream_client c(loopback(s->port()));
+      for (int i = 0; i < 2000 && s->clients() < 1; i++) {
+        usleep(1000);
+      }
+      write_counter(*s, 0, total);
+      s->flush();
+      const uint64_t dropped = s->dropped();
+      CPPUNIT_ASSERT(dropped > 0);
+
+      std::vector<int16_t> out(2 * 5000);
+      uint64_t frames = 0, gaps = 0, gap;
+      bool ok = true;
+      boost::thread closer(boost::bind(
+        &boost::scoped_ptr<iq_stream_server>::reset, &s,
+        (iq_stream_server *)NULL));
+      for (;;) {
+        size_t n = c.read(&out[0], 5000, 2000, &gap);
+        if (n == 0) {
+          break;
+        }
+        ok = ok && is_counter(&out[0], c.position() - n, n);
+        frames += n;
+        gaps += gap;
+      }
+      closer.join();
+
+      CPPUNIT_ASSERT(ok);
+      CPPUNIT_ASSERT(!c.connected());
+      CPPUNIT_ASSERT_EQUAL(total, frames + dropped);
+      CPPUNIT_ASSERT_EQUAL(gaps, c.lost());
+      CPPUNIT_ASSERT(c.lost() <= dropped);
+      CPPUNIT_ASSERT(c.server_dropped() >= c.lost());
+    }
+
+    /* Over UDP a client joins at a hello and accounts for whatever
+     * does not arrive */
+    void
+    qa_iq_stream::t4()
+    {
+      /* A free port to send to */
+      int fd = socket(AF_INET, SOCK_DGRAM, 0);
+      struct sockaddr_in sa;
+      socklen_t len = sizeof(sa);
+      memset(&sa, 0, sizeof(sa));
+      sa.sin_family = AF_INET;
+      sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      CPPUNIT_ASSERT_EQUAL(0, bind(fd, (struct sockaddr *)&sa, sizeof(sa)));
+      CPPUNIT_ASSERT_EQUAL(0, getsockname(fd, (struct sockaddr *)&sa, &len));
+      close(fd);
+      const std::string address = loopback(ntohs(sa.sin_port));
+
+      const uint64_t total = 400000;
+      stream_reader r(address, true, total);
+      boost::thread t(boost::ref(r));
+      usleep(50000);
+
+      struct iq_stream_config config = default_iq_stream_config(0, 20000);
+      config.udp = address;
+      config.codec = SC16_CODEC_DELTA;
+      iq_stream_server s(config);
+      std::vector<int16_t> in;
+      for (uint64_t pos = 0; pos < total; pos += 2000) {
+        counter_frames(pos, 2000, in);
+        s.write(&in[0], 2000);
+        usleep(200);
+      }
+      s.flush();
+      t.join();
+
+      CPPUNIT_ASSERT(r.ok);
+      CPPUNIT_ASSERT(r.frames > total / 2);
+      CPPUNIT_ASSERT_EQUAL(r.last - r.first, r.frames + r.gaps);
+      CPPUNIT_ASSERT_EQUAL(r.gaps, r.lost);
+      CPPUNIT_ASSERT_EQUAL((size_t)0, s.clients());
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
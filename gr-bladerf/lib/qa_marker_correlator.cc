@@ -0,0 +1,158 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <math.h>
+#include "qa_marker_correlator.h"
+#include "marker_correlator.h"
+#include "loopback_sim.h"
+#include "sample_convert.h"
+
+namespace gr {
+  namespace bladerf {
+
+    void
+    qa_marker_correlator::t1()
+    {
+      const std::vector<std::complex<float> > marker = zadoff_chu(255, 7);
+      for (size_t n = 0; n < marker.size(); n++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, std::abs(marker[n]), 1e-6);
+      }
+
+      /* Markers scaled, turned and in noise, one across the boundary of
+       * the first transform and two closer than a transform apart */
+      const size_t positions[4] = { 1000, 1900, 2600, 9000 };
+      std::vector<std::complex<float> > x(12000);
+      srand(3);
+      for (size_t i = 0; i < x.size(); i++) {
+        x[i] = std::complex<float>(0.05f * (rand() / (float)RAND_MAX - 0.5f),
+                                   0.05f * (rand() / (float)RAND_MAX - 0.5f));
+      }
+      const std::complex<float> turn = std::polar(0.3f, 2.0f);
+      for (size_t p = 0; p < 4; p++) {
+        for (size_t n = 0; n < marker.size(); n++) {
+          x[positions[p] + n] += turn * marker[n];
+        }
+      }
+
+      /* Fed in odd sizes; the last marker needs one more transform */
+      marker_correlator c(marker, 0.5f);
+      for (size_t i = 0; i < x.size(); i += 777) {
+        c.process(&x[i], std::min((size_t)777, x.size() - i));
+      }
+      std::vector<std::complex<float> > quiet(4096);
+      c.process(&quiet[0], quiet.size());
+
+      CPPUNIT_ASSERT_EQUAL((size_t)4, c.hits().size());
+      for (size_t p = 0; p < 4; p++) {
+        CPPUNIT_ASSERT_EQUAL((uint64_t)positions[p], c.hits()[p].position);
+        CPPUNIT_ASSERT(c.hits()[p].score > 0.9f);
+      }
+
+      /* Silence and noise alone find nothing */
+      c.reset();
+      c.clear_hits();
+      c.process(&quiet[0], quiet.size());
+      c.process(&x[0], 900);
+      c.process(&quiet[0], quiet.size());
+      CPPUNIT_ASSERT(c.hits().empty());
+
+      bool threw = false;
+      try {
+        marker_correlator bad(marker, 1.5f);
+      } catch (std::invalid_argument &) {
+        threw = true;
+      }
+      CPPUNIT_ASSERT(threw);
+    }
+
+    /* Receives from the simulator until the correlator finds a marker */
+    static uint64_t
+    find_marker(loopback_sim &sim, marker_correlator &c, uint64_t *first)
+    {
+      std::vector<int16_t> buf(2 * 2048);
+      std::vector<std::complex<float> > x(2048);
+      std::complex<float> *out = &x[0];
+      for (int i = 0; i < 200 && c.hits().empty(); i++) {
+        struct bladerf_metadata meta;
+        memset(&meta, 0, sizeof(meta));
+        sim.receive(&buf[0], 2048, &meta);
+        if (c.samples() == 0) {
+          *first = meta.timestamp;
+        }
+        sc16_to_fc32(&buf[0], &out, 2048, 1, SC16_Q11_SCALE);
+        c.process(&x[0], x.size());
+      }
+      return c.hits().empty() ? 0 : *first + c.hits()[0].position;
+    }
+
+    void
+    qa_marker_correlator::t2()
+    {
+      struct loopback_sim_config config;
+      config.samp_rate = 2e6;
+      config.stream = default_stream_config;
+      config.stream.buffer_size = 2048;
+      config.path_delay = 37;
+      config.usb_latency = 100e-6;
+      config.gain = 0.25f;
+      config.noise = 4;
+      loopback_sim sim(config);
+
+      const std::vector<std::complex<float> > marker = zadoff_chu(255, 7);
+      std::vector<int16_t> burst(2 * (marker.size() + 1), 0);
+      for (size_t n = 0; n < marker.size(); n++) {
+        burst[2 * n] = (int16_t)lrintf(1024 * marker[n].real());
+        burst[2 * n + 1] = (int16_t)lrintf(1024 * marker[n].imag());
+      }
+
+      /* A timestamped burst comes back exactly path_delay later */
+      marker_correlator c(marker, 0.5f);
+      uint64_t first = 0;
+      std::vector<int16_t> buf(2 * 2048);
+      struct bladerf_metadata meta;
+      memset(&meta, 0, sizeof(meta));
+      sim.receive(&buf[0], 2048, &meta);
+      const uint64_t when = meta.timestamp + 20000;
+      meta.timestamp = when;
+      meta.flags = BLADERF_META_FLAG_TX_BURST_START |
+                   BLADERF_META_FLAG_TX_BURST_END;
+      sim.transmit(&burst[0], marker.size() + 1, &meta);
+      CPPUNIT_ASSERT_EQUAL(when + 37, find_marker(sim, c, &first));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, sim.late_bursts());
+
+      /* One sent now goes out once across the bus */
+      c.reset();
+      c.clear_hits();
+      const uint64_t sent = sim.now();
+      meta.flags |= BLADERF_META_FLAG_TX_NOW;
+      sim.transmit(&burst[0], marker.size() + 1, &meta);
+      const uint64_t found = find_marker(sim, c, &first);
+      CPPUNIT_ASSERT(found >= sent + 200 + 37);
+      CPPUNIT_ASSERT(found < sent + 200 + 37 + 2000);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,132 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <stdexcept>
+#include <math.h>
+#include "qa_nbfm_modulator.h"
+#include "nbfm_modulator.h"
+#include "nbfm_channel.h"
+#include "ctcss_detector.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Modulate a second of a tone, in uneven pieces, and receive it
+     * with nbfm_channel; returns the audio and fills in the largest
+     * deviation of the output magnitude from the amplitude */
+    static std::vector<float>
+    loop(const struct nbfm_tx_config &tx, float level, bool hpf,
+         float *magnitude_error)
+    {
+      const size_t block = 1000;
+      nbfm_modulator mod(tx, block);
+      struct nbfm_config rx = nbfm_channel::default_config();
+      rx.samp_rate = tx.samp_rate;
+      rx.offset = tx.offset;
+      rx.tau = tx.tau;
+      rx.hpf = hpf;
+      nbfm_channel demod(rx, mod.max_output(block));
+
+      std::vector<float> audio(block);
+      std::vector<std::complex<float> > rf(mod.max_output(block));
+      std::vector<float> out(demod.max_audio(rf.size()));
+      std::vector<float> result;
+      std::vector<struct squelch_event> events;
+      const size_t sizes[3] = { 1000, 37, 613 };
+      size_t done = 0;
+      *magnitude_error = 0;
+      for (int i = 0; done < (size_t)tx.audio_rate; i++) {
+        const size_t n = sizes[i % 3];
+        for (size_t k = 0; k < n; k++) {
+          audio[k] = level * (float)sin(2 * M_PI * 1000 * (done + k) /
+                                        tx.audio_rate);
+        }
+        done += n;
+        const size_t m = mod.process(&audio[0], n, &rf[0]);
+        CPPUNIT_ASSERT_EQUAL(n * mod.interpolation(), m);
+        for (size_t k = 0; k < m; k++) {
+          *magnitude_error = std::max(*magnitude_error,
+                                      fabsf(std::abs(rf[k]) -
+                                            tx.amplitude));
+        }
+        const size_t a = demod.process(&rf[0], m, &out[0], events);
+        result.insert(result.end(), out.begin(), out.begin() + a);
+      }
+      return result;
+    }
+
+    /* A 1 kHz tone at half scale comes back at 1 kHz and about half
+     * scale, from a constant envelope carrier off the LO */
+    void
+    qa_nbfm_modulator::t1()
+    {
+      struct nbfm_tx_config tx = nbfm_modulator::default_config();
+      tx.offset = 200e3;
+      CPPUNIT_ASSERT_EQUAL(80u, nbfm_modulator::interpolation(tx));
+
+      float error;
+      std::vector<float> a = loop(tx, 0.5f, true, &error);
+      CPPUNIT_ASSERT(error < 1e-3f);
+      CPPUNIT_ASSERT(a.size() > 20000);
+
+      /* Skip the filter start-up, then count zero crossings */
+      size_t crossings = 0;
+      double power = 0;
+      for (size_t i = 2001; i < a.size(); i++) {
+        if ((a[i - 1] < 0) != (a[i] < 0)) {
+          crossings++;
+        }
+        power += a[i] * a[i];
+      }
+      const double seconds = (a.size() - 2001) / tx.audio_rate;
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(1000.0, crossings / 2.0 / seconds, 5.0);
+      const double peak = sqrt(2 * power / (a.size() - 2001));
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5, peak, 0.05);
+
+      tx.samp_rate = 2.01e6;
+      CPPUNIT_ASSERT_THROW(nbfm_modulator(tx, 100), std::invalid_argument);
+    }
+
+    /* The CTCSS tone is found under the voice */
+    void
+    qa_nbfm_modulator::t2()
+    {
+      struct nbfm_tx_config tx = nbfm_modulator::default_config();
+      tx.offset = -300e3;
+      tx.ctcss = 88.5;
+
+      float error;
+      std::vector<float> a = loop(tx, 0.8f, false, &error);
+      CPPUNIT_ASSERT(error < 1e-3f);
+
+      ctcss_detector detector(tx.audio_rate);
+      std::vector<struct ctcss_event> events;
+      detector.process(&a[0], a.size(), events);
+      CPPUNIT_ASSERT_EQUAL((size_t)1, events.size());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(88.5, events[0].tone, 0.01);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(88.5, detector.tone(), 0.01);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
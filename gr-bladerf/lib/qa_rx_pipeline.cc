@@ -0,0 +1,193 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <libbladeRF.h>
+#include "qa_rx_pipeline.h"
+#include "rx_pipeline.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Stands in for bladerf_sync_rx: frame k carries I = k, Q = -k on
+     * channel 0 and I = k, Q = 1 on channel 1 (modulo the Q11 range) */
+    static int
+    fake_receive(int *counter, void *raw, unsigned int nsamples)
+    {
+      int16_t *buf = (int16_t *)raw;
+      for (unsigned int i = 0; i < nsamples / 2; i++) {
+        int16_t k = (int16_t)(*counter % 2048);
+        buf[4 * i] = k;
+        buf[4 * i + 1] = -k;
+        buf[4 * i + 2] = k;
+        buf[4 * i + 3] = 1;
+        (*counter)++;
+      }
+      return 0;
+    }
+
+    /* Times out the first *failures calls, then behaves like fake_receive */
+    static int
+    flaky_receive(int *failures, int *counter, void *buf,
+                  unsigned int nsamples)
+    {
+      if (*failures > 0) {
+        (*failures)--;
+        boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+        return BLADERF_ERR_TIMEOUT;
+      }
+      return fake_receive(counter, buf, nsamples);
+    }
+
+    static int
+    count_reset(int *resets)
+    {
+      (*resets)++;
+      return 0;
+    }
+
+    void
+    qa_rx_pipeline::t1()
+    {
+      int counter = 0;
+      std::vector<int> channels;
+      channels.push_back(1);
+      channels.push_back(0);
+
+      rx_pipeline p(4, 256, 2, channels,
+                    boost::bind(&fake_receive, &counter, _1, _2), 2e6);
+      p.start(std::vector<int>(), std::vector<int>(), 0);
+
+      std::vector<std::complex<float> > ch1(1000), ch0(1000);
+      std::complex<float> *out[2] = { &ch1[0], &ch0[0] };
+      size_t total = 0;
+      while (total < 1000) {
+        std::complex<float> *o[2] = { out[0] + total, out[1] + total };
+        total += p.deliver(o, std::min((size_t)333, 1000 - total), 1000);
+      }
+      p.stop();
+
+      for (size_t k = 0; k < 1000; k++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(k / 2048.0, ch0[k].real(), 1e-6);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(-(k / 2048.0), ch0[k].imag(), 1e-6);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(k / 2048.0, ch1[k].real(), 1e-6);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(1 / 2048.0, ch1[k].imag(), 1e-6);
+      }
+    }
+
+    void
+    qa_rx_pipeline::t2()
+    {
+      int failures = 4, counter = 0, resets = 0;
+      std::vector<rx_pipeline::gap_t> gaps;
+
+      rx_pipeline p(4, 256, 2, std::vector<int>(1, 0),
+                    boost::bind(&flaky_receive, &failures, &counter, _1, _2),
+                    2e6, boost::bind(&count_reset, &resets));
+      p.start(std::vector<int>(), std::vector<int>(), 0);
+
+      /* The outage comes out as zeros ahead of the first real frame */
+      std::vector<std::complex<float> > ch0(200000);
+      std::complex<float> *o = &ch0[0];
+      size_t total = 0;
+      while (total < ch0.size()) {
+        std::complex<float> *out = o + total;
+        std::vector<rx_pipeline::gap_t> g;
+        size_t n = p.deliver(&out, ch0.size() - total, 1000, &g);
+        for (size_t i = 0; i < g.size(); i++) {
+          gaps.push_back(rx_pipeline::gap_t(g[i].first + total, g[i].second));
+        }
+        total += n;
+      }
+      p.stop();
+
+      CPPUNIT_ASSERT_EQUAL(1, resets);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)4, p.receive_errors());
+      CPPUNIT_ASSERT(!gaps.empty());
+      CPPUNIT_ASSERT_EQUAL((size_t)0, gaps[0].first);
+
+      size_t start = 0;
+      for (size_t i = 0; i < gaps.size(); i++) {
+        CPPUNIT_ASSERT_EQUAL(start, gaps[i].first);
+        start += gaps[i].second;
+      }
+      CPPUNIT_ASSERT(start > 0 && start < ch0.size());
+      for (size_t k = 0; k < start; k++) {
+        CPPUNIT_ASSERT_EQUAL(0.0f, ch0[k].real());
+      }
+      for (size_t k = start; k < ch0.size(); k++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(((k - start) % 2048) / 2048.0,
+                                     ch0[k].real(), 1e-6);
+      }
+    }
+
+    /* Raw delivery hands out the SC16 frames untouched, outage included */
+    void
+    qa_rx_pipeline::t3()
+    {
+      int failures = 4, counter = 0, resets = 0;
+      std::vector<rx_pipeline::gap_t> gaps;
+
+      rx_pipeline p(4, 256, 2, std::vector<int>(),
+                    boost::bind(&flaky_receive, &failures, &counter, _1, _2),
+                    2e6, boost::bind(&count_reset, &resets));
+      p.start(std::vector<int>(), std::vector<int>(), 0);
+
+      std::vector<int16_t> raw(4 * 200000);
+      size_t total = 0;
+      while (total < raw.size() / 4) {
+        std::vector<rx_pipeline::gap_t> g;
+        size_t n = p.deliver_raw(&raw[4 * total], raw.size() / 4 - total,
+                                 1000, &g);
+        for (size_t i = 0; i < g.size(); i++) {
+          gaps.push_back(rx_pipeline::gap_t(g[i].first + total, g[i].second));
+        }
+        total += n;
+      }
+      p.stop();
+
+      CPPUNIT_ASSERT_EQUAL(1, resets);
+      CPPUNIT_ASSERT(!gaps.empty());
+      size_t start = 0;
+      for (size_t i = 0; i < gaps.size(); i++) {
+        CPPUNIT_ASSERT_EQUAL(start, gaps[i].first);
+        start += gaps[i].second;
+      }
+      CPPUNIT_ASSERT(start > 0 && start < total);
+      for (size_t k = 0; k < 4 * start; k++) {
+        CPPUNIT_ASSERT_EQUAL((int16_t)0, raw[k]);
+      }
+      for (size_t k = start; k < total; k++) {
+        int16_t v = (int16_t)((k - start) % 2048);
+        CPPUNIT_ASSERT_EQUAL(v, raw[4 * k]);
+        CPPUNIT_ASSERT_EQUAL((int16_t)-v, raw[4 * k + 1]);
+        CPPUNIT_ASSERT_EQUAL(v, raw[4 * k + 2]);
+        CPPUNIT_ASSERT_EQUAL((int16_t)1, raw[4 * k + 3]);
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
+
@@ -0,0 +1,110 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <vector>
+#include "qa_sample_convert.h"
+#include "sample_convert.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* SC8 single channel, with a length that leaves a scalar tail */
+    void
+    qa_sample_convert::t1()
+    {
+      const size_t n = 21;
+      std::vector<int8_t> in(2 * n);
+      std::vector<std::complex<float> > o(n);
+      std::complex<float> *out[1] = { &o[0] };
+
+      for (size_t i = 0; i < 2 * n; i++) {
+        in[i] = (int8_t)(i * 13 - 128);
+      }
+      sc8_to_fc32(&in[0], out, n, 1, SC8_Q7_SCALE);
+
+      for (size_t i = 0; i < n; i++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(in[2 * i] / 128.0, o[i].real(), 1e-7);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(in[2 * i + 1] / 128.0, o[i].imag(), 1e-7);
+      }
+    }
+
+    /* SC8 and SC16 two channel streams land on the same outputs */
+    void
+    qa_sample_convert::t2()
+    {
+      const size_t n = 15;
+      std::vector<int8_t> in8(4 * n);
+      std::vector<int16_t> in16(4 * n);
+      std::vector<std::complex<float> > a0(n), a1(n), b0(n), b1(n);
+      std::complex<float> *a[2] = { &a0[0], &a1[0] };
+      std::complex<float> *b[2] = { &b0[0], &b1[0] };
+
+      for (size_t i = 0; i < 4 * n; i++) {
+        in8[i] = (int8_t)(127 - (int)i * 7);
+        in16[i] = (int16_t)(in8[i] * 16);
+      }
+      sc8_to_fc32(&in8[0], a, n, 2, SC8_Q7_SCALE);
+      sc16_to_fc32(&in16[0], b, n, 2, SC16_Q11_SCALE);
+
+      for (size_t i = 0; i < n; i++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(in8[4 * i + 2] / 128.0, a1[i].real(),
+                                     1e-7);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(b0[i].real(), a0[i].real(), 1e-7);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(b0[i].imag(), a0[i].imag(), 1e-7);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(b1[i].real(), a1[i].real(), 1e-7);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(b1[i].imag(), a1[i].imag(), 1e-7);
+      }
+    }
+
+    /* SC16 survives a round trip through float; out of range values
+     * saturate */
+    void
+    qa_sample_convert::t3()
+    {
+      const size_t n = 13;
+      std::vector<int16_t> in(2 * n), back(2 * n);
+      std::vector<std::complex<float> > f(n);
+      std::complex<float> *out[1] = { &f[0] };
+
+      for (size_t i = 0; i < 2 * n; i++) {
+        in[i] = (int16_t)((int)i * 157 - 2047);
+      }
+      sc16_to_fc32(&in[0], out, n, 1, SC16_Q11_SCALE);
+      fc32_to_sc16(&f[0], &back[0], n, SC16_Q11_SCALE);
+      for (size_t i = 0; i < 2 * n; i++) {
+        CPPUNIT_ASSERT_EQUAL(in[i], back[i]);
+      }
+
+      f[0] = std::complex<float>(100.0f, -100.0f);
+      f[n - 1] = std::complex<float>(-100.0f, 100.0f);
+      fc32_to_sc16(&f[0], &back[0], n, SC16_Q11_SCALE);
+      CPPUNIT_ASSERT_EQUAL((int16_t)32767, back[0]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)-32768, back[1]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)-32768, back[2 * n - 2]);
+      CPPUNIT_ASSERT_EQUAL((int16_t)32767, back[2 * n - 1]);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
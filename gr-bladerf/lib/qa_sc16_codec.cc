@@ -0,0 +1,197 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <unistd.h>
+#include "qa_sc16_codec.h"
+#include "sc16_codec.h"
+#include "sc16_file.h"
+#include "worker_pool.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* A few carriers over a little noise, as a 12-bit receiver sees */
+    static void
+    band_limited(size_t n, size_t nchan, std::vector<int16_t> &out)
+    {
+      out.resize(n * 2 * nchan);
+      srand(7);
+      for (size_t i = 0; i < n; i++) {
+        for (size_t c = 0; c < nchan; c++) {
+          double re = 0, im = 0;
+          for (int k = 1; k <= 3; k++) {
+            double w = 0.01 * k * (c + 1) * i;
+            re += 400 * cos(w) / k;
+            im += 400 * sin(w) / k;
+          }
+          out[2 * (i * nchan + c)] = (int16_t)(re + rand() % 9 - 4);
+          out[2 * (i * nchan + c) + 1] = (int16_t)(im + rand() % 9 - 4);
+        }
+      }
+    }
+
+    static bool
+    round_trip(enum sc16_codec_type type, const std::vector<int16_t> &in,
+               size_t nchan, enum sc16_codec_type *used, size_t *bytes)
+    {
+      const size_t n = in.size() / (2 * nchan);
+      std::vector<uint8_t> enc(5, 0x55);
+      std::vector<int16_t> out(in.size() + 1, 0x1234);
+
+      *used = sc16_encode(type, &in[0], n, nchan, enc);
+      *bytes = enc.size() - 5;
+      return *bytes <= sc16_max_encoded(type, n, nchan) &&
+             sc16_decode(*used, &enc[5], *bytes, n, nchan, &out[0]) &&
+             memcmp(&in[0], &out[0], in.size() * sizeof(int16_t)) == 0 &&
+             out[in.size()] == 0x1234;
+    }
+
+    /* Every codec is lossless on 12-bit signals, noise and extremes, and
+     * anything it cannot hold or shrink comes back as NONE */
+    void
+    qa_sc16_codec::t1()
+    {
+      enum sc16_codec_type types[4] = {
+        SC16_CODEC_NONE, SC16_CODEC_DELTA, SC16_CODEC_RICE,
+        SC16_CODEC_PACK12
+      };
+      enum sc16_codec_type used;
+      size_t bytes;
+
+      for (size_t nchan = 1; nchan <= 3; nchan++) {
+        std::vector<int16_t> in;
+        band_limited(5003, nchan, in);
+        const size_t raw = in.size() * 2;
+        for (int t = 0; t < 4; t++) {
+          CPPUNIT_ASSERT(round_trip(types[t], in, nchan, &used, &bytes));
+          CPPUNIT_ASSERT_EQUAL(types[t], used);
+        }
+        CPPUNIT_ASSERT(round_trip(SC16_CODEC_RICE, in, nchan, &used,
+                                  &bytes));
+        CPPUNIT_ASSERT(bytes < raw / 2);
+        CPPUNIT_ASSERT(round_trip(SC16_CODEC_PACK12, in, nchan, &used,
+                                  &bytes));
+        CPPUNIT_ASSERT_EQUAL(raw / 4 * 3, bytes);
+
+        /* Full scale noise and the largest steps there are */
+        for (size_t i = 0; i < in.size(); i++) {
+          in[i] = (int16_t)(rand() % 65536 - 32768);
+        }
+        for (size_t i = 0; i < 64; i++) {
+          in[i] = (i / (2 * nchan)) % 2 ? 32767 : -32768;
+        }
+        for (int t = 0; t < 4; t++) {
+          CPPUNIT_ASSERT(round_trip(types[t], in, nchan, &used, &bytes));
+          CPPUNIT_ASSERT(bytes <= raw);
+        }
+        CPPUNIT_ASSERT(round_trip(SC16_CODEC_PACK12, in, nchan, &used,
+                                  &bytes));
+        CPPUNIT_ASSERT_EQUAL(SC16_CODEC_NONE, used);
+      }
+
+      /* A Rice block that is cut short, too long or has a bad header */
+      std::vector<int16_t> in, out(2 * 1000);
+      std::vector<uint8_t> enc;
+      band_limited(1000, 1, in);
+      CPPUNIT_ASSERT_EQUAL(SC16_CODEC_RICE,
+                           sc16_encode(SC16_CODEC_RICE, &in[0], 1000, 1, enc));
+      CPPUNIT_ASSERT(!sc16_decode(SC16_CODEC_RICE, &enc[0], enc.size() - 1,
+                                  1000, 1, &out[0]));
+      enc.push_back(0);
+      CPPUNIT_ASSERT(!sc16_decode(SC16_CODEC_RICE, &enc[0], enc.size(),
+                                  1000, 1, &out[0]));
+      enc.pop_back();
+      enc[0] = 3;
+      CPPUNIT_ASSERT(!sc16_decode(SC16_CODEC_RICE, &enc[0], enc.size(),
+                                  1000, 1, &out[0]));
+
+      enum sc16_codec_type parsed;
+      CPPUNIT_ASSERT(parse_sc16_codec("rice", &parsed));
+      CPPUNIT_ASSERT_EQUAL(SC16_CODEC_RICE, parsed);
+      CPPUNIT_ASSERT(!parse_sc16_codec("zip", &parsed));
+    }
+
+    /* A recording written in odd sized pieces decodes the same on one
+     * thread and on several; a torn last block is left out */
+    void
+    qa_sc16_codec::t2()
+    {
+      char path[64];
+      snprintf(path, sizeof(path), "/tmp/qa_sc16_codec_%d.sc16z",
+               (int)getpid());
+      const size_t nchan = 2, total = 100003;
+      std::vector<int16_t> in;
+      band_limited(total, nchan, in);
+
+      struct sc16_writer_config config;
+      config.path = path;
+      config.codec = SC16_CODEC_RICE;
+      config.block_frames = 4096;
+      config.nchan = nchan;
+      config.samp_rate = 2e6;
+      config.center_freq = 462e6;
+      config.start_time = 1e9;
+      {
+        sc16_file_writer w(config);
+        for (size_t pos = 0; pos < total; ) {
+          size_t n = std::min(total - pos, (size_t)(1 + pos % 7777));
+          w.write(&in[pos * 2 * nchan], n);
+          pos += n;
+        }
+        w.close();
+        CPPUNIT_ASSERT(w.ok());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)total, w.frames());
+        CPPUNIT_ASSERT(w.bytes() < in.size());
+      }
+
+      sc16_file_reader r(path);
+      const size_t blocks = (total + 4095) / 4096;
+      CPPUNIT_ASSERT_EQUAL(blocks, r.blocks());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)total, r.frames());
+      CPPUNIT_ASSERT_EQUAL(462e6, r.header().center_freq);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)4096 * 3, r.block_start(3));
+
+      std::vector<int16_t> out(in.size());
+      CPPUNIT_ASSERT(r.decode(0, r.blocks(), &out[0]));
+      CPPUNIT_ASSERT(in == out);
+
+      std::fill(out.begin(), out.end(), 0);
+      worker_pool pool(3, std::vector<int>(), 0);
+      CPPUNIT_ASSERT(r.decode(2, r.blocks() - 2, &out[0], &pool));
+      CPPUNIT_ASSERT(memcmp(&in[2 * 4096 * 2 * nchan], &out[0],
+                            (total - 2 * 4096) * 2 * nchan * 2) == 0);
+
+      CPPUNIT_ASSERT_EQUAL(0, truncate(path, r.file_size() - 10));
+      sc16_file_reader torn(path);
+      CPPUNIT_ASSERT_EQUAL(blocks - 1, torn.blocks());
+      unlink(path);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
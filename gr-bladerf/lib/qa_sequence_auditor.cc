@@ -0,0 +1,148 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "qa_sequence_auditor.h"
+#include "sequence_auditor.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static bool
+    has_event(const std::vector<sequence_event> &events, size_t k,
+              enum sequence_event_type type, size_t channel,
+              uint64_t position, uint64_t frames)
+    {
+      return k < events.size() && events[k].type == type &&
+             events[k].channel == channel &&
+             events[k].position == position && events[k].frames == frames;
+    }
+
+    /* The tagged pattern, clean across the counter's wrap and then
+     * with every kind of fault a buffer can bring */
+    void
+    qa_sequence_auditor::t1()
+    {
+      const size_t nchan = 2;
+      const uint64_t first = (1 << 22) - 1000;
+      std::vector<int16_t> frames(2 * nchan * 30000);
+      sequence_frames(first, nchan, 30000, &frames[0]);
+      for (size_t i = 0; i < frames.size(); i++) {
+        CPPUNIT_ASSERT(frames[i] >= -2048 && frames[i] <= 2047);
+      }
+
+      sequence_auditor clean(nchan, SEQ_TAGGED);
+      for (size_t k = 0; k < 30000; k += 777) {
+        size_t n = std::min((size_t)777, 30000 - k);
+        clean.process(&frames[2 * nchan * k], n);
+      }
+      clean.finish();
+      CPPUNIT_ASSERT_EQUAL((uint64_t)30000, clean.frames());
+      CPPUNIT_ASSERT(clean.events().empty());
+      CPPUNIT_ASSERT(clean.synced(0) && clean.synced(1));
+
+      /* Frames 0-4999, 5100-9099, 9070-..: 100 lost, then 30 again */
+      std::vector<int16_t> s;
+      s.insert(s.end(), frames.begin(), frames.begin() + 4 * 5000);
+      s.insert(s.end(), frames.begin() + 4 * 5100, frames.begin() + 4 * 9100);
+      s.insert(s.end(), frames.begin() + 4 * 9070, frames.end());
+      /* Stream frame 12000 has a bad sample on channel 1, frames
+       * 15000-15009 come with the channels the wrong way round and
+       * channel 0 is stuck for frames 25000-25002 */
+      s[4 * 12000 + 2] ^= 0x155;
+      for (size_t k = 25000; k < 25003; k++) {
+        s[4 * k] = 100;
+        s[4 * k + 1] = -2048;
+      }
+      for (size_t k = 15000; k < 15010; k++) {
+        std::swap(s[4 * k], s[4 * k + 2]);
+        std::swap(s[4 * k + 1], s[4 * k + 3]);
+      }
+
+      sequence_auditor audit(nchan, SEQ_TAGGED);
+      audit.process(&s[0], s.size() / 4);
+      audit.finish();
+      const std::vector<sequence_event> &e = audit.events();
+      CPPUNIT_ASSERT_EQUAL((size_t)8, e.size());
+      CPPUNIT_ASSERT(has_event(e, 0, SEQ_SLIP, 0, 5000, 100));
+      CPPUNIT_ASSERT(has_event(e, 1, SEQ_SLIP, 1, 5000, 100));
+      CPPUNIT_ASSERT(has_event(e, 2, SEQ_REPEAT, 0, 9000, 30));
+      CPPUNIT_ASSERT(has_event(e, 3, SEQ_REPEAT, 1, 9000, 30));
+      CPPUNIT_ASSERT(has_event(e, 4, SEQ_CORRUPT, 1, 12000, 1));
+      CPPUNIT_ASSERT(has_event(e, 5, SEQ_SWAP, 0, 15000, 10));
+      CPPUNIT_ASSERT(has_event(e, 6, SEQ_SWAP, 1, 15000, 10));
+      CPPUNIT_ASSERT(has_event(e, 7, SEQ_CORRUPT, 0, 25000, 3));
+      CPPUNIT_ASSERT_EQUAL((size_t)1, e[5].source);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)100, audit.lost(1));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)30, audit.repeated(0));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, audit.corrupt(1));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)3, audit.corrupt(0));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)10, audit.swapped(0));
+
+      audit.clear_events();
+      CPPUNIT_ASSERT(audit.events().empty());
+    }
+
+    /* The FPGA counter, stepping once per sample of two channels, with
+     * a buffer lost across its wrap */
+    void
+    qa_sequence_auditor::t2()
+    {
+      const size_t n = 20000;
+      std::vector<int16_t> s;
+      uint32_t c = 0xffffffffu - 2 * 10000;
+      for (size_t k = 0; k < n; k++) {
+        if (k == 9000) {
+          c += 2 * 4096;
+        }
+        for (size_t ch = 0; ch < 2; ch++, c++) {
+          s.push_back((int16_t)(c & 0xffff));
+          s.push_back((int16_t)(c >> 16));
+        }
+      }
+      sequence_auditor audit(2, SEQ_COUNTER32);
+      audit.process(&s[0], n);
+      audit.finish();
+      const std::vector<sequence_event> &e = audit.events();
+      CPPUNIT_ASSERT_EQUAL((size_t)2, e.size());
+      CPPUNIT_ASSERT(has_event(e, 0, SEQ_SLIP, 0, 9000, 4096));
+      CPPUNIT_ASSERT(has_event(e, 1, SEQ_SLIP, 1, 9000, 4096));
+
+      enum sequence_pattern p;
+      CPPUNIT_ASSERT(parse_sequence_pattern("counter", &p) &&
+                     p == SEQ_COUNTER32);
+      CPPUNIT_ASSERT(!parse_sequence_pattern("pn", &p));
+      bool thrown = false;
+      try {
+        sequence_auditor bad(5, SEQ_TAGGED);
+      } catch (const std::invalid_argument &e) {
+        thrown = true;
+      }
+      CPPUNIT_ASSERT(thrown);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
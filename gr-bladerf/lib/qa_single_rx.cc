@@ -23,6 +23,7 @@
 #include <cppunit/TestAssert.h>
 #include "qa_single_rx.h"
 #include <bladerf/single_rx.h>
+#include "device_utils.h"
 
 namespace gr {
   namespace bladerf {
@@ -33,6 +34,33 @@ namespace gr {
       // Put test here
     }
 
+    /* The layout and channels the block configures the sync interface
+     * with and enables: one channel alone goes X1, RX1 included */
+    void
+    qa_single_rx::t2()
+    {
+      struct rx_stream_plan plan;
+
+      CPPUNIT_ASSERT_EQUAL(0, plan_rx_stream(0x2, &plan));
+      CPPUNIT_ASSERT_EQUAL(BLADERF_RX_X1, plan.layout);
+      CPPUNIT_ASSERT_EQUAL((size_t)1, plan.channels.size());
+      CPPUNIT_ASSERT_EQUAL(BLADERF_CHANNEL_RX(1), plan.channels[0]);
+
+      CPPUNIT_ASSERT_EQUAL(0, plan_rx_stream(0x1, &plan));
+      CPPUNIT_ASSERT_EQUAL(BLADERF_RX_X1, plan.layout);
+      CPPUNIT_ASSERT_EQUAL((size_t)1, plan.channels.size());
+      CPPUNIT_ASSERT_EQUAL(BLADERF_CHANNEL_RX(0), plan.channels[0]);
+
+      CPPUNIT_ASSERT_EQUAL(0, plan_rx_stream(0x3, &plan));
+      CPPUNIT_ASSERT_EQUAL(BLADERF_RX_X2, plan.layout);
+      CPPUNIT_ASSERT_EQUAL((size_t)2, plan.channels.size());
+      CPPUNIT_ASSERT_EQUAL(BLADERF_CHANNEL_RX(0), plan.channels[0]);
+      CPPUNIT_ASSERT_EQUAL(BLADERF_CHANNEL_RX(1), plan.channels[1]);
+
+      CPPUNIT_ASSERT(plan_rx_stream(0x4, &plan) != 0);
+      CPPUNIT_ASSERT(plan_rx_stream(0, &plan) != 0);
+    }
+
   } /* namespace bladerf */
 } /* namespace gr */
 
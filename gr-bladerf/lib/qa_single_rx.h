@@ -33,10 +33,12 @@ namespace gr {
     public:
       CPPUNIT_TEST_SUITE(qa_single_rx);
       CPPUNIT_TEST(t1);
+      CPPUNIT_TEST(t2);
       CPPUNIT_TEST_SUITE_END();
 
     private:
       void t1();
+      void t2();
     };
 
   } /* namespace bladerf */
@@ -0,0 +1,134 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#include <gnuradio/attributes.h>
+#include <cppunit/TestAssert.h>
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include <stdlib.h>
+#include "qa_welch_psd.h"
+#include "welch_psd.h"
+#include "worker_pool.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static std::vector<std::complex<float> >
+    tone_in_noise(size_t n, double cycles, float amplitude, float sigma)
+    {
+      std::vector<std::complex<float> > x(n);
+      srand(5);
+      for (size_t i = 0; i < n; i++) {
+        /* Uniform noise of variance sigma^2 per component */
+        float ni = (rand() / (float)RAND_MAX - 0.5f) * sigma * sqrtf(12);
+        float nq = (rand() / (float)RAND_MAX - 0.5f) * sigma * sqrtf(12);
+        double phase = 2 * M_PI * fmod(cycles * i, 1.0);
+        x[i] = std::complex<float>(amplitude * cos(phase) + ni,
+                                   amplitude * sin(phase) + nq);
+      }
+      return x;
+    }
+
+    /* A tone lands in its bin with its power, and the noise floor sits
+     * at the noise density */
+    void
+    qa_welch_psd::t1()
+    {
+      const double fs = 8e6;
+      const size_t size = 1024;
+      const float sigma = 0.01f;
+      std::vector<std::complex<float> > x =
+        tone_in_noise(200000, -100.0 / size, 0.5f, sigma);
+
+      welch_psd psd(size, fs);
+      psd.process(&x[0], x.size());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)((x.size() - size) / (size / 2) + 1),
+                           psd.segments());
+
+      std::vector<double> db = psd.density_db();
+      size_t peak = 0;
+      double power = 0;
+      for (size_t i = 0; i < size; i++) {
+        if (db[i] > db[peak]) {
+          peak = i;
+        }
+        power += pow(10, db[i] / 10) * fs / size;
+      }
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(-100.0 / size * fs, psd.frequency(peak),
+                                   1e-6);
+      /* The tone and the noise, 0.25 + 2 sigma^2 */
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.25 + 2 * sigma * sigma, power, 0.0025);
+
+      /* Far from the tone only the noise is left */
+      double floor = 0;
+      for (size_t i = size / 2 + 100; i < size / 2 + 300; i++) {
+        floor += pow(10, db[i] / 10);
+      }
+      floor = 10 * log10(floor / 200);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(10 * log10(2 * sigma * sigma / fs), floor,
+                                   0.5);
+    }
+
+    /* Blocks of any size give the one-shot estimate, and the same
+     * blocks on several threads give it bit for bit */
+    void
+    qa_welch_psd::t2()
+    {
+      const size_t size = 256;
+      std::vector<std::complex<float> > x =
+        tone_in_noise(300001, 0.123, 0.3f, 0.05f);
+
+      welch_psd serial(size, 1e6);
+      serial.process(&x[0], x.size());
+
+      worker_pool pool(3, std::vector<int>(), 0);
+      welch_psd blocked(size, 1e6);
+      welch_psd parallel(size, 1e6, &pool);
+      const size_t blocks[5] = { 100, 7777, 255, 65536, 1 };
+      size_t i = 0, b = 0;
+      while (i < x.size()) {
+        size_t n = std::min(blocks[b++ % 5], x.size() - i);
+        blocked.process(&x[i], n);
+        parallel.process(&x[i], n);
+        i += n;
+      }
+      CPPUNIT_ASSERT_EQUAL(serial.segments(), parallel.segments());
+      std::vector<double> a = serial.density_db();
+      std::vector<double> c = parallel.density_db();
+      /* Summed in a different grouping, so equal to rounding */
+      for (size_t k = 0; k < size; k++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(a[k], c[k], 1e-9);
+      }
+      CPPUNIT_ASSERT(blocked.density_db() == c);
+
+      bool thrown = false;
+      try {
+        welch_psd bad(1000, 1e6);
+      } catch (const std::invalid_argument &e) {
+        thrown = true;
+      }
+      CPPUNIT_ASSERT(thrown);
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
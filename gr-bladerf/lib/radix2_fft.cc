@@ -0,0 +1,94 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "radix2_fft.h"
+
+namespace gr {
+  namespace bladerf {
+
+    radix2_fft::radix2_fft(size_t size, bool forward)
+      : d_size(size)
+    {
+      if (size < 2 || (size & (size - 1)) != 0) {
+        throw std::invalid_argument("radix2_fft: size must be a power "
+                                    "of two");
+      }
+
+      const double sign = forward ? -1.0 : 1.0;
+      d_twiddle.resize(size / 2);
+      for (size_t k = 0; k < size / 2; k++) {
+        double w = sign * 2 * M_PI * k / size;
+        d_twiddle[k] = std::complex<float>((float)cos(w), (float)sin(w));
+      }
+
+      for (size_t i = 1, j = 0; i < size; i++) {
+        size_t bit = size >> 1;
+        for (; j & bit; bit >>= 1) {
+          j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+          d_swaps.push_back(std::make_pair(i, j));
+        }
+      }
+    }
+
+    double
+    radix2_fft::multiplies() const
+    {
+      double stages = log2((double)d_size);
+      return 4.0 * (d_size / 2) * stages;
+    }
+
+    void
+    radix2_fft::execute(std::complex<float> *data) const
+    {
+      for (size_t i = 0; i < d_swaps.size(); i++) {
+        std::swap(data[d_swaps[i].first], data[d_swaps[i].second]);
+      }
+
+      for (size_t len = 2; len <= d_size; len <<= 1) {
+        const size_t half = len / 2;
+        const size_t stride = d_size / len;
+        for (size_t start = 0; start < d_size; start += len) {
+          std::complex<float> *a = data + start;
+          std::complex<float> *b = a + half;
+          for (size_t k = 0; k < half; k++) {
+            const std::complex<float> &w = d_twiddle[k * stride];
+            float tr = b[k].real() * w.real() - b[k].imag() * w.imag();
+            float ti = b[k].real() * w.imag() + b[k].imag() * w.real();
+            b[k] = std::complex<float>(a[k].real() - tr, a[k].imag() - ti);
+            a[k] = std::complex<float>(a[k].real() + tr, a[k].imag() + ti);
+          }
+        }
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
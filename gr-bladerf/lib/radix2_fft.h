@@ -0,0 +1,61 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_RADIX2_FFT_H
+#define INCLUDED_BLADERF_RADIX2_FFT_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief In-place power of two complex FFT.
+     *
+     * Twiddles and the bit reversal order are computed once, so
+     * execute() only reads shared state and one plan can be used from
+     * several threads at once. Neither direction is normalized.
+     */
+    class radix2_fft
+    {
+     public:
+      radix2_fft(size_t size, bool forward);
+
+      void execute(std::complex<float> *data) const;
+
+      size_t size() const { return d_size; }
+
+      /* Real multiplies per transform */
+      double multiplies() const;
+
+     private:
+      size_t d_size;
+      std::vector<std::complex<float> > d_twiddle;
+      std::vector<std::pair<size_t, size_t> > d_swaps;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_RADIX2_FFT_H */
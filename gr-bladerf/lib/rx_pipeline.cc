@@ -0,0 +1,328 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <new>
+#include <string.h>
+#include "rx_pipeline.h"
+#include "sample_convert.h"
+#include "thread_utils.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* How long a stage waits on an empty queue before rechecking d_running */
+    static const unsigned int STAGE_POLL_MS = 100;
+
+    rx_pipeline::rx_pipeline(size_t depth, size_t nframes, size_t nchan,
+                             const std::vector<int> &channels,
+                             receive_fn receive, double samp_rate,
+                             stream_recovery::reset_fn reset,
+                             bladerf_format format)
+      : d_nframes(nframes),
+        d_nchan(nchan),
+        d_format(format),
+        d_channels(channels),
+        d_receive(receive),
+        d_recovery(reset, samp_rate),
+        d_blocks(depth),
+        d_free(depth),
+        d_captured(depth),
+        d_converted(depth),
+        d_current(NULL),
+        d_running(false),
+        d_receive_errors(0),
+        d_resets(0)
+    {
+      size_t i = 0;
+      try {
+        for (; i < d_blocks.size(); i++) {
+          block &b = d_blocks[i];
+          b.raw = NULL;
+          b.conv.reserve(d_channels.size());
+          b.raw = alloc_buffer(raw_bytes());
+          for (size_t c = 0; c < d_channels.size(); c++) {
+            b.conv.push_back((std::complex<float> *)
+                             alloc_buffer(conv_bytes()));
+          }
+          b.gap = 0;
+          b.nframes = 0;
+          b.offset = 0;
+          b.status = 0;
+          d_free.push(&b);
+        }
+      } catch (const std::bad_alloc &) {
+        /* No destructor runs for a constructor that throws */
+        for (size_t j = 0; j <= i; j++) {
+          free_buffer(d_blocks[j].raw, raw_bytes());
+          for (size_t c = 0; c < d_blocks[j].conv.size(); c++) {
+            free_buffer(d_blocks[j].conv[c], conv_bytes());
+          }
+        }
+        throw;
+      }
+    }
+
+    rx_pipeline::~rx_pipeline()
+    {
+      stop();
+      for (size_t i = 0; i < d_blocks.size(); i++) {
+        free_buffer(d_blocks[i].raw, raw_bytes());
+        for (size_t c = 0; c < d_blocks[i].conv.size(); c++) {
+          free_buffer(d_blocks[i].conv[c], conv_bytes());
+        }
+      }
+    }
+
+    size_t
+    rx_pipeline::raw_bytes() const
+    {
+      size_t bytes = (d_format == BLADERF_FORMAT_SC8_Q7) ? sizeof(int8_t)
+                                                         : sizeof(int16_t);
+      return d_nframes * d_nchan * 2 * bytes;
+    }
+
+    size_t
+    rx_pipeline::conv_bytes() const
+    {
+      return d_nframes * sizeof(std::complex<float>);
+    }
+
+    void
+    rx_pipeline::start(const std::vector<int> &capture_cpus,
+                       const std::vector<int> &convert_cpus, int rt_priority)
+    {
+      if (d_running) {
+        return;
+      }
+
+      d_running = true;
+      d_capture_thread.reset(new boost::thread(
+        boost::bind(&rx_pipeline::capture_loop, this, capture_cpus,
+                    rt_priority)));
+      d_convert_thread.reset(new boost::thread(
+        boost::bind(&rx_pipeline::convert_loop, this, convert_cpus,
+                    rt_priority)));
+    }
+
+    void
+    rx_pipeline::stop()
+    {
+      if (!d_running) {
+        return;
+      }
+
+      d_running = false;
+      d_free.close();
+      d_captured.close();
+      d_converted.close();
+      d_capture_thread->join();
+      d_convert_thread->join();
+      d_capture_thread.reset();
+      d_convert_thread.reset();
+
+      /* Put every block back on the free list for the next start() */
+      d_free.reopen();
+      d_captured.reopen();
+      d_converted.reopen();
+      d_current = NULL;
+      for (size_t i = 0; i < d_blocks.size(); i++) {
+        d_free.push(&d_blocks[i]);
+      }
+    }
+
+    void
+    rx_pipeline::capture_loop(std::vector<int> cpus, int rt_priority)
+    {
+      setup_current_thread("rx capture", cpus, rt_priority);
+      for (size_t i = 0; i < d_blocks.size(); i++) {
+        touch_buffer(d_blocks[i].raw, raw_bytes());
+      }
+
+      while (d_running) {
+        block *b;
+        if (!d_free.pop(b, STAGE_POLL_MS)) {
+          continue;
+        }
+
+        b->status = d_receive(b->raw, d_nframes * d_nchan);
+        b->offset = 0;
+        if (b->status == 0) {
+          b->gap = d_recovery.on_success(d_nframes);
+          b->nframes = d_nframes;
+        } else {
+          d_receive_errors++;
+          b->gap = d_recovery.on_failure(b->status);
+          b->nframes = 0;
+          d_resets = d_recovery.resets();
+        }
+
+        if (b->gap == 0 && b->nframes == 0) {
+          d_free.push(b);
+          continue;
+        }
+        if (!d_tap.empty()) {
+          d_tap(b->raw, b->nframes, b->gap);
+        }
+
+        if (!d_captured.push(b)) {
+          break;
+        }
+      }
+    }
+
+    void
+    rx_pipeline::convert_loop(std::vector<int> cpus, int rt_priority)
+    {
+      std::vector<std::complex<float> *> out(d_nchan);
+
+      setup_current_thread("rx convert", cpus, rt_priority);
+      for (size_t i = 0; i < d_blocks.size(); i++) {
+        for (size_t c = 0; c < d_blocks[i].conv.size(); c++) {
+          touch_buffer(d_blocks[i].conv[c], conv_bytes());
+        }
+      }
+
+      while (d_running) {
+        block *b;
+        if (!d_captured.pop(b, STAGE_POLL_MS)) {
+          continue;
+        }
+
+        if (b->nframes > 0 && !d_channels.empty()) {
+          std::fill(out.begin(), out.end(), (std::complex<float> *)NULL);
+          for (size_t c = 0; c < d_channels.size(); c++) {
+            out[d_channels[c]] = b->conv[c];
+          }
+          if (d_format == BLADERF_FORMAT_SC8_Q7) {
+            sc8_to_fc32((const int8_t *)b->raw, &out[0], b->nframes,
+                        d_nchan, SC8_Q7_SCALE);
+          } else {
+            sc16_to_fc32((const int16_t *)b->raw, &out[0], b->nframes,
+                         d_nchan, SC16_Q11_SCALE);
+          }
+        }
+
+        if (!d_converted.push(b)) {
+          break;
+        }
+      }
+    }
+
+    size_t
+    rx_pipeline::deliver(std::complex<float> **out, size_t nframes,
+                         unsigned int timeout_ms, std::vector<gap_t> *gaps)
+    {
+      size_t done = 0;
+
+      while (done < nframes) {
+        if (d_current == NULL) {
+          /* Only wait for the first block; after that hand out what we
+           * have rather than stall the flowgraph */
+          if (!d_converted.pop(d_current, done == 0 ? timeout_ms : 0)) {
+            break;
+          }
+        }
+
+        block *b = d_current;
+        size_t n;
+
+        if (b->offset < b->gap) {
+          /* Stand-in for samples lost while the stream was down */
+          n = (size_t)std::min<uint64_t>(nframes - done, b->gap - b->offset);
+          for (size_t c = 0; c < d_channels.size(); c++) {
+            std::fill(out[c] + done, out[c] + done + n,
+                      std::complex<float>(0, 0));
+          }
+          if (gaps != NULL) {
+            gaps->push_back(gap_t(done, n));
+          }
+        } else {
+          size_t pos = (size_t)(b->offset - b->gap);
+          n = std::min(nframes - done, b->nframes - pos);
+          for (size_t c = 0; c < d_channels.size(); c++) {
+            memcpy(out[c] + done, b->conv[c] + pos,
+                   n * sizeof(std::complex<float>));
+          }
+        }
+        done += n;
+        b->offset += n;
+
+        if (b->offset == b->gap + b->nframes) {
+          d_free.push(d_current);
+          d_current = NULL;
+        }
+      }
+
+      return done;
+    }
+
+    size_t
+    rx_pipeline::deliver_raw(void *out, size_t nframes,
+                             unsigned int timeout_ms,
+                             std::vector<gap_t> *gaps)
+    {
+      const size_t frame = raw_bytes() / d_nframes;
+      char *dst = (char *)out;
+      size_t done = 0;
+
+      while (done < nframes) {
+        if (d_current == NULL) {
+          if (!d_converted.pop(d_current, done == 0 ? timeout_ms : 0)) {
+            break;
+          }
+        }
+
+        block *b = d_current;
+        size_t n;
+
+        if (b->offset < b->gap) {
+          n = (size_t)std::min<uint64_t>(nframes - done, b->gap - b->offset);
+          memset(dst + done * frame, 0, n * frame);
+          if (gaps != NULL) {
+            gaps->push_back(gap_t(done, n));
+          }
+        } else {
+          size_t pos = (size_t)(b->offset - b->gap);
+          n = std::min(nframes - done, b->nframes - pos);
+          memcpy(dst + done * frame, (const char *)b->raw + pos * frame,
+                 n * frame);
+        }
+        done += n;
+        b->offset += n;
+
+        if (b->offset == b->gap + b->nframes) {
+          d_free.push(d_current);
+          d_current = NULL;
+        }
+      }
+
+      return done;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,159 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_RX_PIPELINE_H
+#define INCLUDED_BLADERF_RX_PIPELINE_H
+
+#include <libbladeRF.h>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <complex>
+#include <vector>
+#include <stdint.h>
+#include "bounded_queue.h"
+#include "stream_recovery.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Three stage receive pipeline.
+     *
+     * A capture thread waits on USB, a convert thread turns SC16 or SC8
+     * samples into one
+     * complex float stream per requested channel, and the block's own
+     * thread copies converted samples out in deliver(). Blocks travel
+     * free -> captured -> converted -> free through bounded queues, so
+     * while block k+1 is being received block k is converted and block
+     * k-1 delivered, and throughput is set by the slowest stage rather
+     * than by the sum of the three. When the flowgraph falls behind the
+     * capture stage runs out of free blocks and stops reading, leaving
+     * libbladeRF to report the overrun.
+     *
+     * Failed receives never stop the pipeline. A stream_recovery resets
+     * the stream from the capture thread after repeated failures, and the
+     * time the stream was down comes out of deliver() as zero samples,
+     * reported through the gaps argument so the block can tag them.
+     */
+    class rx_pipeline
+    {
+     public:
+      /* Read nsamples (counting every channel) into buf and return a
+       * libbladeRF status code */
+      typedef boost::function<int (void *buf, unsigned int nsamples)>
+        receive_fn;
+
+      /* Sees every received block on the capture thread, raw, after
+       * any gap ahead of it: nframes frames of every streamed channel
+       * in the stream's format, or nframes 0 for a pure gap */
+      typedef boost::function<void (const void *raw, size_t nframes,
+                                    uint64_t gap)> tap_fn;
+
+      /*!
+       * \param depth    number of blocks in flight
+       * \param nframes  frames per block
+       * \param nchan    channels interleaved in the received stream
+       * \param channels channels to convert and deliver, in output order;
+       *                 empty when only deliver_raw() is used
+       * \param receive  hardware read used by the capture stage
+       * \param samp_rate sample rate, used to size gaps from wall clock time
+       * \param reset    stream reset used after repeated receive failures
+       * \param format   BLADERF_FORMAT_SC16_Q11 or BLADERF_FORMAT_SC8_Q7
+       */
+      rx_pipeline(size_t depth, size_t nframes, size_t nchan,
+                  const std::vector<int> &channels, receive_fn receive,
+                  double samp_rate,
+                  stream_recovery::reset_fn reset = stream_recovery::reset_fn(),
+                  bladerf_format format = BLADERF_FORMAT_SC16_Q11);
+      ~rx_pipeline();
+
+      /* Set before start() */
+      void set_tap(tap_fn tap) { d_tap = tap; }
+
+      void start(const std::vector<int> &capture_cpus,
+                 const std::vector<int> &convert_cpus, int rt_priority);
+      void stop();
+
+      /* (offset, length) of a run of zero-filled gap frames */
+      typedef std::pair<size_t, uint64_t> gap_t;
+
+      /* Copy up to nframes into out[0..channels.size()-1]; returns the
+       * number of frames written, 0 if nothing arrived within timeout.
+       * Zero-filled runs standing in for lost samples are appended to
+       * gaps when it is not NULL. */
+      size_t deliver(std::complex<float> **out, size_t nframes,
+                     unsigned int timeout_ms,
+                     std::vector<gap_t> *gaps = NULL);
+
+      /* As deliver(), but copies the received frames as they are, every
+       * channel interleaved in the stream's format. Meant for a pipeline
+       * built with no channels to convert, which skips that stage. */
+      size_t deliver_raw(void *out, size_t nframes, unsigned int timeout_ms,
+                         std::vector<gap_t> *gaps = NULL);
+
+      size_t frames_per_block() const { return d_nframes; }
+      uint64_t receive_errors() const { return d_receive_errors; }
+      uint64_t resets() const { return d_resets; }
+
+     private:
+      struct block {
+        void *raw;
+        std::vector<std::complex<float> *> conv;
+        uint64_t gap;     /* zero frames to emit ahead of the samples */
+        size_t nframes;   /* received frames, 0 for a pure gap */
+        uint64_t offset;  /* frames handed out so far, gap included */
+        int status;
+      };
+
+      size_t d_nframes;
+      size_t d_nchan;
+      bladerf_format d_format;
+      std::vector<int> d_channels;
+      receive_fn d_receive;
+      tap_fn d_tap;
+      stream_recovery d_recovery;
+
+      std::vector<block> d_blocks;
+      bounded_queue<block *> d_free;
+      bounded_queue<block *> d_captured;
+      bounded_queue<block *> d_converted;
+      block *d_current;
+
+      boost::atomic<bool> d_running;
+      boost::atomic<uint64_t> d_receive_errors;
+      boost::atomic<uint64_t> d_resets;
+      boost::shared_ptr<boost::thread> d_capture_thread;
+      boost::shared_ptr<boost::thread> d_convert_thread;
+
+      void capture_loop(std::vector<int> cpus, int rt_priority);
+      void convert_loop(std::vector<int> cpus, int rt_priority);
+
+      size_t raw_bytes() const;
+      size_t conv_bytes() const;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_RX_PIPELINE_H */
@@ -0,0 +1,242 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include "sample_convert.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace gr {
+  namespace bladerf {
+
+#ifdef __SSE2__
+    /* Sign-extend four int16 I/Q values to int32 and scale to float */
+    static inline __m128
+    cvt_lo(__m128i v, __m128 k)
+    {
+      return _mm_mul_ps(_mm_cvtepi32_ps(
+        _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), k);
+    }
+
+    static inline __m128
+    cvt_hi(__m128i v, __m128 k)
+    {
+      return _mm_mul_ps(_mm_cvtepi32_ps(
+        _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), k);
+    }
+
+    /* Sign-extend eight int8 values to int16 */
+    static inline __m128i
+    widen_lo(__m128i v)
+    {
+      return _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+    }
+
+    static inline __m128i
+    widen_hi(__m128i v)
+    {
+      return _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+    }
+
+    /* Store two int16 frames of a two channel stream, one per output */
+    static inline void
+    store2(__m128i v, __m128 k, float *o0, float *o1)
+    {
+      __m128 a = cvt_lo(v, k);
+      __m128 b = cvt_hi(v, k);
+      _mm_storeu_ps(o0, _mm_movelh_ps(a, b));
+      _mm_storeu_ps(o1, _mm_movehl_ps(b, a));
+    }
+#endif
+
+    void
+    sc16_to_fc32(const int16_t *in, std::complex<float> **out,
+                 size_t nframes, size_t nchan, float scale)
+    {
+      const float k = 1.0f / scale;
+      size_t i = 0;
+
+      if (nchan == 1) {
+        float *o = reinterpret_cast<float *>(out[0]);
+        if (o == NULL) {
+          return;
+        }
+#ifdef __SSE2__
+        const __m128 vk = _mm_set1_ps(k);
+        for (; i + 4 <= nframes; i += 4) {
+          __m128i v = _mm_loadu_si128((const __m128i *)(in + 2 * i));
+          _mm_storeu_ps(o + 2 * i, cvt_lo(v, vk));
+          _mm_storeu_ps(o + 2 * i + 4, cvt_hi(v, vk));
+        }
+#endif
+        for (; i < nframes; i++) {
+          o[2 * i] = in[2 * i] * k;
+          o[2 * i + 1] = in[2 * i + 1] * k;
+        }
+        return;
+      }
+
+      if (nchan == 2) {
+        float *o0 = reinterpret_cast<float *>(out[0]);
+        float *o1 = reinterpret_cast<float *>(out[1]);
+#ifdef __SSE2__
+        /* Two frames per load: [I0 Q0 I1 Q1 | I0 Q0 I1 Q1]. The low half
+         * of each converted vector is channel 0, the high half channel 1. */
+        if (o0 != NULL && o1 != NULL) {
+          const __m128 vk = _mm_set1_ps(k);
+          for (; i + 2 <= nframes; i += 2) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(in + 4 * i));
+            store2(v, vk, o0 + 2 * i, o1 + 2 * i);
+          }
+        }
+#endif
+        for (; i < nframes; i++) {
+          if (o0 != NULL) {
+            o0[2 * i] = in[4 * i] * k;
+            o0[2 * i + 1] = in[4 * i + 1] * k;
+          }
+          if (o1 != NULL) {
+            o1[2 * i] = in[4 * i + 2] * k;
+            o1[2 * i + 1] = in[4 * i + 3] * k;
+          }
+        }
+        return;
+      }
+
+      for (size_t ch = 0; ch < nchan; ch++) {
+        float *o = reinterpret_cast<float *>(out[ch]);
+        if (o == NULL) {
+          continue;
+        }
+        const int16_t *p = in + 2 * ch;
+        for (i = 0; i < nframes; i++) {
+          o[2 * i] = p[0] * k;
+          o[2 * i + 1] = p[1] * k;
+          p += 2 * nchan;
+        }
+      }
+    }
+
+    void
+    sc8_to_fc32(const int8_t *in, std::complex<float> **out,
+                size_t nframes, size_t nchan, float scale)
+    {
+      const float k = 1.0f / scale;
+      size_t i = 0;
+
+      if (nchan == 1) {
+        float *o = reinterpret_cast<float *>(out[0]);
+        if (o == NULL) {
+          return;
+        }
+#ifdef __SSE2__
+        /* Eight frames per load, widened to int16 in two halves */
+        const __m128 vk = _mm_set1_ps(k);
+        for (; i + 8 <= nframes; i += 8) {
+          __m128i v = _mm_loadu_si128((const __m128i *)(in + 2 * i));
+          __m128i lo = widen_lo(v);
+          __m128i hi = widen_hi(v);
+          _mm_storeu_ps(o + 2 * i, cvt_lo(lo, vk));
+          _mm_storeu_ps(o + 2 * i + 4, cvt_hi(lo, vk));
+          _mm_storeu_ps(o + 2 * i + 8, cvt_lo(hi, vk));
+          _mm_storeu_ps(o + 2 * i + 12, cvt_hi(hi, vk));
+        }
+#endif
+        for (; i < nframes; i++) {
+          o[2 * i] = in[2 * i] * k;
+          o[2 * i + 1] = in[2 * i + 1] * k;
+        }
+        return;
+      }
+
+      if (nchan == 2) {
+        float *o0 = reinterpret_cast<float *>(out[0]);
+        float *o1 = reinterpret_cast<float *>(out[1]);
+#ifdef __SSE2__
+        /* Four frames per load; each widened half is laid out like two
+         * SC16 frames */
+        if (o0 != NULL && o1 != NULL) {
+          const __m128 vk = _mm_set1_ps(k);
+          for (; i + 4 <= nframes; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(in + 4 * i));
+            store2(widen_lo(v), vk, o0 + 2 * i, o1 + 2 * i);
+            store2(widen_hi(v), vk, o0 + 2 * i + 4, o1 + 2 * i + 4);
+          }
+        }
+#endif
+        for (; i < nframes; i++) {
+          if (o0 != NULL) {
+            o0[2 * i] = in[4 * i] * k;
+            o0[2 * i + 1] = in[4 * i + 1] * k;
+          }
+          if (o1 != NULL) {
+            o1[2 * i] = in[4 * i + 2] * k;
+            o1[2 * i + 1] = in[4 * i + 3] * k;
+          }
+        }
+        return;
+      }
+
+      for (size_t ch = 0; ch < nchan; ch++) {
+        float *o = reinterpret_cast<float *>(out[ch]);
+        if (o == NULL) {
+          continue;
+        }
+        const int8_t *p = in + 2 * ch;
+        for (i = 0; i < nframes; i++) {
+          o[2 * i] = p[0] * k;
+          o[2 * i + 1] = p[1] * k;
+          p += 2 * nchan;
+        }
+      }
+    }
+
+    void
+    fc32_to_sc16(const std::complex<float> *in, int16_t *out, size_t n,
+                 float scale)
+    {
+      const float *x = reinterpret_cast<const float *>(in);
+      size_t i = 0;
+
+#ifdef __SSE2__
+      const __m128 vk = _mm_set1_ps(scale);
+      for (; i + 4 <= n; i += 4) {
+        __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(x + 2 * i), vk));
+        __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(x + 2 * i + 4),
+                                               vk));
+        _mm_storeu_si128((__m128i *)(out + 2 * i), _mm_packs_epi32(a, b));
+      }
+#endif
+      for (i *= 2; i < 2 * n; i++) {
+        long v = lrintf(x[i] * scale);
+        out[i] = (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,59 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_SAMPLE_CONVERT_H
+#define INCLUDED_BLADERF_SAMPLE_CONVERT_H
+
+#include <complex>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /* Full scale of the SC16 Q11 format */
+    static const float SC16_Q11_SCALE = 2048.0f;
+
+    /* Full scale of the SC8 Q7 format */
+    static const float SC8_Q7_SCALE = 128.0f;
+
+    /*
+     * Convert nframes interleaved SC16 frames (nchan I/Q pairs per frame,
+     * as delivered by bladerf_sync_rx) to one complex float stream per
+     * channel. A NULL out[ch] skips that channel.
+     */
+    void sc16_to_fc32(const int16_t *in, std::complex<float> **out,
+                      size_t nframes, size_t nchan, float scale);
+
+    /* The same for SC8 frames, which carry half the bytes over USB */
+    void sc8_to_fc32(const int8_t *in, std::complex<float> **out,
+                     size_t nframes, size_t nchan, float scale);
+
+    /* Back to single channel SC16, rounding and saturating, for raw
+     * recordings of a float stream */
+    void fc32_to_sc16(const std::complex<float> *in, int16_t *out,
+                      size_t n, float scale);
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_SAMPLE_CONVERT_H */
@@ -0,0 +1,559 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <endian.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sc16_codec.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace gr {
+  namespace bladerf {
+
+    /*
+     * The delta codec predicts each I and Q value from the same one a
+     * frame earlier and stores the difference zigzag mapped (0, -1, 1,
+     * -2...) in 7-bit groups. Band limited captures at sensible gain
+     * mostly need one or two bytes a value where the raw format always
+     * takes two; a full scale step costs three.
+     */
+
+    static inline uint32_t
+    zigzag(int32_t v)
+    {
+      return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+    }
+
+    static inline int32_t
+    unzigzag(uint32_t u)
+    {
+      return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+    }
+
+    static void
+    encode_delta(const int16_t *frames, size_t n, size_t nchan,
+                 std::vector<uint8_t> &out)
+    {
+      const size_t stride = 2 * nchan;
+      const size_t count = n * stride;
+      size_t pos = out.size();
+
+      /* A difference of two int16 zigzags to 17 bits: three groups */
+      out.resize(pos + 3 * count);
+      uint8_t *p = &out[pos];
+      for (size_t i = 0; i < count; i++) {
+        int32_t prev = i >= stride ? frames[i - stride] : 0;
+        uint32_t u = zigzag((int32_t)frames[i] - prev);
+        while (u >= 0x80) {
+          *p++ = (uint8_t)(u | 0x80);
+          u >>= 7;
+        }
+        *p++ = (uint8_t)u;
+      }
+      out.resize(p - &out[0]);
+    }
+
+    static bool
+    decode_delta(const uint8_t *in, size_t len, size_t n, size_t nchan,
+                 int16_t *out)
+    {
+      const size_t stride = 2 * nchan;
+      const size_t count = n * stride;
+      const uint8_t *end = in + len;
+
+      for (size_t i = 0; i < count; i++) {
+        uint32_t u = 0;
+        for (int shift = 0; ; shift += 7) {
+          if (in == end || shift > 14) {
+            return false;
+          }
+          uint8_t b = *in++;
+          u |= (uint32_t)(b & 0x7f) << shift;
+          if (!(b & 0x80)) {
+            break;
+          }
+        }
+        int32_t prev = i >= stride ? out[i - stride] : 0;
+        out[i] = (int16_t)(prev + unzigzag(u));
+      }
+      return in == end;
+    }
+
+    /*
+     * The Rice codec. Each I and Q component of a block gets the
+     * predictor, none, the previous value or the line through the two
+     * previous ones, that leaves the smallest residuals, and a Rice
+     * parameter k matched to their mean: a zigzagged residual u is
+     * stored as u >> k in unary followed by its low k bits. Residuals
+     * whose unary part would exceed RICE_ESCAPE bits are stored raw
+     * after an escape. Block layout: a predictor order and a k byte per
+     * component, then the codes frame by frame, LSB first, padded to a
+     * byte.
+     */
+
+    static const unsigned int RICE_MAX_ORDER = 2;
+    static const unsigned int RICE_ESCAPE = 24;
+    static const unsigned int RICE_RAW_BITS = 18;  /* any zigzagged residual */
+    static const unsigned int RICE_MAX_K = RICE_RAW_BITS;
+
+    class bit_writer
+    {
+     public:
+      bit_writer(uint8_t *p) : d_p(p), d_acc(0), d_count(0) {}
+
+      /* len <= 32 */
+      inline void put(uint32_t v, unsigned int len)
+      {
+        d_acc |= (uint64_t)v << d_count;
+        d_count += len;
+        if (d_count >= 32) {
+          uint32_t w = htole32((uint32_t)d_acc);
+          memcpy(d_p, &w, sizeof(w));
+          d_p += 4;
+          d_acc >>= 32;
+          d_count -= 32;
+        }
+      }
+
+      /* Pad to a byte; returns the end of the output */
+      uint8_t *finish()
+      {
+        for (; d_count > 0; d_count -= std::min(d_count, 8u)) {
+          *d_p++ = (uint8_t)d_acc;
+          d_acc >>= 8;
+        }
+        return d_p;
+      }
+
+     private:
+      uint8_t *d_p;
+      uint64_t d_acc;
+      unsigned int d_count;
+    };
+
+    class bit_reader
+    {
+     public:
+      bit_reader(const uint8_t *p, size_t len)
+        : d_start(p), d_p(p), d_end(p + len), d_acc(0), d_count(0)
+      {
+      }
+
+      /* At least 56 bits in the accumulator, zeros past the end */
+      inline void refill()
+      {
+        if (d_end - d_p >= 8) {
+          uint64_t w;
+          memcpy(&w, d_p, sizeof(w));
+          d_acc |= le64toh(w) << d_count;
+          d_p += (63 - d_count) >> 3;
+          d_count |= 56;
+          return;
+        }
+        while (d_count <= 56) {
+          if (d_p < d_end) {
+            d_acc |= (uint64_t)*d_p << d_count;
+          }
+          d_p++;
+          d_count += 8;
+        }
+      }
+
+      inline uint32_t peek_ones() const
+      {
+        uint64_t zeros = ~d_acc;
+        return zeros ? __builtin_ctzll(zeros) : 64;
+      }
+
+      inline uint32_t get(unsigned int len)
+      {
+        uint32_t v = (uint32_t)(d_acc & ((1ULL << len) - 1));
+        d_acc >>= len;
+        d_count -= len;
+        return v;
+      }
+
+      /* Bits taken so far */
+      uint64_t consumed() const
+      {
+        return (uint64_t)(d_p - d_start) * 8 - d_count;
+      }
+
+     private:
+      const uint8_t *d_start;
+      const uint8_t *d_p;
+      const uint8_t *d_end;
+      uint64_t d_acc;
+      unsigned int d_count;
+    };
+
+    /* Sum of |residual| per component for each predictor order, in
+     * sums[3 * c + order] */
+    static void
+    residual_sums(const int16_t *frames, size_t n, size_t stride,
+                  uint64_t *sums)
+    {
+      std::fill(sums, sums + 3 * stride, 0);
+      size_t i = 0;
+
+#ifdef __SSE2__
+      /* One and two channel frames map components onto fixed lanes of
+       * four 32-bit values; the first two frames lack history */
+      if ((stride == 2 || stride == 4) && n >= 2) {
+        for (size_t f = 0; f < 2; f++) {
+          for (size_t c = 0; c < stride; c++) {
+            int32_t x = frames[f * stride + c];
+            int32_t x1 = f >= 1 ? frames[(f - 1) * stride + c] : 0;
+            sums[3 * c] += abs(x);
+            sums[3 * c + 1] += abs(x - x1);
+            sums[3 * c + 2] += abs(x - 2 * x1);
+          }
+        }
+        const int16_t *x = frames + 2 * stride;
+        const size_t count = (n - 2) * stride;
+        __m128i acc[3];
+        size_t j = 0;
+        while (j + 4 <= count) {
+          /* Partial sums fit 32 bits for 4096 steps of 2^19 */
+          acc[0] = acc[1] = acc[2] = _mm_setzero_si128();
+          size_t stop = std::min(count - count % 4, j + 4 * 4096);
+          for (; j < stop; j += 4) {
+            __m128i v0 = _mm_loadl_epi64((const __m128i *)(x + j));
+            __m128i v1 = _mm_loadl_epi64((const __m128i *)(x + j - stride));
+            __m128i v2 = _mm_loadl_epi64(
+              (const __m128i *)(x + j - 2 * stride));
+            v0 = _mm_srai_epi32(_mm_unpacklo_epi16(v0, v0), 16);
+            v1 = _mm_srai_epi32(_mm_unpacklo_epi16(v1, v1), 16);
+            v2 = _mm_srai_epi32(_mm_unpacklo_epi16(v2, v2), 16);
+            __m128i d1 = _mm_sub_epi32(v0, v1);
+            __m128i d2 = _mm_sub_epi32(d1, _mm_sub_epi32(v1, v2));
+            __m128i r[3] = { v0, d1, d2 };
+            for (int o = 0; o < 3; o++) {
+              __m128i sign = _mm_srai_epi32(r[o], 31);
+              acc[o] = _mm_add_epi32(acc[o], _mm_sub_epi32(
+                _mm_xor_si128(r[o], sign), sign));
+            }
+          }
+          for (int o = 0; o < 3; o++) {
+            uint32_t lanes[4];
+            _mm_storeu_si128((__m128i *)lanes, acc[o]);
+            for (int l = 0; l < 4; l++) {
+              sums[3 * (l % stride) + o] += lanes[l];
+            }
+          }
+        }
+        i = 2 + j / stride;
+      }
+#endif
+
+      for (; i < n; i++) {
+        for (size_t c = 0; c < stride; c++) {
+          int32_t x = frames[i * stride + c];
+          int32_t x1 = i >= 1 ? frames[(i - 1) * stride + c] : 0;
+          int32_t x2 = i >= 2 ? frames[(i - 2) * stride + c] : 0;
+          sums[3 * c] += abs(x);
+          sums[3 * c + 1] += abs(x - x1);
+          sums[3 * c + 2] += abs(x - 2 * x1 + x2);
+        }
+      }
+    }
+
+    static inline int32_t
+    predict(unsigned int order, int32_t x1, int32_t x2)
+    {
+      return order == 0 ? 0 : (order == 1 ? x1 : 2 * x1 - x2);
+    }
+
+    static void
+    encode_rice(const int16_t *frames, size_t n, size_t nchan,
+                std::vector<uint8_t> &out)
+    {
+      const size_t stride = 2 * nchan;
+      std::vector<uint64_t> sums(3 * stride);
+      std::vector<uint8_t> order(stride), k(stride);
+
+      residual_sums(frames, n, stride, &sums[0]);
+      for (size_t c = 0; c < stride; c++) {
+        const uint64_t *s = &sums[3 * c];
+        unsigned int o = (unsigned int)(std::min_element(s, s + 3) - s);
+        /* k = floor(log2(mean zigzag value)), about twice the mean |r| */
+        unsigned int kk = 0;
+        while (kk < RICE_MAX_K && ((uint64_t)n << (kk + 1)) <= 2 * s[o]) {
+          kk++;
+        }
+        order[c] = o;
+        k[c] = kk;
+      }
+
+      size_t pos = out.size();
+      /* The escape bounds a value to 44 bits */
+      out.resize(pos + 2 * stride + 6 * n * stride + 8);
+      uint8_t *p = &out[pos];
+      for (size_t c = 0; c < stride; c++) {
+        *p++ = order[c];
+        *p++ = k[c];
+      }
+
+      /* Each component's two previous values */
+      std::vector<int32_t> h1(stride, 0), h2(stride, 0);
+      bit_writer w(p);
+      for (size_t i = 0; i < n; i++) {
+        for (size_t c = 0; c < stride; c++) {
+          int32_t x = frames[i * stride + c];
+          uint32_t u = zigzag(x - predict(order[c], h1[c], h2[c]));
+          h2[c] = h1[c];
+          h1[c] = x;
+          uint32_t q = u >> k[c];
+          if (q < RICE_ESCAPE) {
+            w.put((1u << q) - 1, q + 1);
+            w.put(u & ((1u << k[c]) - 1), k[c]);
+          } else {
+            w.put((1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+            w.put(u, RICE_RAW_BITS);
+          }
+        }
+      }
+      out.resize(w.finish() - &out[0]);
+    }
+
+    static bool
+    decode_rice(const uint8_t *in, size_t len, size_t n, size_t nchan,
+                int16_t *out)
+    {
+      const size_t stride = 2 * nchan;
+      std::vector<uint8_t> order(stride), k(stride);
+
+      if (len < 2 * stride) {
+        return false;
+      }
+      for (size_t c = 0; c < stride; c++) {
+        order[c] = in[2 * c];
+        k[c] = in[2 * c + 1];
+        if (order[c] > RICE_MAX_ORDER || k[c] > RICE_MAX_K) {
+          return false;
+        }
+      }
+      in += 2 * stride;
+      len -= 2 * stride;
+
+      std::vector<int32_t> h1(stride, 0), h2(stride, 0);
+      bit_reader r(in, len);
+      for (size_t i = 0; i < n; i++) {
+        for (size_t c = 0; c < stride; c++) {
+          r.refill();
+          uint32_t q = std::min(r.peek_ones(), RICE_ESCAPE);
+          uint32_t u;
+          if (q < RICE_ESCAPE) {
+            r.get(q + 1);
+            u = (q << k[c]) | r.get(k[c]);
+          } else {
+            r.get(RICE_ESCAPE);
+            u = r.get(RICE_RAW_BITS);
+          }
+          int32_t x = predict(order[c], h1[c], h2[c]) + unzigzag(u);
+          if (x < -32768 || x > 32767) {
+            return false;
+          }
+          h2[c] = h1[c];
+          h1[c] = x;
+          out[i * stride + c] = (int16_t)x;
+        }
+        if (r.consumed() > (uint64_t)len * 8) {
+          return false;
+        }
+      }
+      return (r.consumed() + 7) / 8 == len;
+    }
+
+    /*
+     * PACK12 keeps the 12 bits a bladeRF sample actually has, two
+     * values in three bytes, low value first.
+     */
+
+    static bool
+    fits_12_bits(const int16_t *x, size_t count)
+    {
+      size_t i = 0;
+      int16_t lo = 0, hi = 0;
+#ifdef __SSE2__
+      __m128i vlo = _mm_setzero_si128(), vhi = _mm_setzero_si128();
+      for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+        vlo = _mm_min_epi16(vlo, v);
+        vhi = _mm_max_epi16(vhi, v);
+      }
+      int16_t l[8], h[8];
+      _mm_storeu_si128((__m128i *)l, vlo);
+      _mm_storeu_si128((__m128i *)h, vhi);
+      lo = *std::min_element(l, l + 8);
+      hi = *std::max_element(h, h + 8);
+#endif
+      for (; i < count; i++) {
+        lo = std::min(lo, x[i]);
+        hi = std::max(hi, x[i]);
+      }
+      return lo >= -2048 && hi <= 2047;
+    }
+
+    static void
+    encode_pack12(const int16_t *x, size_t count, uint8_t *p)
+    {
+      for (size_t i = 0; i < count; i += 2) {
+        uint32_t v = ((uint32_t)x[i] & 0xfff) |
+                     (((uint32_t)x[i + 1] & 0xfff) << 12);
+        p[0] = (uint8_t)v;
+        p[1] = (uint8_t)(v >> 8);
+        p[2] = (uint8_t)(v >> 16);
+        p += 3;
+      }
+    }
+
+    static void
+    decode_pack12(const uint8_t *p, size_t count, int16_t *x)
+    {
+      for (size_t i = 0; i < count; i += 2) {
+        uint32_t v = p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+        x[i] = (int16_t)((int16_t)(v << 4) >> 4);
+        x[i + 1] = (int16_t)((int16_t)((v >> 12) << 4) >> 4);
+        p += 3;
+      }
+    }
+
+    static void
+    encode_none(const int16_t *frames, size_t count, uint8_t *p)
+    {
+      for (size_t i = 0; i < count; i++) {
+        uint16_t v = htole16((uint16_t)frames[i]);
+        memcpy(p + 2 * i, &v, sizeof(v));
+      }
+    }
+
+    enum sc16_codec_type
+    sc16_encode(enum sc16_codec_type type, const int16_t *frames,
+                size_t n, size_t nchan, std::vector<uint8_t> &out)
+    {
+      const size_t count = n * 2 * nchan;
+      const size_t raw = count * sizeof(int16_t);
+      size_t pos = out.size();
+
+      bool coded = false;
+      switch (type) {
+      case SC16_CODEC_DELTA:
+        encode_delta(frames, n, nchan, out);
+        coded = true;
+        break;
+      case SC16_CODEC_RICE:
+        encode_rice(frames, n, nchan, out);
+        coded = true;
+        break;
+      case SC16_CODEC_PACK12:
+        if (fits_12_bits(frames, count)) {
+          out.resize(pos + count / 2 * 3);
+          encode_pack12(frames, count, &out[pos]);
+          return type;
+        }
+        break;
+      default:
+        break;
+      }
+
+      /* Blocks the codec could not hold or shrink are stored raw */
+      if (coded && out.size() - pos < raw) {
+        return type;
+      }
+      out.resize(pos + raw);
+      encode_none(frames, count, &out[pos]);
+      return SC16_CODEC_NONE;
+    }
+
+    bool
+    sc16_decode(enum sc16_codec_type type, const uint8_t *in, size_t len,
+                size_t n, size_t nchan, int16_t *out)
+    {
+      const size_t count = n * 2 * nchan;
+
+      switch (type) {
+      case SC16_CODEC_DELTA:
+        return decode_delta(in, len, n, nchan, out);
+      case SC16_CODEC_RICE:
+        return decode_rice(in, len, n, nchan, out);
+      case SC16_CODEC_PACK12:
+        if (len != count / 2 * 3) {
+          return false;
+        }
+        decode_pack12(in, count, out);
+        return true;
+      case SC16_CODEC_NONE:
+        break;
+      default:
+        return false;
+      }
+
+      if (len != count * sizeof(int16_t)) {
+        return false;
+      }
+      for (size_t i = 0; i < count; i++) {
+        uint16_t v;
+        memcpy(&v, in + 2 * i, sizeof(v));
+        out[i] = (int16_t)le16toh(v);
+      }
+      return true;
+    }
+
+    size_t
+    sc16_max_encoded(enum sc16_codec_type type, size_t n, size_t nchan)
+    {
+      return n * 2 * nchan * sizeof(int16_t);
+    }
+
+    static const char *const codec_names[] = {
+      "none", "delta", "rice", "pack12"
+    };
+
+    bool
+    parse_sc16_codec(const std::string &name, enum sc16_codec_type *type)
+    {
+      for (int i = 0; i < 4; i++) {
+        if (name == codec_names[i]) {
+          *type = (enum sc16_codec_type)i;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    const char *
+    sc16_codec_name(enum sc16_codec_type type)
+    {
+      return (unsigned int)type < 4 ? codec_names[type] : "unknown";
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
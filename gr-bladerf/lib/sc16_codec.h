@@ -0,0 +1,73 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_SC16_CODEC_H
+#define INCLUDED_BLADERF_SC16_CODEC_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /* Encodings of a block of SC16 frames; the values go on the wire
+     * and into files */
+    enum sc16_codec_type {
+      SC16_CODEC_NONE = 0,   /* little-endian int16 as captured */
+      SC16_CODEC_DELTA = 1,  /* per component deltas, zigzag varints */
+      SC16_CODEC_RICE = 2,   /* per block predictor and Rice codes */
+      SC16_CODEC_PACK12 = 3, /* 12-bit values, three bytes a pair */
+    };
+
+    /*
+     * Append the encoding of n frames of nchan I/Q pairs to out and
+     * return the codec used: a block the requested codec cannot hold
+     * (PACK12 with values beyond 12 bits) or does not shrink is stored
+     * as NONE instead. Every block is coded on its own, so blocks can
+     * be lost or decoded in any order.
+     */
+    enum sc16_codec_type sc16_encode(enum sc16_codec_type type,
+                                     const int16_t *frames, size_t n,
+                                     size_t nchan,
+                                     std::vector<uint8_t> &out);
+
+    /* Decode exactly n frames from len bytes; false if the block is
+     * malformed or does not hold exactly that many */
+    bool sc16_decode(enum sc16_codec_type type, const uint8_t *in,
+                     size_t len, size_t n, size_t nchan, int16_t *out);
+
+    /* Largest encoding of n frames sc16_encode() produces; with the
+     * fallback that is the raw size whatever the codec */
+    size_t sc16_max_encoded(enum sc16_codec_type type, size_t n,
+                            size_t nchan);
+
+    /* "none", "delta", "rice" or "pack12"; false for anything else */
+    bool parse_sc16_codec(const std::string &name,
+                          enum sc16_codec_type *type);
+    const char *sc16_codec_name(enum sc16_codec_type type);
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_SC16_CODEC_H */
@@ -0,0 +1,294 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sc16_file.h"
+#include "worker_pool.h"
+
+namespace gr {
+  namespace bladerf {
+
+    sc16_file_writer::sc16_file_writer(
+      const struct sc16_writer_config &config)
+      : d_config(config),
+        d_file(NULL),
+        d_fill(0),
+        d_ok(true),
+        d_frames(0),
+        d_bytes(0)
+    {
+      if (config.nchan < 1 || config.block_frames < 1 ||
+          config.block_frames > 0xffffffffu / (4 * config.nchan)) {
+        throw std::invalid_argument("sc16_file_writer: bad block size or "
+                                    "channel count");
+      }
+      d_file = fopen(config.path.c_str(), "wb");
+      if (d_file == NULL) {
+        throw std::runtime_error("sc16_file_writer: unable to create " +
+                                 config.path);
+      }
+      /* A block or so per write() to the kernel */
+      setvbuf(d_file, NULL, _IOFBF, 1 << 20);
+
+      struct sc16_file_header h;
+      memset(&h, 0, sizeof(h));
+      memcpy(h.magic, SC16_FILE_MAGIC, sizeof(SC16_FILE_MAGIC));
+      h.nchan = config.nchan;
+      h.block_frames = config.block_frames;
+      h.samp_rate = config.samp_rate;
+      h.center_freq = config.center_freq;
+      h.start_time = config.start_time;
+      d_ok = fwrite(&h, sizeof(h), 1, d_file) == 1;
+      d_bytes = sizeof(h);
+
+      d_pending.resize(config.block_frames * 2 * config.nchan);
+      d_coded.reserve(sc16_max_encoded(config.codec, config.block_frames,
+                                       config.nchan));
+    }
+
+    sc16_file_writer::~sc16_file_writer()
+    {
+      close();
+    }
+
+    void
+    sc16_file_writer::write(const int16_t *frames, size_t n)
+    {
+      const size_t stride = 2 * d_config.nchan;
+      while (n > 0 && d_file != NULL) {
+        size_t k = std::min(n, d_config.block_frames - d_fill);
+        memcpy(&d_pending[d_fill * stride], frames,
+               k * stride * sizeof(int16_t));
+        d_fill += k;
+        frames += k * stride;
+        n -= k;
+        if (d_fill == d_config.block_frames) {
+          flush();
+        }
+      }
+    }
+
+    void
+    sc16_file_writer::flush()
+    {
+      if (d_fill == 0) {
+        return;
+      }
+
+      struct sc16_block_header b;
+      d_coded.clear();
+      b.codec = sc16_encode(d_config.codec, &d_pending[0], d_fill,
+                            d_config.nchan, d_coded);
+      b.nframes = d_fill;
+      b.bytes = d_coded.size();
+      b.reserved = 0;
+      if (fwrite(&b, sizeof(b), 1, d_file) != 1 ||
+          fwrite(&d_coded[0], 1, d_coded.size(), d_file) != d_coded.size()) {
+        d_ok = false;
+      }
+      d_frames += d_fill;
+      d_bytes += sizeof(b) + d_coded.size();
+      d_fill = 0;
+    }
+
+    void
+    sc16_file_writer::close()
+    {
+      if (d_file == NULL) {
+        return;
+      }
+      flush();
+      if (fclose(d_file) != 0) {
+        d_ok = false;
+      }
+      d_file = NULL;
+    }
+
+    sc16_file_reader::sc16_file_reader(const std::string &path)
+      : d_map(NULL),
+        d_map_size(0),
+        d_header(NULL),
+        d_frames(0)
+    {
+      d_fd = open(path.c_str(), O_RDONLY);
+      if (d_fd < 0) {
+        throw std::runtime_error("sc16_file_reader: unable to open " + path);
+      }
+
+      struct stat st;
+      if (fstat(d_fd, &st) != 0 ||
+          (size_t)st.st_size < sizeof(struct sc16_file_header)) {
+        ::close(d_fd);
+        throw std::runtime_error("sc16_file_reader: " + path +
+                                 " is not a compressed recording");
+      }
+      d_map_size = st.st_size;
+      d_map = mmap(NULL, d_map_size, PROT_READ, MAP_SHARED, d_fd, 0);
+      if (d_map == MAP_FAILED) {
+        ::close(d_fd);
+        throw std::runtime_error("sc16_file_reader: unable to map " + path);
+      }
+      /* Decoding walks the file front to back */
+      madvise(d_map, d_map_size, MADV_SEQUENTIAL);
+
+      d_header = (const struct sc16_file_header *)d_map;
+      if (memcmp(d_header->magic, SC16_FILE_MAGIC, sizeof(SC16_FILE_MAGIC)) != 0 ||
+          d_header->nchan < 1 || d_header->block_frames < 1) {
+        munmap(d_map, d_map_size);
+        ::close(d_fd);
+        throw std::runtime_error("sc16_file_reader: " + path +
+                                 " is not a compressed recording");
+      }
+
+      const size_t max_bytes = sc16_max_encoded(SC16_CODEC_NONE,
+                                                d_header->block_frames,
+                                                d_header->nchan);
+      const uint8_t *p = (const uint8_t *)d_map + sizeof(*d_header);
+      const uint8_t *end = (const uint8_t *)d_map + d_map_size;
+      while ((size_t)(end - p) >= sizeof(struct sc16_block_header)) {
+        struct sc16_block_header b;
+        memcpy(&b, p, sizeof(b));
+        p += sizeof(b);
+        if (b.bytes > max_bytes || b.nframes < 1 ||
+            b.nframes > d_header->block_frames ||
+            (size_t)(end - p) < b.bytes) {
+          break;
+        }
+        struct block_ref r;
+        r.payload = p;
+        r.bytes = b.bytes;
+        r.nframes = b.nframes;
+        r.codec = b.codec;
+        r.start = d_frames;
+        d_blocks.push_back(r);
+        d_frames += b.nframes;
+        p += b.bytes;
+      }
+    }
+
+    sc16_file_reader::~sc16_file_reader()
+    {
+      munmap(d_map, d_map_size);
+      ::close(d_fd);
+    }
+
+    void
+    sc16_file_reader::decode_block(size_t first, int16_t *out, char *ok,
+                                   size_t task) const
+    {
+      const struct block_ref &b = d_blocks[first + task];
+      int16_t *dst = out + (b.start - d_blocks[first].start) * 2 *
+                           d_header->nchan;
+      ok[task] = sc16_decode((enum sc16_codec_type)b.codec, b.payload,
+                             b.bytes, b.nframes, d_header->nchan, dst);
+    }
+
+    bool
+    sc16_file_reader::decode(size_t first, size_t count, int16_t *out,
+                             worker_pool *pool) const
+    {
+      if (count == 0) {
+        return true;
+      }
+      if (first + count > d_blocks.size()) {
+        throw std::out_of_range("sc16_file_reader: no such block");
+      }
+
+      std::vector<char> ok(count, 0);
+      if (pool != NULL) {
+        pool->run(count, boost::bind(&sc16_file_reader::decode_block, this,
+                                     first, out, &ok[0], _1));
+      } else {
+        for (size_t i = 0; i < count; i++) {
+          decode_block(first, out, &ok[0], i);
+        }
+      }
+      return std::find(ok.begin(), ok.end(), 0) == ok.end();
+    }
+
+    size_t
+    sc16_file_reader::find_block(uint64_t pos) const
+    {
+      size_t lo = 0, hi = d_blocks.size();
+      while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (d_blocks[mid].start <= pos) {
+          lo = mid;
+        } else {
+          hi = mid;
+        }
+      }
+      return lo;
+    }
+
+    bool
+    sc16_file_reader::read(uint64_t pos, size_t n, int16_t *out) const
+    {
+      if (n == 0) {
+        return true;
+      }
+      if (pos + n > d_frames) {
+        return false;
+      }
+
+      const size_t nchan = d_header->nchan;
+      std::vector<int16_t> scratch;
+      for (size_t i = find_block(pos); n > 0; i++) {
+        const struct block_ref &b = d_blocks[i];
+        const size_t skip = pos - b.start;
+        const size_t take = std::min(n, (size_t)b.nframes - skip);
+        int16_t *dst = out;
+
+        /* Whole blocks go straight to out, partial ones through
+         * scratch */
+        if (skip > 0 || take < b.nframes) {
+          scratch.resize(b.nframes * 2 * nchan);
+          dst = &scratch[0];
+        }
+        if (!sc16_decode((enum sc16_codec_type)b.codec, b.payload, b.bytes,
+                         b.nframes, nchan, dst)) {
+          return false;
+        }
+        if (dst != out) {
+          memcpy(out, dst + skip * 2 * nchan,
+                 take * 2 * nchan * sizeof(int16_t));
+        }
+        out += take * 2 * nchan;
+        pos += take;
+        n -= take;
+      }
+      return true;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,167 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_SC16_FILE_H
+#define INCLUDED_BLADERF_SC16_FILE_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "sc16_codec.h"
+
+namespace gr {
+  namespace bladerf {
+
+    class worker_pool;
+
+    /*
+     * A compressed recording (.sc16z) is this header followed by
+     * blocks, each an sc16_block_header and its payload as coded by
+     * sc16_encode(), native byte order. Every block is coded on its own,
+     * so a file cut short loses only its last block and the blocks can
+     * be decoded in parallel.
+     */
+    static const char SC16_FILE_MAGIC[8] = "SC16Z01";
+
+    struct sc16_file_header {
+      char magic[8];          /* SC16_FILE_MAGIC */
+      uint32_t nchan;
+      uint32_t block_frames;  /* most frames in one block */
+      double samp_rate;
+      double center_freq;
+      double start_time;      /* Unix time of the first frame, or 0 */
+    };
+
+    struct sc16_block_header {
+      uint32_t nframes;
+      uint32_t bytes;         /* payload following the header */
+      uint32_t codec;         /* sc16_codec_type of the payload */
+      uint32_t reserved;
+    };
+
+    struct sc16_writer_config {
+      std::string path;
+      enum sc16_codec_type codec;
+      size_t block_frames;
+      size_t nchan;
+      double samp_rate;
+      double center_freq;
+      double start_time;
+    };
+
+    /*!
+     * \brief Compresses a stream of SC16 frames into a file as it comes.
+     *
+     * Meant for the capture thread: write() only copies until a block
+     * is full, then codes it in place of the copy and appends it
+     * through stdio, so the cost per sample is the codec's and no
+     * buffer grows. Write errors do not throw; ok() turns false.
+     */
+    class sc16_file_writer
+    {
+     public:
+      sc16_file_writer(const struct sc16_writer_config &config);
+      ~sc16_file_writer();
+
+      void write(const int16_t *frames, size_t n);
+
+      /* Write the partial block and close the file */
+      void close();
+
+      bool ok() const { return d_ok; }
+      uint64_t frames() const { return d_frames; }
+      uint64_t bytes() const { return d_bytes; }
+
+     private:
+      struct sc16_writer_config d_config;
+      FILE *d_file;
+      std::vector<int16_t> d_pending;
+      std::vector<uint8_t> d_coded;
+      size_t d_fill;
+      bool d_ok;
+      uint64_t d_frames;
+      uint64_t d_bytes;
+
+      void flush();
+    };
+
+    /*!
+     * \brief Random access to a compressed recording.
+     *
+     * Maps the file and indexes its blocks once; decode() then fills a
+     * run of blocks, one task per block on a worker_pool when given
+     * one. A trailing block cut short by a crash is left out.
+     */
+    class sc16_file_reader
+    {
+     public:
+      sc16_file_reader(const std::string &path);
+      ~sc16_file_reader();
+
+      const struct sc16_file_header &header() const { return *d_header; }
+      size_t blocks() const { return d_blocks.size(); }
+      uint64_t frames() const { return d_frames; }
+
+      /* Frame position and length of block i */
+      uint64_t block_start(size_t i) const { return d_blocks[i].start; }
+      size_t block_frames(size_t i) const { return d_blocks[i].nframes; }
+
+      /* Coded bytes of the whole file */
+      size_t file_size() const { return d_map_size; }
+
+      /* Decode blocks [first, first + count) to out; false if one of
+       * them is corrupt */
+      bool decode(size_t first, size_t count, int16_t *out,
+                  worker_pool *pool = NULL) const;
+
+      /* Decode n frames from frame pos on, whatever blocks they fall
+       * in; false if one of those is corrupt or the file is shorter.
+       * Safe to call from several threads at once. */
+      bool read(uint64_t pos, size_t n, int16_t *out) const;
+
+     private:
+      struct block_ref {
+        const uint8_t *payload;
+        uint32_t bytes;
+        uint32_t nframes;
+        uint32_t codec;
+        uint64_t start;
+      };
+
+      int d_fd;
+      void *d_map;
+      size_t d_map_size;
+      const struct sc16_file_header *d_header;
+      std::vector<struct block_ref> d_blocks;
+      uint64_t d_frames;
+
+      void decode_block(size_t first, int16_t *out, char *ok,
+                        size_t task) const;
+      size_t find_block(uint64_t pos) const;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_SC16_FILE_H */
@@ -0,0 +1,267 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdexcept>
+#include "sequence_auditor.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* SEQ_TAGGED: I holds the low 12 bits of the count and Q two bits
+     * of channel over the next 10, both offset into -2048..2047 */
+    static const unsigned int TAG_COUNT_BITS = 22;
+    static const unsigned int TAG_CHANNELS = 4;
+
+    /* The most the FPGA counter may step between frames of a channel */
+    static const uint32_t MAX_STEP = 16;
+
+    static const char *pattern_names[2] = { "tagged", "counter" };
+
+    bool
+    parse_sequence_pattern(const std::string &name,
+                           enum sequence_pattern *pattern)
+    {
+      for (int i = 0; i < 2; i++) {
+        if (name == pattern_names[i]) {
+          *pattern = (enum sequence_pattern)i;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void
+    sequence_frames(uint64_t first, size_t nchan, size_t n, int16_t *out)
+    {
+      for (size_t k = 0; k < n; k++) {
+        const uint32_t c = (uint32_t)(first + k);
+        for (size_t ch = 0; ch < nchan; ch++) {
+          *out++ = (int16_t)((c & 0xfff) - 2048);
+          *out++ = (int16_t)((((ch & 3) << 10) | ((c >> 12) & 0x3ff)) -
+                             2048);
+        }
+      }
+    }
+
+    const char *
+    sequence_event_name(enum sequence_event_type type)
+    {
+      static const char *names[4] = { "slip", "repeat", "corrupt", "swap" };
+      return (unsigned int)type < 4 ? names[type] : "unknown";
+    }
+
+    sequence_auditor::sequence_auditor(size_t nchan,
+                                       enum sequence_pattern pattern)
+      : d_pattern(pattern),
+        d_mask(pattern == SEQ_TAGGED ? (1u << TAG_COUNT_BITS) - 1
+                                     : 0xffffffffu),
+        d_frames(0)
+    {
+      if (nchan < 1 || (pattern == SEQ_TAGGED && nchan > TAG_CHANNELS)) {
+        throw std::invalid_argument("sequence_auditor: bad channel count");
+      }
+      struct slot s;
+      s.synced = false;
+      s.have_first = false;
+      s.expected = 0;
+      s.step = 1;
+      s.held = false;
+      s.held_count = s.held_expected = 0;
+      s.held_position = 0;
+      s.swapping = false;
+      s.swap_start = 0;
+      s.swap_source = 0;
+      s.lost = s.repeated = s.corrupt = s.swapped = s.slips = 0;
+      d_slots.assign(nchan, s);
+    }
+
+    void
+    sequence_auditor::event(size_t ch, enum sequence_event_type type,
+                            uint64_t position, uint64_t frames,
+                            size_t source)
+    {
+      /* Corrupt samples in a row are one run, so a stuck stream does
+       * not make an event per sample */
+      if (type == SEQ_CORRUPT) {
+        for (size_t k = d_events.size();
+             k > 0 && k + d_slots.size() > d_events.size(); k--) {
+          struct sequence_event &last = d_events[k - 1];
+          if (last.channel == ch && last.type == SEQ_CORRUPT &&
+              last.position + last.frames == position) {
+            last.frames += frames;
+            return;
+          }
+        }
+      }
+      struct sequence_event e;
+      e.position = position;
+      e.channel = ch;
+      e.type = type;
+      e.frames = frames;
+      e.source = source;
+      d_events.push_back(e);
+    }
+
+    void
+    sequence_auditor::end_swap(size_t ch)
+    {
+      struct slot &s = d_slots[ch];
+      if (s.swapping) {
+        event(ch, SEQ_SWAP, s.swap_start, d_frames - s.swap_start,
+              s.swap_source);
+        s.swapping = false;
+      }
+    }
+
+    void
+    sequence_auditor::process(const int16_t *frames, size_t n)
+    {
+      const size_t nchan = d_slots.size();
+      for (size_t k = 0; k < n; k++) {
+        for (size_t ch = 0; ch < nchan; ch++) {
+          sample(ch, frames[0], frames[1]);
+          frames += 2;
+        }
+        d_frames++;
+      }
+    }
+
+    void
+    sequence_auditor::sample(size_t ch, int16_t i, int16_t q)
+    {
+      struct slot &s = d_slots[ch];
+      uint32_t c;
+
+      if (d_pattern == SEQ_TAGGED) {
+        if (i < -2048 || i > 2047 || q < -2048 || q > 2047) {
+          /* Out of SC16 Q11 range; no count to take from it */
+          count(ch, ~0u);
+          return;
+        }
+        const uint32_t ui = (uint32_t)(i + 2048), uq = (uint32_t)(q + 2048);
+        const size_t source = uq >> 10;
+        if (source != ch) {
+          if (!s.swapping) {
+            s.swapping = true;
+            s.swap_start = d_frames;
+            s.swap_source = source;
+          }
+          s.swapped++;
+        } else {
+          end_swap(ch);
+        }
+        c = ui | (uq & 0x3ff) << 12;
+      } else {
+        c = (uint32_t)(uint16_t)i | (uint32_t)(uint16_t)q << 16;
+      }
+      count(ch, c);
+    }
+
+    void
+    sequence_auditor::count(size_t ch, uint32_t c)
+    {
+      struct slot &s = d_slots[ch];
+      const uint32_t half = (d_mask >> 1) + 1;
+
+      if (!s.synced) {
+        if (c == ~0u) {
+          return;
+        }
+        if (d_pattern == SEQ_COUNTER32 && !s.have_first) {
+          s.have_first = true;
+          s.expected = c;
+          return;
+        }
+        if (d_pattern == SEQ_COUNTER32) {
+          uint32_t step = c - s.expected;
+          if (step == 0 || step > MAX_STEP) {
+            s.expected = c;
+            return;
+          }
+          s.step = step;
+        }
+        s.synced = true;
+        s.expected = (c + s.step) & d_mask;
+        return;
+      }
+
+      if (s.held) {
+        if (c == s.expected) {
+          /* The old count goes on: the held sample alone was bad */
+          s.held = false;
+          s.corrupt++;
+          event(ch, SEQ_CORRUPT, s.held_position, 1, ch);
+        } else if (c == ((s.held_count + s.step) & d_mask)) {
+          /* The held sample starts a new run: the stream jumped */
+          s.held = false;
+          uint32_t diff = (s.held_count - s.held_expected) & d_mask;
+          if (diff < half) {
+            uint64_t n = diff / s.step;
+            s.lost += n;
+            s.slips++;
+            event(ch, SEQ_SLIP, s.held_position, n, ch);
+          } else {
+            uint64_t n = ((d_mask - diff + 1) & d_mask) / s.step;
+            s.repeated += n;
+            event(ch, SEQ_REPEAT, s.held_position, n, ch);
+          }
+          s.expected = (c + s.step) & d_mask;
+          return;
+        } else {
+          /* Neither: the held sample was bad, this one is held next */
+          s.corrupt++;
+          event(ch, SEQ_CORRUPT, s.held_position, 1, ch);
+          s.held = false;
+        }
+      }
+
+      if (c == s.expected) {
+        s.expected = (c + s.step) & d_mask;
+        return;
+      }
+      s.held = true;
+      s.held_count = c;
+      s.held_expected = s.expected;
+      s.held_position = d_frames;
+      s.expected = (s.expected + s.step) & d_mask;
+    }
+
+    void
+    sequence_auditor::finish()
+    {
+      for (size_t ch = 0; ch < d_slots.size(); ch++) {
+        struct slot &s = d_slots[ch];
+        if (s.held) {
+          s.held = false;
+          s.corrupt++;
+          event(ch, SEQ_CORRUPT, s.held_position, 1, ch);
+        }
+        end_swap(ch);
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,136 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_SEQUENCE_AUDITOR_H
+#define INCLUDED_BLADERF_SEQUENCE_AUDITOR_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace bladerf {
+
+    enum sequence_pattern {
+      /* Ours: a 22 bit frame counter and the channel number, in SC16 Q11
+       * range so it goes through the TX path and the FPGA loopback */
+      SEQ_TAGGED,
+      /* What the FPGA sends with bladerf_set_rx_mux(dev,
+       * BLADERF_RX_MUX_32BIT_COUNTER): I the low half, Q the high */
+      SEQ_COUNTER32
+    };
+
+    /* "tagged" or "counter"; false for any other name */
+    bool parse_sequence_pattern(const std::string &name,
+                                enum sequence_pattern *pattern);
+
+    /* Frames [first, first + n) of the SEQ_TAGGED pattern for nchan
+     * (up to 4) interleaved channels, as sc16 */
+    void sequence_frames(uint64_t first, size_t nchan, size_t n,
+                         int16_t *out);
+
+    enum sequence_event_type {
+      SEQ_SLIP,        /* frames lost */
+      SEQ_REPEAT,      /* frames delivered again */
+      SEQ_CORRUPT,     /* samples that fit nowhere in the sequence */
+      SEQ_SWAP         /* a run of another channel's samples */
+    };
+
+    struct sequence_event {
+      uint64_t position;   /* frame of the stream where it shows */
+      size_t channel;
+      enum sequence_event_type type;
+      uint64_t frames;     /* lost, repeated, corrupt or swapped */
+      size_t source;       /* for swaps, the channel they came from */
+    };
+
+    const char *sequence_event_name(enum sequence_event_type type);
+
+    /*!
+     * \brief Follows a counter pattern through a stream of interleaved
+     * sc16 frames and reports where it breaks.
+     *
+     * A sample that does not carry the next count is held until the
+     * next one says what it was: one that follows on from it confirms
+     * a jump, lost frames forward and repeated ones back, one that
+     * carries on the old count marks it corrupt. Tagged samples of the
+     * wrong channel are counted and reported as a swap per run. The
+     * FPGA counter may step per frame or per sample across channels,
+     * so its step is learned from the first two samples of a channel.
+     */
+    class sequence_auditor
+    {
+     public:
+      sequence_auditor(size_t nchan, enum sequence_pattern pattern);
+
+      void process(const int16_t *frames, size_t n);
+
+      /* Settle a sample still held at the end of the stream */
+      void finish();
+
+      /* Events so far; clear_events() once they have been used */
+      const std::vector<sequence_event> &events() const { return d_events; }
+      void clear_events() { d_events.clear(); }
+
+      size_t nchan() const { return d_slots.size(); }
+      uint64_t frames() const { return d_frames; }
+      uint64_t lost(size_t ch) const { return d_slots[ch].lost; }
+      uint64_t repeated(size_t ch) const { return d_slots[ch].repeated; }
+      uint64_t corrupt(size_t ch) const { return d_slots[ch].corrupt; }
+      uint64_t swapped(size_t ch) const { return d_slots[ch].swapped; }
+      uint64_t slips(size_t ch) const { return d_slots[ch].slips; }
+      bool synced(size_t ch) const { return d_slots[ch].synced; }
+
+     private:
+      struct slot {
+        bool synced;
+        bool have_first;     /* a first counter sample, for the step */
+        uint32_t expected;
+        uint32_t step;
+        bool held;
+        uint32_t held_count;
+        uint32_t held_expected;
+        uint64_t held_position;
+        bool swapping;
+        uint64_t swap_start;
+        size_t swap_source;
+        uint64_t lost, repeated, corrupt, swapped, slips;
+      };
+
+      enum sequence_pattern d_pattern;
+      uint32_t d_mask;          /* counter modulus - 1 */
+      std::vector<struct slot> d_slots;
+      uint64_t d_frames;
+      std::vector<sequence_event> d_events;
+
+      void sample(size_t ch, int16_t i, int16_t q);
+      void count(size_t ch, uint32_t c);
+      void event(size_t ch, enum sequence_event_type type,
+                 uint64_t position, uint64_t frames, size_t source);
+      void end_swap(size_t ch);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_SEQUENCE_AUDITOR_H */
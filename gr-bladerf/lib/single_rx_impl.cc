@@ -26,161 +26,176 @@
 #endif
 
 #include <gnuradio/io_signature.h>
+#include <boost/bind.hpp>
+#include <pmt/pmt.h>
+#include <stdexcept>
+#include <sys/time.h>
 #include "single_rx_impl.h"
-
-
-static int init_sync(struct bladerf *dev)
-{
-    int status;
-    /* These items configure the underlying asynch stream used by the sync
-     * interface. The "buffer" here refers to those used internally by worker
-     * threads, not the user's sample buffers.
-     *
-     * It is important to remember that TX buffers will not be submitted to
-     * the hardware until `buffer_size` samples are provided via the
-     * bladerf_sync_tx call.  Similarly, samples will not be available to
-     * RX via bladerf_sync_rx() until a block of `buffer_size` samples has been
-     * received.
-     */
-    const unsigned int num_buffers   = 16;
-    const unsigned int buffer_size   = 4096; /* Must be a multiple of 1024 */
-    const unsigned int num_transfers = 8;
-    const unsigned int timeout_ms    = 3500;
-    /* Configure both the device's x1 RX and TX channels for use with the
-     * synchronous
-     * interface. SC16 Q11 samples *without* metadata are used. */
-    status = bladerf_sync_config(dev, BLADERF_RX_X2, BLADERF_FORMAT_SC16_Q11,
-                                 num_buffers, buffer_size, num_transfers,
-                                 timeout_ms);
-    if (status != 0) {
-        fprintf(stderr, "Failed to configure RX sync interface: %s\n",
-                bladerf_strerror(status));
-        return status;
-    }
-    else {
-        printf("Succesfully configured interface\n ");
-    }
-
-
-}
-
-
-/* The RX and TX channels are configured independently for these parameters */
-struct channel_config {
-    bladerf_channel channel;
-    unsigned int frequency;
-    unsigned int bandwidth;
-    unsigned int samplerate;
-    int gain;
-};
-int configure_channel(struct bladerf *dev, struct channel_config *c)
-{
-    int status;
-    status = bladerf_set_frequency(dev, c->channel, c->frequency);
-    if (status != 0) {
-        fprintf(stderr, "Failed to set frequency = %u: %s\n", c->frequency,
-                bladerf_strerror(status));
-        return status;
-    }
-    status = bladerf_set_sample_rate(dev, c->channel, c->samplerate, NULL);
-    if (status != 0) {
-        fprintf(stderr, "Failed to set samplerate = %u: %s\n", c->samplerate,
-                bladerf_strerror(status));
-        return status;
-    }
-    status = bladerf_set_bandwidth(dev, c->channel, c->bandwidth, NULL);
-    if (status != 0) {
-        fprintf(stderr, "Failed to set bandwidth = %u: %s\n", c->bandwidth,
-                bladerf_strerror(status));
-        return status;
-    }
-    status = bladerf_set_gain(dev, c->channel, c->gain);
-    if (status != 0) {
-        fprintf(stderr, "Failed to set gain: %s\n", bladerf_strerror(status));
-        return status;
-    }
-    return status;
-}
+#include "device_utils.h"
+#include "thread_utils.h"
 
 
 namespace gr {
   namespace bladerf {
 
+    /* Frames per pipeline block; a frame holds one sample of each
+     * streamed channel */
+    static const size_t FRAMES_PER_BLOCK = 2048;
+    /* Blocks in flight between the capture, convert and work threads */
+    static const size_t PIPELINE_DEPTH = 8;
+    static const unsigned int RX_TIMEOUT_MS = 1000;
+    static const double SAMPLE_RATE = 2000000;
+    static const double CENTER_FREQ = 2100000000;
+    /* Frames the IQ bus holds for its readers */
+    static const size_t BUS_FRAMES = 1 << 22;
 
     static unsigned int iter = 0;
     unsigned long int t2;
     static unsigned long int t1;
     double time;
 
+    /* One entry of the cores list, or no restriction when it is empty */
+    static std::vector<int>
+    core_at(const std::vector<int> &cores, size_t i)
+    {
+      if (cores.empty()) {
+        return cores;
+      }
+      return std::vector<int>(1, cores[i % cores.size()]);
+    }
+
+    /* Channels selected by a mask, lowest first */
+    static std::vector<int>
+    mask_channels(int channel_mask)
+    {
+      std::vector<int> channels;
+      for (int ch = 0; ch < 2; ch++) {
+        if (channel_mask & (1 << ch)) {
+          channels.push_back(ch);
+        }
+      }
+      return channels;
+    }
+
+    /* No destructor runs when the constructor throws, so the device is
+     * closed before giving up on it */
+    static void
+    close_and_throw(struct bladerf *dev, const std::string &what)
+    {
+      bladerf_close(dev);
+      throw std::runtime_error("single_rx: " + what);
+    }
+
     single_rx::sptr
-    single_rx::make()
+    single_rx::make(const std::vector<int> &cores, int rt_priority,
+                    const std::string &profile, int channel_mask,
+                    const std::string &format, const std::string &bus)
     {
       return gnuradio::get_initial_sptr
-        (new single_rx_impl());
-
+        (new single_rx_impl(cores, rt_priority, profile, channel_mask,
+                            format, bus));
     }
 
     /*
      * The private constructor
      */
-    single_rx_impl::single_rx_impl()
+    single_rx_impl::single_rx_impl(const std::vector<int> &cores,
+                                   int rt_priority,
+                                   const std::string &profile,
+                                   int channel_mask,
+                                   const std::string &format,
+                                   const std::string &bus)
       : gr::sync_block("single_rx",
               gr::io_signature::make(0, 0, 0),
-              gr::io_signature::make(1, 1, sizeof( gr_complex ))),
-    _dev(NULL)
+              gr::io_signature::make(mask_channels(channel_mask).size(),
+                                     mask_channels(channel_mask).size(),
+                                     sizeof( gr_complex ))),
+        _dev(NULL),
+        _cores(cores),
+        _rt_priority(rt_priority),
+        _thread_ready(false),
+        _channels(mask_channels(channel_mask)),
+        _format(BLADERF_FORMAT_SC16_Q11),
+        _bus_name(bus)
     {
-	    set_max_noutput_items(2048);
-	    set_output_multiple(2048);
-	    int status;
-	    struct channel_config config;
-	    struct bladerf_devinfo dev_info;
-	    /* Initialize the information used to identify the desired device
-	     * to all wildcard (i.e., "any device") values */
-	    bladerf_init_devinfo(&dev_info);
-	    status = bladerf_open_with_devinfo(&_dev, &dev_info);
-	    if (status != 0) {
-		fprintf(stderr, "Unable to open device: %s\n",
-		        bladerf_strerror(status));
-	    }
-	    /* Set up RX channel parameters */
-	    config.channel    = BLADERF_CHANNEL_RX(0);
-	    config.frequency  = 2100000000;
-	    config.bandwidth  = 6000000;
-	    config.samplerate = 2000000;
-	    config.gain       = 30;
-	    status = configure_channel(_dev, &config);
-	    if (status != 0) {
-		fprintf(stderr, "Failed to configure RX channel. Exiting.\n");
-	    }
-            int ret;
-    	    bool done         = false;
-    	    bool have_tx_data = false;
-    	    unsigned long int t1,t2;
-    	    double time;
-            /* "User" samples buffers and their associated sizes, in units of samples.
-            * Recall that one sample = two int16_t values. */
-            rx_samples            = NULL;
-            int16_t *tx_samples            = NULL;
-            const unsigned int samples_len = 4096; /* May be any (reasonable) size */
-            /* Allocate a buffer to store received samples in */
-            rx_samples = (int16_t*)malloc(samples_len * 2 * 1 * sizeof(int16_t));
-    	    if (rx_samples == NULL) {
-        	perror("malloc");
-    	    }
-
-	    /* Initialize synch interface on RX and TX */
-	    status = init_sync(_dev);
-	    if (status != 0) {
-	    }
-	    status = bladerf_enable_module(_dev, BLADERF_CHANNEL_RX(0), true);
-	    if (status != 0) {
-		fprintf(stderr, "Failed to enable RX: %s\n", bladerf_strerror(status));
-	    }
-            usleep(2000000);
-	    status = bladerf_enable_module(_dev, BLADERF_CHANNEL_RX(1), true);
-	    if (status != 0) {
-		fprintf(stderr, "Failed to enable RX: %s\n", bladerf_strerror(status));
-	    }
+      int status;
+      struct channel_config config;
+      struct device_profile saved;
+
+      if (plan_rx_stream(channel_mask, &_plan) != 0) {
+        throw std::invalid_argument("single_rx: channel_mask must be "
+                                    "0x1, 0x2 or 0x3");
+      }
+      if (format == "sc8") {
+        _format = BLADERF_FORMAT_SC8_Q7;
+      } else if (format != "sc16") {
+        throw std::invalid_argument("single_rx: unknown format " + format);
+      }
+
+      /* Only the selected channels are streamed, so all of them are
+       * delivered, in stream order */
+      _nstream = _plan.channels.size();
+      std::vector<int> delivered;
+      for (unsigned int i = 0; i < _nstream; i++) {
+        delivered.push_back(i);
+      }
+
+      set_max_noutput_items(FRAMES_PER_BLOCK);
+
+      if (open_device(&_dev, "") != 0) {
+        throw std::runtime_error("single_rx: unable to open device");
+      }
+      _state.reset(new device_state(_dev));
+
+      /* A saved profile brings back calibration and quick-tune entries;
+       * anything that already matches the hardware is left alone */
+      if (!profile.empty() && load_profile(profile, saved) == 0) {
+        _state->restore(saved);
+      }
+
+      /* Set up RX channel parameters */
+      for (size_t i = 0; i < _channels.size(); i++) {
+        config.channel    = BLADERF_CHANNEL_RX(_channels[i]);
+        config.frequency  = (unsigned int)CENTER_FREQ;
+        config.bandwidth  = 6000000;
+        config.samplerate = (unsigned int)SAMPLE_RATE;
+        config.gain       = 30;
+        if (_state->apply(&config) != 0) {
+          close_and_throw(_dev, _channels[i] ? "failed to configure RX1"
+                                             : "failed to configure RX0");
+        }
+      }
+      printf("RX configuration: %u settings applied, %u already set\n",
+             _state->applied(), _state->skipped());
+
+      if (!profile.empty() && _state->snapshot(saved) == 0) {
+        save_profile(profile, saved);
+      }
+
+      /* Initialize synch interface on RX */
+      status = init_sync(_dev, _plan.layout, _format, &default_stream_config);
+      if (status != 0 && _format == BLADERF_FORMAT_SC8_Q7) {
+        /* SC8 needs libbladeRF 2.2 and a recent FPGA */
+        fprintf(stderr, "SC8_Q7 not available, using SC16_Q11\n");
+        _format = BLADERF_FORMAT_SC16_Q11;
+        status = init_sync(_dev, _plan.layout, _format, &default_stream_config);
+      }
+      if (status != 0) {
+        close_and_throw(_dev, "failed to set up the RX stream");
+      }
+      if (enable_rx_stream(_dev, _plan, true) != 0) {
+        enable_rx_stream(_dev, _plan, false);
+        close_and_throw(_dev, "failed to enable RX");
+      }
+
+      _pipeline.reset(new rx_pipeline(PIPELINE_DEPTH, FRAMES_PER_BLOCK,
+                                      _nstream, delivered,
+                                      boost::bind(&single_rx_impl::receive,
+                                                  this, _1, _2),
+                                      SAMPLE_RATE,
+                                      boost::bind(&single_rx_impl::reset_stream,
+                                                  this),
+                                      _format));
     }
 
     /*
@@ -188,22 +203,86 @@ namespace gr {
      */
     single_rx_impl::~single_rx_impl()
     {
-	int status;
-	/* Disable RX, shutting down our underlying RX stream */
-	status = bladerf_enable_module(_dev, BLADERF_CHANNEL_RX(0), false);
-	if (status != 0) {
-	fprintf(stderr, "Failed to disable RX: %s\n", bladerf_strerror(status));
-	}
-
-	/* Disable RX, shutting down our underlying RX stream */
-        
-	/*status = bladerf_enable_module(_dev, BLADERF_CHANNEL_RX(1), false);
-	if (status != 0) {
-	fprintf(stderr, "Failed to disable RX: %s\n", bladerf_strerror(status));
-	}*/
-
-	/* Free up our resources */
-	free(rx_samples);
+      int status;
+
+      _pipeline.reset();
+
+      /* Disable RX, shutting down our underlying RX stream */
+      status = enable_rx_stream(_dev, _plan, false);
+      if (status != 0) {
+        fprintf(stderr, "Failed to disable RX: %s\n", bladerf_strerror(status));
+      }
+    }
+
+    int
+    single_rx_impl::receive(void *buf, unsigned int nsamples)
+    {
+      return bladerf_sync_rx(_dev, buf, nsamples, NULL, RX_TIMEOUT_MS);
+    }
+
+    /* Called from the capture thread once receives keep failing. Tearing
+     * the sync interface down and re-enabling the channels clears a
+     * wedged USB stream without reopening the device. */
+    int
+    single_rx_impl::reset_stream()
+    {
+      int status;
+
+      enable_rx_stream(_dev, _plan, false);
+      status = init_sync(_dev, _plan.layout, _format, &default_stream_config);
+      if (status != 0) {
+        return status;
+      }
+      return enable_rx_stream(_dev, _plan, true);
+    }
+
+    /* Capture runs on the first listed core, conversion on the second and
+     * this block's work() on the third, wrapping around shorter lists. */
+    bool
+    single_rx_impl::start()
+    {
+      _thread_ready = false;
+
+      if (!_bus_name.empty()) {
+        struct iq_bus_config config;
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        config.name = _bus_name;
+        config.capacity = BUS_FRAMES;
+        config.nchan = _nstream;
+        config.samp_rate = SAMPLE_RATE;
+        config.center_freq = CENTER_FREQ;
+        config.start_time = now.tv_sec + now.tv_usec / 1e6;
+        _bus.reset(new iq_bus_writer(config));
+        _pipeline->set_tap(boost::bind(&single_rx_impl::publish, this,
+                                       _1, _2, _3));
+      }
+
+      _pipeline->start(core_at(_cores, 0), core_at(_cores, 1), _rt_priority);
+      return true;
+    }
+
+    bool
+    single_rx_impl::stop()
+    {
+      _pipeline->stop();
+      _pipeline->set_tap(rx_pipeline::tap_fn());
+      _bus.reset();
+      return true;
+    }
+
+    /* Capture thread; the bus never blocks it */
+    void
+    single_rx_impl::publish(const void *raw, size_t nframes, uint64_t gap)
+    {
+      if (gap > 0) {
+        _bus->gap(gap);
+      }
+      if (_format == BLADERF_FORMAT_SC8_Q7) {
+        _bus->write((const int8_t *)raw, nframes);
+      } else {
+        _bus->write((const int16_t *)raw, nframes);
+      }
     }
 
     int
@@ -211,41 +290,44 @@ namespace gr {
         gr_vector_const_void_star &input_items,
         gr_vector_void_star &output_items)
     {
-        int status;
-	const unsigned int samples_len = 4096; /* May be any (reasonable) size */
-        unsigned int timeout_ms = 1000;
-	iter++;
-        gr_complex *out = ( gr_complex *) output_items[0];
-	status = bladerf_sync_rx(_dev, rx_samples, samples_len, NULL, timeout_ms);
-	t2 = clock();
-	time = (float)(t2 - t1)/CLOCKS_PER_SEC*1000;
-      	if(iter % 1024 == 0){
-	   printf("iter: %u time: %fms: spb: %u timeout_ms: noutput_items: %u\n", iter, time, samples_len, noutput_items);
-	}
-
-	if(noutput_items > 3000)
-          printf(",");
-  	t1 = clock();
-      // Do <+signal processing+>
-       for(int i = 0; i < noutput_items ; i++)
-        {
-        	// ML decoder, determine the minimum distance from all constellation points
-		float real = (float)rx_samples[4*i]/2048;
-		float imag = (float)rx_samples[4*i+1]/2048;
-      	if(iter % 1024*100 == 0){
-
-		if(real > 4 | imag > 4)
-		    printf("iter: %u , i: %u\n" , iter,i );
-
-}
-                out[i] = gr_complex(real,imag);
+      gr_complex **out = reinterpret_cast<gr_complex **>(&output_items[0]);
+      std::vector<rx_pipeline::gap_t> gaps;
+      size_t produced;
+      iter++;
 
+      /* The scheduler gives this block its own thread; pin it and raise
+       * its priority once */
+      if (!_thread_ready) {
+        setup_current_thread("single_rx", core_at(_cores, 2), _rt_priority);
+        _thread_ready = true;
+      }
+
+      produced = _pipeline->deliver(out, noutput_items, RX_TIMEOUT_MS,
+                                    &gaps);
+
+      /* Mark zero-filled stretches so downstream can tell them from
+       * silence; the value is the number of missing samples */
+      for (size_t i = 0; i < gaps.size(); i++) {
+        for (size_t n = 0; n < output_items.size(); n++) {
+          add_item_tag(n, nitems_written(n) + gaps[i].first,
+                       pmt::intern("rx_gap"),
+                       pmt::from_uint64(gaps[i].second));
         }
+      }
+
+      t2 = clock();
+      time = (float)(t2 - t1)/CLOCKS_PER_SEC*1000;
+      if (iter % 1024 == 0) {
+        printf("iter: %u time: %fms: produced: %zu noutput_items: %u "
+               "rx errors: %" PRIu64 " resets: %" PRIu64 "\n", iter, time,
+               produced, noutput_items, _pipeline->receive_errors(),
+               _pipeline->resets());
+      }
+      t1 = clock();
 
       // Tell runtime system how many output items we produced.
-      return noutput_items;
+      return produced;
     }
 
   } /* namespace bladerf */
 } /* namespace gr */
-
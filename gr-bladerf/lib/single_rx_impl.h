@@ -35,6 +35,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "rx_pipeline.h"
+#include "device_state.h"
+#include "device_utils.h"
+#include "iq_bus.h"
 /* Save to a file, e.g. boilerplate.c, and then compile:
  * $ gcc boilerplate.c -o libbladeRF_example_boilerplate -lbladeRF
  */
@@ -48,13 +52,36 @@ namespace gr {
     {
      private:
       struct bladerf *_dev;
-      int16_t *rx_samples;
+      boost::shared_ptr<rx_pipeline> _pipeline;
+      boost::shared_ptr<device_state> _state;
+      std::vector<int> _cores;
+      int _rt_priority;
+      bool _thread_ready;
+
+      /* Channels in the USB stream, all of them delivered */
+      struct rx_stream_plan _plan;
+      unsigned int _nstream;
+      std::vector<int> _channels;
+      bladerf_format _format;
+
+      /* Raw stream published for other processes while running */
+      std::string _bus_name;
+      boost::shared_ptr<iq_bus_writer> _bus;
+
+      int receive(void *buf, unsigned int nsamples);
+      int reset_stream();
+      void publish(const void *raw, size_t nframes, uint64_t gap);
 
 
      public:
-      single_rx_impl();
+      single_rx_impl(const std::vector<int> &cores, int rt_priority,
+                     const std::string &profile, int channel_mask,
+                     const std::string &format, const std::string &bus);
       ~single_rx_impl();
 
+      bool start();
+      bool stop();
+
       // Where all the action really happens
       int work(int noutput_items,
          gr_vector_const_void_star &input_items,
@@ -0,0 +1,116 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdexcept>
+#include <math.h>
+#include <string.h>
+#include "squelch_gate.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* CTCSS high pass from the flowgraph (ctcss_hpf_*_taps), designed
+     * for a 25 kHz audio rate */
+    static const double HPF_RATE = 25e3;
+    static const double HPF_FF[7] = {
+      0.77275029037678344, -4.6293488673623484, 11.562660778112377,
+      -15.41212439390735, 11.562660778112377, -4.6293488673623484,
+      0.77275029037678344
+    };
+    static const double HPF_FB[7] = {
+      1, -5.6992016578761877, 13.561013515144872, -17.245104284691045,
+      12.36205649920962, -4.7368104535795812, 0.75804902111618766
+    };
+
+    squelch_gate::squelch_gate(double squelch_db, double alpha, bool hpf,
+                               double audio_rate)
+      : d_power(0),
+        d_alpha((float)alpha),
+        d_threshold((float)pow(10.0, squelch_db / 10)),
+        d_open(false),
+        d_hpf(hpf)
+    {
+      if (hpf && audio_rate != HPF_RATE) {
+        throw std::invalid_argument("squelch_gate: the CTCSS high pass "
+                                    "needs a 25 kHz audio rate");
+      }
+      memset(d_hpf_x, 0, sizeof(d_hpf_x));
+      memset(d_hpf_y, 0, sizeof(d_hpf_y));
+    }
+
+    float
+    squelch_gate::power_db() const
+    {
+      return (float)(10 * log10(d_power + 1e-20));
+    }
+
+    float
+    squelch_gate::highpass(float x)
+    {
+      memmove(d_hpf_x + 1, d_hpf_x, 6 * sizeof(double));
+      d_hpf_x[0] = x;
+      double y = 0;
+      for (int k = 0; k < 7; k++) {
+        y += HPF_FF[k] * d_hpf_x[k];
+      }
+      for (int k = 1; k < 7; k++) {
+        y -= HPF_FB[k] * d_hpf_y[k - 1];
+      }
+      memmove(d_hpf_y + 1, d_hpf_y, 5 * sizeof(double));
+      d_hpf_y[0] = y;
+      return (float)y;
+    }
+
+    size_t
+    squelch_gate::process(const std::complex<float> *baseband,
+                          const float *demod, size_t n, float *audio,
+                          std::vector<struct squelch_event> &events)
+    {
+      size_t nout = 0;
+
+      for (size_t i = 0; i < n; i++) {
+        d_power = (1 - d_alpha) * d_power + d_alpha * std::norm(baseband[i]);
+
+        bool open = d_power >= d_threshold;
+        if (open != d_open) {
+          struct squelch_event e;
+          e.index = i;
+          e.open = open;
+          e.power_db = power_db();
+          events.push_back(e);
+          d_open = open;
+        }
+
+        if (d_open) {
+          audio[nout++] = d_hpf ? highpass(demod[i]) : demod[i];
+        }
+      }
+
+      return nout;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
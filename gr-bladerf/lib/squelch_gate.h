@@ -0,0 +1,76 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_SQUELCH_GATE_H
+#define INCLUDED_BLADERF_SQUELCH_GATE_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    struct squelch_event {
+      size_t index;      /* channel rate sample where the squelch changed */
+      bool open;
+      float power_db;
+    };
+
+    /*!
+     * \brief Power squelch and CTCSS high pass for one channel.
+     *
+     * Tracks the power of the channel's baseband samples and lets the
+     * matching demodulated samples through only while it is above the
+     * threshold, optionally through the flowgraph's 300 Hz high pass.
+     */
+    class squelch_gate
+    {
+     public:
+      squelch_gate(double squelch_db, double alpha, bool hpf,
+                   double audio_rate);
+
+      /* Gate n demodulated samples by the power of the matching baseband
+       * samples. Returns the audio written; squelch changes are appended
+       * to events, indexed by sample in this call. */
+      size_t process(const std::complex<float> *baseband, const float *demod,
+                     size_t n, float *audio,
+                     std::vector<struct squelch_event> &events);
+
+      bool open() const { return d_open; }
+      float power_db() const;
+
+     private:
+      double d_power;
+      float d_alpha;
+      float d_threshold;
+      bool d_open;
+      bool d_hpf;
+      double d_hpf_x[7], d_hpf_y[7];
+
+      float highpass(float x);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_SQUELCH_GATE_H */
@@ -0,0 +1,122 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <libbladeRF.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <stdio.h>
+#include "stream_recovery.h"
+
+namespace gr {
+  namespace bladerf {
+
+    static const unsigned int MIN_BACKOFF_MS = 50;
+    static const unsigned int MAX_BACKOFF_MS = 2000;
+
+    static boost::posix_time::ptime
+    now()
+    {
+      return boost::posix_time::microsec_clock::universal_time();
+    }
+
+    stream_recovery::stream_recovery(reset_fn reset, double samp_rate,
+                                     unsigned int max_failures)
+      : d_reset(reset),
+        d_samp_rate(samp_rate),
+        d_max_failures(max_failures),
+        d_state(STREAMING),
+        d_failures(0),
+        d_backoff_ms(MIN_BACKOFF_MS),
+        d_accounted(now()),
+        d_resets(0),
+        d_total_failures(0),
+        d_lost_frames(0)
+    {
+    }
+
+    uint64_t
+    stream_recovery::elapsed_frames(boost::posix_time::ptime t)
+    {
+      double seconds = (t - d_accounted).total_microseconds() * 1e-6;
+      d_accounted = t;
+      return seconds > 0 ? (uint64_t)(seconds * d_samp_rate) : 0;
+    }
+
+    uint64_t
+    stream_recovery::on_success(uint64_t nframes)
+    {
+      boost::posix_time::ptime t = now();
+      uint64_t lost = 0;
+
+      if (d_state != STREAMING) {
+        /* Whatever this receive did not cover of the outage is lost */
+        uint64_t elapsed = elapsed_frames(t);
+        lost = elapsed > nframes ? elapsed - nframes : 0;
+        d_lost_frames += lost;
+        fprintf(stderr, "RX stream recovered after %u failures, "
+                "%llu frames lost\n", d_failures, (unsigned long long)lost);
+      }
+
+      d_accounted = t;
+      d_state = STREAMING;
+      d_failures = 0;
+      d_backoff_ms = MIN_BACKOFF_MS;
+      return lost;
+    }
+
+    uint64_t
+    stream_recovery::on_failure(int status)
+    {
+      d_failures++;
+      d_total_failures++;
+
+      if (d_failures < d_max_failures) {
+        d_state = FAILING;
+      } else {
+        d_state = RESETTING;
+        if (!d_reset.empty()) {
+          fprintf(stderr, "RX stream: %u consecutive failures (%s), "
+                  "resetting\n", d_failures, bladerf_strerror(status));
+          if (d_reset() == 0) {
+            d_resets++;
+            d_failures = 0;
+            d_backoff_ms = MIN_BACKOFF_MS;
+          } else {
+            boost::this_thread::sleep(
+              boost::posix_time::milliseconds(d_backoff_ms));
+            d_backoff_ms = std::min(2 * d_backoff_ms, MAX_BACKOFF_MS);
+          }
+        }
+      }
+
+      uint64_t lost = elapsed_frames(now());
+      d_lost_frames += lost;
+      return lost;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,93 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_STREAM_RECOVERY_H
+#define INCLUDED_BLADERF_STREAM_RECOVERY_H
+
+#include <boost/function.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <stdint.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Keeps an RX stream alive across USB timeouts and errors.
+     *
+     * The capture thread reports the status of every bladerf_sync_rx()
+     * call. After max_failures consecutive failures the stream is reset
+     * (sync interface reconfigured and the channels re-enabled) with an
+     * exponential backoff between attempts, instead of giving up. While
+     * the stream is down the wall clock time that passes is converted to a
+     * number of missing frames, so the caller can emit that many zeros and
+     * downstream blocks keep a correct sample timeline.
+     */
+    class stream_recovery
+    {
+     public:
+      /* Re-run bladerf_sync_config and bladerf_enable_module; returns a
+       * libbladeRF status code */
+      typedef boost::function<int ()> reset_fn;
+
+      enum state {
+        STREAMING,  /* receives succeed */
+        FAILING,    /* recent receives failed, below the reset threshold */
+        RESETTING   /* the stream is being (or waiting to be) reset */
+      };
+
+      stream_recovery(reset_fn reset, double samp_rate,
+                      unsigned int max_failures = 3);
+
+      /* Account for a successful receive of nframes; returns the number
+       * of frames lost since the previous good one (0 while streaming) */
+      uint64_t on_success(uint64_t nframes);
+
+      /* Account for a failed receive; resets the stream when the failure
+       * limit is hit. Returns the frames lost so far in this outage. */
+      uint64_t on_failure(int status);
+
+      state get_state() const { return d_state; }
+      uint64_t resets() const { return d_resets; }
+      uint64_t failures() const { return d_total_failures; }
+      uint64_t lost_frames() const { return d_lost_frames; }
+
+     private:
+      reset_fn d_reset;
+      double d_samp_rate;
+      unsigned int d_max_failures;
+
+      state d_state;
+      unsigned int d_failures;
+      unsigned int d_backoff_ms;
+      boost::posix_time::ptime d_accounted;
+
+      uint64_t d_resets;
+      uint64_t d_total_failures;
+      uint64_t d_lost_frames;
+
+      uint64_t elapsed_frames(boost::posix_time::ptime now);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_STREAM_RECOVERY_H */
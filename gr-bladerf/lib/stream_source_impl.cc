@@ -0,0 +1,125 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include <pmt/pmt.h>
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "stream_source_impl.h"
+#include "sample_convert.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Longest work() waits for the server */
+    static const unsigned int WAIT_MS = 100;
+
+    /* Most frames converted per call */
+    static const size_t MAX_FRAMES = 16384;
+
+    stream_source::sptr
+    stream_source::make(const std::string &address, bool udp, int channels)
+    {
+      return gnuradio::get_initial_sptr
+        (new stream_source_impl(address, udp, channels));
+    }
+
+    /*
+     * The private constructor
+     */
+    stream_source_impl::stream_source_impl(const std::string &address,
+                                           bool udp, int channels)
+      : gr::sync_block("stream_source",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(channels, channels,
+                                     sizeof(gr_complex))),
+        _tag_time(true)
+    {
+      _client.reset(new iq_stream_client(address, udp));
+      if ((size_t)channels != _client->nchan()) {
+        throw std::invalid_argument("stream_source: the stream carries a "
+                                    "different number of channels");
+      }
+      _frames.resize(MAX_FRAMES * 2 * channels);
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    stream_source_impl::~stream_source_impl()
+    {
+    }
+
+    void
+    stream_source_impl::tag_gap(int offset, uint64_t lost)
+    {
+      for (size_t n = 0; n < _client->nchan(); n++) {
+        add_item_tag(n, nitems_written(n) + offset, pmt::intern("rx_gap"),
+                     pmt::from_uint64(lost));
+      }
+    }
+
+    int
+    stream_source_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      gr_complex **out = reinterpret_cast<gr_complex **>(&output_items[0]);
+      uint64_t gap;
+
+      size_t n = _client->read(&_frames[0],
+                               std::min((size_t)noutput_items, MAX_FRAMES),
+                               WAIT_MS, &gap);
+      if (n == 0) {
+        /* Server gone: end the flowgraph */
+        return _client->connected() ? 0 : WORK_DONE;
+      }
+
+      if (gap > 0) {
+        tag_gap(0, gap);
+        _tag_time = true;
+      }
+      if (_tag_time) {
+        double t = _client->start_time() +
+                   (_client->position() - n) / _client->samp_rate();
+        double secs = floor(t);
+        pmt::pmt_t time = pmt::make_tuple(
+          pmt::from_uint64((uint64_t)secs), pmt::from_double(t - secs));
+        for (size_t c = 0; c < _client->nchan(); c++) {
+          add_item_tag(c, nitems_written(c), pmt::intern("rx_time"), time);
+        }
+        _tag_time = false;
+      }
+
+      sc16_to_fc32(&_frames[0], out, n, _client->nchan(), SC16_Q11_SCALE);
+
+      // Tell runtime system how many output items we produced.
+      return n;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,56 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_STREAM_SOURCE_IMPL_H
+#define INCLUDED_BLADERF_STREAM_SOURCE_IMPL_H
+
+#include <bladerf/stream_source.h>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include "iq_stream.h"
+
+namespace gr {
+  namespace bladerf {
+
+    class stream_source_impl : public stream_source
+    {
+     private:
+      boost::shared_ptr<iq_stream_client> _client;
+      std::vector<int16_t> _frames;
+      bool _tag_time;
+
+      void tag_gap(int offset, uint64_t lost);
+
+     public:
+      stream_source_impl(const std::string &address, bool udp,
+                         int channels);
+      ~stream_source_impl();
+
+      int work(int noutput_items,
+               gr_vector_const_void_star &input_items,
+               gr_vector_void_star &output_items);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_STREAM_SOURCE_IMPL_H */
@@ -0,0 +1,125 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <new>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "thread_utils.h"
+
+namespace gr {
+  namespace bladerf {
+
+    int
+    pin_current_thread(const std::vector<int> &cpus)
+    {
+      cpu_set_t set;
+
+      if (cpus.empty()) {
+        return 0;
+      }
+
+      CPU_ZERO(&set);
+      for (size_t i = 0; i < cpus.size(); i++) {
+        if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) {
+          CPU_SET(cpus[i], &set);
+        }
+      }
+      return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    int
+    set_realtime_priority(int priority)
+    {
+      struct sched_param param;
+
+      if (priority <= 0) {
+        return 0;
+      }
+
+      memset(&param, 0, sizeof(param));
+      param.sched_priority = priority;
+      if (priority > sched_get_priority_max(SCHED_FIFO)) {
+        param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+      }
+      return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
+
+    void
+    setup_current_thread(const char *name, const std::vector<int> &cpus,
+                         int rt_priority)
+    {
+      int status;
+
+      status = pin_current_thread(cpus);
+      if (status != 0) {
+        fprintf(stderr, "%s: failed to set CPU affinity: %s\n",
+                name, strerror(status));
+      }
+
+      status = set_realtime_priority(rt_priority);
+      if (status != 0) {
+        fprintf(stderr, "%s: failed to set SCHED_FIFO priority %d: %s\n",
+                name, rt_priority, strerror(status));
+      }
+    }
+
+    void *
+    alloc_buffer(size_t bytes)
+    {
+      void *buf = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (buf == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+      return buf;
+    }
+
+    void
+    free_buffer(void *buf, size_t bytes)
+    {
+      if (buf != NULL) {
+        munmap(buf, bytes);
+      }
+    }
+
+    void
+    touch_buffer(void *buf, size_t bytes)
+    {
+      const size_t page = sysconf(_SC_PAGESIZE);
+      volatile char *p = (volatile char *)buf;
+
+      for (size_t i = 0; i < bytes; i += page) {
+        p[i] = 0;
+      }
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,58 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_THREAD_UTILS_H
+#define INCLUDED_BLADERF_THREAD_UTILS_H
+
+#include <vector>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /* Restrict the calling thread to the given CPUs. An empty list leaves
+     * the affinity untouched. Returns 0 or an errno value. */
+    int pin_current_thread(const std::vector<int> &cpus);
+
+    /* Run the calling thread under SCHED_FIFO at the given priority
+     * (1..99). Zero keeps the default policy. Needs CAP_SYS_NICE or an
+     * rtprio limit; returns 0 or an errno value. */
+    int set_realtime_priority(int priority);
+
+    /* Convenience for thread entry points: pin, then raise the priority,
+     * and report failures on stderr under the given thread name. */
+    void setup_current_thread(const char *name, const std::vector<int> &cpus,
+                              int rt_priority);
+
+    /* Page aligned buffers whose pages are not populated until first
+     * written. Linux places a page on the NUMA node of the thread that
+     * first touches it, so a pinned thread calling touch_buffer() on a
+     * fresh buffer gets node-local memory. alloc_buffer() throws
+     * std::bad_alloc when the mapping fails. */
+    void *alloc_buffer(size_t bytes);
+    void free_buffer(void *buf, size_t bytes);
+    void touch_buffer(void *buf, size_t bytes);
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_THREAD_UTILS_H */
@@ -0,0 +1,221 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include "trigger_recorder.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Frames copied out of the ring at a time */
+    static const size_t CHUNK_FRAMES = 65536;
+
+    /* How long to wait for the writer when a window runs ahead of it */
+    static const unsigned int POLL_MS = 20;
+
+    trigger_recorder::trigger_recorder(const iq_ring &ring,
+                                       const struct trigger_config &config)
+      : d_ring(ring),
+        d_config(config),
+        d_pre((uint64_t)llrint(config.pre_seconds * config.samp_rate)),
+        d_post((uint64_t)llrint(config.post_seconds * config.samp_rate)),
+        d_stopping(false),
+        d_files(0),
+        d_lost(0)
+    {
+      if (config.samp_rate <= 0 || config.pre_seconds < 0 ||
+          config.post_seconds < 0) {
+        throw std::invalid_argument("trigger_recorder: bad rate or window");
+      }
+      d_thread.reset(new boost::thread(
+        boost::bind(&trigger_recorder::run, this)));
+    }
+
+    trigger_recorder::~trigger_recorder()
+    {
+      stop();
+    }
+
+    void
+    trigger_recorder::stop()
+    {
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        d_stopping = true;
+        d_cond.notify_all();
+      }
+      if (d_thread && d_thread->joinable()) {
+        d_thread->join();
+      }
+    }
+
+    void
+    trigger_recorder::trigger(uint64_t pos, const std::string &reason)
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      uint64_t start = pos > d_pre ? pos - d_pre : 0;
+      uint64_t end = pos + d_post;
+
+      if (!d_windows.empty() && start <= d_windows.back().end) {
+        struct window &w = d_windows.back();
+        w.end = std::max(w.end, end);
+        w.reasons += "," + reason;
+      } else {
+        struct window w;
+        w.start = start;
+        w.end = end;
+        w.reasons = reason;
+        d_windows.push_back(w);
+        d_cond.notify_all();
+      }
+    }
+
+    uint64_t
+    trigger_recorder::files() const
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      return d_files;
+    }
+
+    uint64_t
+    trigger_recorder::lost_frames() const
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      return d_lost;
+    }
+
+    std::string
+    trigger_recorder::file_name(uint64_t pos) const
+    {
+      double t = d_config.start_time + pos / d_config.samp_rate;
+      time_t secs = (time_t)floor(t);
+      struct tm tm;
+      char stamp[32], name[64];
+
+      gmtime_r(&secs, &tm);
+      strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm);
+      snprintf(name, sizeof(name), "%s.%03d.sc16", stamp,
+               (int)((t - secs) * 1000));
+      return d_config.prefix + "_" + name;
+    }
+
+    void
+    trigger_recorder::run()
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      while (true) {
+        while (d_windows.empty() && !d_stopping) {
+          d_cond.wait(lock);
+        }
+        if (d_windows.empty()) {
+          break;
+        }
+        record(lock);
+      }
+    }
+
+    /* Write the front window; called and returns with the lock held,
+     * dropping it around ring copies and file writes */
+    void
+    trigger_recorder::record(boost::mutex::scoped_lock &lock)
+    {
+      struct window &w = d_windows.front();
+      const size_t width = 2 * d_ring.nchan();
+      const size_t chunk = std::min(CHUNK_FRAMES,
+                                    std::max(d_ring.capacity() / 2,
+                                             (size_t)1));
+      const std::string name = file_name(w.start);
+      const std::string path = d_config.directory + "/" + name;
+      std::vector<int16_t> buf(chunk * width);
+      uint64_t pos = w.start, lost = 0;
+
+      lock.unlock();
+      FILE *f = fopen(path.c_str(), "wb");
+      if (f == NULL) {
+        perror(path.c_str());
+      }
+      lock.lock();
+
+      while (pos < w.end) {
+        const uint64_t end = w.end;
+        const bool stopping = d_stopping;
+        lock.unlock();
+
+        uint64_t avail = d_ring.written();
+        uint64_t oldest = d_ring.oldest();
+        if (pos < oldest) {
+          uint64_t skip = std::min(oldest, end) - pos;
+          lost += skip;
+          pos += skip;
+        } else if (pos >= avail) {
+          if (stopping) {
+            lock.lock();
+            break;
+          }
+          boost::this_thread::sleep(boost::posix_time::milliseconds(POLL_MS));
+        } else {
+          size_t n = (size_t)std::min((uint64_t)chunk,
+                                      std::min(end, avail) - pos);
+          if (d_ring.read(pos, n, &buf[0])) {
+            if (f != NULL) {
+              fwrite(&buf[0], sizeof(int16_t), n * width, f);
+            }
+            pos += n;
+          }
+        }
+        lock.lock();
+      }
+
+      lock.unlock();
+      if (f != NULL) {
+        fclose(f);
+        std::string log = d_config.directory + "/" + d_config.prefix +
+                          ".log";
+        FILE *l = fopen(log.c_str(), "a");
+        if (l != NULL) {
+          fprintf(l, "%s %llu %llu %llu %s\n", name.c_str(),
+                  (unsigned long long)w.start,
+                  (unsigned long long)(pos - w.start - lost),
+                  (unsigned long long)lost, w.reasons.c_str());
+          fclose(l);
+        }
+      }
+      lock.lock();
+
+      if (f != NULL) {
+        d_files++;
+      }
+      d_lost += lost;
+      d_windows.pop_front();
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_TRIGGER_RECORDER_H
+#define INCLUDED_BLADERF_TRIGGER_RECORDER_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "iq_ring.h"
+
+namespace gr {
+  namespace bladerf {
+
+    struct trigger_config {
+      double samp_rate;
+      double pre_seconds;   /* kept from before the trigger */
+      double post_seconds;  /* recorded after the last trigger */
+      double start_time;    /* Unix time of ring position 0 */
+      std::string directory;
+      std::string prefix;
+    };
+
+    /*!
+     * \brief Writes windows of an iq_ring to disk around trigger events.
+     *
+     * trigger() only queues a request, so detectors can call it from
+     * any thread, the RX thread included. A background thread copies
+     * each window out of the ring as the writer fills it and appends
+     * it to <directory>/<prefix>_<UTC time>.sc16 as raw SC16 frames,
+     * the format rx.cpp writes and frs_rxd -f reads. A trigger landing
+     * inside a window still being recorded extends that window instead
+     * of starting a new file. Every finished file gets a line in
+     * <directory>/<prefix>.log: file, first position, frames, frames
+     * lost to the writer, and the reasons.
+     *
+     * Frames the ring no longer holds when their turn comes (a window
+     * longer than the ring, or a slow disk) are counted as lost and
+     * skipped; the writer is never held up.
+     */
+    class trigger_recorder
+    {
+     public:
+      trigger_recorder(const iq_ring &ring, const struct trigger_config &config);
+      ~trigger_recorder();
+
+      /* Record around ring position pos */
+      void trigger(uint64_t pos, const std::string &reason);
+
+      /* Finish the windows already requested as far as the ring allows,
+       * then stop the thread */
+      void stop();
+
+      uint64_t files() const;
+      uint64_t lost_frames() const;
+
+     private:
+      struct window {
+        uint64_t start;
+        uint64_t end;
+        std::string reasons;
+      };
+
+      const iq_ring &d_ring;
+      struct trigger_config d_config;
+      uint64_t d_pre;
+      uint64_t d_post;
+
+      mutable boost::mutex d_mutex;
+      boost::condition_variable d_cond;
+      std::deque<struct window> d_windows;  /* front is being written */
+      bool d_stopping;
+      uint64_t d_files;
+      uint64_t d_lost;
+      boost::shared_ptr<boost::thread> d_thread;
+
+      void run();
+      void record(boost::mutex::scoped_lock &lock);
+      std::string file_name(uint64_t pos) const;
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_TRIGGER_RECORDER_H */
@@ -0,0 +1,143 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "welch_psd.h"
+#include "worker_pool.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Segments per task; the grain of the parallel sum */
+    static const size_t TASK_SEGMENTS = 16;
+
+    welch_psd::welch_psd(size_t size, double samp_rate, worker_pool *pool)
+      : d_fft(size, true),
+        d_samp_rate(samp_rate),
+        d_pool(pool),
+        d_window(size),
+        d_window_power(0),
+        d_sum(size, 0.0),
+        d_segments(0)
+    {
+      if (samp_rate <= 0) {
+        throw std::invalid_argument("welch_psd: bad sample rate");
+      }
+      /* Periodic Hann, which overlaps by half to a constant */
+      for (size_t i = 0; i < size; i++) {
+        d_window[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / size));
+        d_window_power += (double)d_window[i] * d_window[i];
+      }
+    }
+
+    void
+    welch_psd::transform(const std::complex<float> *in, size_t segments,
+                         size_t task)
+    {
+      const size_t size = d_fft.size();
+      const size_t hop = size / 2;
+      const size_t first = task * TASK_SEGMENTS;
+      const size_t last = std::min(segments, first + TASK_SEGMENTS);
+      std::vector<double> &sum = d_partial[task];
+      std::vector<std::complex<float> > buf(size);
+
+      sum.assign(size, 0.0);
+      for (size_t s = first; s < last; s++) {
+        const std::complex<float> *x = in + s * hop;
+        for (size_t i = 0; i < size; i++) {
+          buf[i] = x[i] * d_window[i];
+        }
+        d_fft.execute(&buf[0]);
+        for (size_t i = 0; i < size; i++) {
+          sum[i] += std::norm(buf[i]);
+        }
+      }
+    }
+
+    void
+    welch_psd::process(const std::complex<float> *in, size_t n)
+    {
+      const size_t size = d_fft.size();
+      const size_t hop = size / 2;
+      d_pending.insert(d_pending.end(), in, in + n);
+      if (d_pending.size() < size) {
+        return;
+      }
+
+      const size_t segments = (d_pending.size() - size) / hop + 1;
+      const size_t tasks = (segments + TASK_SEGMENTS - 1) / TASK_SEGMENTS;
+      if (d_partial.size() < tasks) {
+        d_partial.resize(tasks);
+      }
+      if (d_pool != NULL) {
+        d_pool->run(tasks, boost::bind(&welch_psd::transform, this,
+                                       &d_pending[0], segments, _1));
+      } else {
+        for (size_t t = 0; t < tasks; t++) {
+          transform(&d_pending[0], segments, t);
+        }
+      }
+      for (size_t t = 0; t < tasks; t++) {
+        for (size_t i = 0; i < size; i++) {
+          d_sum[i] += d_partial[t][i];
+        }
+      }
+      d_segments += segments;
+
+      d_pending.erase(d_pending.begin(),
+                      d_pending.begin() + segments * hop);
+    }
+
+    std::vector<double>
+    welch_psd::density_db() const
+    {
+      const size_t size = d_fft.size();
+      std::vector<double> out(size, -INFINITY);
+      if (d_segments == 0) {
+        return out;
+      }
+      const double scale = 1.0 / (d_segments * d_samp_rate *
+                                  d_window_power);
+      for (size_t i = 0; i < size; i++) {
+        /* Negative frequencies first, as fftshift has them */
+        double p = d_sum[(i + size / 2) % size] * scale;
+        out[i] = p > 0 ? 10 * log10(p) : -INFINITY;
+      }
+      return out;
+    }
+
+    double
+    welch_psd::frequency(size_t i) const
+    {
+      const double size = (double)d_fft.size();
+      return (i - size / 2) * d_samp_rate / size;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
@@ -0,0 +1,83 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_WELCH_PSD_H
+#define INCLUDED_BLADERF_WELCH_PSD_H
+
+#include <complex>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "radix2_fft.h"
+
+namespace gr {
+  namespace bladerf {
+
+    class worker_pool;
+
+    /*!
+     * \brief Welch power spectral density of a stream of any length.
+     *
+     * Hann windowed segments of size samples overlap by half. process()
+     * takes input in blocks of any size and carries the partial segment
+     * over, so a capture far larger than memory can be fed through a
+     * block at a time; the whole segments of a block are transformed in
+     * tasks of a fixed number of segments, on a worker_pool when given
+     * one, and summed in task order, so the estimate is the same bit
+     * for bit on any number of threads.
+     */
+    class welch_psd
+    {
+     public:
+      welch_psd(size_t size, double samp_rate, worker_pool *pool = NULL);
+
+      void process(const std::complex<float> *in, size_t n);
+
+      /* Density per bin in dB relative to full scale per Hz, from -fs/2
+       * up, after the segments so far */
+      std::vector<double> density_db() const;
+
+      /* Centre of bin i of density_db() */
+      double frequency(size_t i) const;
+
+      size_t size() const { return d_fft.size(); }
+      uint64_t segments() const { return d_segments; }
+
+     private:
+      radix2_fft d_fft;
+      double d_samp_rate;
+      worker_pool *d_pool;
+      std::vector<float> d_window;
+      double d_window_power;              /* sum of squared taps */
+      std::vector<std::complex<float> > d_pending;
+      std::vector<std::vector<double> > d_partial;   /* per task */
+      std::vector<double> d_sum;
+      uint64_t d_segments;
+
+      void transform(const std::complex<float> *in, size_t segments,
+                     size_t task);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_WELCH_PSD_H */
@@ -0,0 +1,121 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <boost/bind.hpp>
+#include "thread_utils.h"
+#include "worker_pool.h"
+
+namespace gr {
+  namespace bladerf {
+
+    worker_pool::worker_pool(size_t nthreads, const std::vector<int> &cpus,
+                             int rt_priority)
+      : d_task(NULL),
+        d_ntasks(0),
+        d_next(0),
+        d_pending(0),
+        d_generation(0),
+        d_stop(false)
+    {
+      for (size_t i = 0; i < nthreads; i++) {
+        std::vector<int> cpu;
+        if (!cpus.empty()) {
+          cpu.push_back(cpus[i % cpus.size()]);
+        }
+        d_threads.push_back(boost::shared_ptr<boost::thread>(
+          new boost::thread(boost::bind(&worker_pool::worker, this, i, cpu,
+                                        rt_priority))));
+      }
+    }
+
+    worker_pool::~worker_pool()
+    {
+      {
+        boost::mutex::scoped_lock lock(d_mutex);
+        d_stop = true;
+        d_start.notify_all();
+      }
+      for (size_t i = 0; i < d_threads.size(); i++) {
+        d_threads[i]->join();
+      }
+    }
+
+    /* Take tasks until none are left; the lock is dropped while one runs */
+    void
+    worker_pool::drain(boost::mutex::scoped_lock &lock)
+    {
+      while (d_next < d_ntasks) {
+        size_t task = d_next++;
+        const task_fn *fn = d_task;
+        lock.unlock();
+        (*fn)(task);
+        lock.lock();
+        if (--d_pending == 0) {
+          d_done.notify_all();
+        }
+      }
+    }
+
+    void
+    worker_pool::worker(size_t index, std::vector<int> cpus, int rt_priority)
+    {
+      unsigned long seen = 0;
+
+      setup_current_thread("worker", cpus, rt_priority);
+
+      boost::mutex::scoped_lock lock(d_mutex);
+      while (true) {
+        while (!d_stop && d_generation == seen) {
+          d_start.wait(lock);
+        }
+        if (d_stop) {
+          return;
+        }
+        seen = d_generation;
+        drain(lock);
+      }
+    }
+
+    void
+    worker_pool::run(size_t ntasks, const task_fn &task)
+    {
+      boost::mutex::scoped_lock lock(d_mutex);
+      d_task = &task;
+      d_ntasks = ntasks;
+      d_next = 0;
+      d_pending = ntasks;
+      d_generation++;
+      d_start.notify_all();
+
+      drain(lock);
+      while (d_pending > 0) {
+        d_done.wait(lock);
+      }
+      d_task = NULL;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
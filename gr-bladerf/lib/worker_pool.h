@@ -0,0 +1,80 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_WORKER_POOL_H
+#define INCLUDED_BLADERF_WORKER_POOL_H
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+#include <stddef.h>
+
+namespace gr {
+  namespace bladerf {
+
+    /*!
+     * \brief Fixed set of threads that run indexed tasks in parallel.
+     *
+     * run() hands task indices 0..ntasks-1 out to the workers and to the
+     * calling thread, and returns once every one has finished. The
+     * threads are created once, so a per-block fan out costs a wake-up
+     * instead of a thread start.
+     */
+    class worker_pool
+    {
+     public:
+      typedef boost::function<void (size_t task)> task_fn;
+
+      /* nthreads extra threads, each pinned to the matching entry of
+       * cpus when given */
+      worker_pool(size_t nthreads, const std::vector<int> &cpus,
+                  int rt_priority);
+      ~worker_pool();
+
+      void run(size_t ntasks, const task_fn &task);
+
+      size_t size() const { return d_threads.size() + 1; }
+
+     private:
+      std::vector<boost::shared_ptr<boost::thread> > d_threads;
+      boost::mutex d_mutex;
+      boost::condition_variable d_start;
+      boost::condition_variable d_done;
+
+      const task_fn *d_task;
+      size_t d_ntasks;
+      size_t d_next;
+      size_t d_pending;
+      unsigned long d_generation;
+      bool d_stop;
+
+      void worker(size_t index, std::vector<int> cpus, int rt_priority);
+      void drain(boost::mutex::scoped_lock &lock);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_WORKER_POOL_H */
@@ -0,0 +1,91 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include <algorithm>
+#include "xlating_decimator_impl.h"
+
+namespace gr {
+  namespace bladerf {
+
+    /* Outputs per channel_decimator call */
+    static const int OUTPUTS_PER_CALL = 1024;
+
+    xlating_decimator::sptr
+    xlating_decimator::make(double samp_rate, double offset, int decim,
+                            double passband, double stopband)
+    {
+      return gnuradio::get_initial_sptr
+        (new xlating_decimator_impl(samp_rate, offset, decim, passband,
+                                    stopband));
+    }
+
+    /*
+     * The private constructor
+     */
+    xlating_decimator_impl::xlating_decimator_impl(double samp_rate,
+                                                   double offset, int decim,
+                                                   double passband,
+                                                   double stopband)
+      : gr::sync_decimator("xlating_decimator",
+              gr::io_signature::make(1, 1, sizeof(gr_complex)),
+              gr::io_signature::make(1, 1, sizeof(gr_complex)), decim),
+        _decim(decim)
+    {
+      _decimator.reset(new channel_decimator(samp_rate, offset, decim,
+                                             passband, stopband,
+                                             decim * OUTPUTS_PER_CALL));
+    }
+
+    /*
+     * Our virtual destructor.
+     */
+    xlating_decimator_impl::~xlating_decimator_impl()
+    {
+    }
+
+    int
+    xlating_decimator_impl::work(int noutput_items,
+        gr_vector_const_void_star &input_items,
+        gr_vector_void_star &output_items)
+    {
+      const gr_complex *in = (const gr_complex *)input_items[0];
+      gr_complex *out = (gr_complex *)output_items[0];
+      int produced = 0;
+
+      /* Whole multiples of decim in give exactly one output each */
+      while (produced < noutput_items) {
+        int n = std::min(noutput_items - produced, OUTPUTS_PER_CALL);
+        produced += _decimator->process(in + produced * _decim,
+                                        n * _decim, out + produced);
+      }
+
+      // Tell runtime system how many output items we produced.
+      return produced;
+    }
+
+  } /* namespace bladerf */
+} /* namespace gr */
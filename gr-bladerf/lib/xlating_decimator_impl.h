@@ -0,0 +1,52 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 foci.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_BLADERF_XLATING_DECIMATOR_IMPL_H
+#define INCLUDED_BLADERF_XLATING_DECIMATOR_IMPL_H
+
+#include <bladerf/xlating_decimator.h>
+#include <boost/shared_ptr.hpp>
+#include "channel_decimator.h"
+
+namespace gr {
+  namespace bladerf {
+
+    class xlating_decimator_impl : public xlating_decimator
+    {
+     private:
+      boost::shared_ptr<channel_decimator> _decimator;
+      int _decim;
+
+     public:
+      xlating_decimator_impl(double samp_rate, double offset, int decim,
+                             double passband, double stopband);
+      ~xlating_decimator_impl();
+
+      int work(int noutput_items,
+               gr_vector_const_void_star &input_items,
+               gr_vector_void_star &output_items);
+    };
+
+  } // namespace bladerf
+} // namespace gr
+
+#endif /* INCLUDED_BLADERF_XLATING_DECIMATOR_IMPL_H */
@@ -9,8 +9,24 @@
 
 %{
 #include "bladerf/single_rx.h"
+#include "bladerf/multi_rx.h"
+#include "bladerf/core_layout.h"
+#include "bladerf/xlating_decimator.h"
+#include "bladerf/bus_source.h"
+#include "bladerf/stream_source.h"
 %}
 
 
 %include "bladerf/single_rx.h"
 GR_SWIG_BLOCK_MAGIC2(bladerf, single_rx);
+%include "bladerf/multi_rx.h"
+GR_SWIG_BLOCK_MAGIC2(bladerf, multi_rx);
+%include "bladerf/xlating_decimator.h"
+GR_SWIG_BLOCK_MAGIC2(bladerf, xlating_decimator);
+%include "bladerf/bus_source.h"
+GR_SWIG_BLOCK_MAGIC2(bladerf, bus_source);
+%include "bladerf/stream_source.h"
+GR_SWIG_BLOCK_MAGIC2(bladerf, stream_source);
+
+%include "bladerf/core_layout.h"
+%template(cpu_info_vector) std::vector<gr::bladerf::cpu_info>;